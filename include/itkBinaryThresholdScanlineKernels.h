@@ -0,0 +1,108 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkBinaryThresholdScanlineKernels_h
+#define __itkBinaryThresholdScanlineKernels_h
+
+#include <cstddef>
+
+namespace itk
+{
+
+/** \class BinaryThresholdScanlineKernels
+ *
+ * \brief Thresholds contiguous runs of pixels into unsigned char labels.
+ *
+ * Each kernel writes insideValue where lower <= input <= upper, and
+ * outsideValue everywhere else (including NaN inputs). The instruction set
+ * is chosen once, at run time, among AVX2, SSE4.1 and plain C++, from what
+ * the processor supports. SetMaximumInstructionSet() restricts the choice,
+ * which is how the vector kernels are checked against the scalar one.
+ */
+class BinaryThresholdScanlineKernels
+{
+public:
+  typedef enum { Scalar = 0, SSE41, AVX2 } InstructionSetType;
+
+  static void Threshold( const unsigned char * input, unsigned char * output,
+                         std::size_t length,
+                         unsigned char lower, unsigned char upper,
+                         unsigned char insideValue, unsigned char outsideValue );
+
+  static void Threshold( const float * input, unsigned char * output,
+                         std::size_t length,
+                         float lower, float upper,
+                         unsigned char insideValue, unsigned char outsideValue );
+
+  /** Instruction set used by the kernels. */
+  static InstructionSetType GetInstructionSet();
+  static const char * GetInstructionSetName();
+
+  /** Do not use instructions beyond this set, even if they are available. */
+  static void SetMaximumInstructionSet( InstructionSetType instructionSet );
+
+private:
+  static InstructionSetType DetectInstructionSet();
+
+  static InstructionSetType m_MaximumInstructionSet;
+};
+
+/** \class BinaryThresholdScanline
+ *
+ * \brief Selects at compile time whether a pair of pixel types has a
+ * scanline kernel.
+ */
+template< typename TInputPixel, typename TOutputPixel >
+struct BinaryThresholdScanline
+{
+  static const bool Supported = false;
+
+  static void Run( const TInputPixel *, TOutputPixel *, std::size_t,
+                   TInputPixel, TInputPixel, TOutputPixel, TOutputPixel ) {}
+};
+
+template<>
+struct BinaryThresholdScanline< unsigned char, unsigned char >
+{
+  static const bool Supported = true;
+
+  static void Run( const unsigned char * input, unsigned char * output, std::size_t length,
+                   unsigned char lower, unsigned char upper,
+                   unsigned char insideValue, unsigned char outsideValue )
+  {
+    BinaryThresholdScanlineKernels::Threshold( input, output, length,
+      lower, upper, insideValue, outsideValue );
+  }
+};
+
+template<>
+struct BinaryThresholdScanline< float, unsigned char >
+{
+  static const bool Supported = true;
+
+  static void Run( const float * input, unsigned char * output, std::size_t length,
+                   float lower, float upper,
+                   unsigned char insideValue, unsigned char outsideValue )
+  {
+    BinaryThresholdScanlineKernels::Threshold( input, output, length,
+      lower, upper, insideValue, outsideValue );
+  }
+};
+
+} // end namespace itk
+
+#endif
@@ -0,0 +1,168 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkBitPackedImageIO_h
+#define __itkBitPackedImageIO_h
+
+#include "itkStreamingImageIOBase.h"
+
+#include <fstream>
+#include <vector>
+
+namespace itk
+{
+
+/** \class BitPackedImageIO
+ *
+ * \brief ImageIO for binary volumes stored with one bit per voxel
+ * (".bitvol").
+ *
+ * The segmentation results are unsigned char images holding only 0 and
+ * 255, so seven bits out of eight are wasted on disk and in the page
+ * cache. This format stores one bit per voxel, with X varying fastest
+ * and every row padded to a whole number of bytes, so that any region
+ * can be read or written row by row without touching its neighbors.
+ * Bits are stored least significant first.
+ *
+ * The file starts with a text header of "Key = Value" lines ending with
+ * "HeaderEnd", padded to a multiple of 512 bytes, followed by the rows.
+ *
+ * Images are read as unsigned char, with ForegroundValue for the set
+ * bits and 0 elsewhere. Only unsigned char scalar images holding 0 and a
+ * single other value can be written. That value is the ForegroundValue
+ * when it was set, and the first non-zero voxel written otherwise; any
+ * other non-zero voxel is an error, since it could not be read back.
+ * Streamed and pasted writes are supported, as long as all the pieces of
+ * a file go through the same ImageIO: rows that are only partly covered
+ * by a piece are merged with the bits written by the earlier pieces. The
+ * first piece written to a file truncates it, so a later writer with a
+ * new ImageIO starts the file over instead of pasting into it.
+ *
+ * Only the files are packed: the images in memory are still unsigned
+ * char, one byte per voxel, so the savings are on disk and in the page
+ * cache, while streaming is what bounds the memory of the filters.
+ */
+class BitPackedImageIO : public StreamingImageIOBase
+{
+public:
+  /** Standard class typedefs. */
+  typedef BitPackedImageIO         Self;
+  typedef StreamingImageIOBase     Superclass;
+  typedef SmartPointer< Self >     Pointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro(Self);
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro(BitPackedImageIO, StreamingImageIOBase);
+
+  /** Value of the foreground voxels. It is stored in the header of the
+   * files that are written, and read back from the files that are read.
+   * Unless it is set, files are written with the value of their first
+   * non-zero voxel. */
+  virtual void SetForegroundValue( unsigned char value )
+  {
+    m_ForegroundValue = value;
+    m_ForegroundValueFromData = false;
+    this->Modified();
+  }
+  itkGetConstMacro(ForegroundValue, unsigned char);
+
+  /** Images of up to three dimensions are supported. */
+  virtual bool SupportsDimension(unsigned long dim)
+  {
+    return dim >= 1 && dim <= 3;
+  }
+
+  /** Determine the file type. Returns true if this ImageIO can read the
+   * file specified. */
+  virtual bool CanReadFile(const char *);
+
+  /** Set the spacing and dimension information for the set filename. */
+  virtual void ReadImageInformation();
+
+  /** Reads and expands the rows of the IORegion into the buffer. */
+  virtual void Read(void *buffer);
+
+  /** Determine the file type. Returns true if this ImageIO can write the
+   * file specified. */
+  virtual bool CanWriteFile(const char *);
+
+  /** The header is written together with the first piece of data. */
+  virtual void WriteImageInformation() {}
+
+  /** Packs the IORegion of the buffer into the rows of the file. */
+  virtual void Write(const void *buffer);
+
+  /** Size of the text header, the rows start right after it. */
+  virtual SizeType GetHeaderSize() const
+  {
+    return static_cast< SizeType >( m_HeaderSize );
+  }
+
+protected:
+  BitPackedImageIO();
+  ~BitPackedImageIO();
+  void PrintSelf(std::ostream & os, Indent indent) const;
+
+private:
+  BitPackedImageIO(const Self &); // Purposely not implemented
+  void operator=(const Self &);   // Purposely not implemented
+
+  typedef std::vector< unsigned char > RowBufferType;
+
+  /** Size of the image, and index and size of the IORegion, along X, Y
+   * and Z, with missing dimensions of size one. */
+  SizeValueType GetDimension( unsigned int i ) const;
+  void GetIORegionExtent( IndexValueType index[3], SizeValueType size[3] ) const;
+
+  /** Bytes taken by one row of the image. */
+  SizeValueType GetRowLength() const;
+
+  /** File offset of the first byte of row (y, z). */
+  uint64_t GetRowOffset( SizeValueType y, SizeValueType z ) const;
+
+  /** Bits [begin, end) of a row, whose byte begin / 8 is packed[0]. */
+  void UnpackBits( const unsigned char * packed, SizeValueType begin, SizeValueType end,
+                   unsigned char * pixels ) const;
+  static void PackBits( const unsigned char * pixels, SizeValueType begin, SizeValueType end,
+                        unsigned char * packed );
+
+  /** Throws unless the pixels hold only 0 and the foreground value,
+   * which is taken from the first non-zero pixel if it is not known. */
+  void CheckBinaryPixels( const unsigned char * pixels, SizeValueType numberOfPixels );
+
+  void BeginWriting();
+  void EndWriting();
+
+  std::string CreateHeader() const;
+
+  unsigned char                   m_ForegroundValue;
+  bool                            m_ForegroundValueFromData;
+  bool                            m_ForegroundValueKnown;
+  bool                            m_HeaderOutdated;
+  uint64_t                        m_HeaderSize;
+
+  std::fstream                    m_OutputFile;
+  bool                            m_Writing;
+  std::string                     m_WritingFileName;
+  SizeValueType                   m_NumberOfPixelsWritten;
+};
+
+} // end namespace itk
+
+#endif
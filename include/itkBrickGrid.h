@@ -0,0 +1,273 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkBrickGrid_h
+#define __itkBrickGrid_h
+
+#include "itkImageRegion.h"
+
+#include <cstring>
+#include <vector>
+
+namespace itk
+{
+
+/** \class BrickGrid
+ *
+ * \brief Partition of an image region into fixed-size bricks.
+ *
+ * Bricks are numbered with the first dimension varying fastest. Bricks
+ * on the upper faces of the image are clipped to the image region.
+ */
+template< unsigned int VDimension >
+class BrickGrid
+{
+public:
+  typedef ImageRegion< VDimension >       RegionType;
+  typedef typename RegionType::SizeType   SizeType;
+  typedef typename RegionType::IndexType  IndexType;
+  typedef SizeValueType                   BrickIdType;
+  typedef std::vector< BrickIdType >      BrickIdListType;
+
+  BrickGrid()
+  {
+    m_BrickSize.Fill( 1 );
+    m_GridSize.Fill( 0 );
+  }
+
+  BrickGrid( const RegionType & imageRegion, const SizeType & brickSize )
+  {
+    m_ImageRegion = imageRegion;
+    this->SetBrickSize( brickSize );
+  }
+
+  void SetImageRegion( const RegionType & imageRegion )
+  {
+    m_ImageRegion = imageRegion;
+    this->ComputeGridSize();
+  }
+
+  const RegionType & GetImageRegion() const { return m_ImageRegion; }
+
+  void SetBrickSize( const SizeType & brickSize )
+  {
+    m_BrickSize = brickSize;
+    this->ComputeGridSize();
+  }
+
+  const SizeType & GetBrickSize() const { return m_BrickSize; }
+
+  /** Number of bricks along every dimension. */
+  const SizeType & GetGridSize() const { return m_GridSize; }
+
+  BrickIdType GetNumberOfBricks() const
+  {
+    BrickIdType count = 1;
+    for( unsigned int i = 0; i < VDimension; i++ )
+      {
+      count *= m_GridSize[i];
+      }
+    return count;
+  }
+
+  IndexType GetGridIndex( BrickIdType id ) const
+  {
+    IndexType gridIndex;
+    for( unsigned int i = 0; i < VDimension; i++ )
+      {
+      gridIndex[i] = static_cast< IndexValueType >( id % m_GridSize[i] );
+      id /= m_GridSize[i];
+      }
+    return gridIndex;
+  }
+
+  BrickIdType GetBrickId( const IndexType & gridIndex ) const
+  {
+    BrickIdType id = 0;
+    for( unsigned int i = VDimension; i > 0; i-- )
+      {
+      id = id * m_GridSize[i-1] + gridIndex[i-1];
+      }
+    return id;
+  }
+
+  /** Brick that contains a pixel index of the image. */
+  BrickIdType GetBrickIdContaining( const IndexType & pixel ) const
+  {
+    IndexType gridIndex;
+    for( unsigned int i = 0; i < VDimension; i++ )
+      {
+      gridIndex[i] = ( pixel[i] - m_ImageRegion.GetIndex(i) ) / m_BrickSize[i];
+      }
+    return this->GetBrickId( gridIndex );
+  }
+
+  /** Pixels covered by a brick, clipped to the image region. */
+  RegionType GetBrickRegion( BrickIdType id ) const
+  {
+    const IndexType gridIndex = this->GetGridIndex( id );
+
+    RegionType region;
+    for( unsigned int i = 0; i < VDimension; i++ )
+      {
+      const IndexValueType start = m_ImageRegion.GetIndex(i) + gridIndex[i] * m_BrickSize[i];
+      const IndexValueType end   = m_ImageRegion.GetIndex(i) + m_ImageRegion.GetSize(i);
+
+      SizeValueType size = m_BrickSize[i];
+      if( start + static_cast< IndexValueType >( size ) > end )
+        {
+        size = end - start;
+        }
+
+      region.SetIndex( i, start );
+      region.SetSize( i, size );
+      }
+    return region;
+  }
+
+  /** Range of grid indices of the bricks that touch a region. */
+  RegionType GetGridRegion( const RegionType & region ) const
+  {
+    RegionType gridRegion;
+    for( unsigned int i = 0; i < VDimension; i++ )
+      {
+      if( region.GetSize(i) == 0 )
+        {
+        gridRegion.SetIndex( i, 0 );
+        gridRegion.SetSize( i, 0 );
+        continue;
+        }
+      const IndexValueType first = ( region.GetIndex(i) - m_ImageRegion.GetIndex(i) ) / m_BrickSize[i];
+      const IndexValueType last  = ( region.GetIndex(i) + region.GetSize(i) - 1
+                                     - m_ImageRegion.GetIndex(i) ) / m_BrickSize[i];
+      gridRegion.SetIndex( i, first );
+      gridRegion.SetSize( i, last - first + 1 );
+      }
+    return gridRegion;
+  }
+
+  /** Bricks that touch a region, in increasing order of id. */
+  BrickIdListType GetBricksIntersecting( const RegionType & region ) const
+  {
+    BrickIdListType bricks;
+
+    const RegionType gridRegion = this->GetGridRegion( region );
+
+    if( gridRegion.GetNumberOfPixels() == 0 )
+      {
+      return bricks;
+      }
+
+    bricks.reserve( gridRegion.GetNumberOfPixels() );
+
+    IndexType gridIndex = gridRegion.GetIndex();
+
+    while( true )
+      {
+      bricks.push_back( this->GetBrickId( gridIndex ) );
+
+      unsigned int i = 0;
+      for( ; i < VDimension; i++ )
+        {
+        gridIndex[i]++;
+        if( gridIndex[i] < gridRegion.GetIndex(i) +
+            static_cast< IndexValueType >( gridRegion.GetSize(i) ) )
+          {
+          break;
+          }
+        gridIndex[i] = gridRegion.GetIndex(i);
+        }
+      if( i == VDimension )
+        {
+        break;
+        }
+      }
+
+    return bricks;
+  }
+
+  /** Copy the pixels of overlap from a buffer laid out over sourceRegion
+   * into a buffer laid out over destinationRegion. Both buffers store
+   * pixelSize bytes per pixel with the first dimension varying fastest. */
+  static void CopyRegion( const char * source, const RegionType & sourceRegion,
+                          char * destination, const RegionType & destinationRegion,
+                          const RegionType & overlap, SizeValueType pixelSize )
+  {
+    if( overlap.GetNumberOfPixels() == 0 )
+      {
+      return;
+      }
+
+    const SizeValueType rowBytes = overlap.GetSize(0) * pixelSize;
+
+    IndexType index = overlap.GetIndex();
+
+    while( true )
+      {
+      std::memcpy( destination + Offset( destinationRegion, index ) * pixelSize,
+                   source + Offset( sourceRegion, index ) * pixelSize,
+                   rowBytes );
+
+      unsigned int i = 1;
+      for( ; i < VDimension; i++ )
+        {
+        index[i]++;
+        if( index[i] < overlap.GetIndex(i) +
+            static_cast< IndexValueType >( overlap.GetSize(i) ) )
+          {
+          break;
+          }
+        index[i] = overlap.GetIndex(i);
+        }
+      if( i >= VDimension )
+        {
+        break;
+        }
+      }
+  }
+
+private:
+  static SizeValueType Offset( const RegionType & region, const IndexType & index )
+  {
+    SizeValueType offset = 0;
+    for( unsigned int i = VDimension; i > 0; i-- )
+      {
+      offset = offset * region.GetSize(i-1) + ( index[i-1] - region.GetIndex(i-1) );
+      }
+    return offset;
+  }
+
+  void ComputeGridSize()
+  {
+    for( unsigned int i = 0; i < VDimension; i++ )
+      {
+      if( m_BrickSize[i] == 0 )
+        {
+        m_BrickSize[i] = 1;
+        }
+      m_GridSize[i] = ( m_ImageRegion.GetSize(i) + m_BrickSize[i] - 1 ) / m_BrickSize[i];
+      }
+  }
+
+  RegionType  m_ImageRegion;
+  SizeType    m_BrickSize;
+  SizeType    m_GridSize;
+};
+
+} // end namespace itk
+
+#endif
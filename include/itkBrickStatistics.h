@@ -0,0 +1,116 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkBrickStatistics_h
+#define __itkBrickStatistics_h
+
+#include "itkBrickGrid.h"
+#include "itkImageIOBase.h"
+
+#include <string>
+#include <vector>
+
+namespace itk
+{
+
+/** \class BrickStatistics
+ *
+ * \brief Minimum, maximum, mean and a coarse histogram of every brick of
+ * a volume, kept in a small text file next to it.
+ *
+ * The sidecar of "volume.bvol" is "volume.bvol.stats". It is written by
+ * BrickedImageIO, which has every brick in memory when the brick is
+ * complete, so collecting the statistics costs no extra pass. Readers
+ * then get the range of the whole volume in constant time, and can tell
+ * which bricks are uniform under a threshold without touching the data.
+ *
+ * The histogram of a brick has NumberOfBins bins that evenly divide the
+ * range of that brick. NaN pixels are left out of all the statistics;
+ * Count is the number of the other pixels.
+ */
+class BrickStatistics
+{
+public:
+  typedef BrickGrid< 3 >                GridType;
+  typedef GridType::RegionType          RegionType;
+  typedef GridType::SizeType            SizeType;
+  typedef GridType::BrickIdType         BrickIdType;
+
+  static const unsigned int NumberOfBins = 16;
+
+  struct BrickType
+    {
+    double          Minimum;
+    double          Maximum;
+    double          Mean;
+    SizeValueType   Count;
+    SizeValueType   Histogram[NumberOfBins];
+    bool            Valid;
+    };
+
+  /** How the pixels of a brick compare with a [lower, upper] interval. */
+  typedef enum { Mixed = 0, AllInside, AllOutside } ClassificationType;
+
+  BrickStatistics();
+
+  /** Start over with no brick known. */
+  void Initialize( const RegionType & imageRegion, const SizeType & brickSize );
+
+  const GridType & GetGrid() const { return m_Grid; }
+
+  /** Collect the statistics of a brick from its pixels, stored as the
+   * brick region with X varying fastest. */
+  void ComputeBrick( BrickIdType id, const void * pixels,
+                     ImageIOBase::IOComponentType componentType );
+
+  const BrickType & GetBrick( BrickIdType id ) const { return m_Bricks[id]; }
+
+  /** Whether every brick has its statistics. */
+  bool IsComplete() const;
+
+  /** Statistics of the whole volume, updated with every brick. */
+  double GetMinimum() const { return m_Minimum; }
+  double GetMaximum() const { return m_Maximum; }
+  double GetMean() const;
+
+  ClassificationType Classify( BrickIdType id, double lower, double upper ) const;
+
+  /** Throw an ExceptionObject on failure. */
+  void Write( const std::string & fileName ) const;
+  void Read( const std::string & fileName );
+
+  /** Name of the sidecar of an image file. */
+  static std::string GetSidecarFileName( const std::string & imageFileName );
+
+private:
+  template< typename TPixel >
+  void ComputeBrickFromPixels( BrickIdType id, const TPixel * pixels );
+
+  void AddToVolume( const BrickType & brick );
+
+  GridType                  m_Grid;
+  std::vector< BrickType >  m_Bricks;
+
+  double                    m_Minimum;
+  double                    m_Maximum;
+  double                    m_Sum;
+  SizeValueType             m_Count;
+};
+
+} // end namespace itk
+
+#endif
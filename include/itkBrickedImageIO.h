@@ -0,0 +1,261 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkBrickedImageIO_h
+#define __itkBrickedImageIO_h
+
+#include "itkStreamingImageIOBase.h"
+#include "itkMultiThreader.h"
+#include "itkBrickGrid.h"
+#include "itkBrickStatistics.h"
+
+#include <fstream>
+#include <list>
+#include <map>
+#include <vector>
+
+namespace itk
+{
+
+/** \class BrickedImageIO
+ *
+ * \brief ImageIO for volumes stored as fixed-size bricks (".bvol").
+ *
+ * A MetaImage file stores the voxels as one stream with Z varying
+ * slowest, so a sub-volume that is not a full-width slab touches far
+ * more of the file than it covers. This format cuts the volume into
+ * bricks (64x64x64 by default) that are stored contiguously, and a
+ * streamed read only fetches the bricks that intersect the requested
+ * region.
+ *
+ * The file starts with a text header of "Key = Value" lines ending with
+ * "HeaderEnd", padded to a multiple of 512 bytes. It is followed by the
+ * brick index, one pair of 64 bits integers (file offset, length in
+ * bytes) per brick, and by the brick data. Bricks are numbered with X
+ * varying fastest and bricks on the upper faces are clipped to the image.
+ *
+ * Streamed and pasted writes are supported, as long as all the pieces of
+ * a file go through the same ImageIO: the first piece written to a file
+ * truncates it, so a later writer with a new ImageIO starts the file over
+ * instead of pasting into it. A brick stays in memory until all of its
+ * pixels have been written and it is then appended to the file; the
+ * index is written when the last brick is complete, or when the ImageIO
+ * is destroyed. The written pieces must not overlap.
+ *
+ * Decoded bricks are kept in a least recently used cache so that
+ * consecutive streamed reads do not fetch again the bricks they share.
+ *
+ * With UseCompression on, every brick is deflated on its own with zlib,
+ * so streamed writes remain possible and a read only inflates the bricks
+ * that it touches. Bricks are encoded and decoded on several threads.
+ *
+ * With WriteStatistics on, the statistics of every scalar brick are
+ * collected when the brick is complete and written to the BrickStatistics
+ * sidecar of the file once the file is complete.
+ */
+class BrickedImageIO : public StreamingImageIOBase
+{
+public:
+  /** Standard class typedefs. */
+  typedef BrickedImageIO           Self;
+  typedef StreamingImageIOBase     Superclass;
+  typedef SmartPointer< Self >     Pointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro(Self);
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro(BrickedImageIO, StreamingImageIOBase);
+
+  itkStaticConstMacro(GridDimension, unsigned int, 3);
+
+  typedef BrickGrid< GridDimension >         GridType;
+  typedef GridType::RegionType               GridRegionType;
+  typedef GridType::SizeType                 BrickSizeType;
+  typedef GridType::BrickIdType              BrickIdType;
+
+  /** Size of the bricks of the files that are written. */
+  void SetBrickSize( const BrickSizeType & size );
+  void SetBrickSize( SizeValueType size );
+  const BrickSizeType & GetBrickSize() const { return m_BrickSize; }
+
+  /** Memory taken by the bricks that stay pending while an image of the
+   * given size is written in slabs along its slowest dimension: up to one
+   * layer of bricks across the other dimensions. */
+  SizeValueType ComputePendingMemory( const std::vector< SizeValueType > & imageSize,
+                                      SizeValueType bytesPerPixel ) const;
+
+  /** Number of decoded bricks kept in memory while reading. Zero selects
+   * one layer of bricks of the file being read. */
+  itkSetMacro(MaximumNumberOfCachedBricks, unsigned int);
+  itkGetConstMacro(MaximumNumberOfCachedBricks, unsigned int);
+
+  /** zlib level used when UseCompression is on. The default favors speed. */
+  itkSetClampMacro(CompressionLevel, int, 1, 9);
+  itkGetConstMacro(CompressionLevel, int);
+
+  /** Write the BrickStatistics sidecar along with the file. */
+  itkSetMacro(WriteStatistics, bool);
+  itkGetConstMacro(WriteStatistics, bool);
+  itkBooleanMacro(WriteStatistics);
+
+  /** Threads used to encode and decode bricks. */
+  itkSetClampMacro(NumberOfThreads, ThreadIdType, 1, ITK_MAX_THREADS);
+  itkGetConstMacro(NumberOfThreads, ThreadIdType);
+
+  /** Images of up to three dimensions are supported. */
+  virtual bool SupportsDimension(unsigned long dim)
+  {
+    return dim >= 1 && dim <= GridDimension;
+  }
+
+  /** Determine the file type. Returns true if this ImageIO can read the
+   * file specified. */
+  virtual bool CanReadFile(const char *);
+
+  /** Set the spacing and dimension information for the set filename. */
+  virtual void ReadImageInformation();
+
+  /** Reads the bricks intersecting the IORegion into the buffer. */
+  virtual void Read(void *buffer);
+
+  /** Determine the file type. Returns true if this ImageIO can write the
+   * file specified. */
+  virtual bool CanWriteFile(const char *);
+
+  /** The header is written together with the first piece of data. */
+  virtual void WriteImageInformation() {}
+
+  /** Writes the IORegion of the buffer into its bricks. */
+  virtual void Write(const void *buffer);
+
+  /** Size of the text header, the brick index starts right after it. */
+  virtual SizeType GetHeaderSize() const
+  {
+    return static_cast< SizeType >( m_IndexOffset );
+  }
+
+protected:
+  BrickedImageIO();
+  ~BrickedImageIO();
+  void PrintSelf(std::ostream & os, Indent indent) const;
+
+private:
+  BrickedImageIO(const Self &); // Purposely not implemented
+  void operator=(const Self &); // Purposely not implemented
+
+  struct IndexEntryType
+    {
+    uint64_t Offset;
+    uint64_t Length;
+    };
+
+  struct CachedBrickType
+    {
+    std::vector< char >                  Data;
+    std::list< BrickIdType >::iterator   Position;
+    };
+
+  struct PendingBrickType
+    {
+    std::vector< char >  Data;
+    SizeValueType        NumberOfPixelsWritten;
+    };
+
+  typedef std::vector< char >  BufferType;
+
+  /** Bricks encoded or decoded by the threads of one batch. */
+  struct CodecJobType
+    {
+    BrickIdType   Id;
+    BufferType    Input;
+    BufferType    Output;
+    SizeValueType OutputLength;
+    bool          Failed;
+    };
+
+  struct CodecBatchType
+    {
+    const Self *                  IO;
+    std::vector< CodecJobType > * Jobs;
+    bool                          Encode;
+    };
+
+  SizeValueType GetPixelSize() const;
+
+  GridRegionType GetImageGridRegion() const;
+  GridRegionType GetIORegionAsGridRegion() const;
+
+  SizeValueType GetBrickLength( BrickIdType id ) const;
+
+  /** Read and decode bricks that are not in the cache. */
+  void ReadBricks( std::vector< CodecJobType > & jobs );
+
+  /** Keep a decoded brick, evicting the least recently used ones. */
+  void CacheBrick( BrickIdType id, BufferType & data );
+
+  void OpenForReading();
+  void ClearCache();
+
+  void BeginWriting();
+  void FlushBricks( const std::vector< BrickIdType > & ids );
+  void FlushAllBricks();
+  void EndWriting();
+
+  /** Run the codec on all the jobs, in parallel when compressed. */
+  void RunCodec( std::vector< CodecJobType > & jobs, bool encode ) const;
+
+  void EncodeBrick( CodecJobType & job ) const;
+  void DecodeBrick( CodecJobType & job ) const;
+
+  static ITK_THREAD_RETURN_TYPE CodecThreadCallback( void * arg );
+
+  std::string CreateHeader() const;
+
+  BrickSizeType                   m_BrickSize;
+  unsigned int                    m_MaximumNumberOfCachedBricks;
+  int                             m_CompressionLevel;
+  ThreadIdType                    m_NumberOfThreads;
+  bool                            m_WriteStatistics;
+
+  GridType                        m_Grid;
+  std::vector< IndexEntryType >   m_BrickIndex;
+  std::string                     m_Compression;
+  uint64_t                        m_IndexOffset;
+
+  std::ifstream                   m_InputFile;
+  std::string                     m_OpenFileName;
+  long int                        m_OpenFileModifiedTime;
+
+  std::map< BrickIdType, CachedBrickType >   m_Cache;
+  std::list< BrickIdType >                   m_CacheOrder;
+
+  std::ofstream                   m_OutputFile;
+  bool                            m_Writing;
+  std::string                     m_WritingFileName;
+  uint64_t                        m_WriteOffset;
+  BrickIdType                     m_NumberOfBricksWritten;
+
+  std::map< BrickIdType, PendingBrickType >  m_PendingBricks;
+
+  bool                            m_CollectStatistics;
+  BrickStatistics                 m_Statistics;
+};
+
+} // end namespace itk
+
+#endif
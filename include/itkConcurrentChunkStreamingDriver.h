@@ -0,0 +1,190 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkConcurrentChunkStreamingDriver_h
+#define __itkConcurrentChunkStreamingDriver_h
+
+#include "itkObject.h"
+#include "itkImageToImageFilter.h"
+#include "itkImageFileReader.h"
+#include "itkImageFileWriter.h"
+#include "itkImageChunkSource.h"
+#include "itkMultiThreader.h"
+#include "itkMutexLock.h"
+#include "itkConditionVariable.h"
+#include "itkProcessObserverList.h"
+
+#include <deque>
+#include <vector>
+
+namespace itk
+{
+
+/** \class ConcurrentChunkStreamingDriver
+ *
+ * \brief Streams a reader -> filter -> writer pipeline with several
+ * stream divisions read and filtered at the same time.
+ *
+ * Every worker thread owns a reader per input and a copy of the filter,
+ * given with AddFilter (one filter per worker, all with the same
+ * settings). The stream divisions are dealt to the workers in turns;
+ * a worker that runs out of its own divisions takes the lowest one
+ * still queued by another worker. A separate writer thread pastes the
+ * finished divisions into the output file in order, so the file is the
+ * same the ImageFileWriter would write.
+ *
+ * A division is only started if it is less than
+ * MaximumNumberOfChunksInFlight divisions ahead of the next one to be
+ * written, which bounds the divisions that are held in memory (being
+ * read, filtered, or waiting to be written) at any time.
+ *
+ * The filters keep their own NumberOfThreads, which should usually be
+ * the number of cores divided by the number of workers.
+ */
+template< typename TInputImage, typename TOutputImage >
+class ConcurrentChunkStreamingDriver : public Object
+{
+public:
+  /** Standard class typedefs. */
+  typedef ConcurrentChunkStreamingDriver  Self;
+  typedef Object                          Superclass;
+  typedef SmartPointer< Self >            Pointer;
+  typedef SmartPointer< const Self >      ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro(Self);
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro(ConcurrentChunkStreamingDriver, Object);
+
+  typedef TInputImage                               InputImageType;
+  typedef TOutputImage                              OutputImageType;
+  typedef typename InputImageType::Pointer          InputImagePointer;
+  typedef typename OutputImageType::Pointer         OutputImagePointer;
+  typedef typename OutputImageType::RegionType      RegionType;
+
+  typedef ImageToImageFilter< InputImageType, OutputImageType >  FilterType;
+  typedef ImageFileReader< InputImageType >                      ReaderType;
+  typedef ImageFileWriter< OutputImageType >                     WriterType;
+  typedef ImageChunkSource< InputImageType >                     InputSourceType;
+  typedef ImageChunkSource< OutputImageType >                    OutputSourceType;
+
+  /** One file per input of the filter, in the order of the filter inputs. */
+  void AddInputFileName( const std::string & fileName );
+
+  itkSetStringMacro(OutputFileName);
+  itkGetStringMacro(OutputFileName);
+
+  /** One filter per worker. Their inputs are replaced by the driver. */
+  void AddFilter( FilterType * filter );
+
+  /** Add an observer to the filters, and to the readers and the
+   * writer threads that Update creates, so that a whole run can be watched like
+   * a pipeline. */
+  void AddProcessObserver( const EventObject & event, Command * command );
+
+  unsigned int GetNumberOfWorkers() const
+  {
+    return static_cast< unsigned int >( m_Filters.size() );
+  }
+
+  itkSetMacro(NumberOfStreamDivisions, unsigned int);
+  itkGetConstMacro(NumberOfStreamDivisions, unsigned int);
+
+  itkSetClampMacro(MaximumNumberOfChunksInFlight, unsigned int, 1,
+                   NumericTraits< unsigned int >::max());
+  itkGetConstMacro(MaximumNumberOfChunksInFlight, unsigned int);
+
+  /** Passed to the writer, for formats that compress while streaming. */
+  itkSetMacro(UseCompression, bool);
+  itkGetConstMacro(UseCompression, bool);
+  itkBooleanMacro(UseCompression);
+
+  /** Run the whole pipeline. */
+  void Update();
+
+  /** Stream divisions that were run by another worker than the one
+   * they were dealt to, in the last Update. */
+  itkGetConstMacro(NumberOfStolenChunks, unsigned int);
+
+protected:
+  ConcurrentChunkStreamingDriver();
+  ~ConcurrentChunkStreamingDriver() {}
+  void PrintSelf(std::ostream & os, Indent indent) const;
+
+  struct WorkerType
+    {
+    std::vector< typename ReaderType::Pointer >       Readers;
+    std::vector< typename InputSourceType::Pointer >  InputSources;
+    std::deque< unsigned int >                        Chunks;
+    };
+
+  /** Pick the next stream division for a worker, waiting while none is
+   * allowed to start. Returns false when there is nothing left to do. */
+  bool TakeChunk( unsigned int worker, unsigned int & chunkIndex );
+
+  void RunWorker( unsigned int worker );
+  void WriteChunks();
+
+  /** Record the first error and wake up every thread. */
+  void Abort( const std::string & message );
+
+  static ITK_THREAD_RETURN_TYPE WorkerThreadCallback( void * arg );
+  static ITK_THREAD_RETURN_TYPE WriterThreadCallback( void * arg );
+
+private:
+  ConcurrentChunkStreamingDriver(const Self &); // Purposely not implemented
+  void operator=(const Self &);                 // Purposely not implemented
+
+  std::vector< std::string >                    m_InputFileNames;
+  std::string                                   m_OutputFileName;
+
+  std::vector< typename FilterType::Pointer >   m_Filters;
+
+  ProcessObserverList                           m_ProcessObservers;
+
+  unsigned int                  m_NumberOfStreamDivisions;
+  unsigned int                  m_MaximumNumberOfChunksInFlight;
+  bool                          m_UseCompression;
+
+  std::vector< WorkerType >                     m_Workers;
+  typename OutputSourceType::Pointer            m_OutputSource;
+  typename WriterType::Pointer                  m_Writer;
+
+  /** Output chunks and, for each of them, the region of every input. */
+  std::vector< RegionType >                     m_OutputRegions;
+  std::vector< std::vector< RegionType > >      m_InputRegions;
+
+  /** Filtered chunks waiting for the writer, by chunk index. */
+  std::vector< OutputImagePointer >             m_FinishedChunks;
+  unsigned int                                  m_NextChunkToWrite;
+  unsigned int                                  m_NumberOfStolenChunks;
+
+  bool                          m_Aborted;
+  std::string                   m_ErrorMessage;
+
+  SimpleMutexLock               m_Mutex;
+  ConditionVariable::Pointer    m_Condition;
+};
+
+} // end namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkConcurrentChunkStreamingDriver.hxx"
+#endif
+
+#endif
@@ -0,0 +1,450 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkConcurrentChunkStreamingDriver_hxx
+#define __itkConcurrentChunkStreamingDriver_hxx
+
+#include "itkConcurrentChunkStreamingDriver.h"
+#include "itkSlabRegionSplitter.h"
+#include "itkImageIORegion.h"
+#include "itksys/SystemTools.hxx"
+
+namespace itk
+{
+
+template< typename TInputImage, typename TOutputImage >
+ConcurrentChunkStreamingDriver< TInputImage, TOutputImage >
+::ConcurrentChunkStreamingDriver()
+{
+  m_NumberOfStreamDivisions = 1;
+  m_MaximumNumberOfChunksInFlight = 2;
+  m_UseCompression = false;
+  m_NextChunkToWrite = 0;
+  m_NumberOfStolenChunks = 0;
+  m_Aborted = false;
+  m_Condition = ConditionVariable::New();
+}
+
+template< typename TInputImage, typename TOutputImage >
+void
+ConcurrentChunkStreamingDriver< TInputImage, TOutputImage >
+::AddInputFileName( const std::string & fileName )
+{
+  m_InputFileNames.push_back( fileName );
+  this->Modified();
+}
+
+template< typename TInputImage, typename TOutputImage >
+void
+ConcurrentChunkStreamingDriver< TInputImage, TOutputImage >
+::AddFilter( FilterType * filter )
+{
+  m_Filters.push_back( filter );
+  m_ProcessObservers.Attach( filter );
+  this->Modified();
+}
+
+template< typename TInputImage, typename TOutputImage >
+void
+ConcurrentChunkStreamingDriver< TInputImage, TOutputImage >
+::AddProcessObserver( const EventObject & event, Command * command )
+{
+  m_ProcessObservers.Add( event, command );
+
+  for( size_t w = 0; w < m_Filters.size(); w++ )
+    {
+    m_Filters[w]->AddObserver( event, command );
+    }
+}
+
+template< typename TInputImage, typename TOutputImage >
+void
+ConcurrentChunkStreamingDriver< TInputImage, TOutputImage >
+::Update()
+{
+  if( m_Filters.empty() )
+    {
+    itkExceptionMacro("At least one filter must be given");
+    }
+
+  if( m_InputFileNames.empty() )
+    {
+    itkExceptionMacro("At least one input file name must be given");
+    }
+
+  if( m_OutputFileName == "" )
+    {
+    itkExceptionMacro("Output file name must be set");
+    }
+
+  const unsigned int numberOfInputs = static_cast< unsigned int >( m_InputFileNames.size() );
+  const unsigned int numberOfWorkers = this->GetNumberOfWorkers();
+
+  //
+  // Every worker owns its readers and its filter, so that the
+  // pipelines of different workers never share an object.
+  //
+  m_Workers.clear();
+  m_Workers.resize( numberOfWorkers );
+
+  for( unsigned int w = 0; w < numberOfWorkers; w++ )
+    {
+    for( unsigned int j = 0; j < numberOfInputs; j++ )
+      {
+      typename ReaderType::Pointer reader = ReaderType::New();
+      reader->SetFileName( m_InputFileNames[j] );
+      reader->UpdateOutputInformation();
+      m_ProcessObservers.Attach( reader );
+
+      typename InputSourceType::Pointer source = InputSourceType::New();
+      source->SetReferenceImage( reader->GetOutput() );
+
+      m_Filters[w]->SetInput( j, source->GetOutput() );
+
+      m_Workers[w].Readers.push_back( reader );
+      m_Workers[w].InputSources.push_back( source );
+      }
+
+    m_Filters[w]->UpdateOutputInformation();
+    }
+
+  OutputImageType * filterOutput = m_Filters[0]->GetOutput();
+
+  const RegionType largestRegion = filterOutput->GetLargestPossibleRegion();
+
+  //
+  // Ask the filter which input region (output chunk plus halo)
+  // it needs for every stream division.
+  //
+  const unsigned int numberOfChunks =
+    SlabRegionSplitter< OutputImageType::ImageDimension >::GetNumberOfSplits(
+      largestRegion, m_NumberOfStreamDivisions );
+
+  m_OutputRegions.resize( numberOfChunks );
+  m_InputRegions.resize( numberOfChunks );
+
+  for( unsigned int i = 0; i < numberOfChunks; i++ )
+    {
+    m_OutputRegions[i] =
+      SlabRegionSplitter< OutputImageType::ImageDimension >::GetSplit(
+        i, numberOfChunks, largestRegion );
+
+    filterOutput->SetRequestedRegion( m_OutputRegions[i] );
+    m_Filters[0]->PropagateRequestedRegion( filterOutput );
+
+    m_InputRegions[i].resize( numberOfInputs );
+    for( unsigned int j = 0; j < numberOfInputs; j++ )
+      {
+      m_InputRegions[i][j] = m_Workers[0].InputSources[j]->GetOutput()->GetRequestedRegion();
+      }
+
+    // Dealt in turns, so that every worker starts near the front.
+    m_Workers[i % numberOfWorkers].Chunks.push_back( i );
+    }
+
+  m_OutputSource = OutputSourceType::New();
+  m_OutputSource->SetReferenceImage( filterOutput );
+
+  m_Writer = WriterType::New();
+  m_Writer->SetFileName( m_OutputFileName );
+  m_Writer->SetInput( m_OutputSource->GetOutput() );
+  m_Writer->SetUseCompression( m_UseCompression );
+  m_ProcessObservers.Attach( m_Writer );
+
+  //
+  // Chunks are pasted into the output, so a stale file
+  // with a different header must not be reused.
+  //
+  if( itksys::SystemTools::FileExists( m_OutputFileName.c_str() ) )
+    {
+    itksys::SystemTools::RemoveFile( m_OutputFileName.c_str() );
+    }
+
+  m_FinishedChunks.assign( numberOfChunks, OutputImagePointer() );
+  m_NextChunkToWrite = 0;
+  m_NumberOfStolenChunks = 0;
+  m_Aborted = false;
+  m_ErrorMessage = "";
+
+  MultiThreader::Pointer writerThreader = MultiThreader::New();
+
+  const ThreadIdType writerThread =
+    writerThreader->SpawnThread( Self::WriterThreadCallback, this );
+
+  //
+  // The threader may run fewer workers than there are filters. The
+  // chunks dealt to the missing ones are then taken by the others.
+  //
+  MultiThreader::Pointer workerThreader = MultiThreader::New();
+  workerThreader->SetNumberOfThreads( numberOfWorkers );
+  workerThreader->SetSingleMethod( Self::WorkerThreadCallback, this );
+  workerThreader->SingleMethodExecute();
+
+  writerThreader->TerminateThread( writerThread );
+
+  m_Workers.clear();
+  m_FinishedChunks.clear();
+
+  if( m_Aborted )
+    {
+    itkExceptionMacro("Concurrent streaming failed: " << m_ErrorMessage);
+    }
+}
+
+template< typename TInputImage, typename TOutputImage >
+bool
+ConcurrentChunkStreamingDriver< TInputImage, TOutputImage >
+::TakeChunk( unsigned int worker, unsigned int & chunkIndex )
+{
+  m_Mutex.Lock();
+
+  while( !m_Aborted )
+    {
+    //
+    // The worker's own chunk comes first. Otherwise the lowest queued
+    // chunk of any worker is taken: it is the one the writer will be
+    // waiting for soonest.
+    //
+    std::deque< unsigned int > * queue = NULL;
+
+    if( !m_Workers[worker].Chunks.empty() )
+      {
+      queue = &m_Workers[worker].Chunks;
+      }
+
+    for( unsigned int w = 0; w < m_Workers.size(); w++ )
+      {
+      std::deque< unsigned int > & candidate = m_Workers[w].Chunks;
+      if( !candidate.empty() &&
+          ( queue == NULL ||
+            ( queue->front() >= m_NextChunkToWrite + m_MaximumNumberOfChunksInFlight &&
+              candidate.front() < queue->front() ) ) )
+        {
+        queue = &candidate;
+        }
+      }
+
+    if( queue == NULL )
+      {
+      break;
+      }
+
+    if( queue->front() < m_NextChunkToWrite + m_MaximumNumberOfChunksInFlight )
+      {
+      chunkIndex = queue->front();
+      queue->pop_front();
+
+      if( queue != &m_Workers[worker].Chunks )
+        {
+        m_NumberOfStolenChunks++;
+        }
+
+      m_Mutex.Unlock();
+      return true;
+      }
+
+    // Too far ahead of the writer.
+    m_Condition->Wait( &m_Mutex );
+    }
+
+  m_Mutex.Unlock();
+  return false;
+}
+
+template< typename TInputImage, typename TOutputImage >
+void
+ConcurrentChunkStreamingDriver< TInputImage, TOutputImage >
+::RunWorker( unsigned int worker )
+{
+  WorkerType & state = m_Workers[worker];
+  FilterType * filter = m_Filters[worker];
+
+  unsigned int chunkIndex = 0;
+
+  while( this->TakeChunk( worker, chunkIndex ) )
+    {
+    for( unsigned int j = 0; j < state.Readers.size(); j++ )
+      {
+      ReaderType * reader = state.Readers[j];
+      reader->GetOutput()->SetRequestedRegion( m_InputRegions[chunkIndex][j] );
+      reader->Update();
+
+      InputImagePointer image = reader->GetOutput();
+      image->DisconnectPipeline();
+
+      state.InputSources[j]->SetChunk( image );
+      }
+
+    OutputImagePointer output = filter->GetOutput();
+    output->SetRequestedRegion( m_OutputRegions[chunkIndex] );
+    filter->Update();
+    output->DisconnectPipeline();
+
+    for( unsigned int j = 0; j < state.InputSources.size(); j++ )
+      {
+      state.InputSources[j]->SetChunk( NULL );
+      }
+
+    m_Mutex.Lock();
+    m_FinishedChunks[chunkIndex] = output;
+    m_Condition->Broadcast();
+    m_Mutex.Unlock();
+    }
+}
+
+template< typename TInputImage, typename TOutputImage >
+void
+ConcurrentChunkStreamingDriver< TInputImage, TOutputImage >
+::WriteChunks()
+{
+  const unsigned int numberOfChunks = static_cast< unsigned int >( m_OutputRegions.size() );
+
+  const typename RegionType::IndexType largestIndex =
+    m_OutputSource->GetOutput()->GetLargestPossibleRegion().GetIndex();
+
+  for( unsigned int i = 0; i < numberOfChunks; i++ )
+    {
+    m_Mutex.Lock();
+    while( !m_Aborted && m_FinishedChunks[i].IsNull() )
+      {
+      m_Condition->Wait( &m_Mutex );
+      }
+    if( m_Aborted )
+      {
+      m_Mutex.Unlock();
+      return;
+      }
+    OutputImagePointer output = m_FinishedChunks[i];
+    m_FinishedChunks[i] = NULL;
+    m_Mutex.Unlock();
+
+    ImageIORegion ioRegion( OutputImageType::ImageDimension );
+    ImageIORegionAdaptor< OutputImageType::ImageDimension >::Convert(
+      m_OutputRegions[i], ioRegion, largestIndex );
+
+    m_OutputSource->SetChunk( output );
+    m_Writer->SetIORegion( ioRegion );
+    m_Writer->Update();
+    m_OutputSource->SetChunk( NULL );
+
+    output = NULL;
+
+    m_Mutex.Lock();
+    m_NextChunkToWrite++;
+    m_Condition->Broadcast();
+    m_Mutex.Unlock();
+    }
+}
+
+template< typename TInputImage, typename TOutputImage >
+void
+ConcurrentChunkStreamingDriver< TInputImage, TOutputImage >
+::Abort( const std::string & message )
+{
+  m_Mutex.Lock();
+  if( !m_Aborted )
+    {
+    m_Aborted = true;
+    m_ErrorMessage = message;
+    }
+  m_Condition->Broadcast();
+  m_Mutex.Unlock();
+}
+
+template< typename TInputImage, typename TOutputImage >
+ITK_THREAD_RETURN_TYPE
+ConcurrentChunkStreamingDriver< TInputImage, TOutputImage >
+::WorkerThreadCallback( void * arg )
+{
+  MultiThreader::ThreadInfoStruct * info =
+    static_cast< MultiThreader::ThreadInfoStruct * >( arg );
+
+  Self * driver = static_cast< Self * >( info->UserData );
+
+  try
+    {
+    driver->RunWorker( info->ThreadID );
+    }
+  catch( ExceptionObject & excp )
+    {
+    driver->Abort( excp.GetDescription() );
+    }
+  catch( std::exception & excp )
+    {
+    driver->Abort( excp.what() );
+    }
+  catch( ... )
+    {
+    driver->Abort( "Unknown exception" );
+    }
+
+  return ITK_THREAD_RETURN_VALUE;
+}
+
+template< typename TInputImage, typename TOutputImage >
+ITK_THREAD_RETURN_TYPE
+ConcurrentChunkStreamingDriver< TInputImage, TOutputImage >
+::WriterThreadCallback( void * arg )
+{
+  MultiThreader::ThreadInfoStruct * info =
+    static_cast< MultiThreader::ThreadInfoStruct * >( arg );
+
+  Self * driver = static_cast< Self * >( info->UserData );
+
+  try
+    {
+    driver->WriteChunks();
+    }
+  catch( ExceptionObject & excp )
+    {
+    driver->Abort( excp.GetDescription() );
+    }
+  catch( std::exception & excp )
+    {
+    driver->Abort( excp.what() );
+    }
+  catch( ... )
+    {
+    driver->Abort( "Unknown exception" );
+    }
+
+  return ITK_THREAD_RETURN_VALUE;
+}
+
+template< typename TInputImage, typename TOutputImage >
+void
+ConcurrentChunkStreamingDriver< TInputImage, TOutputImage >
+::PrintSelf(std::ostream & os, Indent indent) const
+{
+  Superclass::PrintSelf(os, indent);
+
+  for( unsigned int j = 0; j < m_InputFileNames.size(); j++ )
+    {
+    os << indent << "InputFileName[" << j << "]: " << m_InputFileNames[j] << std::endl;
+    }
+  os << indent << "OutputFileName: " << m_OutputFileName << std::endl;
+  os << indent << "NumberOfWorkers: " << m_Filters.size() << std::endl;
+  os << indent << "NumberOfStreamDivisions: " << m_NumberOfStreamDivisions << std::endl;
+  os << indent << "MaximumNumberOfChunksInFlight: "
+     << m_MaximumNumberOfChunksInFlight << std::endl;
+  os << indent << "UseCompression: " << m_UseCompression << std::endl;
+  os << indent << "NumberOfStolenChunks: " << m_NumberOfStolenChunks << std::endl;
+}
+
+} // end namespace itk
+
+#endif
@@ -0,0 +1,192 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkDirtyBrickIterationDriver_h
+#define __itkDirtyBrickIterationDriver_h
+
+#include "itkObject.h"
+#include "itkImageToImageFilter.h"
+#include "itkImageFileReader.h"
+#include "itkImageFileWriter.h"
+#include "itkImageChunkSource.h"
+#include "itkBrickGrid.h"
+#include "itkProcessObserverList.h"
+
+#include <string>
+#include <vector>
+
+namespace itk
+{
+
+/** \class DirtyBrickIterationDriver
+ *
+ * \brief Applies a neighborhood filter repeatedly to an image file,
+ * recomputing after the first pass only the bricks that can still change.
+ *
+ * A pixel can only change in pass k+1 if some pixel within the radius of
+ * the filter changed in pass k. The image is divided into bricks, and the
+ * driver records which bricks changed in every pass. The next pass only
+ * recomputes these bricks and the bricks within the radius of them. The
+ * iterations stop when a pass changes nothing, or after
+ * MaximumNumberOfIterations passes.
+ *
+ * The result is the same as running the filter MaximumNumberOfIterations
+ * times over the whole image (each pass reads the complete result of the
+ * previous one). The passes alternate between two scratch MetaImage files
+ * next to the output file, "<output>_iterationA.mhd" and
+ * "<output>_iterationB.mhd", that are pasted brick layer by brick layer.
+ * The first pass writes to both, so that each file holds the result of
+ * the previous pass wherever the current pass does not write. The final
+ * result is then streamed to the output file, in any format, and the
+ * scratch files are removed.
+ *
+ * The filter must produce the same pixel type as its input.
+ */
+template< typename TImage >
+class DirtyBrickIterationDriver : public Object
+{
+public:
+  /** Standard class typedefs. */
+  typedef DirtyBrickIterationDriver     Self;
+  typedef Object                        Superclass;
+  typedef SmartPointer< Self >          Pointer;
+  typedef SmartPointer< const Self >    ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro(Self);
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro(DirtyBrickIterationDriver, Object);
+
+  typedef TImage                                ImageType;
+  typedef typename ImageType::Pointer           ImagePointer;
+  typedef typename ImageType::RegionType        RegionType;
+  typedef typename ImageType::SizeType          SizeType;
+
+  itkStaticConstMacro(ImageDimension, unsigned int, TImage::ImageDimension);
+
+  typedef ImageToImageFilter< ImageType, ImageType >  FilterType;
+  typedef ImageFileReader< ImageType >                ReaderType;
+  typedef ImageFileWriter< ImageType >                WriterType;
+  typedef ImageChunkSource< ImageType >               ChunkSourceType;
+  typedef BrickGrid< TImage::ImageDimension >         GridType;
+  typedef typename GridType::BrickIdType              BrickIdType;
+  typedef std::vector< SizeValueType >                CountListType;
+
+  itkSetStringMacro(InputFileName);
+  itkGetStringMacro(InputFileName);
+
+  itkSetStringMacro(OutputFileName);
+  itkGetStringMacro(OutputFileName);
+
+  /** Filter applied in every pass. Its input is replaced by the driver. */
+  void SetFilter( FilterType * filter );
+  itkGetObjectMacro(Filter, FilterType);
+
+  /** Add an observer to the filter, and to the readers and the
+   * writers that Update creates, so that a whole run can be watched like
+   * a pipeline. */
+  void AddProcessObserver( const EventObject & event, Command * command );
+
+  /** Radius of the neighborhood that the filter reads around a pixel. */
+  itkSetMacro(Radius, SizeType);
+  itkGetConstReferenceMacro(Radius, SizeType);
+
+  /** Size of the bricks whose changes are tracked. */
+  itkSetMacro(BrickSize, SizeType);
+  itkGetConstReferenceMacro(BrickSize, SizeType);
+  void SetBrickSize( SizeValueType size )
+  {
+    SizeType brickSize;
+    brickSize.Fill( size );
+    this->SetBrickSize( brickSize );
+  }
+
+  itkSetClampMacro(MaximumNumberOfIterations, unsigned int, 1,
+                   NumericTraits< unsigned int >::max());
+  itkGetConstMacro(MaximumNumberOfIterations, unsigned int);
+
+  /** Stream divisions used to write the output file. */
+  itkSetMacro(NumberOfStreamDivisions, unsigned int);
+  itkGetConstMacro(NumberOfStreamDivisions, unsigned int);
+
+  /** Passed to the writer of the output file. */
+  itkSetMacro(UseCompression, bool);
+  itkGetConstMacro(UseCompression, bool);
+  itkBooleanMacro(UseCompression);
+
+  /** Number of passes run by the last Update(). */
+  unsigned int GetNumberOfIterations() const
+  {
+    return static_cast< unsigned int >( m_NumberOfRecomputedBricks.size() );
+  }
+
+  /** Bricks recomputed, and bricks changed, in every pass. */
+  const CountListType & GetNumberOfRecomputedBricks() const { return m_NumberOfRecomputedBricks; }
+  const CountListType & GetNumberOfChangedBricks() const { return m_NumberOfChangedBricks; }
+
+  /** Run the iterations and write the output file. */
+  void Update();
+
+protected:
+  DirtyBrickIterationDriver();
+  ~DirtyBrickIterationDriver() {}
+  void PrintSelf(std::ostream & os, Indent indent) const;
+
+  /** Recompute the dirty bricks of sourceFileName into the target files,
+   * and flag the bricks that changed. Returns the number of them. */
+  SizeValueType RunIteration( const std::string & sourceFileName,
+                              const std::vector< std::string > & targetFileNames,
+                              const std::vector< bool > & dirty,
+                              std::vector< bool > & changed );
+
+  /** Bricks within the radius of the changed bricks. */
+  void ComputeDirtyBricks( const std::vector< bool > & changed,
+                           std::vector< bool > & dirty ) const;
+
+  static void RemoveMetaImageFile( const std::string & fileName );
+
+private:
+  DirtyBrickIterationDriver(const Self &); // Purposely not implemented
+  void operator=(const Self &);            // Purposely not implemented
+
+  std::string                   m_InputFileName;
+  std::string                   m_OutputFileName;
+
+  typename FilterType::Pointer  m_Filter;
+
+  ProcessObserverList           m_ProcessObservers;
+
+  SizeType                      m_Radius;
+  SizeType                      m_BrickSize;
+  unsigned int                  m_MaximumNumberOfIterations;
+  unsigned int                  m_NumberOfStreamDivisions;
+  bool                          m_UseCompression;
+
+  GridType                      m_Grid;
+
+  CountListType                 m_NumberOfRecomputedBricks;
+  CountListType                 m_NumberOfChangedBricks;
+};
+
+} // end namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkDirtyBrickIterationDriver.hxx"
+#endif
+
+#endif
@@ -0,0 +1,391 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkDirtyBrickIterationDriver_hxx
+#define __itkDirtyBrickIterationDriver_hxx
+
+#include "itkDirtyBrickIterationDriver.h"
+#include "itkImageRegionConstIterator.h"
+#include "itkImageIORegion.h"
+#include "itksys/SystemTools.hxx"
+
+#include <algorithm>
+
+namespace itk
+{
+
+template< typename TImage >
+DirtyBrickIterationDriver< TImage >
+::DirtyBrickIterationDriver()
+{
+  m_Radius.Fill( 1 );
+  m_BrickSize.Fill( 64 );
+  m_MaximumNumberOfIterations = 1;
+  m_NumberOfStreamDivisions = 1;
+  m_UseCompression = false;
+}
+
+template< typename TImage >
+void
+DirtyBrickIterationDriver< TImage >
+::RemoveMetaImageFile( const std::string & fileName )
+{
+  std::string dataFileName = itksys::SystemTools::GetFilenamePath( fileName );
+  if( dataFileName != "" )
+    {
+    dataFileName += "/";
+    }
+  dataFileName += itksys::SystemTools::GetFilenameWithoutLastExtension( fileName ) + ".raw";
+
+  if( itksys::SystemTools::FileExists( fileName.c_str() ) )
+    {
+    itksys::SystemTools::RemoveFile( fileName.c_str() );
+    }
+  if( itksys::SystemTools::FileExists( dataFileName.c_str() ) )
+    {
+    itksys::SystemTools::RemoveFile( dataFileName.c_str() );
+    }
+}
+
+template< typename TImage >
+void
+DirtyBrickIterationDriver< TImage >
+::SetFilter( FilterType * filter )
+{
+  if( m_Filter != filter )
+    {
+    m_Filter = filter;
+    m_ProcessObservers.Attach( filter );
+    this->Modified();
+    }
+}
+
+template< typename TImage >
+void
+DirtyBrickIterationDriver< TImage >
+::AddProcessObserver( const EventObject & event, Command * command )
+{
+  m_ProcessObservers.Add( event, command );
+
+  if( m_Filter.IsNotNull() )
+    {
+    m_Filter->AddObserver( event, command );
+    }
+}
+
+template< typename TImage >
+void
+DirtyBrickIterationDriver< TImage >
+::Update()
+{
+  if( m_Filter.IsNull() )
+    {
+    itkExceptionMacro("Filter must be set");
+    }
+
+  if( m_InputFileName == "" )
+    {
+    itkExceptionMacro("Input file name must be set");
+    }
+
+  if( m_OutputFileName == "" )
+    {
+    itkExceptionMacro("Output file name must be set");
+    }
+
+  typename ReaderType::Pointer informationReader = ReaderType::New();
+  informationReader->SetFileName( m_InputFileName );
+  informationReader->UpdateOutputInformation();
+
+  m_Grid.SetImageRegion( informationReader->GetOutput()->GetLargestPossibleRegion() );
+  m_Grid.SetBrickSize( m_BrickSize );
+
+  const BrickIdType numberOfBricks = m_Grid.GetNumberOfBricks();
+
+  //
+  // The two scratch files live next to the output. Stale ones from an
+  // earlier run may have another header, and could not be pasted into.
+  //
+  std::string prefix = itksys::SystemTools::GetFilenamePath( m_OutputFileName );
+  if( prefix != "" )
+    {
+    prefix += "/";
+    }
+  prefix += itksys::SystemTools::GetFilenameWithoutLastExtension( m_OutputFileName );
+
+  std::vector< std::string > scratchFileNames;
+  scratchFileNames.push_back( prefix + "_iterationA.mhd" );
+  scratchFileNames.push_back( prefix + "_iterationB.mhd" );
+
+  for( unsigned int k = 0; k < scratchFileNames.size(); k++ )
+    {
+    RemoveMetaImageFile( scratchFileNames[k] );
+    }
+
+  m_NumberOfRecomputedBricks.clear();
+  m_NumberOfChangedBricks.clear();
+
+  std::vector< bool > dirty( numberOfBricks, true );
+  std::vector< bool > changed;
+
+  unsigned int resultFile = 0;
+
+  for( unsigned int iteration = 1; iteration <= m_MaximumNumberOfIterations; iteration++ )
+    {
+    std::string sourceFileName;
+    std::vector< std::string > targetFileNames;
+
+    resultFile = ( iteration - 1 ) % 2;
+
+    if( iteration == 1 )
+      {
+      sourceFileName = m_InputFileName;
+      targetFileNames.push_back( scratchFileNames[0] );
+      if( m_MaximumNumberOfIterations > 1 )
+        {
+        targetFileNames.push_back( scratchFileNames[1] );
+        }
+      }
+    else
+      {
+      sourceFileName = scratchFileNames[ iteration % 2 ];
+      targetFileNames.push_back( scratchFileNames[ resultFile ] );
+      }
+
+    changed.assign( numberOfBricks, false );
+
+    const SizeValueType numberOfChangedBricks =
+      this->RunIteration( sourceFileName, targetFileNames, dirty, changed );
+
+    if( numberOfChangedBricks == 0 )
+      {
+      break;
+      }
+
+    this->ComputeDirtyBricks( changed, dirty );
+    }
+
+  m_Filter->SetInput( NULL );
+
+  //
+  // Stream the result to the output file, in its own format.
+  //
+  typename ReaderType::Pointer reader = ReaderType::New();
+  reader->SetFileName( scratchFileNames[ resultFile ] );
+  m_ProcessObservers.Attach( reader );
+
+  typename WriterType::Pointer writer = WriterType::New();
+  writer->SetInput( reader->GetOutput() );
+  writer->SetFileName( m_OutputFileName );
+  writer->SetNumberOfStreamDivisions( m_NumberOfStreamDivisions );
+  writer->SetUseCompression( m_UseCompression );
+  m_ProcessObservers.Attach( writer );
+  writer->Update();
+
+  writer = NULL;
+  reader = NULL;
+
+  for( unsigned int k = 0; k < scratchFileNames.size(); k++ )
+    {
+    RemoveMetaImageFile( scratchFileNames[k] );
+    }
+}
+
+template< typename TImage >
+SizeValueType
+DirtyBrickIterationDriver< TImage >
+::RunIteration( const std::string & sourceFileName,
+                const std::vector< std::string > & targetFileNames,
+                const std::vector< bool > & dirty,
+                std::vector< bool > & changed )
+{
+  const unsigned int slow = ImageDimension - 1;
+
+  typename ReaderType::Pointer reader = ReaderType::New();
+  reader->SetFileName( sourceFileName );
+  reader->UpdateOutputInformation();
+  m_ProcessObservers.Attach( reader );
+
+  m_Filter->SetInput( reader->GetOutput() );
+
+  std::vector< typename ChunkSourceType::Pointer > chunkSources;
+  std::vector< typename WriterType::Pointer >      writers;
+
+  for( unsigned int k = 0; k < targetFileNames.size(); k++ )
+    {
+    typename ChunkSourceType::Pointer chunkSource = ChunkSourceType::New();
+    chunkSource->SetReferenceImage( reader->GetOutput() );
+
+    typename WriterType::Pointer writer = WriterType::New();
+    writer->SetFileName( targetFileNames[k] );
+    writer->SetInput( chunkSource->GetOutput() );
+    m_ProcessObservers.Attach( writer );
+
+    chunkSources.push_back( chunkSource );
+    writers.push_back( writer );
+    }
+
+  const typename RegionType::IndexType largestIndex =
+    reader->GetOutput()->GetLargestPossibleRegion().GetIndex();
+
+  const SizeValueType numberOfLayers = m_Grid.GetGridSize()[slow];
+  const BrickIdType bricksPerLayer = m_Grid.GetNumberOfBricks() / numberOfLayers;
+
+  SizeValueType numberOfRecomputedBricks = 0;
+  SizeValueType numberOfChangedBricks = 0;
+
+  //
+  // The dirty bricks of a layer of bricks are recomputed together, as
+  // their bounding box. Bricks of the box that were not dirty get the
+  // same values again, so they are written back unchanged.
+  //
+  for( SizeValueType layer = 0; layer < numberOfLayers; layer++ )
+    {
+    RegionType box;
+    bool       empty = true;
+
+    for( BrickIdType id = layer * bricksPerLayer; id < ( layer + 1 ) * bricksPerLayer; id++ )
+      {
+      if( !dirty[id] )
+        {
+        continue;
+        }
+
+      const RegionType brick = m_Grid.GetBrickRegion( id );
+
+      if( empty )
+        {
+        box = brick;
+        empty = false;
+        continue;
+        }
+
+      for( unsigned int i = 0; i < ImageDimension; i++ )
+        {
+        const IndexValueType start = std::min( box.GetIndex(i), brick.GetIndex(i) );
+        const IndexValueType end = std::max(
+          box.GetIndex(i) + static_cast< IndexValueType >( box.GetSize(i) ),
+          brick.GetIndex(i) + static_cast< IndexValueType >( brick.GetSize(i) ) );
+
+        box.SetIndex( i, start );
+        box.SetSize( i, end - start );
+        }
+      }
+
+    if( empty )
+      {
+      continue;
+      }
+
+    ImageType * output = m_Filter->GetOutput();
+    output->SetRequestedRegion( box );
+    m_Filter->Update();
+
+    ImagePointer result = output;
+    result->DisconnectPipeline();
+
+    const ImageType * input = reader->GetOutput();
+
+    const typename GridType::BrickIdListType bricks = m_Grid.GetBricksIntersecting( box );
+
+    for( unsigned int b = 0; b < bricks.size(); b++ )
+      {
+      const RegionType brick = m_Grid.GetBrickRegion( bricks[b] );
+
+      ImageRegionConstIterator< ImageType > inputIt( input, brick );
+      ImageRegionConstIterator< ImageType > resultIt( result, brick );
+
+      while( !inputIt.IsAtEnd() )
+        {
+        if( inputIt.Get() != resultIt.Get() )
+          {
+          changed[ bricks[b] ] = true;
+          numberOfChangedBricks++;
+          break;
+          }
+        ++inputIt;
+        ++resultIt;
+        }
+      }
+
+    numberOfRecomputedBricks += bricks.size();
+
+    ImageIORegion ioRegion( ImageDimension );
+    ImageIORegionAdaptor< ImageDimension >::Convert( box, ioRegion, largestIndex );
+
+    for( unsigned int k = 0; k < writers.size(); k++ )
+      {
+      chunkSources[k]->SetChunk( result );
+      writers[k]->SetIORegion( ioRegion );
+      writers[k]->Update();
+      chunkSources[k]->SetChunk( NULL );
+      }
+    }
+
+  m_NumberOfRecomputedBricks.push_back( numberOfRecomputedBricks );
+  m_NumberOfChangedBricks.push_back( numberOfChangedBricks );
+
+  return numberOfChangedBricks;
+}
+
+template< typename TImage >
+void
+DirtyBrickIterationDriver< TImage >
+::ComputeDirtyBricks( const std::vector< bool > & changed,
+                      std::vector< bool > & dirty ) const
+{
+  dirty.assign( changed.size(), false );
+
+  for( BrickIdType id = 0; id < changed.size(); id++ )
+    {
+    if( !changed[id] )
+      {
+      continue;
+      }
+
+    RegionType reach = m_Grid.GetBrickRegion( id );
+    reach.PadByRadius( m_Radius );
+    reach.Crop( m_Grid.GetImageRegion() );
+
+    const typename GridType::BrickIdListType bricks = m_Grid.GetBricksIntersecting( reach );
+
+    for( unsigned int b = 0; b < bricks.size(); b++ )
+      {
+      dirty[ bricks[b] ] = true;
+      }
+    }
+}
+
+template< typename TImage >
+void
+DirtyBrickIterationDriver< TImage >
+::PrintSelf(std::ostream & os, Indent indent) const
+{
+  Superclass::PrintSelf(os, indent);
+
+  os << indent << "InputFileName: " << m_InputFileName << std::endl;
+  os << indent << "OutputFileName: " << m_OutputFileName << std::endl;
+  os << indent << "Radius: " << m_Radius << std::endl;
+  os << indent << "BrickSize: " << m_BrickSize << std::endl;
+  os << indent << "MaximumNumberOfIterations: " << m_MaximumNumberOfIterations << std::endl;
+  os << indent << "NumberOfStreamDivisions: " << m_NumberOfStreamDivisions << std::endl;
+  os << indent << "UseCompression: " << m_UseCompression << std::endl;
+}
+
+} // end namespace itk
+
+#endif
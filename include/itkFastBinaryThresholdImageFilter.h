@@ -0,0 +1,110 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkFastBinaryThresholdImageFilter_h
+#define __itkFastBinaryThresholdImageFilter_h
+
+#include "itkBinaryThresholdImageFilter.h"
+#include "itkBinaryThresholdScanlineKernels.h"
+#include "itkBrickStatistics.h"
+#include "itkProgressReporter.h"
+
+namespace itk
+{
+
+/** \class FastBinaryThresholdImageFilter
+ *
+ * \brief BinaryThresholdImageFilter that thresholds whole scanlines with
+ * vector instructions.
+ *
+ * The generic filter calls its functor once per pixel through the region
+ * iterators, which the compiler does not vectorize. For unsigned char and
+ * float inputs with unsigned char outputs, this filter instead walks the
+ * rows of each thread region and hands every row, which is contiguous in
+ * memory, to BinaryThresholdScanlineKernels. Other pixel types use the
+ * generic implementation, so the class can replace BinaryThresholdImageFilter
+ * anywhere.
+ *
+ * When the BrickStatistics of the input volume are given, each thread
+ * region is processed brick by brick, and the bricks whose range lies
+ * entirely inside or outside of the thresholds are filled with the
+ * inside or outside value without looking at their pixels. The statistics
+ * are not copied and must outlive the filter.
+ */
+template< typename TInputImage, typename TOutputImage >
+class FastBinaryThresholdImageFilter :
+  public BinaryThresholdImageFilter< TInputImage, TOutputImage >
+{
+public:
+  /** Standard class typedefs. */
+  typedef FastBinaryThresholdImageFilter                          Self;
+  typedef BinaryThresholdImageFilter< TInputImage, TOutputImage > Superclass;
+  typedef SmartPointer< Self >                                    Pointer;
+  typedef SmartPointer< const Self >                              ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro(Self);
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro(FastBinaryThresholdImageFilter, BinaryThresholdImageFilter);
+
+  typedef typename Superclass::InputPixelType        InputPixelType;
+  typedef typename Superclass::OutputPixelType       OutputPixelType;
+  typedef typename Superclass::OutputImageRegionType OutputImageRegionType;
+
+  typedef BinaryThresholdScanline< InputPixelType, OutputPixelType > ScanlineType;
+
+  /** Statistics of the bricks of the input volume, or NULL. */
+  void SetBrickStatistics( const BrickStatistics * statistics )
+  {
+    if( m_BrickStatistics != statistics )
+      {
+      m_BrickStatistics = statistics;
+      this->Modified();
+      }
+  }
+  const BrickStatistics * GetBrickStatistics() const { return m_BrickStatistics; }
+
+protected:
+  FastBinaryThresholdImageFilter() : m_BrickStatistics( NULL ) {}
+  ~FastBinaryThresholdImageFilter() {}
+
+  void BeforeThreadedGenerateData();
+
+  void ThreadedGenerateData( const OutputImageRegionType & outputRegionForThread,
+                             ThreadIdType threadId );
+
+  /** Threshold the rows of a region, or fill them with a single value.
+   * The progress, when given, advances by one per row. */
+  void ProcessRows( const OutputImageRegionType & region,
+                    BrickStatistics::ClassificationType classification,
+                    ProgressReporter * progress = NULL );
+
+private:
+  FastBinaryThresholdImageFilter(const Self &); // Purposely not implemented
+  void operator=(const Self &);                 // Purposely not implemented
+
+  const BrickStatistics * m_BrickStatistics;
+};
+
+} // end namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkFastBinaryThresholdImageFilter.hxx"
+#endif
+
+#endif
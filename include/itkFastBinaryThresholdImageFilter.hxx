@@ -0,0 +1,171 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkFastBinaryThresholdImageFilter_hxx
+#define __itkFastBinaryThresholdImageFilter_hxx
+
+#include "itkFastBinaryThresholdImageFilter.h"
+#include "itkImageLinearConstIteratorWithIndex.h"
+#include "itkProgressReporter.h"
+
+#include <algorithm>
+
+namespace itk
+{
+
+template< typename TInputImage, typename TOutputImage >
+void
+FastBinaryThresholdImageFilter< TInputImage, TOutputImage >
+::BeforeThreadedGenerateData()
+{
+  Superclass::BeforeThreadedGenerateData();
+
+  if( m_BrickStatistics == NULL )
+    {
+    return;
+    }
+
+  const typename TInputImage::RegionType & largest =
+    this->GetInput()->GetLargestPossibleRegion();
+  const BrickStatistics::RegionType & described =
+    m_BrickStatistics->GetGrid().GetImageRegion();
+
+  bool matches = ( TInputImage::ImageDimension == 3 );
+  for( unsigned int i = 0; matches && i < TInputImage::ImageDimension; i++ )
+    {
+    matches = ( largest.GetIndex(i) == described.GetIndex(i) &&
+                largest.GetSize(i) == described.GetSize(i) );
+    }
+
+  if( !matches )
+    {
+    itkExceptionMacro("The brick statistics do not describe the input image");
+    }
+}
+
+template< typename TInputImage, typename TOutputImage >
+void
+FastBinaryThresholdImageFilter< TInputImage, TOutputImage >
+::ThreadedGenerateData( const OutputImageRegionType & outputRegionForThread,
+                        ThreadIdType threadId )
+{
+  if( !ScanlineType::Supported )
+    {
+    Superclass::ThreadedGenerateData( outputRegionForThread, threadId );
+    return;
+    }
+
+  if( outputRegionForThread.GetNumberOfPixels() == 0 )
+    {
+    return;
+    }
+
+  if( m_BrickStatistics == NULL )
+    {
+    ProgressReporter progress( this, threadId,
+      outputRegionForThread.GetNumberOfPixels() / outputRegionForThread.GetSize( 0 ) );
+    this->ProcessRows( outputRegionForThread, BrickStatistics::Mixed, &progress );
+    return;
+    }
+
+  const double lower = static_cast< double >( this->GetLowerThreshold() );
+  const double upper = static_cast< double >( this->GetUpperThreshold() );
+
+  const BrickStatistics::GridType & grid = m_BrickStatistics->GetGrid();
+
+  BrickStatistics::RegionType threadRegion;
+  for( unsigned int i = 0; i < 3; i++ )
+    {
+    threadRegion.SetIndex( i, i < TOutputImage::ImageDimension ? outputRegionForThread.GetIndex(i) : 0 );
+    threadRegion.SetSize( i, i < TOutputImage::ImageDimension ? outputRegionForThread.GetSize(i) : 1 );
+    }
+
+  const BrickStatistics::GridType::BrickIdListType bricks =
+    grid.GetBricksIntersecting( threadRegion );
+
+  ProgressReporter progress( this, threadId, bricks.size() );
+
+  for( size_t k = 0; k < bricks.size(); k++ )
+    {
+    BrickStatistics::RegionType piece = grid.GetBrickRegion( bricks[k] );
+    piece.Crop( threadRegion );
+
+    OutputImageRegionType region = outputRegionForThread;
+    for( unsigned int i = 0; i < TOutputImage::ImageDimension && i < 3; i++ )
+      {
+      region.SetIndex( i, piece.GetIndex(i) );
+      region.SetSize( i, piece.GetSize(i) );
+      }
+
+    this->ProcessRows( region, m_BrickStatistics->Classify( bricks[k], lower, upper ) );
+
+    progress.CompletedPixel();
+    }
+}
+
+template< typename TInputImage, typename TOutputImage >
+void
+FastBinaryThresholdImageFilter< TInputImage, TOutputImage >
+::ProcessRows( const OutputImageRegionType & region,
+               BrickStatistics::ClassificationType classification,
+               ProgressReporter * progress )
+{
+  const TInputImage * input = this->GetInput();
+  TOutputImage * output = this->GetOutput();
+
+  const InputPixelType  lower        = this->GetLowerThreshold();
+  const InputPixelType  upper        = this->GetUpperThreshold();
+  const OutputPixelType insideValue  = this->GetInsideValue();
+  const OutputPixelType outsideValue = this->GetOutsideValue();
+
+  const SizeValueType rowLength = region.GetSize( 0 );
+
+  //
+  // Rows are contiguous in both buffers, whatever the buffered regions.
+  //
+  ImageLinearConstIteratorWithIndex< TInputImage > rowIt( input, region );
+  rowIt.SetDirection( 0 );
+
+  for( rowIt.GoToBegin(); !rowIt.IsAtEnd(); rowIt.NextLine() )
+    {
+    const typename TInputImage::IndexType & index = rowIt.GetIndex();
+
+    OutputPixelType * row = output->GetBufferPointer() + output->ComputeOffset( index );
+
+    switch( classification )
+      {
+      case BrickStatistics::AllInside:
+        std::fill( row, row + rowLength, insideValue );
+        break;
+      case BrickStatistics::AllOutside:
+        std::fill( row, row + rowLength, outsideValue );
+        break;
+      default:
+        ScanlineType::Run( input->GetBufferPointer() + input->ComputeOffset( index ),
+                           row, rowLength, lower, upper, insideValue, outsideValue );
+      }
+
+    if( progress )
+      {
+      progress->CompletedPixel();
+      }
+    }
+}
+
+} // end namespace itk
+
+#endif
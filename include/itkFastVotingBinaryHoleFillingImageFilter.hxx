@@ -0,0 +1,342 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkFastVotingBinaryHoleFillingImageFilter_hxx
+#define __itkFastVotingBinaryHoleFillingImageFilter_hxx
+
+#include "itkFastVotingBinaryHoleFillingImageFilter.h"
+#include "itkProgressReporter.h"
+
+#include <algorithm>
+
+namespace itk
+{
+
+template< typename TInputImage, typename TOutputImage >
+FastVotingBinaryHoleFillingImageFilter< TInputImage, TOutputImage >
+::FastVotingBinaryHoleFillingImageFilter()
+{
+  m_Radius.Fill( 1 );
+  m_ForegroundValue = NumericTraits< InputPixelType >::max();
+  m_BackgroundValue = NumericTraits< InputPixelType >::Zero;
+  m_MajorityThreshold = 1;
+  m_BirthThreshold = 0;
+  m_NumberOfPixelsChanged = 0;
+}
+
+template< typename TInputImage, typename TOutputImage >
+void
+FastVotingBinaryHoleFillingImageFilter< TInputImage, TOutputImage >
+::GenerateInputRequestedRegion()
+{
+  Superclass::GenerateInputRequestedRegion();
+
+  InputImageType * input = const_cast< InputImageType * >( this->GetInput() );
+
+  if( !input )
+    {
+    return;
+    }
+
+  InputImageRegionType inputRequestedRegion = input->GetRequestedRegion();
+
+  inputRequestedRegion.PadByRadius( m_Radius );
+
+  if( inputRequestedRegion.Crop( input->GetLargestPossibleRegion() ) )
+    {
+    input->SetRequestedRegion( inputRequestedRegion );
+    return;
+    }
+
+  input->SetRequestedRegion( inputRequestedRegion );
+
+  InvalidRequestedRegionError e(__FILE__, __LINE__);
+  e.SetLocation(ITK_LOCATION);
+  e.SetDescription("Requested region is (at least partially) outside the largest possible region.");
+  e.SetDataObject(input);
+  throw e;
+}
+
+template< typename TInputImage, typename TOutputImage >
+void
+FastVotingBinaryHoleFillingImageFilter< TInputImage, TOutputImage >
+::BeforeThreadedGenerateData()
+{
+  if( ImageDimension != 3 )
+    {
+    itkExceptionMacro("Only 3D images are supported");
+    }
+
+  // Same threshold as VotingBinaryHoleFillingImageFilter.
+  unsigned int neighborhoodSize = 1;
+  for( unsigned int i = 0; i < ImageDimension; i++ )
+    {
+    neighborhoodSize *= static_cast< unsigned int >( 2 * m_Radius[i] + 1 );
+    }
+
+  m_BirthThreshold = neighborhoodSize / 2 + m_MajorityThreshold;
+
+  m_Count.assign( this->GetNumberOfThreads(), 0 );
+}
+
+template< typename TInputImage, typename TOutputImage >
+void
+FastVotingBinaryHoleFillingImageFilter< TInputImage, TOutputImage >
+::AfterThreadedGenerateData()
+{
+  m_NumberOfPixelsChanged = 0;
+  for( size_t k = 0; k < m_Count.size(); k++ )
+    {
+    m_NumberOfPixelsChanged += m_Count[k];
+    }
+}
+
+template< typename TInputImage, typename TOutputImage >
+IndexValueType
+FastVotingBinaryHoleFillingImageFilter< TInputImage, TOutputImage >
+::ClampToBuffer( IndexValueType index, unsigned int dimension ) const
+{
+  const InputImageRegionType & buffered = this->GetInput()->GetBufferedRegion();
+
+  const IndexValueType position = index - buffered.GetIndex( dimension );
+  const IndexValueType last = static_cast< IndexValueType >( buffered.GetSize( dimension ) ) - 1;
+
+  return std::min( std::max( position, IndexValueType( 0 ) ), last );
+}
+
+template< typename TInputImage, typename TOutputImage >
+void
+FastVotingBinaryHoleFillingImageFilter< TInputImage, TOutputImage >
+::SumRow( const InputPixelType * row,
+          const OutputImageRegionType & region,
+          CountType * sums ) const
+{
+  const InputPixelType foreground = m_ForegroundValue;
+  const IndexValueType radius = static_cast< IndexValueType >( m_Radius[0] );
+  const IndexValueType start = region.GetIndex(0);
+  const IndexValueType length = static_cast< IndexValueType >( region.GetSize(0) );
+
+  const InputImageRegionType & buffered = this->GetInput()->GetBufferedRegion();
+  const IndexValueType bufferStart = buffered.GetIndex(0);
+  const IndexValueType last = static_cast< IndexValueType >( buffered.GetSize(0) ) - 1;
+
+  CountType sum = 0;
+  for( IndexValueType k = -radius; k <= radius; k++ )
+    {
+    const IndexValueType x = std::min( std::max( start + k - bufferStart, IndexValueType( 0 ) ), last );
+    sum += ( row[x] == foreground );
+    }
+  sums[0] = sum;
+
+  for( IndexValueType i = 1; i < length; i++ )
+    {
+    const IndexValueType entering = std::min( start + i + radius - bufferStart, last );
+    const IndexValueType leaving  = std::max( start + i - 1 - radius - bufferStart, IndexValueType( 0 ) );
+
+    sum += ( row[entering] == foreground );
+    sum -= ( row[leaving] == foreground );
+    sums[i] = sum;
+    }
+}
+
+template< typename TInputImage, typename TOutputImage >
+void
+FastVotingBinaryHoleFillingImageFilter< TInputImage, TOutputImage >
+::SumSlice( IndexValueType z,
+            const OutputImageRegionType & region,
+            CountBufferType & rowSums,
+            CountBufferType & columnSums,
+            CountType * sums ) const
+{
+  const InputImageType * input = this->GetInput();
+
+  const SizeValueType rowStride = input->GetBufferedRegion().GetSize(0);
+  const InputPixelType * slice = input->GetBufferPointer() +
+    this->ClampToBuffer( z, 2 ) * rowStride * input->GetBufferedRegion().GetSize(1);
+
+  const IndexValueType radius = static_cast< IndexValueType >( m_Radius[1] );
+  const IndexValueType start = region.GetIndex(1);
+  const IndexValueType length = static_cast< IndexValueType >( region.GetSize(1) );
+  const SizeValueType width = region.GetSize(0);
+
+  std::fill( columnSums.begin(), columnSums.end(), 0 );
+
+  for( IndexValueType k = -radius; k <= radius; k++ )
+    {
+    this->SumRow( slice + this->ClampToBuffer( start + k, 1 ) * rowStride, region, &rowSums[0] );
+    for( SizeValueType x = 0; x < width; x++ )
+      {
+      columnSums[x] += rowSums[x];
+      }
+    }
+  std::copy( columnSums.begin(), columnSums.end(), sums );
+
+  for( IndexValueType j = 1; j < length; j++ )
+    {
+    const IndexValueType entering = this->ClampToBuffer( start + j + radius, 1 );
+    const IndexValueType leaving  = this->ClampToBuffer( start + j - 1 - radius, 1 );
+
+    // Near the borders the same clamped row may enter and leave.
+    if( entering != leaving )
+      {
+      this->SumRow( slice + entering * rowStride, region, &rowSums[0] );
+      for( SizeValueType x = 0; x < width; x++ )
+        {
+        columnSums[x] += rowSums[x];
+        }
+      this->SumRow( slice + leaving * rowStride, region, &rowSums[0] );
+      for( SizeValueType x = 0; x < width; x++ )
+        {
+        columnSums[x] -= rowSums[x];
+        }
+      }
+
+    std::copy( columnSums.begin(), columnSums.end(), sums + j * width );
+    }
+}
+
+template< typename TInputImage, typename TOutputImage >
+void
+FastVotingBinaryHoleFillingImageFilter< TInputImage, TOutputImage >
+::ThreadedGenerateData( const OutputImageRegionType & outputRegionForThread,
+                        ThreadIdType threadId )
+{
+  const InputImageType * input = this->GetInput();
+  OutputImageType * output = this->GetOutput();
+
+  const SizeValueType width  = outputRegionForThread.GetSize(0);
+  const SizeValueType height = outputRegionForThread.GetSize(1);
+  const SizeValueType depth  = outputRegionForThread.GetSize(2);
+
+  if( width == 0 || height == 0 || depth == 0 )
+    {
+    return;
+    }
+
+  const IndexValueType radius = static_cast< IndexValueType >( m_Radius[2] );
+  const IndexValueType start = outputRegionForThread.GetIndex(2);
+
+  const InputPixelType foreground = m_ForegroundValue;
+  const InputPixelType background = m_BackgroundValue;
+  const CountType birth = m_BirthThreshold;
+
+  CountBufferType rowSums( width );
+  CountBufferType columnSums( width );
+  CountBufferType sliceSums( width * height );
+  CountBufferType boxSums( width * height, 0 );
+
+  SizeValueType numberOfPixelsChanged = 0;
+
+  ProgressReporter progress( this, threadId, depth );
+
+  for( IndexValueType k = -radius; k <= radius; k++ )
+    {
+    this->SumSlice( start + k, outputRegionForThread, rowSums, columnSums, &sliceSums[0] );
+    for( SizeValueType p = 0; p < sliceSums.size(); p++ )
+      {
+      boxSums[p] += sliceSums[p];
+      }
+    }
+
+  typename OutputImageType::IndexType index = outputRegionForThread.GetIndex();
+
+  for( SizeValueType j = 0; j < depth; j++ )
+    {
+    const IndexValueType z = start + static_cast< IndexValueType >( j );
+
+    if( j > 0 )
+      {
+      const IndexValueType entering = this->ClampToBuffer( z + radius, 2 );
+      const IndexValueType leaving  = this->ClampToBuffer( z - 1 - radius, 2 );
+
+      if( entering != leaving )
+        {
+        this->SumSlice( z + radius, outputRegionForThread, rowSums, columnSums, &sliceSums[0] );
+        for( SizeValueType p = 0; p < sliceSums.size(); p++ )
+          {
+          boxSums[p] += sliceSums[p];
+          }
+        this->SumSlice( z - 1 - radius, outputRegionForThread, rowSums, columnSums, &sliceSums[0] );
+        for( SizeValueType p = 0; p < sliceSums.size(); p++ )
+          {
+          boxSums[p] -= sliceSums[p];
+          }
+        }
+      }
+
+    index[2] = z;
+
+    const CountType * counts = &boxSums[0];
+
+    for( SizeValueType y = 0; y < height; y++ )
+      {
+      index[1] = outputRegionForThread.GetIndex(1) + static_cast< IndexValueType >( y );
+
+      const InputPixelType * in = input->GetBufferPointer() + input->ComputeOffset( index );
+      OutputPixelType * out = output->GetBufferPointer() + output->ComputeOffset( index );
+
+      for( SizeValueType x = 0; x < width; x++ )
+        {
+        const InputPixelType value = in[x];
+
+        if( value == background )
+          {
+          if( counts[x] >= birth )
+            {
+            out[x] = static_cast< OutputPixelType >( foreground );
+            numberOfPixelsChanged++;
+            }
+          else
+            {
+            out[x] = static_cast< OutputPixelType >( background );
+            }
+          }
+        else
+          {
+          out[x] = static_cast< OutputPixelType >( value );
+          }
+        }
+
+      counts += width;
+      }
+
+    progress.CompletedPixel();
+    }
+
+  m_Count[threadId] = numberOfPixelsChanged;
+}
+
+template< typename TInputImage, typename TOutputImage >
+void
+FastVotingBinaryHoleFillingImageFilter< TInputImage, TOutputImage >
+::PrintSelf(std::ostream & os, Indent indent) const
+{
+  Superclass::PrintSelf(os, indent);
+
+  os << indent << "Radius: " << m_Radius << std::endl;
+  os << indent << "ForegroundValue: "
+     << static_cast< typename NumericTraits< InputPixelType >::PrintType >( m_ForegroundValue ) << std::endl;
+  os << indent << "BackgroundValue: "
+     << static_cast< typename NumericTraits< InputPixelType >::PrintType >( m_BackgroundValue ) << std::endl;
+  os << indent << "MajorityThreshold: " << m_MajorityThreshold << std::endl;
+  os << indent << "BirthThreshold: " << m_BirthThreshold << std::endl;
+  os << indent << "NumberOfPixelsChanged: " << m_NumberOfPixelsChanged << std::endl;
+}
+
+} // end namespace itk
+
+#endif
@@ -19,75 +19,209 @@
 #define _itkFilterStreamingWatcher_h
 
 #include "itkCommand.h"
-#include <time.h>
+#include "itkImage.h"
+#include "itkRealTimeClock.h"
+#include "itkProcessResourceUsage.h"
+#include "itkSimpleFastMutexLock.h"
+
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
 
 namespace itk {
 
+/** \class FilterStreamingWatcher
+ *
+ * \brief Reports the progress of a filter, and measures every execution
+ * of it. A filter upstream of a streaming writer runs once per stream
+ * division.
+ *
+ * Every execution is recorded with its requested region, elapsed and
+ * processor time, bytes of the requested input and output regions, and
+ * the peak resident set size of the process when it ended. When a
+ * metrics file is set, the records are written to it after every
+ * execution, as JSON if the file name ends in ".json" and as CSV
+ * otherwise.
+ *
+ * More process objects can be watched with WatchProcess, for example
+ * the copies of a filter that the workers of a concurrent driver run.
+ * Their executions may happen at the same time on different threads,
+ * and are recorded in the order in which they end. The processor time
+ * belongs to the whole process, so it includes the work of the other
+ * executions running at the same time.
+ */
 class FilterStreamingWatcher
 {
 public:
+  /** Measurements of one execution of the filter. */
+  struct ChunkMetricsType
+    {
+    ImageRegion< 3 >  Region;
+    double            WallTime;
+    double            ProcessorTime;
+    SizeValueType     BytesIn;
+    SizeValueType     BytesOut;
+    SizeValueType     PeakResidentSetSize;
+    };
+
+  typedef std::vector< ChunkMetricsType > MetricsType;
+
   FilterStreamingWatcher(itk::ProcessObject* o, const char *comment="")
   {
-    m_Start = 0;
-    m_End = 0;
+    m_Clock = RealTimeClock::New();
     m_Process = o;
-    m_Steps = 0;
     m_Comment = comment;
+    m_RequireProgress = true;
 
-    itk::SimpleMemberCommand<FilterStreamingWatcher>::Pointer startFilterCommand;
-    itk::SimpleMemberCommand<FilterStreamingWatcher>::Pointer endFilterCommand;
-    itk::SimpleMemberCommand<FilterStreamingWatcher>::Pointer progressFilterCommand;
-    itk::SimpleMemberCommand<FilterStreamingWatcher>::Pointer iterationFilterCommand;
-    itk::SimpleMemberCommand<FilterStreamingWatcher>::Pointer abortFilterCommand;
-
-    startFilterCommand =    itk::SimpleMemberCommand<FilterStreamingWatcher>::New();
-    endFilterCommand =      itk::SimpleMemberCommand<FilterStreamingWatcher>::New();
-    progressFilterCommand = itk::SimpleMemberCommand<FilterStreamingWatcher>::New();
-    iterationFilterCommand = itk::SimpleMemberCommand<FilterStreamingWatcher>::New();
-    abortFilterCommand = itk::SimpleMemberCommand<FilterStreamingWatcher>::New();
-
-    startFilterCommand->SetCallbackFunction(this, &FilterStreamingWatcher::StartFilter);
-    endFilterCommand->SetCallbackFunction(this, &FilterStreamingWatcher::EndFilter);
-    progressFilterCommand->SetCallbackFunction(this, &FilterStreamingWatcher::ShowProgress);
-    iterationFilterCommand->SetCallbackFunction(this, &FilterStreamingWatcher::ShowIteration);
-
-    m_Process->AddObserver(itk::StartEvent(), startFilterCommand);
-    m_Process->AddObserver(itk::EndEvent(), endFilterCommand);
-    m_Process->AddObserver(itk::ProgressEvent(), progressFilterCommand);
-    m_Process->AddObserver(itk::IterationEvent(), iterationFilterCommand);
-    m_Process->AddObserver(itk::AbortEvent(), abortFilterCommand);
+    this->WatchProcess( o );
   }
 
   virtual ~FilterStreamingWatcher() {}
 
-  virtual void ShowProgress()
+  /** Also measure the executions of another process object. */
+  void WatchProcess( itk::ProcessObject * o )
+  {
+    if( o == NULL || m_Executions.find( o ) != m_Executions.end() )
+      {
+      return;
+      }
+
+    m_Executions[o] = ExecutionType();
+
+    MemberCommand< FilterStreamingWatcher >::Pointer command =
+      MemberCommand< FilterStreamingWatcher >::New();
+    command->SetCallbackFunction( this, &FilterStreamingWatcher::ProcessEvent );
+
+    o->AddObserver(itk::StartEvent(), command);
+    o->AddObserver(itk::EndEvent(), command);
+    o->AddObserver(itk::ProgressEvent(), command);
+    o->AddObserver(itk::IterationEvent(), command);
+  }
+
+  /** Whether an execution without progress events is an error. Readers
+   * do not report progress. */
+  void SetRequireProgress( bool requireProgress )
+  {
+    m_RequireProgress = requireProgress;
+  }
+
+  /** File that receives the metrics of all the executions. */
+  void SetMetricsFileName( const std::string & fileName )
+  {
+    m_MetricsFileName = fileName;
+  }
+
+  const MetricsType & GetMetrics() const
+  {
+    return m_Metrics;
+  }
+
+  /** Forget the executions recorded so far, for example those of a
+   * trial run before the real one. */
+  void ClearMetrics()
+  {
+    m_Mutex.Lock();
+    m_Metrics.clear();
+    m_Mutex.Unlock();
+  }
+
+  /** Write the metrics recorded so far to the metrics file. */
+  void WriteMetrics()
+  {
+    m_Mutex.Lock();
+
+    try
+      {
+      this->WriteMetricsFile();
+      }
+    catch( ... )
+      {
+      m_Mutex.Unlock();
+      throw;
+      }
+
+    m_Mutex.Unlock();
+  }
+
+  const char *GetNameOfClass () {return m_Process->GetNameOfClass();}
+
+protected:
+  /** State of the current execution of one watched process object. */
+  struct ExecutionType
+    {
+    ExecutionType() : WallStart( 0.0 ), ProcessorStart( 0.0 ), Steps( 0 ), Iterations( 0 ) {}
+
+    double  WallStart;
+    double  ProcessorStart;
+    int     Steps;
+    int     Iterations;
+    };
+
+  void ProcessEvent( Object * caller, const EventObject & event )
   {
-    m_Steps++;
+    ProcessObject * process = dynamic_cast< ProcessObject * >( caller );
 
-    std::cout << " | " << m_Process->GetProgress() << std::flush;
+    if( process == NULL )
+      {
+      return;
+      }
 
-    if ( (m_Steps % 10) == 0 )
+    if( StartEvent().CheckEvent( &event ) )
+      {
+      this->StartFilter( process );
+      }
+    else if( EndEvent().CheckEvent( &event ) )
+      {
+      this->EndFilter( process );
+      }
+    else if( ProgressEvent().CheckEvent( &event ) )
+      {
+      this->ShowProgress( process );
+      }
+    else if( IterationEvent().CheckEvent( &event ) )
+      {
+      this->ShowIteration( process );
+      }
+  }
+
+  virtual void ShowProgress( ProcessObject * process )
+  {
+    m_Mutex.Lock();
+    const int steps = ++m_Executions[process].Steps;
+    m_Mutex.Unlock();
+
+    std::cout << " | " << process->GetProgress() << std::flush;
+
+    if ( (steps % 10) == 0 )
       {
       std::cout << std::endl;
       }
   }
 
-  virtual void ShowIteration()
+  virtual void ShowIteration( ProcessObject * process )
   {
     std::cout << " # " << std::flush;
-    m_Iterations++;
+
+    m_Mutex.Lock();
+    m_Executions[process].Iterations++;
+    m_Mutex.Unlock();
   }
 
-  virtual void StartFilter()
+  virtual void StartFilter( ProcessObject * process )
   {
-    m_Steps = 0;
-    m_Iterations = 0;
-    m_Start = ::clock();
+    ExecutionType execution;
+    execution.WallStart = m_Clock->GetTimeInSeconds();
+    execution.ProcessorStart = ProcessResourceUsage::GetProcessorTime();
+
+    m_Mutex.Lock();
+    m_Executions[process] = execution;
+    m_Mutex.Unlock();
 
-    std::cout << "-------- Start " << m_Process->GetNameOfClass()
+    std::cout << "-------- Start " << process->GetNameOfClass()
               << " \"" << m_Comment << std::endl;
 
-    itk::ProcessObject::DataObjectPointerArray outputsArray = m_Process->GetOutputs();
+    itk::ProcessObject::DataObjectPointerArray outputsArray = process->GetOutputs();
 
     if( ! outputsArray.empty() )
       {
@@ -106,37 +240,187 @@ public:
      std::cout << std::flush << std::endl;
     }
 
-  const char *GetNameOfClass () {return m_Process->GetNameOfClass();}
-
-  virtual void EndFilter()
+  virtual void EndFilter( ProcessObject * process )
   {
-    m_End = ::clock();
+    m_Mutex.Lock();
+    const ExecutionType execution = m_Executions[process];
+    m_Mutex.Unlock();
+
+    ChunkMetricsType chunk;
+
+    chunk.WallTime = m_Clock->GetTimeInSeconds() - execution.WallStart;
+    chunk.ProcessorTime = ProcessResourceUsage::GetProcessorTime() - execution.ProcessorStart;
+    chunk.PeakResidentSetSize = ProcessResourceUsage::GetPeakResidentSetSize();
+
+    chunk.BytesIn = 0;
+    chunk.BytesOut = 0;
+
+    itk::ProcessObject::DataObjectPointerArray inputsArray = process->GetInputs();
+    for( size_t i = 0; i < inputsArray.size(); i++ )
+      {
+      chunk.BytesIn += GetRequestedBytes( inputsArray[i] );
+      }
+
+    itk::ProcessObject::DataObjectPointerArray outputsArray = process->GetOutputs();
+    if( ! outputsArray.empty() )
+      {
+      chunk.BytesOut = GetRequestedBytes( outputsArray[0] );
+
+      const ImageBase<3> * image = dynamic_cast< const ImageBase<3> * >( outputsArray[0].GetPointer() );
+      if( image )
+        {
+        chunk.Region = image->GetRequestedRegion();
+        }
+      }
+
+    m_Mutex.Lock();
+    m_Metrics.push_back( chunk );
+    m_Mutex.Unlock();
+
     std::cout << std::endl << "Filter took "
-              << static_cast<double>(m_End - m_Start) / CLOCKS_PER_SEC
-              << " seconds.";
+              << chunk.WallTime << " seconds ("
+              << chunk.ProcessorTime << " seconds of processor time).";
     std::cout << std::endl << std::endl
-              << "-------- End " << m_Process->GetNameOfClass()
+              << "-------- End " << process->GetNameOfClass()
               << " \"" << m_Comment << "\" "
               << std::flush
               << std::endl;
 
-    if (m_Steps < 1)
+    this->WriteMetrics();
+
+    if (m_RequireProgress && execution.Steps < 1)
       {
       itkExceptionMacro ("Filter does not have progress.");
       }
 
     }
 
-protected:
-  clock_t         m_Start;
-  clock_t         m_End;
+  /** Write the metrics file, with the mutex held. */
+  void WriteMetricsFile() const
+  {
+    if( m_MetricsFileName == "" )
+      {
+      return;
+      }
+
+    std::ofstream file( m_MetricsFileName.c_str() );
+
+    if( !file )
+      {
+      itkGenericExceptionMacro("Could not write metrics file " << m_MetricsFileName);
+      }
+
+    file.precision( 9 );
+
+    const std::string::size_type dot = m_MetricsFileName.rfind('.');
+    const bool json = ( dot != std::string::npos &&
+                        m_MetricsFileName.substr( dot ) == ".json" );
+
+    if( json )
+      {
+      file << "{" << std::endl;
+      file << "  \"filter\": \"" << m_Process->GetNameOfClass() << "\"," << std::endl;
+      file << "  \"comment\": \"" << m_Comment << "\"," << std::endl;
+      file << "  \"chunks\": [" << std::endl;
+      }
+    else
+      {
+      file << "chunk,index_x,index_y,index_z,size_x,size_y,size_z,"
+           << "wall_seconds,cpu_seconds,bytes_in,bytes_out,"
+           << "throughput_mb_per_second,peak_rss_bytes" << std::endl;
+      }
+
+    for( size_t k = 0; k < m_Metrics.size(); k++ )
+      {
+      const ChunkMetricsType & chunk = m_Metrics[k];
 
-  int             m_Steps;
-  int             m_Iterations;
+      // Input and output bytes moved per second of elapsed time.
+      const double throughput = chunk.WallTime > 0.0 ?
+        ( chunk.BytesIn + chunk.BytesOut ) / chunk.WallTime / ( 1024.0 * 1024.0 ) : 0.0;
+
+      if( json )
+        {
+        file << "    { \"chunk\": " << k
+             << ", \"index\": [" << chunk.Region.GetIndex(0) << ", "
+             << chunk.Region.GetIndex(1) << ", " << chunk.Region.GetIndex(2) << "]"
+             << ", \"size\": [" << chunk.Region.GetSize(0) << ", "
+             << chunk.Region.GetSize(1) << ", " << chunk.Region.GetSize(2) << "]"
+             << ", \"wall_seconds\": " << chunk.WallTime
+             << ", \"cpu_seconds\": " << chunk.ProcessorTime
+             << ", \"bytes_in\": " << chunk.BytesIn
+             << ", \"bytes_out\": " << chunk.BytesOut
+             << ", \"throughput_mb_per_second\": " << throughput
+             << ", \"peak_rss_bytes\": " << chunk.PeakResidentSetSize
+             << " }" << ( k + 1 < m_Metrics.size() ? "," : "" ) << std::endl;
+        }
+      else
+        {
+        file << k << ","
+             << chunk.Region.GetIndex(0) << "," << chunk.Region.GetIndex(1) << ","
+             << chunk.Region.GetIndex(2) << ","
+             << chunk.Region.GetSize(0) << "," << chunk.Region.GetSize(1) << ","
+             << chunk.Region.GetSize(2) << ","
+             << chunk.WallTime << "," << chunk.ProcessorTime << ","
+             << chunk.BytesIn << "," << chunk.BytesOut << ","
+             << throughput << "," << chunk.PeakResidentSetSize << std::endl;
+        }
+      }
+
+    if( json )
+      {
+      file << "  ]" << std::endl;
+      file << "}" << std::endl;
+      }
+  }
+
+  /** Bytes of the requested region of an image of one of the
+   * pixel types of the tools, or zero. */
+  static SizeValueType GetRequestedBytes( const DataObject * dataObject )
+  {
+    const ImageBase<3> * image = dynamic_cast< const ImageBase<3> * >( dataObject );
+
+    if( !image )
+      {
+      return 0;
+      }
+
+    SizeValueType pixelSize = 0;
+
+    if( dynamic_cast< const Image< unsigned char, 3 > * >( image ) )
+      {
+      pixelSize = sizeof( unsigned char );
+      }
+    else if( dynamic_cast< const Image< signed short, 3 > * >( image ) ||
+             dynamic_cast< const Image< unsigned short, 3 > * >( image ) )
+      {
+      pixelSize = sizeof( short );
+      }
+    else if( dynamic_cast< const Image< float, 3 > * >( image ) )
+      {
+      pixelSize = sizeof( float );
+      }
+    else if( dynamic_cast< const Image< double, 3 > * >( image ) )
+      {
+      pixelSize = sizeof( double );
+      }
+
+    return image->GetRequestedRegion().GetNumberOfPixels() * pixelSize;
+  }
+
+  RealTimeClock::Pointer  m_Clock;
+
+  MetricsType     m_Metrics;
+  std::string     m_MetricsFileName;
+
+  std::map< ProcessObject *, ExecutionType >  m_Executions;
+  bool            m_RequireProgress;
   std::string     m_Comment;
 
   itk::ProcessObject::Pointer m_Process;
 
+  // Workers end their executions concurrently.
+  SimpleFastMutexLock  m_Mutex;
+
 private:
   FilterStreamingWatcher(); // Purposely not implemented
 };
@@ -0,0 +1,93 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkImageChunkSource_h
+#define __itkImageChunkSource_h
+
+#include "itkImageSource.h"
+
+namespace itk
+{
+
+/** \class ImageChunkSource
+ *
+ * \brief Presents an image that only buffers one chunk as part of a
+ * larger image.
+ *
+ * The output has the geometry of the reference image (largest possible
+ * region, spacing, origin and direction) while its buffer is the one of
+ * the chunk. This allows chunks that were produced somewhere else, for
+ * example by a reader running in another thread, to be fed to filters and
+ * writers as if they came from a streamed pipeline. No pixel is copied.
+ *
+ * Requests outside of the buffered region of the chunk are an error.
+ */
+template< typename TImage >
+class ImageChunkSource : public ImageSource< TImage >
+{
+public:
+  /** Standard class typedefs. */
+  typedef ImageChunkSource              Self;
+  typedef ImageSource< TImage >         Superclass;
+  typedef SmartPointer< Self >          Pointer;
+  typedef SmartPointer< const Self >    ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro(Self);
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro(ImageChunkSource, ImageSource);
+
+  typedef TImage                          ImageType;
+  typedef typename ImageType::Pointer     ImagePointer;
+  typedef typename ImageType::RegionType  RegionType;
+
+  /** Image whose meta data (not its buffer) describes the whole image. */
+  void SetReferenceImage( const ImageBase< TImage::ImageDimension > * reference );
+
+  /** Image that holds the pixels of the current chunk. */
+  void SetChunk( ImageType * chunk );
+  ImageType * GetChunk() { return m_Chunk.GetPointer(); }
+
+protected:
+  ImageChunkSource();
+  ~ImageChunkSource() {}
+  void PrintSelf(std::ostream & os, Indent indent) const;
+
+  virtual void GenerateOutputInformation();
+
+  virtual void GenerateData();
+
+private:
+  ImageChunkSource(const Self &); // Purposely not implemented
+  void operator=(const Self &);   // Purposely not implemented
+
+  RegionType                        m_LargestPossibleRegion;
+  typename ImageType::SpacingType   m_Spacing;
+  typename ImageType::PointType     m_Origin;
+  typename ImageType::DirectionType m_Direction;
+
+  ImagePointer                      m_Chunk;
+};
+
+} // end namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkImageChunkSource.hxx"
+#endif
+
+#endif
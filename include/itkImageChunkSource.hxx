@@ -0,0 +1,109 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkImageChunkSource_hxx
+#define __itkImageChunkSource_hxx
+
+#include "itkImageChunkSource.h"
+
+namespace itk
+{
+
+template< typename TImage >
+ImageChunkSource< TImage >
+::ImageChunkSource()
+{
+  m_Spacing.Fill( 1.0 );
+  m_Origin.Fill( 0.0 );
+  m_Direction.SetIdentity();
+}
+
+template< typename TImage >
+void
+ImageChunkSource< TImage >
+::SetReferenceImage( const ImageBase< TImage::ImageDimension > * reference )
+{
+  m_LargestPossibleRegion = reference->GetLargestPossibleRegion();
+  m_Spacing   = reference->GetSpacing();
+  m_Origin    = reference->GetOrigin();
+  m_Direction = reference->GetDirection();
+  this->Modified();
+}
+
+template< typename TImage >
+void
+ImageChunkSource< TImage >
+::SetChunk( ImageType * chunk )
+{
+  if( m_Chunk != chunk )
+    {
+    m_Chunk = chunk;
+    this->Modified();
+    }
+}
+
+template< typename TImage >
+void
+ImageChunkSource< TImage >
+::GenerateOutputInformation()
+{
+  ImageType * output = this->GetOutput();
+
+  output->SetLargestPossibleRegion( m_LargestPossibleRegion );
+  output->SetSpacing( m_Spacing );
+  output->SetOrigin( m_Origin );
+  output->SetDirection( m_Direction );
+}
+
+template< typename TImage >
+void
+ImageChunkSource< TImage >
+::GenerateData()
+{
+  ImageType * output = this->GetOutput();
+
+  if( m_Chunk.IsNull() )
+    {
+    itkExceptionMacro("No chunk has been set");
+    }
+
+  const RegionType & bufferedRegion = m_Chunk->GetBufferedRegion();
+
+  if( !bufferedRegion.IsInside( output->GetRequestedRegion() ) )
+    {
+    itkExceptionMacro("Requested region " << output->GetRequestedRegion()
+      << " is not buffered by the chunk " << bufferedRegion);
+    }
+
+  output->SetBufferedRegion( bufferedRegion );
+  output->SetPixelContainer( m_Chunk->GetPixelContainer() );
+}
+
+template< typename TImage >
+void
+ImageChunkSource< TImage >
+::PrintSelf(std::ostream & os, Indent indent) const
+{
+  Superclass::PrintSelf(os, indent);
+
+  os << indent << "LargestPossibleRegion: " << m_LargestPossibleRegion << std::endl;
+  os << indent << "Chunk: " << m_Chunk.GetPointer() << std::endl;
+}
+
+} // end namespace itk
+
+#endif
@@ -0,0 +1,218 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkMemoryMappedFile_h
+#define __itkMemoryMappedFile_h
+
+#include "itkMacro.h"
+#include "itkIntTypes.h"
+
+#include <string>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace itk {
+
+/** \class MemoryMappedFile
+ *
+ * \brief Maps a whole file into the address space of the process.
+ *
+ * The mapping is private (copy-on-write): pages can be modified in memory
+ * by in-place filters without ever being written back to the file.
+ * Regions that are no longer needed can be released with ReleasePages()
+ * so that the resident set stays bounded while a large file is streamed.
+ */
+class MemoryMappedFile
+{
+public:
+  typedef SizeValueType  SizeType;
+
+  MemoryMappedFile()
+  {
+    m_Pointer = NULL;
+    m_Size = 0;
+#if defined(_WIN32)
+    m_FileHandle = INVALID_HANDLE_VALUE;
+    m_MappingHandle = NULL;
+#else
+    m_FileDescriptor = -1;
+#endif
+  }
+
+  virtual ~MemoryMappedFile()
+  {
+    this->Close();
+  }
+
+  /** Map the file. Any previous mapping is released first. */
+  void Open( const std::string & fileName )
+  {
+    this->Close();
+
+    m_FileName = fileName;
+
+#if defined(_WIN32)
+    m_FileHandle = ::CreateFileA( fileName.c_str(), GENERIC_READ, FILE_SHARE_READ,
+      NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL );
+
+    if( m_FileHandle == INVALID_HANDLE_VALUE )
+      {
+      itkGenericExceptionMacro("Could not open file for mapping: " << fileName);
+      }
+
+    LARGE_INTEGER fileSize;
+    ::GetFileSizeEx( m_FileHandle, &fileSize );
+    m_Size = static_cast< SizeType >( fileSize.QuadPart );
+
+    m_MappingHandle = ::CreateFileMappingA( m_FileHandle, NULL, PAGE_WRITECOPY, 0, 0, NULL );
+
+    if( m_MappingHandle == NULL )
+      {
+      this->Close();
+      itkGenericExceptionMacro("Could not create file mapping for: " << fileName);
+      }
+
+    m_Pointer = static_cast< char * >(
+      ::MapViewOfFile( m_MappingHandle, FILE_MAP_COPY, 0, 0, 0 ) );
+#else
+    m_FileDescriptor = ::open( fileName.c_str(), O_RDONLY );
+
+    if( m_FileDescriptor < 0 )
+      {
+      itkGenericExceptionMacro("Could not open file for mapping: " << fileName);
+      }
+
+    struct stat fileStatus;
+    ::fstat( m_FileDescriptor, &fileStatus );
+    m_Size = static_cast< SizeType >( fileStatus.st_size );
+
+    void * address = ::mmap( NULL, m_Size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                             m_FileDescriptor, 0 );
+
+    m_Pointer = ( address == MAP_FAILED ) ? NULL : static_cast< char * >( address );
+
+#if defined(MADV_SEQUENTIAL)
+    if( m_Pointer )
+      {
+      ::madvise( m_Pointer, m_Size, MADV_SEQUENTIAL );
+      }
+#endif
+#endif
+
+    if( !m_Pointer )
+      {
+      this->Close();
+      itkGenericExceptionMacro("Could not map file into memory: " << fileName);
+      }
+  }
+
+  void Close()
+  {
+#if defined(_WIN32)
+    if( m_Pointer )
+      {
+      ::UnmapViewOfFile( m_Pointer );
+      }
+    if( m_MappingHandle )
+      {
+      ::CloseHandle( m_MappingHandle );
+      m_MappingHandle = NULL;
+      }
+    if( m_FileHandle != INVALID_HANDLE_VALUE )
+      {
+      ::CloseHandle( m_FileHandle );
+      m_FileHandle = INVALID_HANDLE_VALUE;
+      }
+#else
+    if( m_Pointer )
+      {
+      ::munmap( m_Pointer, m_Size );
+      }
+    if( m_FileDescriptor >= 0 )
+      {
+      ::close( m_FileDescriptor );
+      m_FileDescriptor = -1;
+      }
+#endif
+    m_Pointer = NULL;
+    m_Size = 0;
+  }
+
+  bool IsOpen() const { return m_Pointer != NULL; }
+
+  char * GetPointer() const { return m_Pointer; }
+
+  SizeType GetSize() const { return m_Size; }
+
+  const std::string & GetFileName() const { return m_FileName; }
+
+  /** Tell the system that the pages covering [offset, offset+length) are
+   * not needed anymore. They will be faulted in again from the file if
+   * they are ever touched. */
+  void ReleasePages( SizeType offset, SizeType length )
+  {
+    if( !m_Pointer || length == 0 || offset >= m_Size )
+      {
+      return;
+      }
+
+    if( offset + length > m_Size )
+      {
+      length = m_Size - offset;
+      }
+
+#if !defined(_WIN32) && defined(MADV_DONTNEED)
+    const SizeType pageSize = static_cast< SizeType >( ::sysconf( _SC_PAGESIZE ) );
+
+    // Only whole pages inside the range can be released.
+    const SizeType first = ( ( offset + pageSize - 1 ) / pageSize ) * pageSize;
+    const SizeType last  = ( ( offset + length ) / pageSize ) * pageSize;
+
+    if( last > first )
+      {
+      ::madvise( m_Pointer + first, last - first, MADV_DONTNEED );
+      }
+#endif
+  }
+
+private:
+  MemoryMappedFile(const MemoryMappedFile &); // Purposely not implemented
+  void operator=(const MemoryMappedFile &);   // Purposely not implemented
+
+  std::string     m_FileName;
+  char *          m_Pointer;
+  SizeType        m_Size;
+
+#if defined(_WIN32)
+  HANDLE          m_FileHandle;
+  HANDLE          m_MappingHandle;
+#else
+  int             m_FileDescriptor;
+#endif
+};
+
+}
+
+#endif
@@ -0,0 +1,116 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkMemoryMappedImageFileReader_h
+#define __itkMemoryMappedImageFileReader_h
+
+#include "itkImageSource.h"
+#include "itkMemoryMappedFile.h"
+
+namespace itk
+{
+
+/** \class MemoryMappedImageFileReader
+ *
+ * \brief Zero-copy reader for uncompressed MetaImage files.
+ *
+ * The raw data file behind the MetaImage header is mapped into memory and
+ * the output image is handed a view into the mapping instead of a freshly
+ * allocated buffer. Since a view must be contiguous in memory, the output
+ * requested region is enlarged to full slabs along the slowest dimension.
+ * This matches the regions produced by the ImageFileWriter stream
+ * divisions, so pass-through and pixel-wise pipelines run without any
+ * extra copy of the data.
+ *
+ * Only scalar pixels stored uncompressed in the native byte order can be
+ * mapped. When the data offset is not aligned for the pixel type the
+ * reader falls back to a single copy out of the mapping.
+ *
+ * The mapping is owned by the reader, therefore the reader must outlive
+ * any image buffer that it has produced.
+ */
+template< typename TOutputImage >
+class MemoryMappedImageFileReader : public ImageSource< TOutputImage >
+{
+public:
+  /** Standard class typedefs. */
+  typedef MemoryMappedImageFileReader   Self;
+  typedef ImageSource< TOutputImage >   Superclass;
+  typedef SmartPointer< Self >          Pointer;
+  typedef SmartPointer< const Self >    ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro(Self);
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro(MemoryMappedImageFileReader, ImageSource);
+
+  typedef TOutputImage                          OutputImageType;
+  typedef typename OutputImageType::PixelType   OutputImagePixelType;
+  typedef typename OutputImageType::RegionType  OutputImageRegionType;
+  typedef typename OutputImageType::PixelContainer PixelContainerType;
+
+  itkStaticConstMacro(OutputImageDimension, unsigned int,
+                      TOutputImage::ImageDimension);
+
+  /** Name of the MetaImage header file (.mhd or .mha). */
+  itkSetStringMacro(FileName);
+  itkGetStringMacro(FileName);
+
+  /** Name of the raw data file that is actually mapped. Valid after
+   * UpdateOutputInformation(). */
+  itkGetStringMacro(DataFileName);
+
+  /** True when the last Update() had to copy out of the mapping. */
+  itkGetConstMacro(DataWasCopied, bool);
+
+protected:
+  MemoryMappedImageFileReader();
+  ~MemoryMappedImageFileReader() {}
+  void PrintSelf(std::ostream & os, Indent indent) const;
+
+  virtual void GenerateOutputInformation();
+
+  virtual void EnlargeOutputRequestedRegion(DataObject *output);
+
+  virtual void GenerateData();
+
+private:
+  MemoryMappedImageFileReader(const Self &); // Purposely not implemented
+  void operator=(const Self &);              // Purposely not implemented
+
+  std::string       m_FileName;
+  std::string       m_DataFileName;
+
+  SizeValueType     m_DataOffset;
+  SizeValueType     m_SlabStride;
+
+  SizeValueType     m_PreviousOffset;
+  SizeValueType     m_PreviousLength;
+
+  bool              m_DataWasCopied;
+
+  MemoryMappedFile  m_MappedFile;
+};
+
+} // end namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkMemoryMappedImageFileReader.hxx"
+#endif
+
+#endif
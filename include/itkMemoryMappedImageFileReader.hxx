@@ -0,0 +1,267 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkMemoryMappedImageFileReader_hxx
+#define __itkMemoryMappedImageFileReader_hxx
+
+#include "itkMemoryMappedImageFileReader.h"
+#include "itkMetaImageIO.h"
+#include "itkByteSwapper.h"
+#include "itksys/SystemTools.hxx"
+
+#include <cstring>
+
+namespace itk
+{
+
+template< typename TOutputImage >
+MemoryMappedImageFileReader< TOutputImage >
+::MemoryMappedImageFileReader()
+{
+  m_DataOffset = 0;
+  m_SlabStride = 0;
+  m_PreviousOffset = 0;
+  m_PreviousLength = 0;
+  m_DataWasCopied = false;
+}
+
+template< typename TOutputImage >
+void
+MemoryMappedImageFileReader< TOutputImage >
+::GenerateOutputInformation()
+{
+  OutputImageType * output = this->GetOutput();
+
+  if( m_FileName == "" )
+    {
+    itkExceptionMacro("FileName must be specified");
+    }
+
+  MetaImageIO::Pointer imageIO = MetaImageIO::New();
+
+  if( !imageIO->CanReadFile( m_FileName.c_str() ) )
+    {
+    itkExceptionMacro("File is not a MetaImage: " << m_FileName);
+    }
+
+  imageIO->SetFileName( m_FileName );
+  imageIO->ReadImageInformation();
+
+  if( imageIO->GetNumberOfDimensions() != OutputImageDimension )
+    {
+    itkExceptionMacro("File has " << imageIO->GetNumberOfDimensions()
+      << " dimensions but the output image has " << OutputImageDimension);
+    }
+
+  if( imageIO->GetNumberOfComponents() != 1 ||
+      imageIO->GetComponentTypeInfo() != typeid( OutputImagePixelType ) )
+    {
+    itkExceptionMacro("Pixel type in file ("
+      << imageIO->GetComponentTypeAsString( imageIO->GetComponentType() )
+      << ") does not match the output pixel type. Memory mapping requires an exact match.");
+    }
+
+  MetaImage * metaImage = imageIO->GetMetaImagePointer();
+
+  if( metaImage->CompressedData() )
+    {
+    itkExceptionMacro("Compressed MetaImage files cannot be memory mapped: " << m_FileName);
+    }
+
+  if( metaImage->BinaryDataByteOrderMSB() != ByteSwapper< int >::SystemIsBigEndian() )
+    {
+    itkExceptionMacro("Data is not stored in the native byte order: " << m_FileName);
+    }
+
+  const std::string elementDataFile = metaImage->ElementDataFileName();
+
+  if( elementDataFile == "LIST" || elementDataFile.find('%') != std::string::npos )
+    {
+    itkExceptionMacro("Data split across multiple files cannot be memory mapped: " << m_FileName);
+    }
+
+  if( elementDataFile == "LOCAL" )
+    {
+    m_DataFileName = m_FileName;
+    }
+  else
+    {
+    m_DataFileName = itksys::SystemTools::CollapseFullPath( elementDataFile.c_str(),
+      itksys::SystemTools::GetFilenamePath( m_FileName ).c_str() );
+    }
+
+  OutputImageRegionType largestRegion;
+  typename OutputImageType::SpacingType   spacing;
+  typename OutputImageType::PointType     origin;
+  typename OutputImageType::DirectionType direction;
+
+  SizeValueType numberOfPixels = 1;
+
+  for( unsigned int i = 0; i < OutputImageDimension; i++ )
+    {
+    largestRegion.SetIndex( i, 0 );
+    largestRegion.SetSize( i, imageIO->GetDimensions(i) );
+
+    spacing[i] = imageIO->GetSpacing(i);
+    origin[i]  = imageIO->GetOrigin(i);
+
+    const std::vector< double > axis = imageIO->GetDirection(i);
+    for( unsigned int j = 0; j < OutputImageDimension; j++ )
+      {
+      direction[j][i] = axis[j];
+      }
+
+    if( i < OutputImageDimension - 1 )
+      {
+      numberOfPixels *= imageIO->GetDimensions(i);
+      }
+    }
+
+  m_SlabStride = numberOfPixels * sizeof( OutputImagePixelType );
+
+  const SizeValueType dataSize =
+    m_SlabStride * imageIO->GetDimensions( OutputImageDimension - 1 );
+
+  //
+  // A positive header size gives the offset of the data explicitly.
+  // Otherwise the data sits at the end of the file, which also covers
+  // the LOCAL case where the binary block follows the header.
+  //
+  const SizeValueType fileSize = itksys::SystemTools::FileLength( m_DataFileName.c_str() );
+
+  if( fileSize < dataSize )
+    {
+    itkExceptionMacro("Data file " << m_DataFileName << " holds " << fileSize
+      << " bytes but " << dataSize << " bytes are expected");
+    }
+
+  if( metaImage->HeaderSize() > 0 )
+    {
+    m_DataOffset = metaImage->HeaderSize();
+    }
+  else
+    {
+    m_DataOffset = fileSize - dataSize;
+    }
+
+  output->SetLargestPossibleRegion( largestRegion );
+  output->SetSpacing( spacing );
+  output->SetOrigin( origin );
+  output->SetDirection( direction );
+}
+
+template< typename TOutputImage >
+void
+MemoryMappedImageFileReader< TOutputImage >
+::EnlargeOutputRequestedRegion(DataObject *output)
+{
+  OutputImageType * image = dynamic_cast< OutputImageType * >( output );
+
+  if( !image )
+    {
+    return;
+    }
+
+  const OutputImageRegionType & largestRegion = image->GetLargestPossibleRegion();
+  OutputImageRegionType requestedRegion = image->GetRequestedRegion();
+
+  //
+  // Only full slabs along the slowest dimension are contiguous in the file.
+  //
+  for( unsigned int i = 0; i < OutputImageDimension - 1; i++ )
+    {
+    requestedRegion.SetIndex( i, largestRegion.GetIndex(i) );
+    requestedRegion.SetSize( i, largestRegion.GetSize(i) );
+    }
+
+  image->SetRequestedRegion( requestedRegion );
+}
+
+template< typename TOutputImage >
+void
+MemoryMappedImageFileReader< TOutputImage >
+::GenerateData()
+{
+  OutputImageType * output = this->GetOutput();
+
+  const OutputImageRegionType region = output->GetRequestedRegion();
+
+  if( !m_MappedFile.IsOpen() || m_MappedFile.GetFileName() != m_DataFileName )
+    {
+    m_MappedFile.Open( m_DataFileName );
+    m_PreviousOffset = 0;
+    m_PreviousLength = 0;
+    }
+
+  const unsigned int slowest = OutputImageDimension - 1;
+
+  const SizeValueType offset = m_DataOffset +
+    static_cast< SizeValueType >( region.GetIndex( slowest ) -
+      output->GetLargestPossibleRegion().GetIndex( slowest ) ) * m_SlabStride;
+
+  const SizeValueType length = region.GetSize( slowest ) * m_SlabStride;
+
+  //
+  // Pages from the previous slab that are behind the current one will not
+  // be visited again in a forward sweep.
+  //
+  if( m_PreviousLength > 0 && m_PreviousOffset < offset )
+    {
+    const SizeValueType previousEnd = m_PreviousOffset + m_PreviousLength;
+    m_MappedFile.ReleasePages( m_PreviousOffset,
+      ( previousEnd < offset ? previousEnd : offset ) - m_PreviousOffset );
+    }
+
+  m_PreviousOffset = offset;
+  m_PreviousLength = length;
+
+  char * slab = m_MappedFile.GetPointer() + offset;
+
+  output->SetBufferedRegion( region );
+
+  if( reinterpret_cast< size_t >( slab ) % sizeof( OutputImagePixelType ) == 0 )
+    {
+    typename PixelContainerType::Pointer container = PixelContainerType::New();
+    container->SetImportPointer( reinterpret_cast< OutputImagePixelType * >( slab ),
+                                 region.GetNumberOfPixels(), false );
+    output->SetPixelContainer( container );
+    m_DataWasCopied = false;
+    }
+  else
+    {
+    output->Allocate();
+    std::memcpy( output->GetBufferPointer(), slab, length );
+    m_DataWasCopied = true;
+    }
+}
+
+template< typename TOutputImage >
+void
+MemoryMappedImageFileReader< TOutputImage >
+::PrintSelf(std::ostream & os, Indent indent) const
+{
+  Superclass::PrintSelf(os, indent);
+
+  os << indent << "FileName: " << m_FileName << std::endl;
+  os << indent << "DataFileName: " << m_DataFileName << std::endl;
+  os << indent << "DataOffset: " << m_DataOffset << std::endl;
+  os << indent << "DataWasCopied: " << m_DataWasCopied << std::endl;
+}
+
+} // end namespace itk
+
+#endif
@@ -0,0 +1,178 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkOverlappedStreamingDriver_h
+#define __itkOverlappedStreamingDriver_h
+
+#include "itkObject.h"
+#include "itkImageToImageFilter.h"
+#include "itkImageFileReader.h"
+#include "itkImageFileWriter.h"
+#include "itkImageChunkSource.h"
+#include "itkMultiThreader.h"
+#include "itkMutexLock.h"
+#include "itkConditionVariable.h"
+#include "itkProcessObserverList.h"
+
+#include <deque>
+#include <vector>
+
+namespace itk
+{
+
+/** \class OverlappedStreamingDriver
+ *
+ * \brief Streams a reader -> filter -> writer pipeline with reading,
+ * filtering and writing of consecutive stream divisions overlapped.
+ *
+ * The regular ImageFileWriter processes the stream divisions strictly one
+ * after another. This driver runs three stages instead: a reader thread
+ * that prefetches the input chunks (including the halo requested by the
+ * filter), the calling thread that runs the filter on one chunk at a time,
+ * and a writer thread that pastes the finished chunks into the output file.
+ *
+ * The number of chunks that have been read but not yet written is bounded
+ * by MaximumNumberOfChunksInFlight. A value of 1 reproduces the sequential
+ * behavior, 2 is double buffering (prefetch of chunk N+1 while chunk N is
+ * filtered) and 3 is triple buffering (chunk N-1 is also written back
+ * while chunk N is filtered).
+ *
+ * The stream divisions are the ones the ImageFileWriter would use, and the
+ * output file format must support streamed writing (e.g. MetaImage).
+ */
+template< typename TInputImage, typename TOutputImage >
+class OverlappedStreamingDriver : public Object
+{
+public:
+  /** Standard class typedefs. */
+  typedef OverlappedStreamingDriver     Self;
+  typedef Object                        Superclass;
+  typedef SmartPointer< Self >          Pointer;
+  typedef SmartPointer< const Self >    ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro(Self);
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro(OverlappedStreamingDriver, Object);
+
+  typedef TInputImage                               InputImageType;
+  typedef TOutputImage                              OutputImageType;
+  typedef typename InputImageType::Pointer          InputImagePointer;
+  typedef typename OutputImageType::Pointer         OutputImagePointer;
+  typedef typename OutputImageType::RegionType      RegionType;
+
+  typedef ImageToImageFilter< InputImageType, OutputImageType >  FilterType;
+  typedef ImageFileReader< InputImageType >                      ReaderType;
+  typedef ImageFileWriter< OutputImageType >                     WriterType;
+  typedef ImageChunkSource< InputImageType >                     InputSourceType;
+  typedef ImageChunkSource< OutputImageType >                    OutputSourceType;
+
+  /** One file per input of the filter, in the order of the filter inputs. */
+  void AddInputFileName( const std::string & fileName );
+
+  itkSetStringMacro(OutputFileName);
+  itkGetStringMacro(OutputFileName);
+
+  /** Filter run on every chunk. Its inputs are replaced by the driver. */
+  void SetFilter( FilterType * filter );
+  itkGetObjectMacro(Filter, FilterType);
+
+  /** Add an observer to the filter, and to the readers and the
+   * writer that Update creates, so that a whole run can be watched like
+   * a pipeline. */
+  void AddProcessObserver( const EventObject & event, Command * command );
+
+  itkSetMacro(NumberOfStreamDivisions, unsigned int);
+  itkGetConstMacro(NumberOfStreamDivisions, unsigned int);
+
+  itkSetClampMacro(MaximumNumberOfChunksInFlight, unsigned int, 1,
+                   NumericTraits< unsigned int >::max());
+  itkGetConstMacro(MaximumNumberOfChunksInFlight, unsigned int);
+
+  /** Passed to the writer, for formats that compress while streaming. */
+  itkSetMacro(UseCompression, bool);
+  itkGetConstMacro(UseCompression, bool);
+  itkBooleanMacro(UseCompression);
+
+  /** Run the whole pipeline. */
+  void Update();
+
+protected:
+  OverlappedStreamingDriver();
+  ~OverlappedStreamingDriver() {}
+  void PrintSelf(std::ostream & os, Indent indent) const;
+
+  struct ChunkType
+    {
+    unsigned int                      Index;
+    std::vector< InputImagePointer >  Inputs;
+    OutputImagePointer                Output;
+    };
+
+  void ReadChunks();
+  void FilterChunks();
+  void WriteChunks();
+
+  /** Record the first error and wake up every stage. */
+  void Abort( const std::string & message );
+
+  static ITK_THREAD_RETURN_TYPE ReaderThreadCallback( void * arg );
+  static ITK_THREAD_RETURN_TYPE WriterThreadCallback( void * arg );
+
+private:
+  OverlappedStreamingDriver(const Self &); // Purposely not implemented
+  void operator=(const Self &);            // Purposely not implemented
+
+  std::vector< std::string >    m_InputFileNames;
+  std::string                   m_OutputFileName;
+
+  typename FilterType::Pointer  m_Filter;
+
+  ProcessObserverList           m_ProcessObservers;
+
+  unsigned int                  m_NumberOfStreamDivisions;
+  unsigned int                  m_MaximumNumberOfChunksInFlight;
+  bool                          m_UseCompression;
+
+  std::vector< typename ReaderType::Pointer >       m_Readers;
+  std::vector< typename InputSourceType::Pointer >  m_InputSources;
+  typename OutputSourceType::Pointer                m_OutputSource;
+  typename WriterType::Pointer                      m_Writer;
+
+  /** Output chunks and, for each of them, the region of every input. */
+  std::vector< RegionType >                   m_OutputRegions;
+  std::vector< std::vector< RegionType > >    m_InputRegions;
+
+  std::deque< ChunkType >       m_ReadQueue;
+  std::deque< ChunkType >       m_WriteQueue;
+  unsigned int                  m_ChunksInFlight;
+
+  bool                          m_Aborted;
+  std::string                   m_ErrorMessage;
+
+  SimpleMutexLock               m_Mutex;
+  ConditionVariable::Pointer    m_Condition;
+};
+
+} // end namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkOverlappedStreamingDriver.hxx"
+#endif
+
+#endif
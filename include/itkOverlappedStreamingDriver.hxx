@@ -0,0 +1,440 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkOverlappedStreamingDriver_hxx
+#define __itkOverlappedStreamingDriver_hxx
+
+#include "itkOverlappedStreamingDriver.h"
+#include "itkSlabRegionSplitter.h"
+#include "itkImageIORegion.h"
+#include "itksys/SystemTools.hxx"
+
+namespace itk
+{
+
+template< typename TInputImage, typename TOutputImage >
+OverlappedStreamingDriver< TInputImage, TOutputImage >
+::OverlappedStreamingDriver()
+{
+  m_NumberOfStreamDivisions = 1;
+  m_MaximumNumberOfChunksInFlight = 3;
+  m_UseCompression = false;
+  m_ChunksInFlight = 0;
+  m_Aborted = false;
+  m_Condition = ConditionVariable::New();
+}
+
+template< typename TInputImage, typename TOutputImage >
+void
+OverlappedStreamingDriver< TInputImage, TOutputImage >
+::AddInputFileName( const std::string & fileName )
+{
+  m_InputFileNames.push_back( fileName );
+  this->Modified();
+}
+
+template< typename TInputImage, typename TOutputImage >
+void
+OverlappedStreamingDriver< TInputImage, TOutputImage >
+::SetFilter( FilterType * filter )
+{
+  if( m_Filter != filter )
+    {
+    m_Filter = filter;
+    m_ProcessObservers.Attach( filter );
+    this->Modified();
+    }
+}
+
+template< typename TInputImage, typename TOutputImage >
+void
+OverlappedStreamingDriver< TInputImage, TOutputImage >
+::AddProcessObserver( const EventObject & event, Command * command )
+{
+  m_ProcessObservers.Add( event, command );
+
+  if( m_Filter.IsNotNull() )
+    {
+    m_Filter->AddObserver( event, command );
+    }
+}
+
+template< typename TInputImage, typename TOutputImage >
+void
+OverlappedStreamingDriver< TInputImage, TOutputImage >
+::Update()
+{
+  if( m_Filter.IsNull() )
+    {
+    itkExceptionMacro("Filter must be set");
+    }
+
+  if( m_InputFileNames.empty() )
+    {
+    itkExceptionMacro("At least one input file name must be given");
+    }
+
+  if( m_OutputFileName == "" )
+    {
+    itkExceptionMacro("Output file name must be set");
+    }
+
+  const unsigned int numberOfInputs = static_cast< unsigned int >( m_InputFileNames.size() );
+
+  //
+  // Every stage owns its own pipeline objects. The readers are only used
+  // by the reader thread, the writer only by the writer thread.
+  //
+  m_Readers.clear();
+  m_InputSources.clear();
+
+  for( unsigned int j = 0; j < numberOfInputs; j++ )
+    {
+    typename ReaderType::Pointer reader = ReaderType::New();
+    reader->SetFileName( m_InputFileNames[j] );
+    reader->UpdateOutputInformation();
+    m_ProcessObservers.Attach( reader );
+
+    typename InputSourceType::Pointer source = InputSourceType::New();
+    source->SetReferenceImage( reader->GetOutput() );
+
+    m_Filter->SetInput( j, source->GetOutput() );
+
+    m_Readers.push_back( reader );
+    m_InputSources.push_back( source );
+    }
+
+  m_Filter->UpdateOutputInformation();
+
+  OutputImageType * filterOutput = m_Filter->GetOutput();
+
+  const RegionType largestRegion = filterOutput->GetLargestPossibleRegion();
+
+  //
+  // Ask the filter which input region (output chunk plus halo)
+  // it needs for every stream division.
+  //
+  const unsigned int numberOfChunks =
+    SlabRegionSplitter< OutputImageType::ImageDimension >::GetNumberOfSplits(
+      largestRegion, m_NumberOfStreamDivisions );
+
+  m_OutputRegions.resize( numberOfChunks );
+  m_InputRegions.resize( numberOfChunks );
+
+  for( unsigned int i = 0; i < numberOfChunks; i++ )
+    {
+    m_OutputRegions[i] =
+      SlabRegionSplitter< OutputImageType::ImageDimension >::GetSplit(
+        i, numberOfChunks, largestRegion );
+
+    filterOutput->SetRequestedRegion( m_OutputRegions[i] );
+    m_Filter->PropagateRequestedRegion( filterOutput );
+
+    m_InputRegions[i].resize( numberOfInputs );
+    for( unsigned int j = 0; j < numberOfInputs; j++ )
+      {
+      m_InputRegions[i][j] = m_InputSources[j]->GetOutput()->GetRequestedRegion();
+      }
+    }
+
+  m_OutputSource = OutputSourceType::New();
+  m_OutputSource->SetReferenceImage( filterOutput );
+
+  m_Writer = WriterType::New();
+  m_Writer->SetFileName( m_OutputFileName );
+  m_Writer->SetInput( m_OutputSource->GetOutput() );
+  m_Writer->SetUseCompression( m_UseCompression );
+  m_ProcessObservers.Attach( m_Writer );
+
+  //
+  // Chunks are pasted into the output, so a stale file
+  // with a different header must not be reused.
+  //
+  if( itksys::SystemTools::FileExists( m_OutputFileName.c_str() ) )
+    {
+    itksys::SystemTools::RemoveFile( m_OutputFileName.c_str() );
+    }
+
+  m_ReadQueue.clear();
+  m_WriteQueue.clear();
+  m_ChunksInFlight = 0;
+  m_Aborted = false;
+  m_ErrorMessage = "";
+
+  MultiThreader::Pointer threader = MultiThreader::New();
+
+  const ThreadIdType readerThread = threader->SpawnThread( Self::ReaderThreadCallback, this );
+  const ThreadIdType writerThread = threader->SpawnThread( Self::WriterThreadCallback, this );
+
+  this->FilterChunks();
+
+  threader->TerminateThread( readerThread );
+  threader->TerminateThread( writerThread );
+
+  m_ReadQueue.clear();
+  m_WriteQueue.clear();
+
+  if( m_Aborted )
+    {
+    itkExceptionMacro("Overlapped streaming failed: " << m_ErrorMessage);
+    }
+}
+
+template< typename TInputImage, typename TOutputImage >
+void
+OverlappedStreamingDriver< TInputImage, TOutputImage >
+::ReadChunks()
+{
+  const unsigned int numberOfChunks = static_cast< unsigned int >( m_OutputRegions.size() );
+
+  for( unsigned int i = 0; i < numberOfChunks; i++ )
+    {
+    m_Mutex.Lock();
+    while( !m_Aborted && m_ChunksInFlight >= m_MaximumNumberOfChunksInFlight )
+      {
+      m_Condition->Wait( &m_Mutex );
+      }
+    const bool aborted = m_Aborted;
+    if( !aborted )
+      {
+      m_ChunksInFlight++;
+      }
+    m_Mutex.Unlock();
+
+    if( aborted )
+      {
+      return;
+      }
+
+    ChunkType chunk;
+    chunk.Index = i;
+
+    for( unsigned int j = 0; j < m_Readers.size(); j++ )
+      {
+      ReaderType * reader = m_Readers[j];
+      reader->GetOutput()->SetRequestedRegion( m_InputRegions[i][j] );
+      reader->Update();
+
+      InputImagePointer image = reader->GetOutput();
+      image->DisconnectPipeline();
+
+      chunk.Inputs.push_back( image );
+      }
+
+    m_Mutex.Lock();
+    m_ReadQueue.push_back( chunk );
+    m_Condition->Broadcast();
+    m_Mutex.Unlock();
+    }
+}
+
+template< typename TInputImage, typename TOutputImage >
+void
+OverlappedStreamingDriver< TInputImage, TOutputImage >
+::FilterChunks()
+{
+  const unsigned int numberOfChunks = static_cast< unsigned int >( m_OutputRegions.size() );
+
+  for( unsigned int i = 0; i < numberOfChunks; i++ )
+    {
+    m_Mutex.Lock();
+    while( !m_Aborted && m_ReadQueue.empty() )
+      {
+      m_Condition->Wait( &m_Mutex );
+      }
+    if( m_Aborted )
+      {
+      m_Mutex.Unlock();
+      return;
+      }
+    ChunkType chunk = m_ReadQueue.front();
+    m_ReadQueue.pop_front();
+    m_Mutex.Unlock();
+
+    try
+      {
+      for( unsigned int j = 0; j < m_InputSources.size(); j++ )
+        {
+        m_InputSources[j]->SetChunk( chunk.Inputs[j] );
+        }
+
+      OutputImageType * output = m_Filter->GetOutput();
+      output->SetRequestedRegion( m_OutputRegions[chunk.Index] );
+      m_Filter->Update();
+
+      chunk.Output = output;
+      chunk.Output->DisconnectPipeline();
+
+      for( unsigned int j = 0; j < m_InputSources.size(); j++ )
+        {
+        m_InputSources[j]->SetChunk( NULL );
+        }
+      chunk.Inputs.clear();
+      }
+    catch( ExceptionObject & excp )
+      {
+      this->Abort( excp.GetDescription() );
+      return;
+      }
+
+    m_Mutex.Lock();
+    m_WriteQueue.push_back( chunk );
+    m_Condition->Broadcast();
+    m_Mutex.Unlock();
+    }
+}
+
+template< typename TInputImage, typename TOutputImage >
+void
+OverlappedStreamingDriver< TInputImage, TOutputImage >
+::WriteChunks()
+{
+  const unsigned int numberOfChunks = static_cast< unsigned int >( m_OutputRegions.size() );
+
+  const typename RegionType::IndexType largestIndex =
+    m_OutputSource->GetOutput()->GetLargestPossibleRegion().GetIndex();
+
+  for( unsigned int i = 0; i < numberOfChunks; i++ )
+    {
+    m_Mutex.Lock();
+    while( !m_Aborted && m_WriteQueue.empty() )
+      {
+      m_Condition->Wait( &m_Mutex );
+      }
+    if( m_Aborted )
+      {
+      m_Mutex.Unlock();
+      return;
+      }
+    ChunkType chunk = m_WriteQueue.front();
+    m_WriteQueue.pop_front();
+    m_Mutex.Unlock();
+
+    ImageIORegion ioRegion( OutputImageType::ImageDimension );
+    ImageIORegionAdaptor< OutputImageType::ImageDimension >::Convert(
+      m_OutputRegions[chunk.Index], ioRegion, largestIndex );
+
+    m_OutputSource->SetChunk( chunk.Output );
+    m_Writer->SetIORegion( ioRegion );
+    m_Writer->Update();
+    m_OutputSource->SetChunk( NULL );
+
+    chunk.Output = NULL;
+
+    m_Mutex.Lock();
+    m_ChunksInFlight--;
+    m_Condition->Broadcast();
+    m_Mutex.Unlock();
+    }
+}
+
+template< typename TInputImage, typename TOutputImage >
+void
+OverlappedStreamingDriver< TInputImage, TOutputImage >
+::Abort( const std::string & message )
+{
+  m_Mutex.Lock();
+  if( !m_Aborted )
+    {
+    m_Aborted = true;
+    m_ErrorMessage = message;
+    }
+  m_Condition->Broadcast();
+  m_Mutex.Unlock();
+}
+
+template< typename TInputImage, typename TOutputImage >
+ITK_THREAD_RETURN_TYPE
+OverlappedStreamingDriver< TInputImage, TOutputImage >
+::ReaderThreadCallback( void * arg )
+{
+  MultiThreader::ThreadInfoStruct * info =
+    static_cast< MultiThreader::ThreadInfoStruct * >( arg );
+
+  Self * driver = static_cast< Self * >( info->UserData );
+
+  try
+    {
+    driver->ReadChunks();
+    }
+  catch( ExceptionObject & excp )
+    {
+    driver->Abort( excp.GetDescription() );
+    }
+  catch( std::exception & excp )
+    {
+    driver->Abort( excp.what() );
+    }
+  catch( ... )
+    {
+    driver->Abort( "Unknown exception" );
+    }
+
+  return ITK_THREAD_RETURN_VALUE;
+}
+
+template< typename TInputImage, typename TOutputImage >
+ITK_THREAD_RETURN_TYPE
+OverlappedStreamingDriver< TInputImage, TOutputImage >
+::WriterThreadCallback( void * arg )
+{
+  MultiThreader::ThreadInfoStruct * info =
+    static_cast< MultiThreader::ThreadInfoStruct * >( arg );
+
+  Self * driver = static_cast< Self * >( info->UserData );
+
+  try
+    {
+    driver->WriteChunks();
+    }
+  catch( ExceptionObject & excp )
+    {
+    driver->Abort( excp.GetDescription() );
+    }
+  catch( std::exception & excp )
+    {
+    driver->Abort( excp.what() );
+    }
+  catch( ... )
+    {
+    driver->Abort( "Unknown exception" );
+    }
+
+  return ITK_THREAD_RETURN_VALUE;
+}
+
+template< typename TInputImage, typename TOutputImage >
+void
+OverlappedStreamingDriver< TInputImage, TOutputImage >
+::PrintSelf(std::ostream & os, Indent indent) const
+{
+  Superclass::PrintSelf(os, indent);
+
+  for( unsigned int j = 0; j < m_InputFileNames.size(); j++ )
+    {
+    os << indent << "InputFileName[" << j << "]: " << m_InputFileNames[j] << std::endl;
+    }
+  os << indent << "OutputFileName: " << m_OutputFileName << std::endl;
+  os << indent << "NumberOfStreamDivisions: " << m_NumberOfStreamDivisions << std::endl;
+  os << indent << "MaximumNumberOfChunksInFlight: "
+     << m_MaximumNumberOfChunksInFlight << std::endl;
+  os << indent << "UseCompression: " << m_UseCompression << std::endl;
+}
+
+} // end namespace itk
+
+#endif
@@ -0,0 +1,294 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef _itkPeakMemoryGuard_h
+#define _itkPeakMemoryGuard_h
+
+#include "itkCommand.h"
+#include "itkProcessObject.h"
+#include "itkImageIOFactory.h"
+#include "itkProcessResourceUsage.h"
+#include "itkSimpleFastMutexLock.h"
+#include "itkStreamingMemoryPlanner.h"
+
+#include <cstdlib>
+#include <ostream>
+#include <set>
+#include <string>
+
+namespace itk {
+
+/** \class PeakMemoryGuard
+ *
+ * \brief Checks that a run stays within a declared memory budget.
+ *
+ * The budget applies to the growth of the peak resident set size above
+ * a baseline taken when the guard is constructed, or later with
+ * ResetBaseline, so the libraries, the pipeline objects and any work
+ * done until then (autotuning, histogram passes) do not count. The guard
+ * restarts the peak from the current resident set size, which becomes
+ * the baseline; where the system does not allow that, the peak reached
+ * so far is the baseline. The peak is the high water mark kept by the
+ * system, so short lived allocations between two checks are not missed.
+ *
+ * The peak is checked on every progress and end event of the watched
+ * process objects. When it goes over the budget, all of them are asked
+ * to abort, so that a filter that requests its whole input does not get
+ * to buffer all of it before the run fails. The streaming drivers create
+ * their process objects while they run; WatchDriver watches those too.
+ * Events may come from any thread.
+ *
+ * Pages of memory mapped files count as resident once they are touched.
+ */
+class PeakMemoryGuard
+{
+public:
+  PeakMemoryGuard()
+  {
+    m_Budget = 0;
+    m_Exceeded = false;
+    this->ResetBaseline();
+  }
+
+  virtual ~PeakMemoryGuard() {}
+
+  /** Take the baseline again, so that the work done since the guard was
+   * constructed does not count. */
+  void ResetBaseline()
+  {
+    // After a reset, the peak is the current resident set size.
+    ProcessResourceUsage::ResetPeakResidentSetSize();
+    m_Baseline = ProcessResourceUsage::GetPeakResidentSetSize();
+  }
+
+  /** Bytes the peak may grow above the baseline. Zero disables the check. */
+  void SetBudget( SizeValueType budget ) { m_Budget = budget; }
+  SizeValueType GetBudget() const { return m_Budget; }
+
+  SizeValueType GetBaseline() const { return m_Baseline; }
+
+  /** Growth of the peak resident set size above the baseline, in bytes. */
+  SizeValueType GetPeakGrowth() const
+  {
+    const SizeValueType peak = ProcessResourceUsage::GetPeakResidentSetSize();
+    return peak > m_Baseline ? peak - m_Baseline : 0;
+  }
+
+  /** Check the peak now. Returns false once the budget has been exceeded. */
+  bool Check()
+  {
+    if( m_Budget > 0 && this->GetPeakGrowth() > m_Budget )
+      {
+      m_Exceeded = true;
+      }
+    return !m_Exceeded;
+  }
+
+  bool IsWithinBudget() { return this->Check(); }
+
+  /** Check the peak on the progress and end events of one process object. */
+  void Watch( ProcessObject * process )
+  {
+    if( process == NULL || m_Processes.find( process ) != m_Processes.end() )
+      {
+      return;
+      }
+
+    m_Processes.insert( process );
+
+    MemberCommand< PeakMemoryGuard >::Pointer command = MemberCommand< PeakMemoryGuard >::New();
+    command->SetCallbackFunction( this, &PeakMemoryGuard::CheckEvent );
+
+    process->AddObserver( ProgressEvent(), command );
+    process->AddObserver( EndEvent(), command );
+  }
+
+  /** Watch the filters of a streaming driver, and the readers and
+   * writers it creates when it runs. */
+  template< typename TDriver >
+  void WatchDriver( TDriver * driver )
+  {
+    MemberCommand< PeakMemoryGuard >::Pointer command = MemberCommand< PeakMemoryGuard >::New();
+    command->SetCallbackFunction( this, &PeakMemoryGuard::CheckEvent );
+
+    driver->AddProcessObserver( ProgressEvent(), command );
+    driver->AddProcessObserver( EndEvent(), command );
+  }
+
+  /** Watch a process object and, recursively, the sources of its inputs. */
+  void WatchPipeline( ProcessObject * process )
+  {
+    if( process == NULL || m_Processes.find( process ) != m_Processes.end() )
+      {
+      return;
+      }
+
+    this->Watch( process );
+
+    ProcessObject::DataObjectPointerArray inputs = process->GetInputs();
+    for( size_t i = 0; i < inputs.size(); i++ )
+      {
+      if( inputs[i] )
+        {
+        this->WatchPipeline( inputs[i]->GetSource() );
+        }
+      }
+  }
+
+  /** Print the peak growth, the baseline and the budget. */
+  void Report( std::ostream & os )
+  {
+    const double megabyte = 1024.0 * 1024.0;
+
+    os << "Peak memory: " << this->GetPeakGrowth() / megabyte
+       << " MiB above the " << m_Baseline / megabyte << " MiB at start";
+
+    if( m_Budget > 0 )
+      {
+      os << " (budget " << m_Budget / megabyte << " MiB"
+         << ( this->IsWithinBudget() ? ")" : ", exceeded)" );
+      }
+
+    os << std::endl;
+  }
+
+  /** Parse a budget given either as a size, such as "512MiB" (see
+   * StreamingMemoryPlanner::ParseMemorySize), or as a multiple of the
+   * uncompressed size of one stream division of the input file, such as
+   * "3x", optionally followed by an allowance for everything else, such
+   * as "3x+64MiB". */
+  static SizeValueType ParseBudget( const std::string & text,
+                                    const std::string & inputFileName,
+                                    unsigned int numberOfDivisions )
+  {
+    const std::string::size_type times = text.find_first_of( "xX" );
+
+    if( times == std::string::npos )
+      {
+      return StreamingMemoryPlanner::ParseMemorySize( text );
+      }
+
+    const std::string number = text.substr( 0, times );
+
+    const char * begin = number.c_str();
+    char * end = NULL;
+
+    const double factor = std::strtod( begin, &end );
+
+    if( end == begin || *end != '\0' || factor <= 0.0 )
+      {
+      itkGenericExceptionMacro("Invalid memory budget: " << text);
+      }
+
+    SizeValueType allowance = 0;
+
+    const std::string rest = text.substr( times + 1 );
+
+    if( rest != "" )
+      {
+      if( rest[0] != '+' )
+        {
+        itkGenericExceptionMacro("Invalid memory budget: " << text);
+        }
+      allowance = StreamingMemoryPlanner::ParseMemorySize( rest.substr( 1 ) );
+      }
+
+    ImageIOBase::Pointer imageIO = ImageIOFactory::CreateImageIO(
+      inputFileName.c_str(), ImageIOFactory::ReadMode );
+
+    if( imageIO.IsNull() )
+      {
+      itkGenericExceptionMacro("Could not create IO object for file " << inputFileName);
+      }
+
+    imageIO->SetFileName( inputFileName );
+    imageIO->ReadImageInformation();
+
+    if( numberOfDivisions < 1 )
+      {
+      numberOfDivisions = 1;
+      }
+
+    //
+    // The divisions are slabs along the slowest dimension, so the largest
+    // one holds the rounded up number of slices.
+    //
+    const SizeValueType imageSize =
+      static_cast< SizeValueType >( imageIO->GetImageSizeInBytes() );
+
+    const SizeValueType slices =
+      imageIO->GetDimensions( imageIO->GetNumberOfDimensions() - 1 );
+
+    const SizeValueType sliceSize = slices > 0 ? imageSize / slices : 0;
+
+    const SizeValueType divisionSize =
+      sliceSize * ( ( slices + numberOfDivisions - 1 ) / numberOfDivisions );
+
+    return static_cast< SizeValueType >( factor * divisionSize ) + allowance;
+  }
+
+private:
+  PeakMemoryGuard(const PeakMemoryGuard &); // Purposely not implemented
+  void operator=(const PeakMemoryGuard &); // Purposely not implemented
+
+  void CheckEvent( Object * caller, const EventObject & itkNotUsed( event ) )
+  {
+    m_Mutex.Lock();
+
+    const bool alreadyExceeded = m_Exceeded;
+
+    if( !this->Check() )
+      {
+      if( !alreadyExceeded )
+        {
+        std::cerr << "Memory budget of " << m_Budget << " bytes exceeded, aborting" << std::endl;
+
+        std::set< ProcessObject * >::iterator it = m_Processes.begin();
+        while( it != m_Processes.end() )
+          {
+          ( *it )->AbortGenerateDataOn();
+          ++it;
+          }
+        }
+
+      //
+      // The process objects of a driver are not in the watched set, as
+      // they only live for part of the run. They are aborted when they
+      // report.
+      //
+      ProcessObject * process = dynamic_cast< ProcessObject * >( caller );
+      if( process )
+        {
+        process->AbortGenerateDataOn();
+        }
+      }
+
+    m_Mutex.Unlock();
+  }
+
+  SizeValueType                 m_Baseline;
+  SizeValueType                 m_Budget;
+  bool                          m_Exceeded;
+
+  std::set< ProcessObject * >   m_Processes;
+
+  SimpleFastMutexLock           m_Mutex;
+};
+
+} // end namespace itk
+
+#endif
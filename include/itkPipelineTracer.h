@@ -0,0 +1,284 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef _itkPipelineTracer_h
+#define _itkPipelineTracer_h
+
+#include "itkCommand.h"
+#include "itkProcessObject.h"
+#include "itkImageBase.h"
+#include "itkRealTimeClock.h"
+#include "itkSimpleFastMutexLock.h"
+
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+namespace itk {
+
+/** \class PipelineTracer
+ *
+ * \brief Records when every watched ProcessObject starts, progresses and
+ * ends, and on which thread, and writes the timeline as a trace-event
+ * JSON file (the format of chrome://tracing and Perfetto).
+ *
+ * Every execution of a process object is a duration event, named after
+ * the object and numbered, with the requested region of its first output
+ * as argument. Upstream of a streaming writer, that is one event per
+ * stream division and process object. Progress is recorded as a counter
+ * track per process object. Threads are numbered in the order in which
+ * they first report an event.
+ *
+ * Events may come from any thread.
+ */
+class PipelineTracer
+{
+public:
+  PipelineTracer()
+  {
+    m_Clock = RealTimeClock::New();
+    m_Origin = m_Clock->GetTimeInSeconds();
+  }
+
+  virtual ~PipelineTracer() {}
+
+  /** Record the events of one process object, under the given name,
+   * or its class name. */
+  void Watch( ProcessObject * process, const std::string & name = "" )
+  {
+    if( process == NULL || m_Names.find( process ) != m_Names.end() )
+      {
+      return;
+      }
+
+    m_Names[process] = name != "" ? name : MakeName( process );
+    m_Executions[process] = 0;
+
+    MemberCommand< PipelineTracer >::Pointer command = MemberCommand< PipelineTracer >::New();
+    command->SetCallbackFunction( this, &PipelineTracer::RecordEvent );
+
+    process->AddObserver( StartEvent(), command );
+    process->AddObserver( EndEvent(), command );
+    process->AddObserver( ProgressEvent(), command );
+  }
+
+  /** Record the events of the filters of a streaming driver, and of the
+   * readers and writers it creates when it runs. */
+  template< typename TDriver >
+  void WatchDriver( TDriver * driver )
+  {
+    MemberCommand< PipelineTracer >::Pointer command = MemberCommand< PipelineTracer >::New();
+    command->SetCallbackFunction( this, &PipelineTracer::RecordEvent );
+
+    driver->AddProcessObserver( StartEvent(), command );
+    driver->AddProcessObserver( EndEvent(), command );
+    driver->AddProcessObserver( ProgressEvent(), command );
+  }
+
+  /** Watch a process object and, recursively, the sources of its inputs. */
+  void WatchPipeline( ProcessObject * process )
+  {
+    if( process == NULL || m_Names.find( process ) != m_Names.end() )
+      {
+      return;
+      }
+
+    this->Watch( process );
+
+    ProcessObject::DataObjectPointerArray inputs = process->GetInputs();
+    for( size_t i = 0; i < inputs.size(); i++ )
+      {
+      if( inputs[i] )
+        {
+        ProcessObject * source = inputs[i]->GetSource();
+        this->WatchPipeline( source );
+        }
+      }
+  }
+
+  /** Write all the events recorded so far. Returns false if the file
+   * could not be written. */
+  bool Write( const std::string & fileName )
+  {
+    std::ofstream file( fileName.c_str() );
+
+    if( !file )
+      {
+      return false;
+      }
+
+    m_Mutex.Lock();
+
+    file << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [" << std::endl;
+
+    for( unsigned int t = 0; t < m_Threads.size(); t++ )
+      {
+      file << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << t
+           << ", \"args\": {\"name\": \"thread " << t << "\"}}," << std::endl;
+      }
+
+    for( size_t k = 0; k < m_Events.size(); k++ )
+      {
+      file << m_Events[k] << ( k + 1 < m_Events.size() ? "," : "" ) << std::endl;
+      }
+
+    file << "]}" << std::endl;
+
+    m_Mutex.Unlock();
+
+    return !file.fail();
+  }
+
+protected:
+  typedef std::map< const Object *, std::string >  NameMapType;
+  typedef std::map< const Object *, unsigned int > CountMapType;
+
+#if defined(_WIN32)
+  typedef DWORD      ThreadType;
+#else
+  typedef pthread_t  ThreadType;
+#endif
+
+  /** Class name of a process object, and its address to tell apart
+   * objects of the same class. */
+  static std::string MakeName( const ProcessObject * process )
+  {
+    std::ostringstream label;
+    label << process->GetNameOfClass() << " " << static_cast< const void * >( process );
+    return label.str();
+  }
+
+  /** Small number of the calling thread. Called with the mutex held. */
+  unsigned int GetThreadNumber()
+  {
+#if defined(_WIN32)
+    const ThreadType self = GetCurrentThreadId();
+#else
+    const ThreadType self = pthread_self();
+#endif
+
+    for( unsigned int t = 0; t < m_Threads.size(); t++ )
+      {
+#if defined(_WIN32)
+      if( m_Threads[t] == self )
+#else
+      if( pthread_equal( m_Threads[t], self ) )
+#endif
+        {
+        return t;
+        }
+      }
+
+    m_Threads.push_back( self );
+    return static_cast< unsigned int >( m_Threads.size() - 1 );
+  }
+
+  void RecordEvent( Object * caller, const EventObject & event )
+  {
+    ProcessObject * process = dynamic_cast< ProcessObject * >( caller );
+
+    if( process == NULL )
+      {
+      return;
+      }
+
+    // Microseconds since the tracer was created.
+    const double timestamp = ( m_Clock->GetTimeInSeconds() - m_Origin ) * 1e6;
+
+    std::ostringstream record;
+    record.precision( 15 );
+
+    m_Mutex.Lock();
+
+    const unsigned int thread = this->GetThreadNumber();
+
+    // The process objects of a driver are named when they first report.
+    if( m_Names.find( caller ) == m_Names.end() )
+      {
+      m_Names[caller] = MakeName( process );
+      }
+
+    const std::string & name = m_Names[caller];
+
+    if( StartEvent().CheckEvent( &event ) )
+      {
+      const unsigned int execution = m_Executions[caller]++;
+
+      record << "{\"name\": \"" << name << " #" << execution << "\", \"cat\": \"pipeline\""
+             << ", \"ph\": \"B\", \"ts\": " << timestamp
+             << ", \"pid\": 1, \"tid\": " << thread;
+
+      ProcessObject::DataObjectPointerArray outputs = process->GetOutputs();
+      const ImageBase< 3 > * image = outputs.empty() ? NULL :
+        dynamic_cast< const ImageBase< 3 > * >( outputs[0].GetPointer() );
+
+      if( image )
+        {
+        const ImageRegion< 3 > & region = image->GetRequestedRegion();
+        record << ", \"args\": {\"index\": [" << region.GetIndex(0) << ", "
+               << region.GetIndex(1) << ", " << region.GetIndex(2) << "], \"size\": ["
+               << region.GetSize(0) << ", " << region.GetSize(1) << ", "
+               << region.GetSize(2) << "]}";
+        }
+
+      record << "}";
+      }
+    else if( EndEvent().CheckEvent( &event ) )
+      {
+      record << "{\"name\": \"" << name << " #" << m_Executions[caller] - 1
+             << "\", \"cat\": \"pipeline\", \"ph\": \"E\", \"ts\": " << timestamp
+             << ", \"pid\": 1, \"tid\": " << thread << "}";
+      }
+    else
+      {
+      record << "{\"name\": \"" << name << " progress\", \"ph\": \"C\", \"ts\": " << timestamp
+             << ", \"pid\": 1, \"tid\": " << thread
+             << ", \"args\": {\"progress\": " << process->GetProgress() << "}}";
+      }
+
+    m_Events.push_back( record.str() );
+
+    m_Mutex.Unlock();
+  }
+
+  RealTimeClock::Pointer      m_Clock;
+  double                      m_Origin;
+
+  NameMapType                 m_Names;
+  CountMapType                m_Executions;
+
+  std::vector< ThreadType >   m_Threads;
+  std::vector< std::string >  m_Events;
+
+  SimpleFastMutexLock         m_Mutex;
+
+private:
+  PipelineTracer(const PipelineTracer &); // Purposely not implemented
+  void operator=(const PipelineTracer &); // Purposely not implemented
+};
+
+}
+
+#endif
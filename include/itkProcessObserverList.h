@@ -0,0 +1,83 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkProcessObserverList_h
+#define __itkProcessObserverList_h
+
+#include "itkCommand.h"
+#include "itkProcessObject.h"
+
+#include <vector>
+
+namespace itk
+{
+
+/** \class ProcessObserverList
+ *
+ * \brief Observers to attach to process objects that do not exist yet.
+ *
+ * The streaming drivers create their readers and writers inside Update,
+ * so the observers of a run (a memory guard, a tracer) cannot be added
+ * to them beforehand. The drivers keep the observers in this list, and
+ * attach them to every process object they create, and to the filters
+ * they are given.
+ */
+class ProcessObserverList
+{
+public:
+  ProcessObserverList() {}
+
+  ~ProcessObserverList()
+  {
+    for( size_t k = 0; k < m_Events.size(); k++ )
+      {
+      delete m_Events[k];
+      }
+  }
+
+  /** Observer to attach from now on. */
+  void Add( const EventObject & event, Command * command )
+  {
+    m_Events.push_back( event.MakeObject() );
+    m_Commands.push_back( command );
+  }
+
+  /** Add all the observers to a process object. */
+  void Attach( ProcessObject * process )
+  {
+    if( process == NULL )
+      {
+      return;
+      }
+
+    for( size_t k = 0; k < m_Events.size(); k++ )
+      {
+      process->AddObserver( *m_Events[k], m_Commands[k] );
+      }
+  }
+
+private:
+  ProcessObserverList(const ProcessObserverList &); // Purposely not implemented
+  void operator=(const ProcessObserverList &);      // Purposely not implemented
+
+  std::vector< EventObject * >     m_Events;
+  std::vector< Command::Pointer >  m_Commands;
+};
+
+} // end namespace itk
+
+#endif
@@ -0,0 +1,244 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkProcessResourceUsage_h
+#define __itkProcessResourceUsage_h
+
+#include "itkIntTypes.h"
+
+#include <fstream>
+#include <string>
+#include <time.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <psapi.h>
+#if defined(_MSC_VER)
+#pragma comment(lib, "psapi.lib")
+#endif
+#else
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+namespace itk
+{
+
+/** \class ProcessResourceUsage
+ *
+ * \brief Processor time, memory and I/O used so far by the whole process.
+ */
+class ProcessResourceUsage
+{
+public:
+  /** Cumulative I/O counters of the process. */
+  struct IOCountersType
+    {
+    /** Bytes passed through read and write calls, whether they were
+     * served by the page cache or not. */
+    SizeValueType   BytesRead;
+    SizeValueType   BytesWritten;
+    SizeValueType   ReadCalls;
+    SizeValueType   WriteCalls;
+
+    /** Bytes the process caused to be fetched from, or sent to, storage.
+     * Only known where HasStorageCounters is set. */
+    SizeValueType   StorageBytesRead;
+    SizeValueType   StorageBytesWritten;
+    bool            HasStorageCounters;
+
+    /** Page faults that needed (major) or did not need (minor) a read
+     * from storage. Memory mapped files are read through major faults. */
+    SizeValueType   MajorPageFaults;
+    SizeValueType   MinorPageFaults;
+    };
+
+  /** Processor time of all the threads of the process, in seconds. */
+  static double GetProcessorTime()
+  {
+    return static_cast< double >( ::clock() ) / CLOCKS_PER_SEC;
+  }
+
+  /** Largest resident set size the process has had, in bytes.
+   * Zero where the system does not report it. */
+  static SizeValueType GetPeakResidentSetSize()
+  {
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS counters;
+    if( GetProcessMemoryInfo( GetCurrentProcess(), &counters, sizeof( counters ) ) )
+      {
+      return static_cast< SizeValueType >( counters.PeakWorkingSetSize );
+      }
+    return 0;
+#else
+    //
+    // Linux keeps the peak in /proc/self/status as well, where, unlike
+    // the one of getrusage, it can be reset.
+    //
+    std::ifstream status( "/proc/self/status" );
+
+    std::string name;
+    while( status >> name )
+      {
+      if( name == "VmHWM:" )
+        {
+        SizeValueType kilobytes = 0;
+        if( status >> kilobytes )
+          {
+          return kilobytes * 1024;
+          }
+        break;
+        }
+      }
+
+    struct rusage usage;
+    if( getrusage( RUSAGE_SELF, &usage ) != 0 )
+      {
+      return 0;
+      }
+#if defined(__APPLE__)
+    return static_cast< SizeValueType >( usage.ru_maxrss );
+#else
+    // Linux and the BSDs report kilobytes.
+    return static_cast< SizeValueType >( usage.ru_maxrss ) * 1024;
+#endif
+#endif
+  }
+
+  /** Restart the peak resident set size from the current resident set
+   * size, so that successive runs in one process can be measured apart.
+   * Returns false where the system does not allow it (it needs Linux 4.0
+   * or later). */
+  static bool ResetPeakResidentSetSize()
+  {
+#if defined(__linux__)
+    std::ofstream clearRefs( "/proc/self/clear_refs" );
+    clearRefs << "5" << std::flush;
+    return clearRefs.good();
+#else
+    return false;
+#endif
+  }
+
+  /** Resident set size of the process now, in bytes. Where the system
+   * does not report it, the peak resident set size is returned instead. */
+  static SizeValueType GetResidentSetSize()
+  {
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS counters;
+    if( GetProcessMemoryInfo( GetCurrentProcess(), &counters, sizeof( counters ) ) )
+      {
+      return static_cast< SizeValueType >( counters.WorkingSetSize );
+      }
+    return 0;
+#else
+    //
+    // Linux gives the sizes of the process, in pages, in /proc/self/statm.
+    // The second one is the resident set.
+    //
+    std::ifstream statm( "/proc/self/statm" );
+
+    SizeValueType virtualPages = 0;
+    SizeValueType residentPages = 0;
+
+    if( statm >> virtualPages >> residentPages )
+      {
+      return residentPages * static_cast< SizeValueType >( sysconf( _SC_PAGESIZE ) );
+      }
+
+    return GetPeakResidentSetSize();
+#endif
+  }
+
+  /** Current I/O counters. Counters the system does not report are zero. */
+  static IOCountersType GetIOCounters()
+  {
+    IOCountersType counters;
+
+    counters.BytesRead = 0;
+    counters.BytesWritten = 0;
+    counters.ReadCalls = 0;
+    counters.WriteCalls = 0;
+    counters.StorageBytesRead = 0;
+    counters.StorageBytesWritten = 0;
+    counters.HasStorageCounters = false;
+    counters.MajorPageFaults = 0;
+    counters.MinorPageFaults = 0;
+
+#if defined(_WIN32)
+    IO_COUNTERS io;
+    if( GetProcessIoCounters( GetCurrentProcess(), &io ) )
+      {
+      counters.BytesRead = static_cast< SizeValueType >( io.ReadTransferCount );
+      counters.BytesWritten = static_cast< SizeValueType >( io.WriteTransferCount );
+      counters.ReadCalls = static_cast< SizeValueType >( io.ReadOperationCount );
+      counters.WriteCalls = static_cast< SizeValueType >( io.WriteOperationCount );
+      }
+#else
+    //
+    // Linux keeps the I/O accounting of a process in /proc/self/io,
+    // as "name: value" lines.
+    //
+    std::ifstream io( "/proc/self/io" );
+
+    std::string name;
+    SizeValueType value = 0;
+
+    while( io >> name >> value )
+      {
+      if( name == "rchar:" )
+        {
+        counters.BytesRead = value;
+        }
+      else if( name == "wchar:" )
+        {
+        counters.BytesWritten = value;
+        }
+      else if( name == "syscr:" )
+        {
+        counters.ReadCalls = value;
+        }
+      else if( name == "syscw:" )
+        {
+        counters.WriteCalls = value;
+        }
+      else if( name == "read_bytes:" )
+        {
+        counters.StorageBytesRead = value;
+        counters.HasStorageCounters = true;
+        }
+      else if( name == "write_bytes:" )
+        {
+        counters.StorageBytesWritten = value;
+        }
+      }
+
+    struct rusage usage;
+    if( getrusage( RUSAGE_SELF, &usage ) == 0 )
+      {
+      counters.MajorPageFaults = static_cast< SizeValueType >( usage.ru_majflt );
+      counters.MinorPageFaults = static_cast< SizeValueType >( usage.ru_minflt );
+      }
+#endif
+
+    return counters;
+  }
+};
+
+} // end namespace itk
+
+#endif
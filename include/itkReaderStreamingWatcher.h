@@ -19,17 +19,58 @@
 #define _itkReaderStreamingWatcher_h
 
 #include "itkCommand.h"
-#include "itkTimeProbesCollectorBase.h"
+#include "itkImageBase.h"
+#include "itkRealTimeClock.h"
+#include "itkProcessResourceUsage.h"
+
+#include <algorithm>
+#include <vector>
 
 namespace itk {
 
+/** \class ReaderStreamingWatcher
+ *
+ * \brief Reports the progress of a reader, and the I/O of the process
+ * during every read.
+ *
+ * The I/O counters of the process are sampled when a read starts, on
+ * every progress event and when it ends. For every read the watcher
+ * reports the bytes that went through read calls and their rate, the
+ * bytes that had to come from storage and their rate, the number of read
+ * calls and of major page faults, and an estimate of the fraction of the
+ * bytes that the page cache served. Memory mapped reads do not go
+ * through read calls; their storage reads show up as major page faults.
+ *
+ * The counters belong to the whole process, so I/O done by other
+ * threads during the read is counted too.
+ */
 class ReaderStreamingWatcher
 {
 public:
+  typedef ProcessResourceUsage::IOCountersType  IOCountersType;
+
+  /** I/O of one read. */
+  struct ReadMetricsType
+    {
+    double          WallTime;
+    IOCountersType  Counters;
+    };
+
+  typedef std::vector< ReadMetricsType > MetricsType;
+
   ReaderStreamingWatcher(itk::ProcessObject* o)
   {
     m_Process = o;
     m_Steps = 0;
+    m_Clock = RealTimeClock::New();
+    m_WallStart = 0.0;
+    m_StartCounters = ProcessResourceUsage::GetIOCounters();
+
+    // A watcher of no process reports nothing.
+    if( !m_Process )
+      {
+      return;
+      }
 
     itk::SimpleMemberCommand<ReaderStreamingWatcher>::Pointer startFilterCommand;
     itk::SimpleMemberCommand<ReaderStreamingWatcher>::Pointer endFilterCommand;
@@ -50,11 +91,27 @@ public:
 
   virtual ~ReaderStreamingWatcher() {}
 
+  const MetricsType & GetMetrics() const
+  {
+    return m_Metrics;
+  }
+
   virtual void ShowProgress()
   {
     m_Steps++;
 
-    std::cout << " | " << m_Process->GetProgress() << std::flush;
+    // Rate of the read so far.
+    const ReadMetricsType sample = this->Sample();
+
+    std::cout << " | " << m_Process->GetProgress();
+
+    if( sample.WallTime > 0.0 )
+      {
+      std::cout << " (" << ToMegabytes( sample.Counters.BytesRead ) / sample.WallTime
+                << " MB/s)";
+      }
+
+    std::cout << std::flush;
 
     if ( (m_Steps % 10) == 0 )
       {
@@ -64,8 +121,6 @@ public:
 
   virtual void StartFilter()
   {
-    this->m_Chronometer.Start("Reading");
-
     m_Steps = 0;
 
     std::cout << "-------- Start " << m_Process->GetNameOfClass();
@@ -87,20 +142,88 @@ public:
       }
 
      std::cout << std::flush << std::endl;
+
+    m_WallStart = m_Clock->GetTimeInSeconds();
+    m_StartCounters = ProcessResourceUsage::GetIOCounters();
     }
 
   const char *GetNameOfClass () {return m_Process->GetNameOfClass();}
 
   virtual void EndFilter()
   {
-    this->m_Chronometer.Stop("Reading");
-    this->m_Chronometer.Report( std::cout );
+    const ReadMetricsType read = this->Sample();
+    const IOCountersType & counters = read.Counters;
+
+    m_Metrics.push_back( read );
+
+    const double seconds = read.WallTime > 0.0 ? read.WallTime : 1e-9;
+
+    std::cout << std::endl << "Read took " << read.WallTime << " seconds." << std::endl;
+
+    std::cout << "  Read calls: " << counters.ReadCalls << ", "
+              << ToMegabytes( counters.BytesRead ) << " MB, "
+              << ToMegabytes( counters.BytesRead ) / seconds << " MB/s" << std::endl;
+
+    if( counters.HasStorageCounters )
+      {
+      std::cout << "  From storage: "
+                << ToMegabytes( counters.StorageBytesRead ) << " MB, "
+                << ToMegabytes( counters.StorageBytesRead ) / seconds << " MB/s" << std::endl;
+
+      //
+      // Bytes that went through read calls without being fetched from
+      // storage were served by the page cache.
+      //
+      if( counters.BytesRead > 0 )
+        {
+        const double fromStorage = std::min( 1.0,
+          static_cast< double >( counters.StorageBytesRead ) / counters.BytesRead );
+
+        std::cout << "  Page cache hits: about "
+                  << 100.0 * ( 1.0 - fromStorage ) << " %" << std::endl;
+        }
+      }
+
+    std::cout << "  Major page faults: " << counters.MajorPageFaults << std::endl;
+
+    std::cout << "-------- End " << m_Process->GetNameOfClass() << std::endl << std::endl;
   }
 
 protected:
+  static double ToMegabytes( SizeValueType bytes )
+  {
+    return bytes / ( 1024.0 * 1024.0 );
+  }
+
+  /** Time and I/O since the read started. */
+  ReadMetricsType Sample() const
+  {
+    const IOCountersType now = ProcessResourceUsage::GetIOCounters();
+
+    ReadMetricsType read;
+
+    read.WallTime = m_Clock->GetTimeInSeconds() - m_WallStart;
+
+    read.Counters = now;
+    read.Counters.BytesRead -= m_StartCounters.BytesRead;
+    read.Counters.BytesWritten -= m_StartCounters.BytesWritten;
+    read.Counters.ReadCalls -= m_StartCounters.ReadCalls;
+    read.Counters.WriteCalls -= m_StartCounters.WriteCalls;
+    read.Counters.StorageBytesRead -= m_StartCounters.StorageBytesRead;
+    read.Counters.StorageBytesWritten -= m_StartCounters.StorageBytesWritten;
+    read.Counters.MajorPageFaults -= m_StartCounters.MajorPageFaults;
+    read.Counters.MinorPageFaults -= m_StartCounters.MinorPageFaults;
+
+    return read;
+  }
+
   int             m_Steps;
 
-  itk::TimeProbesCollectorBase m_Chronometer;
+  RealTimeClock::Pointer  m_Clock;
+  double                  m_WallStart;
+  IOCountersType          m_StartCounters;
+
+  MetricsType     m_Metrics;
 
   itk::ProcessObject::Pointer m_Process;
 
@@ -0,0 +1,145 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkRegionOfInterestList_h
+#define __itkRegionOfInterestList_h
+
+#include "itkImageRegion.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace itk
+{
+
+/** \class RegionOfInterestList
+ *
+ * \brief Slices, or rectangles of slices, to extract from a volume, each
+ * one with its own output file.
+ *
+ * Every region is given by the six values
+ *
+ *   outputImageFile SliceNumberInZ startX startY sizeX sizeY
+ *
+ * either on the command line or as one line of a list file. Blank lines
+ * and lines starting with '#' are skipped in list files. Sort() puts the
+ * regions in file order, so that they can be read in a single sweep.
+ */
+class RegionOfInterestList
+{
+public:
+  typedef ImageRegion< 3 >              RegionType;
+  typedef std::vector< std::string >    ValuesType;
+
+  /** Add a region from its output file name and the five numbers that
+   * follow it. Returns false if some value is missing. */
+  bool AddRegion( const ValuesType & values )
+  {
+    if( values.size() < 6 )
+      {
+      return false;
+      }
+
+    RegionType region;
+    region.SetIndex( 0, atoi( values[2].c_str() ) );
+    region.SetIndex( 1, atoi( values[3].c_str() ) );
+    region.SetIndex( 2, atoi( values[1].c_str() ) );
+    region.SetSize( 0, atoi( values[4].c_str() ) );
+    region.SetSize( 1, atoi( values[5].c_str() ) );
+    region.SetSize( 2, 1 ); // one slice in Z
+
+    m_Entries.push_back( EntryType( values[0], region ) );
+
+    return true;
+  }
+
+  /** Add the regions of a list file, one per line. */
+  bool ReadListFile( const std::string & listFileName )
+  {
+    std::ifstream list( listFileName.c_str() );
+
+    if( !list )
+      {
+      return false;
+      }
+
+    std::string line;
+    while( std::getline( list, line ) )
+      {
+      std::istringstream tokens( line );
+
+      ValuesType values;
+      std::string token;
+      while( tokens >> token )
+        {
+        values.push_back( token );
+        }
+
+      if( values.empty() || values[0][0] == '#' )
+        {
+        continue;
+        }
+
+      if( !this->AddRegion( values ) )
+        {
+        return false;
+        }
+      }
+
+    return true;
+  }
+
+  /** Order the regions by slice, then by row. */
+  void Sort()
+  {
+    std::stable_sort( m_Entries.begin(), m_Entries.end(), CompareEntries );
+  }
+
+  unsigned int GetNumberOfRegions() const
+  {
+    return static_cast< unsigned int >( m_Entries.size() );
+  }
+
+  const std::string & GetFileName( unsigned int i ) const { return m_Entries[i].first; }
+  const RegionType & GetRegion( unsigned int i ) const { return m_Entries[i].second; }
+
+private:
+  typedef std::pair< std::string, RegionType >  EntryType;
+
+  static bool CompareEntries( const EntryType & a, const EntryType & b )
+  {
+    for( unsigned int i = 3; i > 0; i-- )
+      {
+      if( a.second.GetIndex(i-1) != b.second.GetIndex(i-1) )
+        {
+        return a.second.GetIndex(i-1) < b.second.GetIndex(i-1);
+        }
+      }
+    return false;
+  }
+
+  std::vector< EntryType >  m_Entries;
+};
+
+} // end namespace itk
+
+#endif
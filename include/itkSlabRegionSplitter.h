@@ -0,0 +1,112 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkSlabRegionSplitter_h
+#define __itkSlabRegionSplitter_h
+
+#include "itkImageRegion.h"
+
+namespace itk
+{
+
+/** \class SlabRegionSplitter
+ *
+ * \brief Splits a region into slabs along its outermost dimension.
+ *
+ * The pieces are exactly the ones that ImageFileWriter produces for a
+ * given number of stream divisions, so that pipelines driven outside of
+ * the writer process the same regions as the writer would.
+ */
+template< unsigned int VImageDimension >
+class SlabRegionSplitter
+{
+public:
+  typedef ImageRegion< VImageDimension >  RegionType;
+
+  /** Number of pieces actually produced when asking for numberOfPieces. */
+  static unsigned int GetNumberOfSplits( const RegionType & region,
+                                         unsigned int numberOfPieces )
+  {
+    int splitAxis;
+    SizeValueType valuesPerPiece;
+    return ComputeSplitting( region, numberOfPieces, splitAxis, valuesPerPiece );
+  }
+
+  /** Region of the i-th piece out of numberOfPieces. */
+  static RegionType GetSplit( unsigned int i, unsigned int numberOfPieces,
+                              const RegionType & region )
+  {
+    int splitAxis;
+    SizeValueType valuesPerPiece;
+
+    const unsigned int numberOfSplits =
+      ComputeSplitting( region, numberOfPieces, splitAxis, valuesPerPiece );
+
+    RegionType split = region;
+
+    if( splitAxis < 0 || i >= numberOfSplits )
+      {
+      return split;
+      }
+
+    split.SetIndex( splitAxis, region.GetIndex( splitAxis ) + i * valuesPerPiece );
+
+    if( i + 1 < numberOfSplits )
+      {
+      split.SetSize( splitAxis, valuesPerPiece );
+      }
+    else
+      {
+      split.SetSize( splitAxis, region.GetSize( splitAxis ) - i * valuesPerPiece );
+      }
+
+    return split;
+  }
+
+private:
+  static unsigned int ComputeSplitting( const RegionType & region,
+                                        unsigned int numberOfPieces,
+                                        int & splitAxis,
+                                        SizeValueType & valuesPerPiece )
+  {
+    splitAxis = VImageDimension - 1;
+
+    while( region.GetSize( splitAxis ) == 1 )
+      {
+      --splitAxis;
+      if( splitAxis < 0 )
+        {
+        return 1;
+        }
+      }
+
+    if( numberOfPieces < 1 )
+      {
+      numberOfPieces = 1;
+      }
+
+    const SizeValueType range = region.GetSize( splitAxis );
+
+    valuesPerPiece = ( range + numberOfPieces - 1 ) / numberOfPieces;
+
+    return static_cast< unsigned int >( ( range + valuesPerPiece - 1 ) / valuesPerPiece );
+  }
+};
+
+} // end namespace itk
+
+#endif
@@ -0,0 +1,222 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkSliceCache_h
+#define __itkSliceCache_h
+
+#include "itkObject.h"
+#include "itkImageFileReader.h"
+#include "itkMultiThreader.h"
+#include "itkMutexLock.h"
+#include "itkConditionVariable.h"
+
+#include <deque>
+#include <list>
+#include <map>
+#include <vector>
+
+namespace itk
+{
+
+/** \class SliceCache
+ *
+ * \brief Reads the Z slices of a 3D image file on demand and keeps the
+ * most recently used ones in memory.
+ *
+ * GetSlice() returns a single slice as an image of its own, whose
+ * buffered region is that slice. A slice that is not cached is read from
+ * the file together with Margin slices on each side, in one request to
+ * the reader, and all of them are added to the cache. When the cache
+ * holds more than Capacity slices the least recently used ones are
+ * dropped. The returned images stay valid after they are dropped, for
+ * as long as the caller keeps a pointer to them.
+ *
+ * Prefetch() hands a few slices to a background thread that reads them
+ * with a reader of its own, so that the slices ahead of the one being
+ * displayed are already in memory when they are asked for. A new call
+ * replaces the slices still waiting from the previous one.
+ *
+ * With a ShrinkFactor larger than one the cache holds a coarse version
+ * of every slice, made of every ShrinkFactor-th pixel along X and Y. Only
+ * the rows that are kept are requested from the reader, one request per
+ * row, so a coarse slice costs a fraction of the reads of a full one.
+ * The coarse slices have their own largest possible region, starting at
+ * zero in X and Y, and a spacing that is ShrinkFactor times larger.
+ *
+ * The file is only read through requested regions, so memory stays
+ * bounded by the cache capacity as long as the ImageIO can stream.
+ */
+template< typename TImage >
+class SliceCache : public Object
+{
+public:
+  /** Standard class typedefs. */
+  typedef SliceCache                    Self;
+  typedef Object                        Superclass;
+  typedef SmartPointer< Self >          Pointer;
+  typedef SmartPointer< const Self >    ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro(Self);
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro(SliceCache, Object);
+
+  typedef TImage                                  ImageType;
+  typedef typename ImageType::Pointer             ImagePointer;
+  typedef typename ImageType::RegionType          RegionType;
+  typedef typename ImageType::PixelType           PixelType;
+  typedef typename ImageType::SpacingType         SpacingType;
+  typedef typename ImageType::PointType           PointType;
+  typedef ImageFileReader< ImageType >            ReaderType;
+
+  itkStaticConstMacro(ImageDimension, unsigned int, TImage::ImageDimension);
+
+  itkSetStringMacro(FileName);
+  itkGetStringMacro(FileName);
+
+  /** Largest number of slices kept in memory. */
+  itkSetClampMacro(Capacity, unsigned int, 1, NumericTraits< unsigned int >::max());
+  itkGetConstMacro(Capacity, unsigned int);
+
+  /** Slices read on each side of a slice that is not cached. */
+  itkSetMacro(Margin, unsigned int);
+  itkGetConstMacro(Margin, unsigned int);
+
+  /** Subsampling along X and Y. Set before Initialize(). */
+  itkSetClampMacro(ShrinkFactor, unsigned int, 1, NumericTraits< unsigned int >::max());
+  itkGetConstMacro(ShrinkFactor, unsigned int);
+
+  /** Read the image information and start the prefetch thread. */
+  void Initialize();
+
+  /** Stop the prefetch thread. Called by the destructor. */
+  void Stop();
+
+  /** Whole image, as read from the file header and shrunk. */
+  const RegionType & GetLargestPossibleRegion() const
+  {
+    return m_LargestPossibleRegion;
+  }
+
+  /** Spacing and origin of the slices, known after Initialize(). */
+  const SpacingType & GetSpacing() const
+  {
+    return m_Spacing;
+  }
+
+  const PointType & GetOrigin() const
+  {
+    return m_Origin;
+  }
+
+  /** Image holding only slice z, read from the file if needed. */
+  ImagePointer GetSlice( IndexValueType z );
+
+  /** Queue up to count slices after z, or before it when direction is
+   * negative, to be read in the background. */
+  void Prefetch( IndexValueType z, int direction, unsigned int count );
+
+  /** Queue slice z alone to be read in the background. */
+  void Load( IndexValueType z );
+
+  /** Drop the slices still waiting to be read in the background. */
+  void CancelPrefetch();
+
+  bool IsCached( IndexValueType z ) const;
+
+  SizeValueType GetNumberOfCachedSlices() const;
+
+  /** Slices found in the cache, slices read by GetSlice() and slices
+   * read by the prefetch thread, since the cache was created. */
+  itkGetConstMacro(NumberOfHits, SizeValueType);
+  itkGetConstMacro(NumberOfMisses, SizeValueType);
+  itkGetConstMacro(NumberOfPrefetchedSlices, SizeValueType);
+
+protected:
+  SliceCache();
+  ~SliceCache();
+  void PrintSelf(std::ostream & os, Indent indent) const;
+
+  typedef std::list< IndexValueType >             UsageListType;
+
+  struct EntryType
+    {
+    ImagePointer                      Slice;
+    typename UsageListType::iterator  Usage;
+    };
+
+  typedef std::map< IndexValueType, EntryType >   EntryMapType;
+
+  /** Read slices first to last with the given reader and add them to the
+   * cache, slice z last so that it is the most recently used. Returns
+   * slice z, or null when z is not among them. */
+  ImagePointer ReadSlices( ReaderType * reader, IndexValueType first,
+                           IndexValueType last, IndexValueType z );
+
+  /** Add a slice, or mark it used if it is there. Mutex must be held. */
+  void Insert( IndexValueType z, ImageType * slice );
+
+  /** Slice z, marked as used, or null. Mutex must be held. */
+  ImageType * Find( IndexValueType z );
+
+  void RunPrefetch();
+
+  static ITK_THREAD_RETURN_TYPE PrefetchThreadCallback( void * arg );
+
+private:
+  SliceCache(const Self &);       // Purposely not implemented
+  void operator=(const Self &);   // Purposely not implemented
+
+  std::string                     m_FileName;
+  unsigned int                    m_Capacity;
+  unsigned int                    m_Margin;
+  unsigned int                    m_ShrinkFactor;
+
+  RegionType                      m_LargestPossibleRegion;
+  RegionType                      m_FileRegion;
+  SpacingType                     m_Spacing;
+  PointType                       m_Origin;
+
+  typename ReaderType::Pointer    m_Reader;
+  typename ReaderType::Pointer    m_PrefetchReader;
+
+  EntryMapType                    m_Entries;
+  UsageListType                   m_Usage;
+
+  std::deque< IndexValueType >    m_PrefetchQueue;
+
+  SizeValueType                   m_NumberOfHits;
+  SizeValueType                   m_NumberOfMisses;
+  SizeValueType                   m_NumberOfPrefetchedSlices;
+
+  MultiThreader::Pointer          m_Threader;
+  ThreadIdType                    m_PrefetchThread;
+  bool                            m_Running;
+  bool                            m_Stopping;
+
+  mutable SimpleMutexLock         m_Mutex;
+  ConditionVariable::Pointer      m_Condition;
+};
+
+} // end namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkSliceCache.hxx"
+#endif
+
+#endif
@@ -0,0 +1,496 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkSliceCache_hxx
+#define __itkSliceCache_hxx
+
+#include "itkSliceCache.h"
+
+#include <algorithm>
+
+namespace itk
+{
+
+template< typename TImage >
+SliceCache< TImage >
+::SliceCache()
+{
+  m_Capacity = 32;
+  m_Margin = 1;
+  m_ShrinkFactor = 1;
+  m_NumberOfHits = 0;
+  m_NumberOfMisses = 0;
+  m_NumberOfPrefetchedSlices = 0;
+  m_PrefetchThread = 0;
+  m_Running = false;
+  m_Stopping = false;
+  m_Condition = ConditionVariable::New();
+}
+
+template< typename TImage >
+SliceCache< TImage >
+::~SliceCache()
+{
+  this->Stop();
+}
+
+template< typename TImage >
+void
+SliceCache< TImage >
+::Initialize()
+{
+  this->Stop();
+
+  m_Reader = ReaderType::New();
+  m_Reader->SetFileName( m_FileName );
+  m_Reader->UpdateOutputInformation();
+
+  m_PrefetchReader = ReaderType::New();
+  m_PrefetchReader->SetFileName( m_FileName );
+  m_PrefetchReader->UpdateOutputInformation();
+
+  const ImageType * output = m_Reader->GetOutput();
+
+  m_FileRegion = output->GetLargestPossibleRegion();
+  m_LargestPossibleRegion = m_FileRegion;
+  m_Spacing = output->GetSpacing();
+  m_Origin = output->GetOrigin();
+
+  //
+  // The coarse pixel (i,j) is the file pixel (x0 + i f, y0 + j f), so
+  // the origin moves to the first file pixel and the spacing grows.
+  //
+  if( m_ShrinkFactor > 1 )
+    {
+    typename ImageType::IndexType start = m_FileRegion.GetIndex();
+    start[2] = 0;
+    output->TransformIndexToPhysicalPoint( start, m_Origin );
+
+    for( unsigned int i = 0; i < 2; i++ )
+      {
+      m_LargestPossibleRegion.SetIndex( i, 0 );
+      m_LargestPossibleRegion.SetSize( i,
+        ( m_FileRegion.GetSize( i ) + m_ShrinkFactor - 1 ) / m_ShrinkFactor );
+      m_Spacing[i] *= m_ShrinkFactor;
+      }
+    }
+
+  m_Mutex.Lock();
+  m_Entries.clear();
+  m_Usage.clear();
+  m_PrefetchQueue.clear();
+  m_Stopping = false;
+  m_Mutex.Unlock();
+
+  m_Threader = MultiThreader::New();
+  m_PrefetchThread = m_Threader->SpawnThread( Self::PrefetchThreadCallback, this );
+  m_Running = true;
+}
+
+template< typename TImage >
+void
+SliceCache< TImage >
+::Stop()
+{
+  if( !m_Running )
+    {
+    return;
+    }
+
+  m_Mutex.Lock();
+  m_Stopping = true;
+  m_PrefetchQueue.clear();
+  m_Condition->Broadcast();
+  m_Mutex.Unlock();
+
+  m_Threader->TerminateThread( m_PrefetchThread );
+  m_Running = false;
+}
+
+template< typename TImage >
+typename SliceCache< TImage >::ImagePointer
+SliceCache< TImage >
+::GetSlice( IndexValueType z )
+{
+  const IndexValueType firstSlice = m_LargestPossibleRegion.GetIndex( 2 );
+  const IndexValueType lastSlice =
+    firstSlice + static_cast< IndexValueType >( m_LargestPossibleRegion.GetSize( 2 ) ) - 1;
+
+  if( z < firstSlice || z > lastSlice )
+    {
+    itkExceptionMacro("Slice " << z << " is outside of ["
+                      << firstSlice << ", " << lastSlice << "]");
+    }
+
+  m_Mutex.Lock();
+  ImagePointer slice = this->Find( z );
+  if( slice )
+    {
+    m_NumberOfHits++;
+    }
+  m_Mutex.Unlock();
+
+  if( slice )
+    {
+    return slice;
+    }
+
+  const IndexValueType margin = static_cast< IndexValueType >( m_Margin );
+
+  slice = this->ReadSlices( m_Reader,
+                            std::max( z - margin, firstSlice ),
+                            std::min( z + margin, lastSlice ), z );
+
+  m_Mutex.Lock();
+  m_NumberOfMisses++;
+  m_Mutex.Unlock();
+
+  return slice;
+}
+
+template< typename TImage >
+void
+SliceCache< TImage >
+::Prefetch( IndexValueType z, int direction, unsigned int count )
+{
+  if( !m_Running || direction == 0 )
+    {
+    return;
+    }
+
+  const IndexValueType firstSlice = m_LargestPossibleRegion.GetIndex( 2 );
+  const IndexValueType lastSlice =
+    firstSlice + static_cast< IndexValueType >( m_LargestPossibleRegion.GetSize( 2 ) ) - 1;
+
+  const IndexValueType step = ( direction > 0 ) ? 1 : -1;
+
+  m_Mutex.Lock();
+
+  //
+  // Slices queued for an earlier position are no longer worth reading.
+  //
+  m_PrefetchQueue.clear();
+
+  for( unsigned int i = 1; i <= count; i++ )
+    {
+    const IndexValueType s = z + step * static_cast< IndexValueType >( i );
+    if( s < firstSlice || s > lastSlice )
+      {
+      break;
+      }
+    if( m_Entries.find( s ) == m_Entries.end() )
+      {
+      m_PrefetchQueue.push_back( s );
+      }
+    }
+
+  if( !m_PrefetchQueue.empty() )
+    {
+    m_Condition->Signal();
+    }
+
+  m_Mutex.Unlock();
+}
+
+template< typename TImage >
+void
+SliceCache< TImage >
+::Load( IndexValueType z )
+{
+  if( !m_Running )
+    {
+    return;
+    }
+
+  m_Mutex.Lock();
+  m_PrefetchQueue.clear();
+  if( m_Entries.find( z ) == m_Entries.end() )
+    {
+    m_PrefetchQueue.push_back( z );
+    m_Condition->Signal();
+    }
+  m_Mutex.Unlock();
+}
+
+template< typename TImage >
+void
+SliceCache< TImage >
+::CancelPrefetch()
+{
+  m_Mutex.Lock();
+  m_PrefetchQueue.clear();
+  m_Mutex.Unlock();
+}
+
+template< typename TImage >
+bool
+SliceCache< TImage >
+::IsCached( IndexValueType z ) const
+{
+  m_Mutex.Lock();
+  const bool cached = ( m_Entries.find( z ) != m_Entries.end() );
+  m_Mutex.Unlock();
+  return cached;
+}
+
+template< typename TImage >
+SizeValueType
+SliceCache< TImage >
+::GetNumberOfCachedSlices() const
+{
+  m_Mutex.Lock();
+  const SizeValueType numberOfSlices = m_Entries.size();
+  m_Mutex.Unlock();
+  return numberOfSlices;
+}
+
+template< typename TImage >
+typename SliceCache< TImage >::ImagePointer
+SliceCache< TImage >
+::ReadSlices( ReaderType * reader, IndexValueType first,
+              IndexValueType last, IndexValueType z )
+{
+  RegionType slab = m_FileRegion;
+  slab.SetIndex( 2, first );
+  slab.SetSize( 2, static_cast< SizeValueType >( last - first + 1 ) );
+
+  ImageType * output = reader->GetOutput();
+
+  const IndexValueType factor = static_cast< IndexValueType >( m_ShrinkFactor );
+
+  std::vector< ImagePointer > slices;
+
+  for( IndexValueType s = first; s <= last; s++ )
+    {
+    RegionType sliceRegion = m_LargestPossibleRegion;
+    sliceRegion.SetIndex( 2, s );
+    sliceRegion.SetSize( 2, 1 );
+
+    ImagePointer slice = ImageType::New();
+    slice->CopyInformation( output );
+    slice->SetLargestPossibleRegion( m_LargestPossibleRegion );
+    slice->SetBufferedRegion( sliceRegion );
+    slice->SetRequestedRegion( sliceRegion );
+    slice->SetSpacing( m_Spacing );
+    slice->SetOrigin( m_Origin );
+    slice->Allocate();
+    slices.push_back( slice );
+    }
+
+  //
+  // Full slices come in one request for the whole slab. Coarse ones ask
+  // for one row at a time, of all the slices in the slab, and the reader
+  // is only updated when the row is not already in its buffer.
+  //
+  const SizeValueType rowLength = m_LargestPossibleRegion.GetSize( 0 );
+  const SizeValueType numberOfRows = m_LargestPossibleRegion.GetSize( 1 );
+
+  for( SizeValueType j = 0; j < numberOfRows; j++ )
+    {
+    typename ImageType::IndexType rowStart = slab.GetIndex();
+    rowStart[1] += static_cast< IndexValueType >( j ) * factor;
+
+    RegionType rowRegion = slab;
+    rowRegion.SetIndex( rowStart );
+    rowRegion.SetSize( 1, 1 );
+
+    if( !output->GetBufferedRegion().IsInside( rowRegion ) )
+      {
+      output->SetRequestedRegion( factor > 1 ? rowRegion : slab );
+      reader->Update();
+      }
+
+    for( size_t k = 0; k < slices.size(); k++ )
+      {
+      rowStart[2] = first + static_cast< IndexValueType >( k );
+
+      const PixelType * source =
+        output->GetBufferPointer() + output->ComputeOffset( rowStart );
+
+      PixelType * destination = slices[k]->GetBufferPointer() + j * rowLength;
+
+      for( SizeValueType i = 0; i < rowLength; i++ )
+        {
+        destination[i] = source[i * factor];
+        }
+      }
+    }
+
+  ImagePointer requestedSlice;
+
+  m_Mutex.Lock();
+  for( size_t k = 0; k < slices.size(); k++ )
+    {
+    const IndexValueType s = first + static_cast< IndexValueType >( k );
+    if( s == z )
+      {
+      requestedSlice = slices[k];
+      }
+    else
+      {
+      this->Insert( s, slices[k] );
+      }
+    }
+  if( requestedSlice )
+    {
+    this->Insert( z, requestedSlice );
+    }
+  m_Mutex.Unlock();
+
+  return requestedSlice;
+}
+
+template< typename TImage >
+void
+SliceCache< TImage >
+::Insert( IndexValueType z, ImageType * slice )
+{
+  if( this->Find( z ) )
+    {
+    return;
+    }
+
+  m_Usage.push_front( z );
+
+  EntryType & entry = m_Entries[z];
+  entry.Slice = slice;
+  entry.Usage = m_Usage.begin();
+
+  while( m_Entries.size() > m_Capacity )
+    {
+    m_Entries.erase( m_Usage.back() );
+    m_Usage.pop_back();
+    }
+}
+
+template< typename TImage >
+TImage *
+SliceCache< TImage >
+::Find( IndexValueType z )
+{
+  typename EntryMapType::iterator entry = m_Entries.find( z );
+
+  if( entry == m_Entries.end() )
+    {
+    return NULL;
+    }
+
+  m_Usage.splice( m_Usage.begin(), m_Usage, entry->second.Usage );
+
+  return entry->second.Slice;
+}
+
+template< typename TImage >
+void
+SliceCache< TImage >
+::RunPrefetch()
+{
+  m_Mutex.Lock();
+
+  while( true )
+    {
+    while( !m_Stopping && m_PrefetchQueue.empty() )
+      {
+      m_Condition->Wait( &m_Mutex );
+      }
+
+    if( m_Stopping )
+      {
+      break;
+      }
+
+    //
+    // Take the queued slices that are next to each other, in the order
+    // of travel, so that they are read in a single request.
+    //
+    IndexValueType first = m_PrefetchQueue.front();
+    IndexValueType last = first;
+    m_PrefetchQueue.pop_front();
+
+    while( !m_PrefetchQueue.empty() &&
+           ( m_PrefetchQueue.front() == last + 1 || m_PrefetchQueue.front() == first - 1 ) &&
+           m_Entries.find( m_PrefetchQueue.front() ) == m_Entries.end() )
+      {
+      first = std::min( first, m_PrefetchQueue.front() );
+      last = std::max( last, m_PrefetchQueue.front() );
+      m_PrefetchQueue.pop_front();
+      }
+
+    if( first == last && m_Entries.find( first ) != m_Entries.end() )
+      {
+      continue;
+      }
+
+    m_Mutex.Unlock();
+
+    bool done = true;
+    try
+      {
+      this->ReadSlices( m_PrefetchReader, first, last, first );
+      }
+    catch( ExceptionObject & )
+      {
+      //
+      // The slices will be read again, and the error reported, when
+      // they are asked for.
+      //
+      done = false;
+      }
+
+    m_Mutex.Lock();
+    if( done )
+      {
+      m_NumberOfPrefetchedSlices += static_cast< SizeValueType >( last - first + 1 );
+      }
+    }
+
+  m_Mutex.Unlock();
+}
+
+template< typename TImage >
+ITK_THREAD_RETURN_TYPE
+SliceCache< TImage >
+::PrefetchThreadCallback( void * arg )
+{
+  MultiThreader::ThreadInfoStruct * info =
+    static_cast< MultiThreader::ThreadInfoStruct * >( arg );
+
+  Self * cache = static_cast< Self * >( info->UserData );
+
+  cache->RunPrefetch();
+
+  return ITK_THREAD_RETURN_VALUE;
+}
+
+template< typename TImage >
+void
+SliceCache< TImage >
+::PrintSelf(std::ostream & os, Indent indent) const
+{
+  Superclass::PrintSelf(os, indent);
+  os << indent << "FileName: " << m_FileName << std::endl;
+  os << indent << "Capacity: " << m_Capacity << std::endl;
+  os << indent << "Margin: " << m_Margin << std::endl;
+  os << indent << "ShrinkFactor: " << m_ShrinkFactor << std::endl;
+  os << indent << "NumberOfHits: " << m_NumberOfHits << std::endl;
+  os << indent << "NumberOfMisses: " << m_NumberOfMisses << std::endl;
+  os << indent << "NumberOfPrefetchedSlices: " << m_NumberOfPrefetchedSlices << std::endl;
+}
+
+} // end namespace itk
+
+#endif
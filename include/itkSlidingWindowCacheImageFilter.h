@@ -0,0 +1,131 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkSlidingWindowCacheImageFilter_h
+#define __itkSlidingWindowCacheImageFilter_h
+
+#include "itkImageToImageFilter.h"
+
+namespace itk
+{
+
+/** \class SlidingWindowCacheImageFilter
+ *
+ * \brief Keeps the last slab that went through it and only asks its
+ * input for the slices that the next slab adds.
+ *
+ * A neighborhood filter that is streamed along Z requests from its input
+ * the output slab plus a halo of slices on both sides. Consecutive slabs
+ * then overlap by twice the radius, and these slices are read or computed
+ * again for every slab. Placed in front of the neighborhood filter, this
+ * filter keeps the slab it produced last. When the next requested slab
+ * has the same extent in the other dimensions and starts inside the
+ * previous one, the overlapping slices are moved to the front of the
+ * buffer and only the slices past the end of the previous slab are
+ * requested from the input.
+ *
+ * Requests that do not move forward, or a modified upstream pipeline,
+ * fall back to requesting the whole region from the input.
+ *
+ * A stage with several consumers that lag behind each other, such as a
+ * neighborhood filter and a pixel-wise filter that both read the same
+ * intermediate, cannot be served by a single output because an output
+ * only holds one requested region. The filter can therefore have several
+ * branches: every output keeps the requested region of its own consumer,
+ * and all of them share one buffer that covers the union of the requests.
+ *
+ * The output buffer is kept by the filter, so consumers must not modify
+ * it in place.
+ */
+template< typename TImage >
+class SlidingWindowCacheImageFilter : public ImageToImageFilter< TImage, TImage >
+{
+public:
+  /** Standard class typedefs. */
+  typedef SlidingWindowCacheImageFilter         Self;
+  typedef ImageToImageFilter< TImage, TImage >  Superclass;
+  typedef SmartPointer< Self >                  Pointer;
+  typedef SmartPointer< const Self >            ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro(Self);
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro(SlidingWindowCacheImageFilter, ImageToImageFilter);
+
+  typedef TImage                                    ImageType;
+  typedef typename ImageType::RegionType            RegionType;
+  typedef typename ImageType::PixelContainer        PixelContainerType;
+  typedef typename ImageType::PixelContainerPointer PixelContainerPointer;
+
+  itkStaticConstMacro(ImageDimension, unsigned int, TImage::ImageDimension);
+
+  /** Number of slices taken from the cache, and computed upstream,
+   * since the filter was created. */
+  itkGetConstMacro(NumberOfReusedSlices, SizeValueType);
+  itkGetConstMacro(NumberOfRequestedSlices, SizeValueType);
+
+  /** Number of outputs, each one for a different consumer. */
+  void SetNumberOfBranches( unsigned int numberOfBranches );
+  unsigned int GetNumberOfBranches() const
+  {
+    return static_cast< unsigned int >( this->GetNumberOfOutputs() );
+  }
+
+  /** Drop the cached slab. */
+  void ClearCache();
+
+protected:
+  SlidingWindowCacheImageFilter();
+  ~SlidingWindowCacheImageFilter() {}
+  void PrintSelf(std::ostream & os, Indent indent) const;
+
+  /** Every branch keeps the region requested by its own consumer. */
+  virtual void GenerateOutputRequestedRegion( DataObject * ) {}
+
+  virtual void GenerateInputRequestedRegion();
+
+  virtual void GenerateData();
+
+  /** Whether the cached slab can serve part of a requested region, and
+   * which region must then come from the input. The region is empty
+   * when the cached slab holds the whole request. */
+  bool ComputeInputRegion( const RegionType & requested, RegionType & inputRegion ) const;
+
+  /** Bounding box of the regions requested on all the branches. */
+  RegionType ComputeRequestedUnion() const;
+
+private:
+  SlidingWindowCacheImageFilter(const Self &); // Purposely not implemented
+  void operator=(const Self &);                // Purposely not implemented
+
+  PixelContainerPointer   m_CachedContainer;
+  RegionType              m_CachedRegion;
+  RegionType              m_CachedLargestPossibleRegion;
+  unsigned long           m_CachedPipelineMTime;
+
+  SizeValueType           m_NumberOfReusedSlices;
+  SizeValueType           m_NumberOfRequestedSlices;
+};
+
+} // end namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkSlidingWindowCacheImageFilter.hxx"
+#endif
+
+#endif
@@ -0,0 +1,300 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkSlidingWindowCacheImageFilter_hxx
+#define __itkSlidingWindowCacheImageFilter_hxx
+
+#include "itkSlidingWindowCacheImageFilter.h"
+#include "itkImageRegionConstIterator.h"
+#include "itkImageRegionIterator.h"
+
+#include <algorithm>
+
+namespace itk
+{
+
+template< typename TImage >
+SlidingWindowCacheImageFilter< TImage >
+::SlidingWindowCacheImageFilter()
+{
+  m_CachedPipelineMTime = 0;
+  m_NumberOfReusedSlices = 0;
+  m_NumberOfRequestedSlices = 0;
+}
+
+template< typename TImage >
+void
+SlidingWindowCacheImageFilter< TImage >
+::SetNumberOfBranches( unsigned int numberOfBranches )
+{
+  if( numberOfBranches < 1 )
+    {
+    numberOfBranches = 1;
+    }
+
+  if( numberOfBranches == this->GetNumberOfBranches() )
+    {
+    return;
+    }
+
+  this->SetNumberOfRequiredOutputs( numberOfBranches );
+
+  for( unsigned int i = 0; i < numberOfBranches; i++ )
+    {
+    if( !this->ProcessObject::GetOutput( i ) )
+      {
+      this->SetNthOutput( i, this->MakeOutput( i ) );
+      }
+    }
+
+  this->Modified();
+}
+
+template< typename TImage >
+typename SlidingWindowCacheImageFilter< TImage >::RegionType
+SlidingWindowCacheImageFilter< TImage >
+::ComputeRequestedUnion() const
+{
+  Self * self = const_cast< Self * >( this );
+
+  RegionType requested = self->GetOutput( 0 )->GetRequestedRegion();
+
+  for( unsigned int k = 1; k < this->GetNumberOfBranches(); k++ )
+    {
+    const RegionType & branch = self->GetOutput( k )->GetRequestedRegion();
+
+    for( unsigned int i = 0; i < ImageDimension; i++ )
+      {
+      const IndexValueType start = std::min( requested.GetIndex(i), branch.GetIndex(i) );
+      const IndexValueType end = std::max(
+        requested.GetIndex(i) + static_cast< IndexValueType >( requested.GetSize(i) ),
+        branch.GetIndex(i) + static_cast< IndexValueType >( branch.GetSize(i) ) );
+
+      requested.SetIndex( i, start );
+      requested.SetSize( i, end - start );
+      }
+    }
+
+  return requested;
+}
+
+template< typename TImage >
+void
+SlidingWindowCacheImageFilter< TImage >
+::ClearCache()
+{
+  m_CachedContainer = NULL;
+  m_CachedRegion = RegionType();
+}
+
+template< typename TImage >
+bool
+SlidingWindowCacheImageFilter< TImage >
+::ComputeInputRegion( const RegionType & requested, RegionType & inputRegion ) const
+{
+  const unsigned int slow = ImageDimension - 1;
+
+  inputRegion = requested;
+
+  const ImageType * input = this->GetInput();
+
+  if( m_CachedContainer.IsNull() ||
+      input->GetPipelineMTime() != m_CachedPipelineMTime ||
+      input->GetLargestPossibleRegion() != m_CachedLargestPossibleRegion )
+    {
+    return false;
+    }
+
+  // The slices of both slabs must be laid out identically in memory.
+  for( unsigned int i = 0; i < slow; i++ )
+    {
+    if( requested.GetIndex(i) != m_CachedRegion.GetIndex(i) ||
+        requested.GetSize(i)  != m_CachedRegion.GetSize(i) )
+      {
+      return false;
+      }
+    }
+
+  const IndexValueType requestedStart = requested.GetIndex( slow );
+  const IndexValueType requestedEnd   = requestedStart + requested.GetSize( slow );
+  const IndexValueType cachedStart    = m_CachedRegion.GetIndex( slow );
+  const IndexValueType cachedEnd      = cachedStart + m_CachedRegion.GetSize( slow );
+
+  if( requestedStart < cachedStart || requestedStart >= cachedEnd )
+    {
+    return false;
+    }
+
+  if( requestedEnd <= cachedEnd )
+    {
+    // Everything is cached, nothing is needed from the input.
+    inputRegion.SetIndex( slow, requestedEnd );
+    inputRegion.SetSize( slow, 0 );
+    }
+  else
+    {
+    inputRegion.SetIndex( slow, cachedEnd );
+    inputRegion.SetSize( slow, requestedEnd - cachedEnd );
+    }
+
+  return true;
+}
+
+template< typename TImage >
+void
+SlidingWindowCacheImageFilter< TImage >
+::GenerateInputRequestedRegion()
+{
+  const unsigned int slow = ImageDimension - 1;
+
+  ImageType * input = const_cast< ImageType * >( this->GetInput() );
+
+  if( !input )
+    {
+    return;
+    }
+
+  RegionType inputRegion;
+  this->ComputeInputRegion( this->ComputeRequestedUnion(), inputRegion );
+
+  //
+  // When the request is fully cached, asking the input for the region it
+  // already holds keeps the pipeline valid without running it again.
+  //
+  if( inputRegion.GetNumberOfPixels() == 0 )
+    {
+    const RegionType & buffered = input->GetBufferedRegion();
+
+    if( buffered.GetNumberOfPixels() > 0 )
+      {
+      inputRegion = buffered;
+      }
+    else
+      {
+      inputRegion.SetIndex( slow, inputRegion.GetIndex( slow ) - 1 );
+      inputRegion.SetSize( slow, 1 );
+      }
+    }
+
+  input->SetRequestedRegion( inputRegion );
+}
+
+template< typename TImage >
+void
+SlidingWindowCacheImageFilter< TImage >
+::GenerateData()
+{
+  const unsigned int slow = ImageDimension - 1;
+
+  const ImageType * input = this->GetInput();
+  ImageType * output = this->GetOutput();
+
+  const RegionType requested = this->ComputeRequestedUnion();
+
+  RegionType inputRegion;
+  const bool reuse = this->ComputeInputRegion( requested, inputRegion );
+
+  SizeValueType sliceSize = 1;
+  for( unsigned int i = 0; i < slow; i++ )
+    {
+    sliceSize *= requested.GetSize(i);
+    }
+
+  PixelContainerPointer container;
+
+  RegionType copyRegion = requested;
+
+  if( reuse )
+    {
+    //
+    // Slide the slices shared with the previous slab to the front of
+    // its buffer, then grow the buffer (which keeps its contents).
+    //
+    const IndexValueType requestedStart = requested.GetIndex( slow );
+    const IndexValueType cachedStart    = m_CachedRegion.GetIndex( slow );
+    const IndexValueType cachedEnd      = cachedStart + m_CachedRegion.GetSize( slow );
+    const IndexValueType requestedEnd   = requestedStart + requested.GetSize( slow );
+
+    const SizeValueType sharedSlices = std::min( cachedEnd, requestedEnd ) - requestedStart;
+
+    container = m_CachedContainer;
+
+    typename PixelContainerType::Element * buffer = container->GetBufferPointer();
+
+    std::copy( buffer + ( requestedStart - cachedStart ) * sliceSize,
+               buffer + ( requestedStart - cachedStart + sharedSlices ) * sliceSize,
+               buffer );
+
+    container->Reserve( requested.GetNumberOfPixels() );
+
+    m_NumberOfReusedSlices += sharedSlices;
+
+    copyRegion.SetIndex( slow, requestedStart + sharedSlices );
+    copyRegion.SetSize( slow, requested.GetSize( slow ) - sharedSlices );
+    }
+  else
+    {
+    container = PixelContainerType::New();
+    container->Reserve( requested.GetNumberOfPixels() );
+    }
+
+  output->SetBufferedRegion( requested );
+  output->SetPixelContainer( container );
+
+  if( copyRegion.GetNumberOfPixels() > 0 )
+    {
+    ImageRegionConstIterator< ImageType > inputIt( input, copyRegion );
+    ImageRegionIterator< ImageType >      outputIt( output, copyRegion );
+
+    while( !inputIt.IsAtEnd() )
+      {
+      outputIt.Set( inputIt.Get() );
+      ++inputIt;
+      ++outputIt;
+      }
+
+    m_NumberOfRequestedSlices += copyRegion.GetSize( slow );
+    }
+
+  // All the branches share the buffer.
+  for( unsigned int k = 1; k < this->GetNumberOfBranches(); k++ )
+    {
+    this->GetOutput( k )->SetBufferedRegion( requested );
+    this->GetOutput( k )->SetPixelContainer( container );
+    }
+
+  m_CachedContainer = container;
+  m_CachedRegion = requested;
+  m_CachedLargestPossibleRegion = input->GetLargestPossibleRegion();
+  m_CachedPipelineMTime = input->GetPipelineMTime();
+}
+
+template< typename TImage >
+void
+SlidingWindowCacheImageFilter< TImage >
+::PrintSelf(std::ostream & os, Indent indent) const
+{
+  Superclass::PrintSelf(os, indent);
+
+  os << indent << "CachedRegion: " << m_CachedRegion << std::endl;
+  os << indent << "NumberOfReusedSlices: " << m_NumberOfReusedSlices << std::endl;
+  os << indent << "NumberOfRequestedSlices: " << m_NumberOfRequestedSlices << std::endl;
+}
+
+} // end namespace itk
+
+#endif
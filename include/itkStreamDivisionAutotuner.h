@@ -0,0 +1,394 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkStreamDivisionAutotuner_h
+#define __itkStreamDivisionAutotuner_h
+
+#include "itkObject.h"
+#include "itkObjectFactory.h"
+#include "itkImageBase.h"
+#include "itkMultiThreader.h"
+#include "itkRealTimeClock.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace itk
+{
+
+/** \class StreamDivisionAutotuner
+ *
+ * \brief Chooses the number of stream divisions by timing a few of them
+ * on a few slabs of the input.
+ *
+ * The writers stream in slabs along the slowest dimension, so a number
+ * of divisions is a slab thickness. The candidates start at the minimum
+ * number of divisions (the one that fits the memory budget) and double
+ * from there: the minimum, twice the minimum, and so on. Every candidate
+ * updates the image given to the autotuner, which is the output of the
+ * last stage before the writer, on a fixed number of whole slabs. The
+ * slabs of the candidates follow each other along the image, so that no
+ * candidate reads from the page cache what another one has just read,
+ * until the image runs out. The candidate with the shortest time per
+ * slice wins.
+ *
+ * The choice is kept in a cache file, under the name of the machine, its
+ * number of threads and a key given by the caller that identifies the
+ * dataset and the pipeline. Later runs with the same key use it without
+ * probing.
+ */
+class StreamDivisionAutotuner : public Object
+{
+public:
+  /** Standard class typedefs. */
+  typedef StreamDivisionAutotuner       Self;
+  typedef Object                        Superclass;
+  typedef SmartPointer< Self >          Pointer;
+  typedef SmartPointer< const Self >    ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro(Self);
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro(StreamDivisionAutotuner, Object);
+
+  typedef ImageBase< 3 >              ImageType;
+  typedef ImageType::RegionType       RegionType;
+
+  /** Time taken by one candidate. */
+  struct ProbeType
+    {
+    unsigned int  NumberOfStreamDivisions;
+    SizeValueType SlicesProbed;
+    double        SecondsPerSlice;
+    };
+
+  typedef std::vector< ProbeType >    ProbeListType;
+
+  /** Output of the last stage of the pipeline before the writer. */
+  void SetImage( ImageType * image )
+  {
+    m_Image = image;
+    this->Modified();
+  }
+
+  /** Smallest number of divisions that may be chosen. */
+  itkSetClampMacro(MinimumNumberOfStreamDivisions, unsigned int, 1,
+                   NumericTraits< unsigned int >::max());
+  itkGetConstMacro(MinimumNumberOfStreamDivisions, unsigned int);
+
+  /** Whole slabs that every candidate processes. */
+  itkSetClampMacro(NumberOfSlabsPerCandidate, unsigned int, 1,
+                   NumericTraits< unsigned int >::max());
+  itkGetConstMacro(NumberOfSlabsPerCandidate, unsigned int);
+
+  itkSetClampMacro(MaximumNumberOfCandidates, unsigned int, 1,
+                   NumericTraits< unsigned int >::max());
+  itkGetConstMacro(MaximumNumberOfCandidates, unsigned int);
+
+  /** File that keeps the choices of earlier runs. No cache when empty. */
+  itkSetStringMacro(CacheFileName);
+  itkGetStringMacro(CacheFileName);
+
+  /** Identifies the dataset and the pipeline in the cache. */
+  itkSetStringMacro(CacheKey);
+  itkGetStringMacro(CacheKey);
+
+  /** Whether the last choice came from the cache. */
+  itkGetConstMacro(UsedCache, bool);
+
+  const ProbeListType & GetProbes() const { return m_Probes; }
+
+  /** Time the candidates, or look the choice up in the cache. */
+  unsigned int ComputeNumberOfStreamDivisions()
+  {
+    if( m_Image.IsNull() )
+      {
+      itkExceptionMacro("No image has been set");
+      }
+
+    m_Probes.clear();
+    m_UsedCache = false;
+
+    const std::string key = this->GetFullCacheKey();
+
+    unsigned int cached = 0;
+    if( this->ReadCache( key, cached ) && cached >= m_MinimumNumberOfStreamDivisions )
+      {
+      m_UsedCache = true;
+      return cached;
+      }
+
+    m_Image->UpdateOutputInformation();
+
+    const RegionType largest = m_Image->GetLargestPossibleRegion();
+    const SizeValueType slices = largest.GetSize( 2 );
+
+    if( slices == 0 )
+      {
+      itkExceptionMacro("The image is empty");
+      }
+
+    //
+    // From the thickest slab allowed by the memory budget, halving the
+    // thickness as the number of divisions doubles.
+    //
+    std::vector< SizeValueType > thicknesses;
+    for( SizeValueType divisions = m_MinimumNumberOfStreamDivisions;
+         divisions <= slices && thicknesses.size() < m_MaximumNumberOfCandidates;
+         divisions *= 2 )
+      {
+      const SizeValueType thickness = ( slices + divisions - 1 ) / divisions;
+
+      if( thicknesses.empty() || thickness < thicknesses.back() )
+        {
+        thicknesses.push_back( thickness );
+        }
+      }
+
+    if( thicknesses.empty() )
+      {
+      thicknesses.push_back( 1 );
+      }
+
+    RealTimeClock::Pointer clock = RealTimeClock::New();
+
+    // First slice not yet read by a candidate.
+    SizeValueType next = 0;
+
+    for( size_t c = 0; c < thicknesses.size(); c++ )
+      {
+      const SizeValueType thickness = thicknesses[c];
+
+      // The same slab boundaries as the writer will use.
+      const unsigned int divisions =
+        static_cast< unsigned int >( ( slices + thickness - 1 ) / thickness );
+
+      // Whole slabs, from the first one that starts after the slabs of
+      // the previous candidates, or from the start once the image has
+      // been used up.
+      SizeValueType first = ( next + thickness - 1 ) / thickness * thickness;
+      if( first + thickness > slices )
+        {
+        first = 0;
+        }
+
+      const SizeValueType numberOfSlabs = std::max( std::min(
+        static_cast< SizeValueType >( m_NumberOfSlabsPerCandidate ),
+        ( slices - first ) / thickness ), static_cast< SizeValueType >( 1 ) );
+
+      next = first + numberOfSlabs * thickness;
+
+      const double start = clock->GetTimeInSeconds();
+
+      for( SizeValueType k = 0; k < numberOfSlabs; k++ )
+        {
+        RegionType slab = largest;
+        slab.SetIndex( 2, largest.GetIndex( 2 ) + first + k * thickness );
+        slab.SetSize( 2, std::min( thickness, slices - first - k * thickness ) );
+
+        m_Image->SetRequestedRegion( slab );
+        m_Image->Update();
+        }
+
+      ProbeType probe;
+      probe.NumberOfStreamDivisions = divisions;
+      probe.SlicesProbed = std::min( numberOfSlabs * thickness, slices - first );
+      probe.SecondsPerSlice = ( clock->GetTimeInSeconds() - start ) / probe.SlicesProbed;
+
+      m_Probes.push_back( probe );
+      }
+
+    unsigned int best = 0;
+    for( size_t c = 1; c < m_Probes.size(); c++ )
+      {
+      if( m_Probes[c].SecondsPerSlice < m_Probes[best].SecondsPerSlice )
+        {
+        best = static_cast< unsigned int >( c );
+        }
+      }
+
+    this->WriteCache( key, m_Probes[best] );
+
+    return m_Probes[best].NumberOfStreamDivisions;
+  }
+
+  /** Name, size and modification time of a file, for cache keys. */
+  static std::string GetFileSignature( const std::string & fileName )
+  {
+    std::ostringstream signature;
+    signature << fileName;
+
+    struct stat status;
+    if( stat( fileName.c_str(), &status ) == 0 )
+      {
+      signature << ":" << status.st_size << ":" << status.st_mtime;
+      }
+
+    return signature.str();
+  }
+
+  /** A file in the home directory of the user. */
+  static std::string GetDefaultCacheFileName()
+  {
+#if defined(_WIN32)
+    const char * home = getenv( "USERPROFILE" );
+#else
+    const char * home = getenv( "HOME" );
+#endif
+    const std::string directory = home ? home : ".";
+
+    return directory + "/.LargeImageStreamingAutotune.txt";
+  }
+
+protected:
+  StreamDivisionAutotuner()
+  {
+    m_MinimumNumberOfStreamDivisions = 1;
+    m_NumberOfSlabsPerCandidate = 2;
+    m_MaximumNumberOfCandidates = 5;
+    m_UsedCache = false;
+  }
+
+  ~StreamDivisionAutotuner() {}
+
+  void PrintSelf(std::ostream & os, Indent indent) const
+  {
+    Superclass::PrintSelf(os, indent);
+    os << indent << "MinimumNumberOfStreamDivisions: " << m_MinimumNumberOfStreamDivisions << std::endl;
+    os << indent << "NumberOfSlabsPerCandidate: " << m_NumberOfSlabsPerCandidate << std::endl;
+    os << indent << "MaximumNumberOfCandidates: " << m_MaximumNumberOfCandidates << std::endl;
+    os << indent << "CacheFileName: " << m_CacheFileName << std::endl;
+    os << indent << "CacheKey: " << m_CacheKey << std::endl;
+  }
+
+private:
+  StreamDivisionAutotuner(const Self &); // Purposely not implemented
+  void operator=(const Self &);          // Purposely not implemented
+
+  std::string GetFullCacheKey() const
+  {
+    char host[256] = "unknown";
+#if defined(_WIN32)
+    DWORD length = sizeof( host );
+    GetComputerNameA( host, &length );
+#else
+    gethostname( host, sizeof( host ) - 1 );
+    host[sizeof( host ) - 1] = '\0';
+#endif
+
+    std::ostringstream key;
+    key << host << " " << MultiThreader::GetGlobalDefaultNumberOfThreads()
+        << " " << m_CacheKey;
+
+    return key.str();
+  }
+
+  //
+  // The cache has one line per key: the key, a tab, the number of
+  // divisions and the seconds per slice that were measured.
+  //
+  bool ReadCache( const std::string & key, unsigned int & divisions ) const
+  {
+    if( m_CacheFileName == "" )
+      {
+      return false;
+      }
+
+    std::ifstream cache( m_CacheFileName.c_str() );
+
+    std::string line;
+    while( std::getline( cache, line ) )
+      {
+      const std::string::size_type tab = line.rfind( '\t', line.rfind( '\t' ) - 1 );
+
+      if( tab != std::string::npos && line.substr( 0, tab ) == key )
+        {
+        divisions = atoi( line.c_str() + tab + 1 );
+        return divisions > 0;
+        }
+      }
+
+    return false;
+  }
+
+  void WriteCache( const std::string & key, const ProbeType & probe ) const
+  {
+    if( m_CacheFileName == "" )
+      {
+      return;
+      }
+
+    std::vector< std::string > lines;
+
+    std::ifstream input( m_CacheFileName.c_str() );
+    std::string line;
+    while( std::getline( input, line ) )
+      {
+      if( line.compare( 0, key.size() + 1, key + "\t" ) != 0 )
+        {
+        lines.push_back( line );
+        }
+      }
+    input.close();
+
+    std::ostringstream entry;
+    entry << key << "\t" << probe.NumberOfStreamDivisions << "\t" << probe.SecondsPerSlice;
+    lines.push_back( entry.str() );
+
+    std::ofstream output( m_CacheFileName.c_str() );
+
+    if( !output )
+      {
+      itkWarningMacro("Could not write the autotuning cache " << m_CacheFileName);
+      return;
+      }
+
+    for( size_t k = 0; k < lines.size(); k++ )
+      {
+      output << lines[k] << std::endl;
+      }
+  }
+
+  ImageType::Pointer  m_Image;
+
+  unsigned int        m_MinimumNumberOfStreamDivisions;
+  unsigned int        m_NumberOfSlabsPerCandidate;
+  unsigned int        m_MaximumNumberOfCandidates;
+
+  std::string         m_CacheFileName;
+  std::string         m_CacheKey;
+  bool                m_UsedCache;
+
+  ProbeListType       m_Probes;
+};
+
+} // end namespace itk
+
+#endif
@@ -0,0 +1,164 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef _itkStreamingCommandLineOptions_h
+#define _itkStreamingCommandLineOptions_h
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <utility>
+
+namespace itk {
+
+/** \class StreamingCommandLineOptions
+ *
+ * \brief Collects the optional "--name value ..." arguments that follow
+ * the positional arguments of the streaming executables.
+ *
+ * Every token starting with "--" opens a new option, and all the tokens
+ * up to the next option are its values. An option may be repeated.
+ *
+ * Every executable declares the options it accepts to CheckOptions, so
+ * that a misspelled option fails the run instead of being ignored.
+ */
+class StreamingCommandLineOptions
+{
+public:
+  typedef std::vector< std::string >  ValuesType;
+
+  StreamingCommandLineOptions(int argc, char * argv[], int firstOption)
+  {
+    for( int i = firstOption; i < argc; i++ )
+      {
+      const std::string token = argv[i];
+
+      if( token.size() > 2 && token.compare(0, 2, "--") == 0 )
+        {
+        m_Options.push_back( OptionType( token, ValuesType() ) );
+        }
+      else if( !m_Options.empty() )
+        {
+        m_Options.back().second.push_back( token );
+        }
+      else
+        {
+        m_Unknown.push_back( token );
+        }
+      }
+  }
+
+  virtual ~StreamingCommandLineOptions() {}
+
+  bool HasOption( const std::string & name ) const
+  {
+    return this->GetNumberOfOccurrences( name ) > 0;
+  }
+
+  unsigned int GetNumberOfOccurrences( const std::string & name ) const
+  {
+    unsigned int count = 0;
+    for( size_t i = 0; i < m_Options.size(); i++ )
+      {
+      if( m_Options[i].first == name )
+        {
+        count++;
+        }
+      }
+    return count;
+  }
+
+  /** Values given to the n-th occurrence of an option. */
+  ValuesType GetOptionValues( const std::string & name, unsigned int occurrence = 0 ) const
+  {
+    unsigned int count = 0;
+    for( size_t i = 0; i < m_Options.size(); i++ )
+      {
+      if( m_Options[i].first == name )
+        {
+        if( count == occurrence )
+          {
+          return m_Options[i].second;
+          }
+        count++;
+        }
+      }
+    return ValuesType();
+  }
+
+  /** First value of the last occurrence of an option. */
+  std::string GetOptionValue( const std::string & name,
+                              const std::string & defaultValue = "" ) const
+  {
+    for( size_t i = m_Options.size(); i > 0; i-- )
+      {
+      if( m_Options[i-1].first == name && !m_Options[i-1].second.empty() )
+        {
+        return m_Options[i-1].second[0];
+        }
+      }
+    return defaultValue;
+  }
+
+  /** Check that all the options given are among the valid ones, a list
+   * that ends with NULL, and that no argument precedes the first option.
+   * Otherwise, the offending arguments are printed and false is returned. */
+  bool CheckOptions( const char * const validOptions[], std::ostream & os ) const
+  {
+    bool valid = true;
+
+    for( size_t i = 0; i < m_Unknown.size(); i++ )
+      {
+      os << "Unexpected argument: " << m_Unknown[i] << std::endl;
+      valid = false;
+      }
+
+    for( size_t i = 0; i < m_Options.size(); i++ )
+      {
+      bool known = false;
+      for( const char * const * name = validOptions; *name != NULL && !known; ++name )
+        {
+        known = ( m_Options[i].first == *name );
+        }
+
+      if( !known )
+        {
+        os << "Unknown option: " << m_Options[i].first << std::endl;
+        valid = false;
+        }
+      }
+
+    return valid;
+  }
+
+  /** Tokens that appeared before the first option. */
+  const ValuesType & GetUnknownArguments() const
+  {
+    return m_Unknown;
+  }
+
+private:
+  typedef std::pair< std::string, ValuesType >  OptionType;
+
+  std::vector< OptionType >  m_Options;
+  ValuesType                 m_Unknown;
+};
+
+}
+
+#endif
@@ -0,0 +1,256 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef _itkStreamingCommandLineSupport_h
+#define _itkStreamingCommandLineSupport_h
+
+#include "itkStreamingCommandLineOptions.h"
+#include "itkStreamingMemoryPlanner.h"
+#include "itkBrickedImageIO.h"
+#include "itkStreamDivisionAutotuner.h"
+#include "itkPeakMemoryGuard.h"
+#include "itkPipelineTracer.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+namespace itk {
+
+/** \class StreamingCommandLineSupport
+ *
+ * \brief The options that the streaming executables share, on top of
+ * StreamingCommandLineOptions:
+ *
+ *   --max-memory       plans the number of stream divisions,
+ *   --autotune         times a few numbers of stream divisions,
+ *   --autotune-cache   keeps the autotuned choices in the given file,
+ *   --memory-budget    fails the run when its peak memory grows past it,
+ *   --trace            writes the timeline of the run.
+ *
+ * Every method does nothing unless its option was given. Errors are
+ * printed, and reported by returning false.
+ */
+class StreamingCommandLineSupport
+{
+public:
+  StreamingCommandLineSupport( const StreamingCommandLineOptions & options ):
+    m_Options( options )
+  {
+  }
+
+  virtual ~StreamingCommandLineSupport() {}
+
+  /** The number of stream divisions with which the stages of the planner
+   * fit the --max-memory budget. Concurrent runs hold --chunks-in-flight
+   * chunks, or one per worker and one waiting for the writer. */
+  bool PlanNumberOfStreamDivisions( StreamingMemoryPlanner * planner,
+                                    const std::string & inputFileName,
+                                    unsigned int & numberOfDivisions ) const
+  {
+    return this->PlanNumberOfStreamDivisions( planner, inputFileName, "", 0, numberOfDivisions );
+  }
+
+  /** As above, and when the output file is bricked, count the bricks
+   * that its writer keeps pending, about one layer of bricks of the
+   * output pixels across the image. */
+  bool PlanNumberOfStreamDivisions( StreamingMemoryPlanner * planner,
+                                    const std::string & inputFileName,
+                                    const std::string & outputFileName,
+                                    SizeValueType outputBytesPerPixel,
+                                    unsigned int & numberOfDivisions ) const
+  {
+    if( !m_Options.HasOption("--max-memory") )
+      {
+      return true;
+      }
+
+    if( m_Options.HasOption("--chunks-in-flight") )
+      {
+      planner->SetNumberOfConcurrentChunks(
+        atoi( m_Options.GetOptionValue("--chunks-in-flight").c_str() ) );
+      }
+    else if( m_Options.HasOption("--workers") )
+      {
+      planner->SetNumberOfConcurrentChunks(
+        atoi( m_Options.GetOptionValue("--workers").c_str() ) + 1 );
+      }
+
+    try
+      {
+      planner->SetImageFileName( inputFileName );
+
+      BrickedImageIO::Pointer brickedIO = BrickedImageIO::New();
+      if( !outputFileName.empty() && brickedIO->CanWriteFile( outputFileName.c_str() ) )
+        {
+        planner->AddFixedBuffer( "pending bricks", brickedIO->ComputePendingMemory(
+          planner->GetImageSize(), outputBytesPerPixel ) );
+        }
+
+      planner->SetMemoryBudget( StreamingMemoryPlanner::ParseMemorySize(
+        m_Options.GetOptionValue("--max-memory") ) );
+      numberOfDivisions = planner->ComputeNumberOfStreamDivisions();
+      }
+    catch( ExceptionObject & err )
+      {
+      std::cerr << err << std::endl;
+      return false;
+      }
+
+    std::cout << "Streaming in " << numberOfDivisions << " data blocks" << std::endl;
+
+    return true;
+  }
+
+  /** With --autotune, time a few numbers of stream divisions on the image,
+   * the output of the last stage before the writer, and keep the fastest.
+   * The given number of divisions is the coarsest candidate. The cache key
+   * names the input and the pipeline. */
+  bool AutotuneNumberOfStreamDivisions( StreamDivisionAutotuner::ImageType * image,
+                                        const std::string & cacheKey,
+                                        unsigned int & numberOfDivisions ) const
+  {
+    if( !m_Options.HasOption("--autotune") )
+      {
+      return true;
+      }
+
+    StreamDivisionAutotuner::Pointer autotuner = StreamDivisionAutotuner::New();
+
+    autotuner->SetImage( image );
+    autotuner->SetMinimumNumberOfStreamDivisions( std::max( numberOfDivisions, 1u ) );
+
+    if( !m_Options.GetOptionValues("--autotune").empty() )
+      {
+      autotuner->SetNumberOfSlabsPerCandidate(
+        atoi( m_Options.GetOptionValue("--autotune").c_str() ) );
+      }
+
+    autotuner->SetCacheFileName( m_Options.GetOptionValue( "--autotune-cache",
+      StreamDivisionAutotuner::GetDefaultCacheFileName() ) );
+    autotuner->SetCacheKey( cacheKey );
+
+    try
+      {
+      numberOfDivisions = autotuner->ComputeNumberOfStreamDivisions();
+      }
+    catch( ExceptionObject & err )
+      {
+      std::cerr << err << std::endl;
+      return false;
+      }
+
+    std::cout << "Autotuned to " << numberOfDivisions << " data blocks"
+              << ( autotuner->GetUsedCache() ? " (cached)" : "" ) << std::endl;
+
+    return true;
+  }
+
+  /** With --memory-budget, set the budget of the guard, which may be a
+   * multiple of one stream division of the input file, and take its
+   * baseline. Call it once the autotuning and other passes are done. */
+  bool StartMemoryGuard( const std::string & inputFileName,
+                         unsigned int numberOfDivisions )
+  {
+    if( !m_Options.HasOption("--memory-budget") )
+      {
+      return true;
+      }
+
+    try
+      {
+      m_MemoryGuard.SetBudget( PeakMemoryGuard::ParseBudget(
+        m_Options.GetOptionValue("--memory-budget"), inputFileName, numberOfDivisions ) );
+      }
+    catch( ExceptionObject & err )
+      {
+      std::cerr << err << std::endl;
+      return false;
+      }
+
+    m_MemoryGuard.ResetBaseline();
+
+    return true;
+  }
+
+  /** Guard and trace a process object and the sources of its inputs. */
+  void WatchPipeline( ProcessObject * process )
+  {
+    if( m_Options.HasOption("--memory-budget") )
+      {
+      m_MemoryGuard.WatchPipeline( process );
+      }
+
+    if( m_Options.HasOption("--trace") )
+      {
+      m_Tracer.WatchPipeline( process );
+      }
+  }
+
+  /** Guard and trace a streaming driver. */
+  template< typename TDriver >
+  void WatchDriver( TDriver * driver )
+  {
+    if( m_Options.HasOption("--memory-budget") )
+      {
+      m_MemoryGuard.WatchDriver( driver );
+      }
+
+    if( m_Options.HasOption("--trace") )
+      {
+      m_Tracer.WatchDriver( driver );
+      }
+  }
+
+  /** After the run, write the trace, and report the peak memory against
+   * the budget. */
+  bool FinishRun()
+  {
+    if( m_Options.HasOption("--trace") && !m_Tracer.Write( m_Options.GetOptionValue("--trace") ) )
+      {
+      std::cerr << "Could not write " << m_Options.GetOptionValue("--trace") << std::endl;
+      return false;
+      }
+
+    if( m_Options.HasOption("--memory-budget") )
+      {
+      m_MemoryGuard.Report( std::cout );
+
+      if( !m_MemoryGuard.IsWithinBudget() )
+        {
+        std::cerr << "Memory budget exceeded" << std::endl;
+        return false;
+        }
+      }
+
+    return true;
+  }
+
+private:
+  StreamingCommandLineSupport(const StreamingCommandLineSupport &); // Purposely not implemented
+  void operator=(const StreamingCommandLineSupport &); // Purposely not implemented
+
+  const StreamingCommandLineOptions &  m_Options;
+
+  PeakMemoryGuard                      m_MemoryGuard;
+  PipelineTracer                       m_Tracer;
+};
+
+}
+
+#endif
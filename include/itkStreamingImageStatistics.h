@@ -0,0 +1,176 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkStreamingImageStatistics_h
+#define __itkStreamingImageStatistics_h
+
+#include "itkObject.h"
+#include "itkImageFileReader.h"
+#include "itkMultiThreader.h"
+
+#include <string>
+#include <vector>
+
+namespace itk
+{
+
+/** \class StreamingImageStatistics
+ *
+ * \brief Minimum, maximum, mean, variance and histogram of an image file,
+ * computed in stream divisions.
+ *
+ * The file is read in the same slabs the ImageFileWriter would use, so
+ * only two slabs are in memory at any time: the one being reduced and
+ * the next one, which a separate thread reads meanwhile. Each slab is
+ * contiguous in memory; it is cut into one range of pixels per thread,
+ * every thread accumulates its own partial statistics and histogram,
+ * and the partial results are merged (with the pairwise update of the
+ * variance) once the threads are done.
+ *
+ * The histogram has NumberOfBins bins of equal width over
+ * [HistogramMinimum, HistogramMaximum). Values outside of that range are
+ * counted in the first or last bin. NaN pixels are left out of all the
+ * statistics. The variance is the population variance.
+ */
+template< typename TImage >
+class StreamingImageStatistics : public Object
+{
+public:
+  /** Standard class typedefs. */
+  typedef StreamingImageStatistics      Self;
+  typedef Object                        Superclass;
+  typedef SmartPointer< Self >          Pointer;
+  typedef SmartPointer< const Self >    ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro(Self);
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro(StreamingImageStatistics, Object);
+
+  typedef TImage                            ImageType;
+  typedef typename ImageType::Pointer       ImagePointer;
+  typedef typename ImageType::PixelType     PixelType;
+  typedef typename ImageType::RegionType    RegionType;
+
+  typedef ImageFileReader< ImageType >      ReaderType;
+  typedef std::vector< SizeValueType >      HistogramType;
+
+  itkSetStringMacro(FileName);
+  itkGetStringMacro(FileName);
+
+  itkSetMacro(NumberOfStreamDivisions, unsigned int);
+  itkGetConstMacro(NumberOfStreamDivisions, unsigned int);
+
+  /** Threads that reduce each stream division. */
+  itkSetClampMacro(NumberOfThreads, ThreadIdType, 1, ITK_MAX_THREADS);
+  itkGetConstMacro(NumberOfThreads, ThreadIdType);
+
+  /** Bins of the histogram. Zero bins skips the histogram. */
+  void SetHistogram( unsigned int numberOfBins, double minimum, double maximum );
+  itkGetConstMacro(NumberOfBins, unsigned int);
+  itkGetConstMacro(HistogramMinimum, double);
+  itkGetConstMacro(HistogramMaximum, double);
+
+  /** Read the file and compute the statistics. */
+  void Update();
+
+  SizeValueType GetCount() const { return m_Total.Count; }
+  double GetMinimum() const { return m_Total.Minimum; }
+  double GetMaximum() const { return m_Total.Maximum; }
+  double GetMean() const { return m_Total.Mean; }
+  double GetVariance() const;
+
+  const HistogramType & GetHistogram() const { return m_Total.Histogram; }
+
+  /** Lower end of a bin of the histogram. */
+  double GetBinMinimum( unsigned int bin ) const;
+
+  /** Lower threshold that splits the histogram in the two classes of
+   * largest between-class variance (Otsu's method). Pixels at or above
+   * the threshold form the upper class. */
+  double ComputeOtsuThreshold() const;
+
+  /** Lower threshold below which at least the given percentage of the
+   * pixels fall. */
+  double ComputePercentileThreshold( double percentage ) const;
+
+protected:
+  StreamingImageStatistics();
+  ~StreamingImageStatistics() {}
+  void PrintSelf(std::ostream & os, Indent indent) const;
+
+  /** Statistics of a set of pixels, that can be merged with others. */
+  struct PartialType
+    {
+    SizeValueType   Count;
+    double          Minimum;
+    double          Maximum;
+    double          Mean;
+    double          SumOfSquaredDeviations;
+    HistogramType   Histogram;
+    };
+
+  void ResetPartial( PartialType & partial ) const;
+  static void MergePartial( PartialType & total, const PartialType & partial );
+
+  /** Read a stream division into m_NextChunk. */
+  void ReadChunk( unsigned int chunkIndex );
+
+  /** Accumulate the pixels of a stream division into m_Total. */
+  void ReduceChunk( const ImageType * chunk, const RegionType & region );
+
+  void ReduceRange( const PixelType * pixels, SizeValueType length,
+                    PartialType & partial ) const;
+
+  static ITK_THREAD_RETURN_TYPE ReaderThreadCallback( void * arg );
+  static ITK_THREAD_RETURN_TYPE ReduceThreadCallback( void * arg );
+
+private:
+  StreamingImageStatistics(const Self &); // Purposely not implemented
+  void operator=(const Self &);           // Purposely not implemented
+
+  std::string                   m_FileName;
+  unsigned int                  m_NumberOfStreamDivisions;
+  ThreadIdType                  m_NumberOfThreads;
+
+  unsigned int                  m_NumberOfBins;
+  double                        m_HistogramMinimum;
+  double                        m_HistogramMaximum;
+
+  typename ReaderType::Pointer  m_Reader;
+  std::vector< RegionType >     m_Regions;
+
+  unsigned int                  m_NextChunkIndex;
+  ImagePointer                  m_NextChunk;
+  std::string                   m_ReadErrorMessage;
+
+  /** Range of pixels being reduced, and one partial result per thread. */
+  const PixelType *             m_ReduceBuffer;
+  SizeValueType                 m_ReduceLength;
+  std::vector< PartialType >    m_Partials;
+
+  PartialType                   m_Total;
+};
+
+} // end namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkStreamingImageStatistics.hxx"
+#endif
+
+#endif
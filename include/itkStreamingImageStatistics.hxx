@@ -0,0 +1,505 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkStreamingImageStatistics_hxx
+#define __itkStreamingImageStatistics_hxx
+
+#include "itkStreamingImageStatistics.h"
+#include "itkSlabRegionSplitter.h"
+#include "itkNumericTraits.h"
+
+namespace itk
+{
+
+template< typename TImage >
+StreamingImageStatistics< TImage >
+::StreamingImageStatistics()
+{
+  m_NumberOfStreamDivisions = 1;
+  m_NumberOfThreads = MultiThreader::GetGlobalDefaultNumberOfThreads();
+
+  m_NumberOfBins = 0;
+  m_HistogramMinimum = 0.0;
+  m_HistogramMaximum = 0.0;
+
+  m_NextChunkIndex = 0;
+
+  m_ReduceBuffer = NULL;
+  m_ReduceLength = 0;
+
+  this->ResetPartial( m_Total );
+}
+
+template< typename TImage >
+void
+StreamingImageStatistics< TImage >
+::SetHistogram( unsigned int numberOfBins, double minimum, double maximum )
+{
+  m_NumberOfBins = numberOfBins;
+  m_HistogramMinimum = minimum;
+  m_HistogramMaximum = maximum;
+  this->Modified();
+}
+
+template< typename TImage >
+double
+StreamingImageStatistics< TImage >
+::GetVariance() const
+{
+  return m_Total.Count > 0 ? m_Total.SumOfSquaredDeviations / m_Total.Count : 0.0;
+}
+
+template< typename TImage >
+double
+StreamingImageStatistics< TImage >
+::GetBinMinimum( unsigned int bin ) const
+{
+  return m_HistogramMinimum +
+    bin * ( m_HistogramMaximum - m_HistogramMinimum ) / m_NumberOfBins;
+}
+
+template< typename TImage >
+double
+StreamingImageStatistics< TImage >
+::ComputeOtsuThreshold() const
+{
+  const HistogramType & histogram = m_Total.Histogram;
+
+  if( histogram.empty() || m_Total.Count == 0 )
+    {
+    itkExceptionMacro("The histogram has not been computed");
+    }
+
+  //
+  // Bins are represented by their centers, and the class weights and
+  // means are accumulated from the lowest bin up.
+  //
+  const double binWidth = ( m_HistogramMaximum - m_HistogramMinimum ) / m_NumberOfBins;
+
+  double totalCount = 0.0;
+  double totalSum = 0.0;
+  for( unsigned int b = 0; b < histogram.size(); b++ )
+    {
+    totalCount += histogram[b];
+    totalSum += histogram[b] * ( this->GetBinMinimum( b ) + 0.5 * binWidth );
+    }
+
+  double lowerCount = 0.0;
+  double lowerSum = 0.0;
+  double maximumVariance = -1.0;
+  unsigned int bestBin = 0;
+
+  for( unsigned int b = 0; b + 1 < histogram.size(); b++ )
+    {
+    lowerCount += histogram[b];
+    lowerSum += histogram[b] * ( this->GetBinMinimum( b ) + 0.5 * binWidth );
+
+    const double upperCount = totalCount - lowerCount;
+
+    if( lowerCount == 0.0 || upperCount == 0.0 )
+      {
+      continue;
+      }
+
+    const double meanDifference = lowerSum / lowerCount - ( totalSum - lowerSum ) / upperCount;
+    const double variance = lowerCount * upperCount * meanDifference * meanDifference;
+
+    if( variance > maximumVariance )
+      {
+      maximumVariance = variance;
+      bestBin = b;
+      }
+    }
+
+  return this->GetBinMinimum( bestBin + 1 );
+}
+
+template< typename TImage >
+double
+StreamingImageStatistics< TImage >
+::ComputePercentileThreshold( double percentage ) const
+{
+  const HistogramType & histogram = m_Total.Histogram;
+
+  if( histogram.empty() || m_Total.Count == 0 )
+    {
+    itkExceptionMacro("The histogram has not been computed");
+    }
+
+  const double target = percentage / 100.0 * m_Total.Count;
+
+  if( target <= 0.0 )
+    {
+    return m_HistogramMinimum;
+    }
+
+  double cumulativeCount = 0.0;
+  for( unsigned int b = 0; b < histogram.size(); b++ )
+    {
+    cumulativeCount += histogram[b];
+    if( cumulativeCount >= target )
+      {
+      return this->GetBinMinimum( b + 1 );
+      }
+    }
+
+  return m_HistogramMaximum;
+}
+
+template< typename TImage >
+void
+StreamingImageStatistics< TImage >
+::ResetPartial( PartialType & partial ) const
+{
+  partial.Count = 0;
+  partial.Minimum = NumericTraits< double >::max();
+  partial.Maximum = NumericTraits< double >::NonpositiveMin();
+  partial.Mean = 0.0;
+  partial.SumOfSquaredDeviations = 0.0;
+  partial.Histogram.assign( m_NumberOfBins, 0 );
+}
+
+template< typename TImage >
+void
+StreamingImageStatistics< TImage >
+::MergePartial( PartialType & total, const PartialType & partial )
+{
+  if( partial.Count == 0 )
+    {
+    return;
+    }
+
+  if( partial.Minimum < total.Minimum )
+    {
+    total.Minimum = partial.Minimum;
+    }
+  if( partial.Maximum > total.Maximum )
+    {
+    total.Maximum = partial.Maximum;
+    }
+
+  //
+  // Pairwise update, which does not lose precision when the two sets
+  // have very different sizes or means.
+  //
+  const double count = static_cast< double >( total.Count ) + partial.Count;
+  const double delta = partial.Mean - total.Mean;
+
+  total.Mean += delta * partial.Count / count;
+  total.SumOfSquaredDeviations += partial.SumOfSquaredDeviations +
+    delta * delta * ( static_cast< double >( total.Count ) * partial.Count / count );
+  total.Count += partial.Count;
+
+  for( size_t b = 0; b < partial.Histogram.size(); b++ )
+    {
+    total.Histogram[b] += partial.Histogram[b];
+    }
+}
+
+template< typename TImage >
+void
+StreamingImageStatistics< TImage >
+::Update()
+{
+  if( m_FileName == "" )
+    {
+    itkExceptionMacro("File name must be set");
+    }
+
+  if( m_NumberOfBins > 0 && !( m_HistogramMaximum > m_HistogramMinimum ) )
+    {
+    itkExceptionMacro("The histogram range is empty");
+    }
+
+  m_Reader = ReaderType::New();
+  m_Reader->SetFileName( m_FileName );
+  m_Reader->UpdateOutputInformation();
+
+  const RegionType largestRegion = m_Reader->GetOutput()->GetLargestPossibleRegion();
+
+  const unsigned int numberOfChunks =
+    SlabRegionSplitter< ImageType::ImageDimension >::GetNumberOfSplits(
+      largestRegion, m_NumberOfStreamDivisions );
+
+  m_Regions.resize( numberOfChunks );
+  for( unsigned int i = 0; i < numberOfChunks; i++ )
+    {
+    m_Regions[i] = SlabRegionSplitter< ImageType::ImageDimension >::GetSplit(
+      i, numberOfChunks, largestRegion );
+    }
+
+  this->ResetPartial( m_Total );
+
+  m_ReadErrorMessage = "";
+  this->ReadChunk( 0 );
+
+  MultiThreader::Pointer prefetcher = MultiThreader::New();
+
+  for( unsigned int i = 0; i < numberOfChunks; i++ )
+    {
+    if( m_ReadErrorMessage != "" )
+      {
+      break;
+      }
+
+    ImagePointer chunk = m_NextChunk;
+    m_NextChunk = NULL;
+
+    // The next division is read while this one is reduced.
+    ThreadIdType readerThread = 0;
+    const bool prefetch = ( i + 1 < numberOfChunks );
+
+    if( prefetch )
+      {
+      m_NextChunkIndex = i + 1;
+      readerThread = prefetcher->SpawnThread( Self::ReaderThreadCallback, this );
+      }
+
+    // The reader thread must not outlive a failed reduction.
+    try
+      {
+      this->ReduceChunk( chunk, m_Regions[i] );
+      }
+    catch( ... )
+      {
+      if( prefetch )
+        {
+        prefetcher->TerminateThread( readerThread );
+        }
+      m_NextChunk = NULL;
+      m_Reader = NULL;
+      throw;
+      }
+
+    chunk = NULL;
+
+    if( prefetch )
+      {
+      prefetcher->TerminateThread( readerThread );
+      }
+    }
+
+  m_NextChunk = NULL;
+  m_Reader = NULL;
+
+  if( m_ReadErrorMessage != "" )
+    {
+    itkExceptionMacro("Could not read " << m_FileName << ": " << m_ReadErrorMessage);
+    }
+}
+
+template< typename TImage >
+void
+StreamingImageStatistics< TImage >
+::ReadChunk( unsigned int chunkIndex )
+{
+  try
+    {
+    m_Reader->GetOutput()->SetRequestedRegion( m_Regions[chunkIndex] );
+    m_Reader->Update();
+
+    m_NextChunk = m_Reader->GetOutput();
+    m_NextChunk->DisconnectPipeline();
+    }
+  catch( ExceptionObject & excp )
+    {
+    m_NextChunk = NULL;
+    m_ReadErrorMessage = excp.GetDescription();
+    }
+}
+
+template< typename TImage >
+void
+StreamingImageStatistics< TImage >
+::ReduceChunk( const ImageType * chunk, const RegionType & region )
+{
+  //
+  // A slab spans the whole image in all but its outermost dimension, so
+  // it is a contiguous range of the buffer even if the reader buffered
+  // more than was requested.
+  //
+  const RegionType & buffered = chunk->GetBufferedRegion();
+
+  for( unsigned int i = 0; i + 1 < ImageType::ImageDimension; i++ )
+    {
+    if( buffered.GetIndex(i) != region.GetIndex(i) ||
+        buffered.GetSize(i) != region.GetSize(i) )
+      {
+      itkExceptionMacro("Stream division " << region << " is not contiguous in " << buffered);
+      }
+    }
+
+  m_ReduceBuffer = chunk->GetBufferPointer() + chunk->ComputeOffset( region.GetIndex() );
+  m_ReduceLength = region.GetNumberOfPixels();
+
+  ThreadIdType numberOfThreads = m_NumberOfThreads;
+  if( m_ReduceLength < numberOfThreads )
+    {
+    numberOfThreads = 1;
+    }
+
+  m_Partials.resize( numberOfThreads );
+
+  MultiThreader::Pointer threader = MultiThreader::New();
+  threader->SetNumberOfThreads( numberOfThreads );
+  threader->SetSingleMethod( Self::ReduceThreadCallback, this );
+  threader->SingleMethodExecute();
+
+  // The threader may have run fewer threads than asked for.
+  for( ThreadIdType t = 0; t < threader->GetNumberOfThreads(); t++ )
+    {
+    MergePartial( m_Total, m_Partials[t] );
+    }
+
+  m_ReduceBuffer = NULL;
+}
+
+template< typename TImage >
+void
+StreamingImageStatistics< TImage >
+::ReduceRange( const PixelType * pixels, SizeValueType length,
+               PartialType & partial ) const
+{
+  this->ResetPartial( partial );
+
+  if( length == 0 )
+    {
+    return;
+    }
+
+  //
+  // Sums are taken around the first pixel, which keeps the sum of
+  // squares from cancelling when the mean is far from zero.
+  //
+  double shift = static_cast< double >( pixels[0] );
+  if( shift != shift )
+    {
+    shift = 0.0;
+    }
+
+  double minimum = partial.Minimum;
+  double maximum = partial.Maximum;
+  double sum = 0.0;
+  double sumOfSquares = 0.0;
+  SizeValueType count = 0;
+
+  const unsigned int numberOfBins = m_NumberOfBins;
+  const double binScale = numberOfBins > 0 ?
+    numberOfBins / ( m_HistogramMaximum - m_HistogramMinimum ) : 0.0;
+  SizeValueType * histogram = numberOfBins > 0 ? &partial.Histogram[0] : NULL;
+
+  for( SizeValueType i = 0; i < length; i++ )
+    {
+    const double value = static_cast< double >( pixels[i] );
+
+    if( value != value )
+      {
+      continue;
+      }
+
+    if( value < minimum )
+      {
+      minimum = value;
+      }
+    if( value > maximum )
+      {
+      maximum = value;
+      }
+
+    const double deviation = value - shift;
+    sum += deviation;
+    sumOfSquares += deviation * deviation;
+    count++;
+
+    if( histogram )
+      {
+      const double position = ( value - m_HistogramMinimum ) * binScale;
+      unsigned int bin = 0;
+      if( position > 0.0 )
+        {
+        bin = position < numberOfBins ? static_cast< unsigned int >( position ) : numberOfBins - 1;
+        }
+      histogram[bin]++;
+      }
+    }
+
+  if( count == 0 )
+    {
+    return;
+    }
+
+  partial.Count = count;
+  partial.Minimum = minimum;
+  partial.Maximum = maximum;
+  partial.Mean = shift + sum / count;
+  partial.SumOfSquaredDeviations = sumOfSquares - sum * sum / count;
+}
+
+template< typename TImage >
+ITK_THREAD_RETURN_TYPE
+StreamingImageStatistics< TImage >
+::ReaderThreadCallback( void * arg )
+{
+  MultiThreader::ThreadInfoStruct * info =
+    static_cast< MultiThreader::ThreadInfoStruct * >( arg );
+
+  Self * statistics = static_cast< Self * >( info->UserData );
+
+  statistics->ReadChunk( statistics->m_NextChunkIndex );
+
+  return ITK_THREAD_RETURN_VALUE;
+}
+
+template< typename TImage >
+ITK_THREAD_RETURN_TYPE
+StreamingImageStatistics< TImage >
+::ReduceThreadCallback( void * arg )
+{
+  MultiThreader::ThreadInfoStruct * info =
+    static_cast< MultiThreader::ThreadInfoStruct * >( arg );
+
+  Self * statistics = static_cast< Self * >( info->UserData );
+
+  const SizeValueType length = statistics->m_ReduceLength;
+  const SizeValueType begin = length * info->ThreadID / info->NumberOfThreads;
+  const SizeValueType end = length * ( info->ThreadID + 1 ) / info->NumberOfThreads;
+
+  statistics->ReduceRange( statistics->m_ReduceBuffer + begin, end - begin,
+                           statistics->m_Partials[info->ThreadID] );
+
+  return ITK_THREAD_RETURN_VALUE;
+}
+
+template< typename TImage >
+void
+StreamingImageStatistics< TImage >
+::PrintSelf(std::ostream & os, Indent indent) const
+{
+  Superclass::PrintSelf(os, indent);
+
+  os << indent << "FileName: " << m_FileName << std::endl;
+  os << indent << "NumberOfStreamDivisions: " << m_NumberOfStreamDivisions << std::endl;
+  os << indent << "NumberOfThreads: " << m_NumberOfThreads << std::endl;
+  os << indent << "NumberOfBins: " << m_NumberOfBins << std::endl;
+  os << indent << "HistogramMinimum: " << m_HistogramMinimum << std::endl;
+  os << indent << "HistogramMaximum: " << m_HistogramMaximum << std::endl;
+  os << indent << "Count: " << m_Total.Count << std::endl;
+}
+
+} // end namespace itk
+
+#endif
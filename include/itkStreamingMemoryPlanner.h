@@ -0,0 +1,374 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkStreamingMemoryPlanner_h
+#define __itkStreamingMemoryPlanner_h
+
+#include "itkObject.h"
+#include "itkObjectFactory.h"
+#include "itkImageIOFactory.h"
+
+#include <cctype>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace itk
+{
+
+/** \class StreamingMemoryPlanner
+ *
+ * \brief Chooses the number of stream divisions from a memory budget.
+ *
+ * The pipeline is described as a list of stages in upstream to
+ * downstream order (the reader first). Every stage buffers its output
+ * region, and a stage with a neighborhood radius makes all the stages
+ * upstream of it produce a halo of that many slices around the chunk.
+ * Without ReleaseDataFlag all those buffers are alive at the same time,
+ * so the estimated peak is their sum, times the number of chunks that
+ * are processed concurrently.
+ *
+ * Buffers whose size does not depend on the stream divisions, such as
+ * the bricks that a bricked writer keeps until they are complete, are
+ * added once to the estimate.
+ *
+ * The planner returns the smallest number of divisions whose estimate
+ * fits in the budget, which avoids over-splitting the image.
+ */
+class StreamingMemoryPlanner : public Object
+{
+public:
+  /** Standard class typedefs. */
+  typedef StreamingMemoryPlanner        Self;
+  typedef Object                        Superclass;
+  typedef SmartPointer< Self >          Pointer;
+  typedef SmartPointer< const Self >    ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro(Self);
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro(StreamingMemoryPlanner, Object);
+
+  typedef std::vector< SizeValueType >  ImageSizeType;
+
+  /** Read the image size from the header of a file. */
+  void SetImageFileName( const std::string & fileName )
+  {
+    ImageIOBase::Pointer imageIO = ImageIOFactory::CreateImageIO(
+      fileName.c_str(), ImageIOFactory::ReadMode );
+
+    if( imageIO.IsNull() )
+      {
+      itkExceptionMacro("Could not create IO object for file " << fileName);
+      }
+
+    imageIO->SetFileName( fileName );
+    imageIO->ReadImageInformation();
+
+    ImageSizeType size( imageIO->GetNumberOfDimensions() );
+    for( unsigned int i = 0; i < size.size(); i++ )
+      {
+      size[i] = imageIO->GetDimensions(i);
+      }
+
+    this->SetImageSize( size );
+  }
+
+  void SetImageSize( const ImageSizeType & size )
+  {
+    m_ImageSize = size;
+    this->Modified();
+  }
+
+  const ImageSizeType & GetImageSize() const { return m_ImageSize; }
+
+  /** Append a stage. The radius is the neighborhood the stage needs
+   * around every output pixel (0 for readers and pixel-wise filters). */
+  void AddStage( const std::string & name, SizeValueType bytesPerPixel,
+                 unsigned int radius = 0 )
+  {
+    StageType stage;
+    stage.Name = name;
+    stage.BytesPerPixel = bytesPerPixel;
+    stage.Radius = radius;
+    m_Stages.push_back( stage );
+    this->Modified();
+  }
+
+  unsigned int GetNumberOfStages() const
+  {
+    return static_cast< unsigned int >( m_Stages.size() );
+  }
+
+  /** Append a buffer of a fixed number of bytes, held once for the whole
+   * run whatever the number of divisions. */
+  void AddFixedBuffer( const std::string & name, SizeValueType bytes )
+  {
+    FixedBufferType buffer;
+    buffer.Name = name;
+    buffer.Bytes = bytes;
+    m_FixedBuffers.push_back( buffer );
+    this->Modified();
+  }
+
+  /** Memory available for image buffers, in bytes. */
+  itkSetMacro(MemoryBudget, SizeValueType);
+  itkGetConstMacro(MemoryBudget, SizeValueType);
+
+  /** Chunks that are held in memory at the same time, for example by the
+   * overlapped or concurrent streaming drivers. */
+  itkSetClampMacro(NumberOfConcurrentChunks, unsigned int, 1,
+                   NumericTraits< unsigned int >::max());
+  itkGetConstMacro(NumberOfConcurrentChunks, unsigned int);
+
+  /** Thickness, along the slowest dimension, of the largest chunk. */
+  SizeValueType ComputeChunkThickness( unsigned int numberOfDivisions ) const
+  {
+    const SizeValueType range = this->GetSlowestSize();
+
+    if( numberOfDivisions < 1 )
+      {
+      numberOfDivisions = 1;
+      }
+
+    return ( range + numberOfDivisions - 1 ) / numberOfDivisions;
+  }
+
+  /** Estimated peak of resident image memory, in bytes. */
+  SizeValueType EstimatePeakMemory( unsigned int numberOfDivisions ) const
+  {
+    if( m_ImageSize.empty() )
+      {
+      itkExceptionMacro("Image size has not been set");
+      }
+
+    SizeValueType sliceSize = 1;
+    for( unsigned int i = 0; i + 1 < m_ImageSize.size(); i++ )
+      {
+      sliceSize *= m_ImageSize[i];
+      }
+
+    const SizeValueType range = this->GetSlowestSize();
+    const SizeValueType thickness = this->ComputeChunkThickness( numberOfDivisions );
+
+    SizeValueType total = 0;
+    SizeValueType halo = 0;
+
+    // Walk from the most downstream stage, accumulating the halo.
+    for( size_t k = m_Stages.size(); k > 0; k-- )
+      {
+      const StageType & stage = m_Stages[k-1];
+
+      SizeValueType slices = thickness + 2 * halo;
+      if( slices > range )
+        {
+        slices = range;
+        }
+
+      total += stage.BytesPerPixel * sliceSize * slices;
+
+      halo += stage.Radius;
+      }
+
+    SizeValueType fixed = 0;
+    for( size_t k = 0; k < m_FixedBuffers.size(); k++ )
+      {
+      fixed += m_FixedBuffers[k].Bytes;
+      }
+
+    return total * m_NumberOfConcurrentChunks + fixed;
+  }
+
+  /** Smallest number of divisions whose estimate fits in the budget. */
+  unsigned int ComputeNumberOfStreamDivisions() const
+  {
+    if( m_Stages.empty() )
+      {
+      itkExceptionMacro("No pipeline stage has been described");
+      }
+
+    const unsigned int range = static_cast< unsigned int >( this->GetSlowestSize() );
+
+    unsigned int previousThickness = 0;
+
+    for( unsigned int n = 1; n <= range; n++ )
+      {
+      // Division counts that give the same chunk thickness give the same peak.
+      const unsigned int thickness =
+        static_cast< unsigned int >( this->ComputeChunkThickness( n ) );
+      if( thickness == previousThickness )
+        {
+        continue;
+        }
+      previousThickness = thickness;
+
+      if( this->EstimatePeakMemory( n ) <= m_MemoryBudget )
+        {
+        return n;
+        }
+      }
+
+    itkExceptionMacro("A memory budget of " << m_MemoryBudget
+      << " bytes is too small, even one slice per division needs "
+      << this->EstimatePeakMemory( range ) << " bytes");
+  }
+
+  /** Parse sizes such as "2GiB", "512MB", "1.5G" or "1000000". Both the
+   * decimal (kB, MB, GB, TB) and binary (KiB, MiB, GiB, TiB) units are
+   * understood; a single letter is taken as binary. */
+  static SizeValueType ParseMemorySize( const std::string & text )
+  {
+    const char * begin = text.c_str();
+    char * end = NULL;
+
+    const double value = std::strtod( begin, &end );
+
+    if( end == begin || value < 0.0 )
+      {
+      itkGenericExceptionMacro("Invalid memory size: " << text);
+      }
+
+    std::string unit;
+    for( const char * c = end; *c; ++c )
+      {
+      if( !std::isspace( *c ) )
+        {
+        unit += static_cast< char >( std::toupper( *c ) );
+        }
+      }
+
+    double factor = 1.0;
+
+    if( unit == "" || unit == "B" )
+      {
+      factor = 1.0;
+      }
+    else if( unit == "KB" )
+      {
+      factor = 1e3;
+      }
+    else if( unit == "MB" )
+      {
+      factor = 1e6;
+      }
+    else if( unit == "GB" )
+      {
+      factor = 1e9;
+      }
+    else if( unit == "TB" )
+      {
+      factor = 1e12;
+      }
+    else if( unit == "K" || unit == "KIB" )
+      {
+      factor = 1024.0;
+      }
+    else if( unit == "M" || unit == "MIB" )
+      {
+      factor = 1024.0 * 1024.0;
+      }
+    else if( unit == "G" || unit == "GIB" )
+      {
+      factor = 1024.0 * 1024.0 * 1024.0;
+      }
+    else if( unit == "T" || unit == "TIB" )
+      {
+      factor = 1024.0 * 1024.0 * 1024.0 * 1024.0;
+      }
+    else
+      {
+      itkGenericExceptionMacro("Unknown memory unit in: " << text);
+      }
+
+    return static_cast< SizeValueType >( value * factor );
+  }
+
+protected:
+  StreamingMemoryPlanner()
+  {
+    m_MemoryBudget = 0;
+    m_NumberOfConcurrentChunks = 1;
+  }
+
+  ~StreamingMemoryPlanner() {}
+
+  void PrintSelf(std::ostream & os, Indent indent) const
+  {
+    Superclass::PrintSelf(os, indent);
+
+    os << indent << "ImageSize:";
+    for( unsigned int i = 0; i < m_ImageSize.size(); i++ )
+      {
+      os << " " << m_ImageSize[i];
+      }
+    os << std::endl;
+
+    for( unsigned int k = 0; k < m_Stages.size(); k++ )
+      {
+      os << indent << "Stage " << k << ": " << m_Stages[k].Name
+         << " (" << m_Stages[k].BytesPerPixel << " bytes per pixel, radius "
+         << m_Stages[k].Radius << ")" << std::endl;
+      }
+
+    for( unsigned int k = 0; k < m_FixedBuffers.size(); k++ )
+      {
+      os << indent << "Fixed buffer " << k << ": " << m_FixedBuffers[k].Name
+         << " (" << m_FixedBuffers[k].Bytes << " bytes)" << std::endl;
+      }
+
+    os << indent << "MemoryBudget: " << m_MemoryBudget << std::endl;
+    os << indent << "NumberOfConcurrentChunks: " << m_NumberOfConcurrentChunks << std::endl;
+  }
+
+  SizeValueType GetSlowestSize() const
+  {
+    if( m_ImageSize.empty() )
+      {
+      return 1;
+      }
+    return m_ImageSize.back();
+  }
+
+private:
+  StreamingMemoryPlanner(const Self &); // Purposely not implemented
+  void operator=(const Self &);         // Purposely not implemented
+
+  struct StageType
+    {
+    std::string    Name;
+    SizeValueType  BytesPerPixel;
+    unsigned int   Radius;
+    };
+
+  struct FixedBufferType
+    {
+    std::string    Name;
+    SizeValueType  Bytes;
+    };
+
+  ImageSizeType                    m_ImageSize;
+  std::vector< StageType >         m_Stages;
+  std::vector< FixedBufferType >   m_FixedBuffers;
+
+  SizeValueType                    m_MemoryBudget;
+  unsigned int                     m_NumberOfConcurrentChunks;
+};
+
+} // end namespace itk
+
+#endif
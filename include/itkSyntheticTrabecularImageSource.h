@@ -0,0 +1,181 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkSyntheticTrabecularImageSource_h
+#define __itkSyntheticTrabecularImageSource_h
+
+#include "itkImageSource.h"
+#include "itkIntTypes.h"
+
+#include <vector>
+
+namespace itk
+{
+
+/** \class SyntheticTrabecularImageSource
+ *
+ * \brief Generates a deterministic volume that looks like a micro-CT scan
+ * of trabecular bone, of any size, one requested region at a time.
+ *
+ * Space is divided in cubic cells. Every cell holds a node at a jittered
+ * position, and the node may be joined to the nodes of the next cells
+ * along each axis by a strut, a cylinder with rounded ends and its own
+ * radius. Voxels inside a strut take the bone value and the others the
+ * marrow value, with a one voxel ramp across the surface for the partial
+ * volume effect, and uniform noise on top.
+ *
+ * Every random choice is a hash of the seed and of the integer indices of
+ * a cell or of a voxel, so a pixel has the same value whatever region is
+ * requested and however the region is split among threads or stream
+ * divisions. Only the requested region is ever allocated, which lets the
+ * source stand in for the reader of an arbitrarily large file.
+ *
+ * The source is three-dimensional. Integer pixel types are rounded and
+ * clamped to their range.
+ */
+template< typename TOutputImage >
+class SyntheticTrabecularImageSource : public ImageSource< TOutputImage >
+{
+public:
+  /** Standard class typedefs. */
+  typedef SyntheticTrabecularImageSource  Self;
+  typedef ImageSource< TOutputImage >     Superclass;
+  typedef SmartPointer< Self >            Pointer;
+  typedef SmartPointer< const Self >      ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro(Self);
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro(SyntheticTrabecularImageSource, ImageSource);
+
+  typedef TOutputImage                                OutputImageType;
+  typedef typename OutputImageType::PixelType         OutputPixelType;
+  typedef typename OutputImageType::RegionType        OutputImageRegionType;
+  typedef typename OutputImageType::SizeType          SizeType;
+  typedef typename OutputImageType::SpacingType       SpacingType;
+  typedef typename OutputImageType::PointType         PointType;
+
+  itkStaticConstMacro(ImageDimension, unsigned int, TOutputImage::ImageDimension);
+
+#ifdef ITK_USE_CONCEPT_CHECKING
+  itkConceptMacro(ThreeDimensionalCheck,
+    ( Concept::SameDimension< itkGetStaticConstMacro(ImageDimension), 3 > ));
+#endif
+
+  /** Geometry of the generated volume. */
+  itkSetMacro(Size, SizeType);
+  itkGetConstReferenceMacro(Size, SizeType);
+  itkSetMacro(Spacing, SpacingType);
+  itkGetConstReferenceMacro(Spacing, SpacingType);
+  itkSetMacro(Origin, PointType);
+  itkGetConstReferenceMacro(Origin, PointType);
+
+  /** Volumes with different seeds have different structures. */
+  itkSetMacro(Seed, unsigned int);
+  itkGetConstMacro(Seed, unsigned int);
+
+  /** Edge of the cells, in voxels. Sets the distance between struts. */
+  itkSetClampMacro(CellSize, double, 2.0, NumericTraits< double >::max());
+  itkGetConstMacro(CellSize, double);
+
+  /** Mean radius of the struts in voxels, and the fraction by which the
+   * radius of each strut may differ from it. */
+  itkSetClampMacro(StrutRadius, double, 0.0, NumericTraits< double >::max());
+  itkGetConstMacro(StrutRadius, double);
+  itkSetClampMacro(StrutRadiusVariation, double, 0.0, 1.0);
+  itkGetConstMacro(StrutRadiusVariation, double);
+
+  /** Probability that two neighbor nodes are joined. Lower values give
+   * the sparser, more disconnected structure of osteoporotic bone. */
+  itkSetClampMacro(Connectivity, double, 0.0, 1.0);
+  itkGetConstMacro(Connectivity, double);
+
+  /** Values inside and outside of the struts, and the amplitude of the
+   * noise added to both. */
+  itkSetMacro(BoneValue, double);
+  itkGetConstMacro(BoneValue, double);
+  itkSetMacro(MarrowValue, double);
+  itkGetConstMacro(MarrowValue, double);
+  itkSetClampMacro(NoiseAmplitude, double, 0.0, NumericTraits< double >::max());
+  itkGetConstMacro(NoiseAmplitude, double);
+
+protected:
+  SyntheticTrabecularImageSource();
+  ~SyntheticTrabecularImageSource() {}
+  void PrintSelf(std::ostream & os, Indent indent) const;
+
+  virtual void GenerateOutputInformation();
+
+  void ThreadedGenerateData( const OutputImageRegionType & outputRegionForThread,
+                             ThreadIdType threadId );
+
+private:
+  SyntheticTrabecularImageSource(const Self &); // Purposely not implemented
+  void operator=(const Self &);                 // Purposely not implemented
+
+  /** A strut, with the bounding box of the voxels it may reach. */
+  struct StrutType
+    {
+    double Start[3];
+    double Direction[3];
+    double LengthSquared;
+    double Radius;
+    double Lower[3];
+    double Upper[3];
+    };
+
+  typedef std::vector< StrutType > StrutListType;
+
+  /** Hash of the seed and of an integer position, from 0 to 2^64-1. */
+  uint64_t Hash( IndexValueType i, IndexValueType j, IndexValueType k,
+                 unsigned int salt ) const;
+
+  /** Hash mapped to [0,1). */
+  double Random( IndexValueType i, IndexValueType j, IndexValueType k,
+                 unsigned int salt ) const;
+
+  /** Position of the node of a cell, in voxels. */
+  void GetNode( IndexValueType i, IndexValueType j, IndexValueType k,
+                double node[3] ) const;
+
+  /** Struts that may reach the voxels of the row at (y,z) from x0 to x1. */
+  void CollectStruts( IndexValueType x0, IndexValueType x1,
+                      IndexValueType y, IndexValueType z,
+                      StrutListType & struts ) const;
+
+  SizeType      m_Size;
+  SpacingType   m_Spacing;
+  PointType     m_Origin;
+
+  unsigned int  m_Seed;
+  double        m_CellSize;
+  double        m_StrutRadius;
+  double        m_StrutRadiusVariation;
+  double        m_Connectivity;
+  double        m_BoneValue;
+  double        m_MarrowValue;
+  double        m_NoiseAmplitude;
+};
+
+} // end namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkSyntheticTrabecularImageSource.hxx"
+#endif
+
+#endif
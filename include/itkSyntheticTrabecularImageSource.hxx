@@ -0,0 +1,308 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkSyntheticTrabecularImageSource_hxx
+#define __itkSyntheticTrabecularImageSource_hxx
+
+#include "itkSyntheticTrabecularImageSource.h"
+#include "itkImageLinearIteratorWithIndex.h"
+#include "itkProgressReporter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace itk
+{
+
+template< typename TOutputImage >
+SyntheticTrabecularImageSource< TOutputImage >
+::SyntheticTrabecularImageSource()
+{
+  m_Size.Fill( 256 );
+  m_Spacing.Fill( 1.0 );
+  m_Origin.Fill( 0.0 );
+
+  m_Seed = 0;
+  m_CellSize = 20.0;
+  m_StrutRadius = 2.5;
+  m_StrutRadiusVariation = 0.4;
+  m_Connectivity = 0.75;
+  m_BoneValue = 200.0;
+  m_MarrowValue = 40.0;
+  m_NoiseAmplitude = 12.0;
+}
+
+template< typename TOutputImage >
+void
+SyntheticTrabecularImageSource< TOutputImage >
+::GenerateOutputInformation()
+{
+  OutputImageType * output = this->GetOutput();
+
+  OutputImageRegionType largestPossibleRegion;
+  largestPossibleRegion.SetSize( m_Size );
+
+  output->SetLargestPossibleRegion( largestPossibleRegion );
+  output->SetSpacing( m_Spacing );
+  output->SetOrigin( m_Origin );
+}
+
+template< typename TOutputImage >
+uint64_t
+SyntheticTrabecularImageSource< TOutputImage >
+::Hash( IndexValueType i, IndexValueType j, IndexValueType k,
+        unsigned int salt ) const
+{
+  const uint64_t values[3] = { static_cast< uint64_t >( i ),
+                               static_cast< uint64_t >( j ),
+                               static_cast< uint64_t >( k ) };
+
+  uint64_t hash = static_cast< uint64_t >( m_Seed ) * 0x9E3779B97F4A7C15ULL + salt;
+
+  // One round of the splitmix64 finalizer per coordinate.
+  for( unsigned int c = 0; c < 3; c++ )
+    {
+    hash ^= values[c];
+    hash += 0x9E3779B97F4A7C15ULL;
+    hash = ( hash ^ ( hash >> 30 ) ) * 0xBF58476D1CE4E5B9ULL;
+    hash = ( hash ^ ( hash >> 27 ) ) * 0x94D049BB133111EBULL;
+    hash ^= hash >> 31;
+    }
+
+  return hash;
+}
+
+template< typename TOutputImage >
+double
+SyntheticTrabecularImageSource< TOutputImage >
+::Random( IndexValueType i, IndexValueType j, IndexValueType k,
+          unsigned int salt ) const
+{
+  // The top 53 bits fill the mantissa of a double exactly.
+  return static_cast< double >( this->Hash( i, j, k, salt ) >> 11 ) * ( 1.0 / 9007199254740992.0 );
+}
+
+template< typename TOutputImage >
+void
+SyntheticTrabecularImageSource< TOutputImage >
+::GetNode( IndexValueType i, IndexValueType j, IndexValueType k,
+           double node[3] ) const
+{
+  const IndexValueType cell[3] = { i, j, k };
+
+  // Kept away from the faces of the cell, so struts are never too short.
+  for( unsigned int a = 0; a < 3; a++ )
+    {
+    node[a] = ( cell[a] + 0.2 + 0.6 * this->Random( i, j, k, a ) ) * m_CellSize;
+    }
+}
+
+template< typename TOutputImage >
+void
+SyntheticTrabecularImageSource< TOutputImage >
+::CollectStruts( IndexValueType x0, IndexValueType x1,
+                 IndexValueType y, IndexValueType z,
+                 StrutListType & struts ) const
+{
+  struts.clear();
+
+  //
+  // A strut leaving the node of a cell ends in the next cell, so it stays
+  // within two cells of its origin. Voxels are reached up to the largest
+  // radius plus the partial volume ramp.
+  //
+  const double reach = m_StrutRadius * ( 1.0 + m_StrutRadiusVariation ) + 1.0;
+
+  const double lower[3] = { x0 - reach, y - reach, z - reach };
+  const double upper[3] = { x1 + reach, y + reach, z + reach };
+
+  IndexValueType first[3];
+  IndexValueType last[3];
+  for( unsigned int a = 0; a < 3; a++ )
+    {
+    first[a] = static_cast< IndexValueType >( std::floor( lower[a] / m_CellSize ) ) - 1;
+    last[a]  = static_cast< IndexValueType >( std::floor( upper[a] / m_CellSize ) );
+    }
+
+  const IndexValueType row[3] = { 0, y, z };
+
+  for( IndexValueType k = first[2]; k <= last[2]; k++ )
+    {
+    for( IndexValueType j = first[1]; j <= last[1]; j++ )
+      {
+      for( IndexValueType i = first[0]; i <= last[0]; i++ )
+        {
+        double start[3];
+        this->GetNode( i, j, k, start );
+
+        for( unsigned int axis = 0; axis < 3; axis++ )
+          {
+          if( this->Random( i, j, k, 3 + axis ) >= m_Connectivity )
+            {
+            continue;
+            }
+
+          double end[3];
+          this->GetNode( i + ( axis == 0 ), j + ( axis == 1 ), k + ( axis == 2 ), end );
+
+          StrutType strut;
+          strut.Radius = m_StrutRadius *
+            ( 1.0 + m_StrutRadiusVariation * ( 2.0 * this->Random( i, j, k, 6 + axis ) - 1.0 ) );
+          strut.LengthSquared = 0.0;
+
+          const double extent = strut.Radius + 1.0;
+
+          bool reaches = true;
+          for( unsigned int a = 0; a < 3; a++ )
+            {
+            strut.Start[a] = start[a];
+            strut.Direction[a] = end[a] - start[a];
+            strut.LengthSquared += strut.Direction[a] * strut.Direction[a];
+            strut.Lower[a] = std::min( start[a], end[a] ) - extent;
+            strut.Upper[a] = std::max( start[a], end[a] ) + extent;
+
+            if( a > 0 && ( row[a] < strut.Lower[a] || row[a] > strut.Upper[a] ) )
+              {
+              reaches = false;
+              }
+            }
+
+          if( reaches && strut.Upper[0] >= x0 && strut.Lower[0] <= x1 )
+            {
+            struts.push_back( strut );
+            }
+          }
+        }
+      }
+    }
+}
+
+template< typename TOutputImage >
+void
+SyntheticTrabecularImageSource< TOutputImage >
+::ThreadedGenerateData( const OutputImageRegionType & outputRegionForThread,
+                        ThreadIdType threadId )
+{
+  if( outputRegionForThread.GetNumberOfPixels() == 0 )
+    {
+    return;
+    }
+
+  OutputImageType * output = this->GetOutput();
+
+  const SizeValueType rowLength = outputRegionForThread.GetSize( 0 );
+
+  ProgressReporter progress( this, threadId,
+    outputRegionForThread.GetNumberOfPixels() / rowLength );
+
+  const bool isInteger = std::numeric_limits< OutputPixelType >::is_integer;
+  const double minimum = static_cast< double >( NumericTraits< OutputPixelType >::NonpositiveMin() );
+  const double maximum = static_cast< double >( NumericTraits< OutputPixelType >::max() );
+
+  StrutListType struts;
+
+  ImageLinearIteratorWithIndex< OutputImageType > it( output, outputRegionForThread );
+  it.SetDirection( 0 );
+
+  for( it.GoToBegin(); !it.IsAtEnd(); it.NextLine() )
+    {
+    const typename OutputImageType::IndexType & rowStart = it.GetIndex();
+
+    const IndexValueType y = rowStart[1];
+    const IndexValueType z = rowStart[2];
+
+    this->CollectStruts( rowStart[0], rowStart[0] + rowLength - 1, y, z, struts );
+
+    IndexValueType x = rowStart[0];
+
+    while( !it.IsAtEndOfLine() )
+      {
+      //
+      // Signed distance from the voxel to the surface of the nearest strut.
+      //
+      double distance = NumericTraits< double >::max();
+
+      for( size_t s = 0; s < struts.size(); s++ )
+        {
+        const StrutType & strut = struts[s];
+
+        if( x < strut.Lower[0] || x > strut.Upper[0] )
+          {
+          continue;
+          }
+
+        const double offset[3] = { x - strut.Start[0], y - strut.Start[1], z - strut.Start[2] };
+
+        double t = ( offset[0] * strut.Direction[0] +
+                     offset[1] * strut.Direction[1] +
+                     offset[2] * strut.Direction[2] ) / strut.LengthSquared;
+        t = std::min( std::max( t, 0.0 ), 1.0 );
+
+        double squared = 0.0;
+        for( unsigned int a = 0; a < 3; a++ )
+          {
+          const double d = offset[a] - t * strut.Direction[a];
+          squared += d * d;
+          }
+
+        distance = std::min( distance, std::sqrt( squared ) - strut.Radius );
+        }
+
+      const double bone = std::min( std::max( 0.5 - distance, 0.0 ), 1.0 );
+
+      double value = m_MarrowValue + ( m_BoneValue - m_MarrowValue ) * bone +
+        m_NoiseAmplitude * ( 2.0 * this->Random( x, y, z, 9 ) - 1.0 );
+
+      if( isInteger )
+        {
+        value = std::min( std::max( std::floor( value + 0.5 ), minimum ), maximum );
+        }
+
+      it.Set( static_cast< OutputPixelType >( value ) );
+
+      ++it;
+      ++x;
+      }
+
+    progress.CompletedPixel();
+    }
+}
+
+template< typename TOutputImage >
+void
+SyntheticTrabecularImageSource< TOutputImage >
+::PrintSelf(std::ostream & os, Indent indent) const
+{
+  Superclass::PrintSelf(os, indent);
+
+  os << indent << "Size: " << m_Size << std::endl;
+  os << indent << "Spacing: " << m_Spacing << std::endl;
+  os << indent << "Origin: " << m_Origin << std::endl;
+  os << indent << "Seed: " << m_Seed << std::endl;
+  os << indent << "CellSize: " << m_CellSize << std::endl;
+  os << indent << "StrutRadius: " << m_StrutRadius << std::endl;
+  os << indent << "StrutRadiusVariation: " << m_StrutRadiusVariation << std::endl;
+  os << indent << "Connectivity: " << m_Connectivity << std::endl;
+  os << indent << "BoneValue: " << m_BoneValue << std::endl;
+  os << indent << "MarrowValue: " << m_MarrowValue << std::endl;
+  os << indent << "NoiseAmplitude: " << m_NoiseAmplitude << std::endl;
+}
+
+} // end namespace itk
+
+#endif
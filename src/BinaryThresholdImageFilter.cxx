@@ -19,11 +19,21 @@
 #pragma warning ( disable : 4786 )
 #endif
 
-#include "itkBinaryThresholdImageFilter.h"
+#include <algorithm>
+
+#include "itkFastBinaryThresholdImageFilter.h"
 #include "itkImage.h"
 #include "itkImageFileReader.h"
 #include "itkImageFileWriter.h"
 #include "itkFilterStreamingWatcher.h"
+#include "itkOverlappedStreamingDriver.h"
+#include "itkConcurrentChunkStreamingDriver.h"
+#include "itkStreamingCommandLineOptions.h"
+#include "itkStreamingCommandLineSupport.h"
+#include "itkStreamingImageStatistics.h"
+#include "itkBrickedImageIO.h"
+#include "itkBrickedImageIOFactory.h"
+#include "itkBitPackedImageIOFactory.h"
 
 #include "itkTimeProbesCollectorBase.h"
 
@@ -34,9 +44,23 @@ int main( int argc, char * argv[] )
     std::cerr << "Usage: " << argv[0];
     std::cerr << " inputImageFile outputImageFile ";
     std::cerr << " thresholdValue numberOfDataBlocks" << std::endl;
+    std::cerr << " [--chunks-in-flight maximumNumberOfChunksInFlight]" << std::endl;
+    std::cerr << " [--workers numberOfWorkers]" << std::endl;
+    std::cerr << " [--max-memory memoryBudget]" << std::endl;
+    std::cerr << " [--autotune [slabsPerCandidate]] [--autotune-cache cacheFile]" << std::endl;
+    std::cerr << " [--compress]" << std::endl;
+    std::cerr << " [--no-simd]" << std::endl;
+    std::cerr << " [--statistics]" << std::endl;
+    std::cerr << " [--auto-threshold otsu | --auto-threshold percentile percentage]" << std::endl;
+    std::cerr << " [--metrics metricsFile.json|metricsFile.csv]" << std::endl;
+    std::cerr << " [--trace traceFile.json]" << std::endl;
+    std::cerr << " [--memory-budget memoryBudget|Nx[+overhead]]" << std::endl;
     return EXIT_FAILURE;
     }
 
+  itk::BrickedImageIOFactory::RegisterOneFactory();
+  itk::BitPackedImageIOFactory::RegisterOneFactory();
+
   typedef  unsigned char  InputPixelType;
   typedef  unsigned char  OutputPixelType;
 
@@ -45,7 +69,7 @@ int main( int argc, char * argv[] )
   typedef itk::Image< InputPixelType,  Dimension >   InputImageType;
   typedef itk::Image< OutputPixelType, Dimension >   OutputImageType;
 
-  typedef itk::BinaryThresholdImageFilter<
+  typedef itk::FastBinaryThresholdImageFilter<
                InputImageType, OutputImageType >  FilterType;
   typedef itk::ImageFileReader< InputImageType >  ReaderType;
   typedef itk::ImageFileWriter< OutputImageType >  WriterType;
@@ -64,7 +88,7 @@ int main( int argc, char * argv[] )
   filter->SetOutsideValue( outsideValue );
   filter->SetInsideValue(  insideValue  );
 
-  const InputPixelType lowerThreshold = atoi( argv[3] );
+  InputPixelType lowerThreshold = atoi( argv[3] );
   const InputPixelType upperThreshold = itk::NumericTraits< InputPixelType >::max();
 
   filter->SetLowerThreshold( lowerThreshold );
@@ -74,17 +98,317 @@ int main( int argc, char * argv[] )
 
   writer->SetFileName( argv[2] );
 
-  const unsigned int numberOfDataBlocks = atoi( argv[4] );
+  itk::StreamingCommandLineOptions options( argc, argv, 5 );
+
+  static const char * const validOptions[] = {
+    "--chunks-in-flight",
+    "--workers",
+    "--max-memory",
+    "--autotune",
+    "--autotune-cache",
+    "--compress",
+    "--no-simd",
+    "--statistics",
+    "--auto-threshold",
+    "--metrics",
+    "--trace",
+    "--memory-budget",
+    NULL };
+
+  if( !options.CheckOptions( validOptions, std::cerr ) )
+    {
+    return EXIT_FAILURE;
+    }
+
+  itk::StreamingCommandLineSupport support( options );
+
+  //
+  // Per stream division timings, sizes and memory, for comparing runs.
+  //
+  if( options.HasOption("--metrics") )
+    {
+    watcher.SetMetricsFileName( options.GetOptionValue("--metrics") );
+    }
+
+  unsigned int numberOfDataBlocks = atoi( argv[4] );
+
+  //
+  // The scalar kernel is the reference for the vector ones.
+  //
+  if( options.HasOption("--no-simd") )
+    {
+    itk::BinaryThresholdScanlineKernels::SetMaximumInstructionSet(
+      itk::BinaryThresholdScanlineKernels::Scalar );
+    }
+
+  std::cout << "Threshold kernel: "
+            << itk::BinaryThresholdScanlineKernels::GetInstructionSetName() << std::endl;
+
+  //
+  // A memory budget, when given, overrides the number of data blocks.
+  //
+  itk::StreamingMemoryPlanner::Pointer planner = itk::StreamingMemoryPlanner::New();
+
+  planner->AddStage( "reader", sizeof( InputPixelType ) );
+  planner->AddStage( "threshold", sizeof( OutputPixelType ) );
+
+  if( !support.PlanNumberOfStreamDivisions( planner, argv[1],
+      argv[2], sizeof( OutputPixelType ), numberOfDataBlocks ) )
+    {
+    return EXIT_FAILURE;
+    }
+
+  //
+  // The threshold can instead be picked from the histogram of the input,
+  // built in a streamed pre-pass that holds two data blocks at a time.
+  //
+  if( options.HasOption("--auto-threshold") )
+    {
+    const itk::StreamingCommandLineOptions::ValuesType method =
+      options.GetOptionValues("--auto-threshold");
+
+    const bool percentile = !method.empty() && method[0] == "percentile";
+
+    if( method.empty() || ( method[0] != "otsu" && !( percentile && method.size() == 2 ) ) )
+      {
+      std::cerr << "--auto-threshold needs otsu, or percentile and a percentage" << std::endl;
+      return EXIT_FAILURE;
+      }
+
+    typedef itk::StreamingImageStatistics< InputImageType > HistogramPassType;
+
+    HistogramPassType::Pointer histogramPass = HistogramPassType::New();
+
+    double threshold = 0.0;
+
+    try
+      {
+      unsigned int numberOfHistogramBlocks = numberOfDataBlocks;
+
+      if( options.HasOption("--max-memory") )
+        {
+        itk::StreamingMemoryPlanner::Pointer statisticsPlanner = itk::StreamingMemoryPlanner::New();
+
+        statisticsPlanner->AddStage( "reader", sizeof( InputPixelType ) );
+        statisticsPlanner->SetNumberOfConcurrentChunks( 2 );
+        statisticsPlanner->SetImageFileName( argv[1] );
+        statisticsPlanner->SetMemoryBudget( itk::StreamingMemoryPlanner::ParseMemorySize(
+          options.GetOptionValue("--max-memory") ) );
+        numberOfHistogramBlocks = statisticsPlanner->ComputeNumberOfStreamDivisions();
+        }
+
+      histogramPass->SetFileName( argv[1] );
+      histogramPass->SetNumberOfStreamDivisions( numberOfHistogramBlocks );
+
+      // One bin per gray level.
+      histogramPass->SetHistogram( 256, 0.0, 256.0 );
+
+      histogramPass->Update();
+
+      threshold = percentile ?
+        histogramPass->ComputePercentileThreshold( atof( method[1].c_str() ) ) :
+        histogramPass->ComputeOtsuThreshold();
+      }
+    catch( itk::ExceptionObject & err )
+      {
+      std::cerr << err << std::endl;
+      return EXIT_FAILURE;
+      }
+
+    lowerThreshold = threshold < upperThreshold ?
+      static_cast< InputPixelType >( threshold ) : upperThreshold;
+
+    filter->SetLowerThreshold( lowerThreshold );
+
+    std::cout << "Automatic threshold: " << static_cast< double >( lowerThreshold ) << std::endl;
+    }
+
+  //
+  // With the statistics sidecar of the input, the bricks that are
+  // entirely above or below the threshold are filled without being thresholded.
+  //
+  itk::BrickStatistics statistics;
+
+  if( options.HasOption("--statistics") )
+    {
+    try
+      {
+      statistics.Read( itk::BrickStatistics::GetSidecarFileName( argv[1] ) );
+      }
+    catch( itk::ExceptionObject & err )
+      {
+      std::cerr << err << std::endl;
+      return EXIT_FAILURE;
+      }
+
+    const itk::BrickStatistics::BrickIdType numberOfBricks =
+      statistics.GetGrid().GetNumberOfBricks();
+
+    itk::BrickStatistics::BrickIdType numberOfUniformBricks = 0;
+    for( itk::BrickStatistics::BrickIdType id = 0; id < numberOfBricks; id++ )
+      {
+      if( statistics.Classify( id, lowerThreshold, upperThreshold ) != itk::BrickStatistics::Mixed )
+        {
+        numberOfUniformBricks++;
+        }
+      }
+
+    std::cout << "Uniform bricks: " << numberOfUniformBricks
+              << " of " << numberOfBricks << std::endl;
+
+    filter->SetBrickStatistics( &statistics );
+    }
+
+  //
+  // Autotuning times a few data block counts on a sample of the input,
+  // and keeps the fastest one that fits the memory budget. The choice is
+  // cached for later runs on this machine and dataset.
+  //
+  if( !support.AutotuneNumberOfStreamDivisions( filter->GetOutput(),
+        itk::StreamDivisionAutotuner::GetFileSignature( argv[1] ) + " threshold",
+        numberOfDataBlocks ) )
+    {
+    return EXIT_FAILURE;
+    }
+
+  // The probes are not part of the run.
+  watcher.ClearMetrics();
 
   writer->SetNumberOfStreamDivisions( numberOfDataBlocks );
 
+  //
+  // Bricked outputs can be compressed brick by brick while streaming.
+  //
+  const bool compress = options.HasOption("--compress");
+
+  if( compress && !itk::BrickedImageIO::New()->CanWriteFile( argv[2] ) )
+    {
+    std::cerr << "Compression needs a bricked (.bvol) output file" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  writer->SetUseCompression( compress );
+
+  //
+  // Optionally read and filter several data blocks at once, every
+  // worker with its own copy of the filter. The cores are shared
+  // among the workers.
+  //
+  typedef itk::ConcurrentChunkStreamingDriver<
+    InputImageType, OutputImageType > ConcurrentDriverType;
+
+  ConcurrentDriverType::Pointer concurrentDriver = ConcurrentDriverType::New();
+
+  const bool concurrent = options.HasOption("--workers");
+
+  if( concurrent )
+    {
+    const unsigned int numberOfWorkers =
+      std::max( atoi( options.GetOptionValue("--workers").c_str() ), 1 );
+
+    const itk::ThreadIdType threadsPerWorker = std::max(
+      itk::MultiThreader::GetGlobalDefaultNumberOfThreads() / numberOfWorkers, 1u );
+
+    concurrentDriver->AddInputFileName( argv[1] );
+    concurrentDriver->SetOutputFileName( argv[2] );
+    concurrentDriver->SetNumberOfStreamDivisions( numberOfDataBlocks );
+    concurrentDriver->SetUseCompression( compress );
+
+    // One chunk per worker, and one finished chunk waiting for the writer.
+    unsigned int chunksInFlight = numberOfWorkers + 1;
+
+    if( options.HasOption("--chunks-in-flight") )
+      {
+      chunksInFlight = atoi( options.GetOptionValue("--chunks-in-flight").c_str() );
+      }
+
+    concurrentDriver->SetMaximumNumberOfChunksInFlight( chunksInFlight );
+
+    filter->SetNumberOfThreads( threadsPerWorker );
+    concurrentDriver->AddFilter( filter );
+
+    for( unsigned int w = 1; w < numberOfWorkers; w++ )
+      {
+      FilterType::Pointer workerFilter = FilterType::New();
+      workerFilter->SetOutsideValue( outsideValue );
+      workerFilter->SetInsideValue( insideValue );
+      workerFilter->SetLowerThreshold( lowerThreshold );
+      workerFilter->SetUpperThreshold( upperThreshold );
+
+      if( options.HasOption("--statistics") )
+        {
+        workerFilter->SetBrickStatistics( &statistics );
+        }
+
+      workerFilter->SetNumberOfThreads( threadsPerWorker );
+      concurrentDriver->AddFilter( workerFilter );
+      watcher.WatchProcess( workerFilter );
+      }
+    }
+
+  //
+  // Optionally overlap the reading, filtering and writing
+  // of consecutive data blocks.
+  //
+  typedef itk::OverlappedStreamingDriver<
+    InputImageType, OutputImageType > DriverType;
+
+  DriverType::Pointer driver = DriverType::New();
+
+  const bool overlapped = options.HasOption("--chunks-in-flight") && !concurrent;
+
+  if( overlapped )
+    {
+    driver->AddInputFileName( argv[1] );
+    driver->SetOutputFileName( argv[2] );
+    driver->SetFilter( filter );
+    driver->SetNumberOfStreamDivisions( numberOfDataBlocks );
+    driver->SetMaximumNumberOfChunksInFlight(
+      atoi( options.GetOptionValue("--chunks-in-flight").c_str() ) );
+    driver->SetUseCompression( compress );
+    }
+
+  //
+  // With a declared memory budget, the run fails when its peak memory
+  // grows past it. The trace is the timeline of every stage and stream
+  // division, for a trace viewer.
+  //
+  if( !support.StartMemoryGuard( argv[1], numberOfDataBlocks ) )
+    {
+    return EXIT_FAILURE;
+    }
+
+  if( concurrent )
+    {
+    support.WatchDriver( concurrentDriver.GetPointer() );
+    }
+  else if( overlapped )
+    {
+    support.WatchDriver( driver.GetPointer() );
+    }
+  else
+    {
+    support.WatchPipeline( writer );
+    }
+
   itk::TimeProbesCollectorBase chronometer;
 
   chronometer.Start("Filtering");
 
   try
     {
-    writer->Update();
+    if( concurrent )
+      {
+      concurrentDriver->Update();
+      }
+    else if( overlapped )
+      {
+      driver->Update();
+      }
+    else
+      {
+      writer->Update();
+      }
     }
   catch( itk::ExceptionObject & err )
     {
@@ -95,5 +419,16 @@ int main( int argc, char * argv[] )
   chronometer.Stop("Filtering");
   chronometer.Report( std::cout );
 
+  if( !support.FinishRun() )
+    {
+    return EXIT_FAILURE;
+    }
+
+  if( concurrent )
+    {
+    std::cout << "Chunks run by another worker: "
+              << concurrentDriver->GetNumberOfStolenChunks() << std::endl;
+    }
+
   return EXIT_SUCCESS;
 }
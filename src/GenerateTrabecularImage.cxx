@@ -0,0 +1,226 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include <iostream>
+
+#include "itkImage.h"
+#include "itkImageFileWriter.h"
+#include "itkSyntheticTrabecularImageSource.h"
+#include "itkFilterStreamingWatcher.h"
+#include "itkStreamingCommandLineOptions.h"
+#include "itkStreamingCommandLineSupport.h"
+#include "itkBrickedImageIO.h"
+#include "itkBrickedImageIOFactory.h"
+#include "itkBitPackedImageIOFactory.h"
+
+#include "itkTimeProbesCollectorBase.h"
+
+//
+// Writes a synthetic trabecular bone volume of any size, for running and
+// timing the streaming tools without the Creatis datasets. The volume is
+// generated one stream division at a time, so it is never held in memory
+// as a whole, and the same seed always gives the same file.
+//
+template< typename TPixel >
+int GenerateImage( const std::string & outputImageFileName,
+                   const itk::Size< 3 > & size,
+                   unsigned int numberOfDataBlocks,
+                   const itk::StreamingCommandLineOptions & options )
+{
+  const unsigned int Dimension = 3;
+
+  typedef itk::Image< TPixel, Dimension >                   ImageType;
+  typedef itk::SyntheticTrabecularImageSource< ImageType >  SourceType;
+  typedef itk::ImageFileWriter< ImageType >                 ImageWriterType;
+
+  typename SourceType::Pointer source = SourceType::New();
+  typename ImageWriterType::Pointer writer = ImageWriterType::New();
+
+  source->SetSize( size );
+  source->SetSeed( atoi( options.GetOptionValue( "--seed", "0" ).c_str() ) );
+
+  if( options.HasOption("--spacing") )
+    {
+    const itk::StreamingCommandLineOptions::ValuesType values =
+      options.GetOptionValues( "--spacing" );
+
+    if( values.size() != Dimension )
+      {
+      std::cerr << "--spacing needs three values" << std::endl;
+      return EXIT_FAILURE;
+      }
+
+    typename SourceType::SpacingType spacing;
+    for( unsigned int i = 0; i < Dimension; i++ )
+      {
+      spacing[i] = atof( values[i].c_str() );
+      }
+    source->SetSpacing( spacing );
+    }
+
+  if( options.HasOption("--cell-size") )
+    {
+    source->SetCellSize( atof( options.GetOptionValue("--cell-size").c_str() ) );
+    }
+
+  if( options.HasOption("--strut-radius") )
+    {
+    source->SetStrutRadius( atof( options.GetOptionValue("--strut-radius").c_str() ) );
+    }
+
+  if( options.HasOption("--connectivity") )
+    {
+    source->SetConnectivity( atof( options.GetOptionValue("--connectivity").c_str() ) );
+    }
+
+  if( options.HasOption("--bone-value") )
+    {
+    source->SetBoneValue( atof( options.GetOptionValue("--bone-value").c_str() ) );
+    }
+
+  if( options.HasOption("--marrow-value") )
+    {
+    source->SetMarrowValue( atof( options.GetOptionValue("--marrow-value").c_str() ) );
+    }
+
+  if( options.HasOption("--noise") )
+    {
+    source->SetNoiseAmplitude( atof( options.GetOptionValue("--noise").c_str() ) );
+    }
+
+  writer->SetInput( source->GetOutput() );
+  writer->SetFileName( outputImageFileName );
+
+  writer->SetNumberOfStreamDivisions( numberOfDataBlocks );
+
+  //
+  // Bricked outputs can be compressed brick by brick while streaming.
+  //
+  const bool compress = options.HasOption("--compress");
+
+  if( compress && !itk::BrickedImageIO::New()->CanWriteFile( outputImageFileName.c_str() ) )
+    {
+    std::cerr << "Compression needs a bricked (.bvol) output file" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  writer->SetUseCompression( compress );
+
+  itk::FilterStreamingWatcher watcher(source, "generating");
+
+  //
+  // Per stream division timings, sizes and memory, for comparing runs.
+  //
+  if( options.HasOption("--metrics") )
+    {
+    watcher.SetMetricsFileName( options.GetOptionValue("--metrics") );
+    }
+
+  //
+  // Timeline of every stage and stream division, for a trace viewer.
+  //
+  itk::StreamingCommandLineSupport support( options );
+
+  support.WatchPipeline( writer );
+
+  itk::TimeProbesCollectorBase chronometer;
+
+  chronometer.Start("Generating");
+
+  try
+    {
+    writer->Update();
+    }
+  catch( itk::ExceptionObject & err )
+    {
+    std::cerr << err << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  chronometer.Stop("Generating");
+  chronometer.Report( std::cout );
+
+  if( !support.FinishRun() )
+    {
+    return EXIT_FAILURE;
+    }
+
+  return EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[])
+{
+  if ( argc < 6 )
+    {
+    std::cerr << "Missing Parameters " << std::endl;
+    std::cerr << "Usage: " << argv[0];
+    std::cerr << " outputImageFile sizeX sizeY sizeZ numberOfDataBlocks" << std::endl;
+    std::cerr << " [--float]" << std::endl;
+    std::cerr << " [--seed seed]" << std::endl;
+    std::cerr << " [--spacing spacingX spacingY spacingZ]" << std::endl;
+    std::cerr << " [--cell-size voxels]" << std::endl;
+    std::cerr << " [--strut-radius voxels]" << std::endl;
+    std::cerr << " [--connectivity probability]" << std::endl;
+    std::cerr << " [--bone-value value] [--marrow-value value] [--noise amplitude]" << std::endl;
+    std::cerr << " [--compress]" << std::endl;
+    std::cerr << " [--metrics metricsFile.json|metricsFile.csv]" << std::endl;
+    std::cerr << " [--trace traceFile.json]" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  itk::BrickedImageIOFactory::RegisterOneFactory();
+  itk::BitPackedImageIOFactory::RegisterOneFactory();
+
+  std::string outputImageFileName = argv[1];
+
+  itk::Size< 3 > size;
+  size[0] = atoi( argv[2] );
+  size[1] = atoi( argv[3] );
+  size[2] = atoi( argv[4] );
+
+  unsigned int numberOfDataBlocks = atoi( argv[5] );
+
+  itk::StreamingCommandLineOptions options( argc, argv, 6 );
+
+  static const char * const validOptions[] = {
+    "--seed",
+    "--spacing",
+    "--cell-size",
+    "--strut-radius",
+    "--connectivity",
+    "--bone-value",
+    "--marrow-value",
+    "--noise",
+    "--compress",
+    "--metrics",
+    "--trace",
+    "--float",
+    NULL };
+
+  if( !options.CheckOptions( validOptions, std::cerr ) )
+    {
+    return EXIT_FAILURE;
+    }
+
+  if( options.HasOption("--float") )
+    {
+    return GenerateImage< float >( outputImageFileName, size, numberOfDataBlocks, options );
+    }
+
+  return GenerateImage< unsigned char >( outputImageFileName, size, numberOfDataBlocks, options );
+}
@@ -17,10 +17,15 @@
  *=========================================================================*/
 
 #include "itkImage.h"
-#include "itkVTKImageExport.h"
-#include "itkImageFileReader.h"
+#include "itkImageIOFactory.h"
+#include "itkSliceCache.h"
+#include "itkBrickedImageIOFactory.h"
+#include "itkBitPackedImageIOFactory.h"
+#include "itkStreamingCommandLineOptions.h"
+#include "itkRealTimeClock.h"
 
 #include "vtkSmartPointer.h"
+#include "vtkCommand.h"
 #include "vtkImageData.h"
 #include "vtkImageImport.h"
 #include "vtkImageActor.h"
@@ -29,130 +34,481 @@
 #include "vtkRenderWindowInteractor.h"
 #include "vtkInteractorStyleImageCursor.h"
 
-#include "itkReaderStreamingWatcher.h"
+#include <algorithm>
+#include <cstdlib>
 
 #define VTK_CREATE(type, name) \
   vtkSmartPointer<type> name = vtkSmartPointer<type>::New()
 
-template <typename ITK_Exporter, typename VTK_Importer>
-void ConnectPipelines(ITK_Exporter exporter, VTK_Importer importer)
+
+//
+// Shows the slice of the interactor style, taken from the slice cache,
+// and asks the cache for the next slices in the direction of travel.
+//
+// With a coarse cache, a slice that is not cached at full resolution is
+// first shown from the coarse one, which is fast to read. Its full
+// resolution version is only asked for once the slice stayed on screen
+// for the refine delay, so that paging through the slices does not queue
+// reads of slices that are already gone. The interactor timer then polls
+// the background read, and swaps the coarse slice for the full one when
+// it is in the cache. VTK is only touched from the interactor thread.
+//
+// The importers wrap the buffers of the slices being displayed, without
+// a copy, so the loader keeps these slices alive until the next ones are
+// shown.
+//
+template < typename TImage >
+class SliceLoader : public vtkCommand
 {
-  importer->SetUpdateInformationCallback(exporter->GetUpdateInformationCallback());
-  importer->SetPipelineModifiedCallback(exporter->GetPipelineModifiedCallback());
-  importer->SetWholeExtentCallback(exporter->GetWholeExtentCallback());
-  importer->SetSpacingCallback(exporter->GetSpacingCallback());
-  importer->SetOriginCallback(exporter->GetOriginCallback());
-  importer->SetScalarTypeCallback(exporter->GetScalarTypeCallback());
-  importer->SetNumberOfComponentsCallback(exporter->GetNumberOfComponentsCallback());
-  importer->SetPropagateUpdateExtentCallback(exporter->GetPropagateUpdateExtentCallback());
-  importer->SetUpdateDataCallback(exporter->GetUpdateDataCallback());
-  importer->SetDataExtentCallback(exporter->GetDataExtentCallback());
-  importer->SetBufferPointerCallback(exporter->GetBufferPointerCallback());
-  importer->SetCallbackUserData(exporter->GetCallbackUserData());
-}
+public:
+  typedef itk::SliceCache< TImage >  CacheType;
+
+  static SliceLoader * New() { return new SliceLoader; }
+
+  void Initialize( CacheType * cache, vtkImageImport * importer, vtkImageActor * actor,
+                   vtkInteractorStyleImageCursor * style, vtkRenderWindow * renderWindow,
+                   unsigned int prefetch )
+  {
+    this->Cache = cache;
+    this->Importer = importer;
+    this->Actor = actor;
+    this->Style = style;
+    this->RenderWindow = renderWindow;
+    this->NumberOfPrefetchedSlices = prefetch;
+  }
+
+  void SetCoarseLevel( CacheType * cache, vtkImageImport * importer,
+                       vtkImageActor * actor, double refineDelay )
+  {
+    this->CoarseCache = cache;
+    this->CoarseImporter = importer;
+    this->CoarseActor = actor;
+    this->RefineDelay = refineDelay;
+  }
+
+  void ShowSlice( int z )
+  {
+    this->Slice = this->Cache->GetSlice( z );
+    this->Wrap( this->Cache, this->Slice, this->Importer, this->Actor, z );
+
+    this->Actor->VisibilityOn();
+    if( this->CoarseActor )
+      {
+      this->CoarseActor->VisibilityOff();
+      }
 
+    this->CurrentSlice = z;
+    this->Refined = true;
+  }
 
-int main(int argc, char * argv [] )
-{
+  void ShowCoarseSlice( int z )
+  {
+    this->CoarseSlice = this->CoarseCache->GetSlice( z );
+    this->Wrap( this->CoarseCache, this->CoarseSlice, this->CoarseImporter,
+                this->CoarseActor, z );
 
-  // Load a scalar image using ITK and display it with VTK
+    this->CoarseActor->VisibilityOn();
+    this->Actor->VisibilityOff();
 
-  if( argc < 2 )
+    this->CurrentSlice = z;
+    this->Refined = false;
+    this->RefineRequested = false;
+    this->ShownTime = this->Clock->GetTimeInSeconds();
+  }
+
+  virtual void Execute( vtkObject *, unsigned long eventId, void * callData )
+  {
+    try
+      {
+      if( eventId == vtkCommand::TimerEvent )
+        {
+        this->Refine();
+        }
+      else
+        {
+        this->Direction = *static_cast< int * >( callData );
+        this->GoToSlice( this->Style->GetSlice() );
+        }
+      }
+    catch( itk::ExceptionObject & e )
+      {
+      std::cerr << "Failed to read slice " << this->Style->GetSlice()
+                << " : " << e << std::endl;
+      }
+  }
+
+protected:
+  SliceLoader()
+  {
+    this->Importer = NULL;
+    this->Actor = NULL;
+    this->CoarseImporter = NULL;
+    this->CoarseActor = NULL;
+    this->Style = NULL;
+    this->RenderWindow = NULL;
+    this->NumberOfPrefetchedSlices = 0;
+    this->RefineDelay = 0.0;
+    this->CurrentSlice = 0;
+    this->Direction = 1;
+    this->Refined = true;
+    this->RefineRequested = false;
+    this->ShownTime = 0.0;
+    this->Clock = itk::RealTimeClock::New();
+  }
+
+  void GoToSlice( int z )
+  {
+    if( !this->CoarseCache || this->Cache->IsCached( z ) )
+      {
+      this->ShowSlice( z );
+      this->Cache->Prefetch( z, this->Direction, this->NumberOfPrefetchedSlices );
+      return;
+      }
+
+    this->Cache->CancelPrefetch();
+    this->ShowCoarseSlice( z );
+    this->CoarseCache->Prefetch( z, this->Direction, this->NumberOfPrefetchedSlices );
+  }
+
+  void Refine()
+  {
+    if( this->Refined )
+      {
+      return;
+      }
+
+    const int z = this->CurrentSlice;
+
+    if( !this->RefineRequested )
+      {
+      if( this->Clock->GetTimeInSeconds() - this->ShownTime < this->RefineDelay )
+        {
+        return;
+        }
+      this->Cache->Load( z );
+      this->RefineRequested = true;
+      }
+
+    if( this->Cache->IsCached( z ) )
+      {
+      this->ShowSlice( z );
+      this->Cache->Prefetch( z, this->Direction, this->NumberOfPrefetchedSlices );
+      this->RenderWindow->Render();
+      }
+  }
+
+  void Wrap( CacheType * cache, TImage * slice, vtkImageImport * importer,
+             vtkImageActor * actor, int z )
+  {
+    const typename TImage::RegionType & region = cache->GetLargestPossibleRegion();
+
+    const int x0 = region.GetIndex(0);
+    const int x1 = x0 + static_cast< int >( region.GetSize(0) ) - 1;
+    const int y0 = region.GetIndex(1);
+    const int y1 = y0 + static_cast< int >( region.GetSize(1) ) - 1;
+
+    importer->SetDataExtent( x0, x1, y0, y1, z, z );
+    importer->SetImportVoidPointer( slice->GetBufferPointer() );
+    importer->Modified();
+
+    actor->SetDisplayExtent( x0, x1, y0, y1, z, z );
+  }
+
+private:
+  typename CacheType::Pointer       Cache;
+  typename TImage::Pointer          Slice;
+  vtkImageImport                  * Importer;
+  vtkImageActor                   * Actor;
+
+  typename CacheType::Pointer       CoarseCache;
+  typename TImage::Pointer          CoarseSlice;
+  vtkImageImport                  * CoarseImporter;
+  vtkImageActor                   * CoarseActor;
+
+  vtkInteractorStyleImageCursor   * Style;
+  vtkRenderWindow                 * RenderWindow;
+  unsigned int                      NumberOfPrefetchedSlices;
+
+  double                            RefineDelay;
+  int                               CurrentSlice;
+  int                               Direction;
+  bool                              Refined;
+  bool                              RefineRequested;
+  double                            ShownTime;
+  itk::RealTimeClock::Pointer       Clock;
+};
+
+
+//
+// Importer of the slices of a cache. The whole extent covers the volume,
+// so the camera does not move between slices.
+//
+template < typename TImage >
+void SetupImporter( vtkImageImport * importer, itk::SliceCache< TImage > * cache,
+                    int vtkScalarType )
+{
+  const typename TImage::RegionType & region = cache->GetLargestPossibleRegion();
+
+  int extent[6];
+  for( unsigned int i = 0; i < 3; i++ )
     {
-    std::cerr << "Missing parameters" << std::endl;
-    std::cerr << "Usage: " << argv[0] << " inputImageFileName " << std::endl;
-    return EXIT_FAILURE;
+    extent[2*i] = region.GetIndex(i);
+    extent[2*i+1] = region.GetIndex(i) + static_cast< int >( region.GetSize(i) ) - 1;
     }
 
-  std::string inputImageFileName = argv[1];
+  importer->SetDataScalarType( vtkScalarType );
+  importer->SetNumberOfScalarComponents( 1 );
+  importer->SetWholeExtent( extent );
+  importer->SetDataSpacing( cache->GetSpacing()[0], cache->GetSpacing()[1],
+                            cache->GetSpacing()[2] );
+  importer->SetDataOrigin( cache->GetOrigin()[0], cache->GetOrigin()[1],
+                           cache->GetOrigin()[2] );
+}
 
-  itk::ImageIOBase::Pointer imageIO = itk::ImageIOFactory::CreateImageIO(
-    inputImageFileName.c_str(), itk::ImageIOFactory::ReadMode);
 
-  imageIO->SetFileName( inputImageFileName );
-  imageIO->ReadImageInformation();
+template < typename TPixel >
+int DisplayImage( const std::string & inputImageFileName, int vtkScalarType,
+                  const itk::StreamingCommandLineOptions & options )
+{
+  const unsigned int ImageDimension = 3;
 
-  std::cout << "File = " << inputImageFileName << std::endl;
-  std::cout << "File Recognized by " << imageIO->GetNameOfClass() << std::endl;
+  typedef itk::Image< TPixel, ImageDimension >  ImageType;
+  typedef itk::SliceCache< ImageType >          CacheType;
 
+  typename CacheType::Pointer cache = CacheType::New();
 
-  itk::ImageIOBase::IOComponentType componentType = imageIO->GetComponentType();
+  cache->SetFileName( inputImageFileName );
+  cache->SetCapacity( atoi( options.GetOptionValue("--cache-slices", "32").c_str() ) );
+  cache->SetMargin( atoi( options.GetOptionValue("--margin", "1").c_str() ) );
 
-  const unsigned int ImageDimension = 3;
+  const unsigned int prefetch =
+    atoi( options.GetOptionValue("--prefetch", "4").c_str() );
 
-  try
+  cache->Initialize();
+
+  const typename ImageType::RegionType & region = cache->GetLargestPossibleRegion();
+
+  int slice_min = region.GetIndex(2);
+  int slice_max = slice_min + static_cast< int >( region.GetSize(2) ) - 1;
+
+  int middleSlice = ( slice_min + slice_max ) / 2.0;
+
+  std::cout << "Slices : " << slice_min << " to " << slice_max << std::endl;
+
+  //
+  //  The coarse level comes from a precomputed file, written for instance
+  //  by ImageReadShrinkWrite, or is read on the fly from every n-th pixel
+  //  along X and Y of the input.
+  //
+  typename CacheType::Pointer coarseCache;
+
+  const unsigned int shrinkFactor =
+    atoi( options.GetOptionValue("--shrink", "4").c_str() );
+
+  if( options.HasOption("--pyramid") || shrinkFactor > 1 )
     {
+    coarseCache = CacheType::New();
+    coarseCache->SetMargin( cache->GetMargin() );
 
-    //
-    //   Pixel Type = unsigned char
-    //
-    typedef unsigned char PixelType1;
-    typedef itk::Image< PixelType1, ImageDimension > ImageType1;
-    typedef itk::ImageFileReader< ImageType1 > ReaderType1;
-    ReaderType1::Pointer reader1  = ReaderType1::New();
-    reader1->SetFileName( inputImageFileName );
+    if( options.HasOption("--pyramid") )
+      {
+      coarseCache->SetFileName( options.GetOptionValue("--pyramid") );
+      }
+    else
+      {
+      coarseCache->SetFileName( inputImageFileName );
+      coarseCache->SetShrinkFactor( shrinkFactor );
+      }
 
-    typedef itk::VTKImageExport< ImageType1 > ExportFilterType1;
-    ExportFilterType1::Pointer exporter1 = ExportFilterType1::New();
+    coarseCache->Initialize();
 
-    exporter1->SetInput( reader1->GetOutput() );
-    itk::ReaderStreamingWatcher watcher1( reader1 );
+    const typename ImageType::RegionType & coarseRegion =
+      coarseCache->GetLargestPossibleRegion();
+
+    if( coarseRegion.GetIndex(2) != region.GetIndex(2) ||
+        coarseRegion.GetSize(2) != region.GetSize(2) )
+      {
+      std::cerr << "The coarse level must have the same slices as the image" << std::endl;
+      return EXIT_FAILURE;
+      }
 
     //
-    //   Pixel Type = float
+    //  The coarse slices are smaller, and get as much memory as the full ones.
     //
-    typedef float PixelType2;
-    typedef itk::Image< PixelType2, ImageDimension > ImageType2;
-    typedef itk::ImageFileReader< ImageType2 > ReaderType2;
-    ReaderType2::Pointer reader2  = ReaderType2::New();
-    reader2->SetFileName( inputImageFileName );
+    const double ratio =
+      static_cast< double >( region.GetSize(0) * region.GetSize(1) ) /
+      static_cast< double >( coarseRegion.GetSize(0) * coarseRegion.GetSize(1) );
 
-    typedef itk::VTKImageExport< ImageType2 > ExportFilterType2;
-    ExportFilterType2::Pointer exporter2 = ExportFilterType2::New();
+    coarseCache->SetCapacity( static_cast< unsigned int >(
+      cache->GetCapacity() * std::max( ratio, 1.0 ) ) );
+    }
 
-    exporter2->SetInput( reader2->GetOutput() );
-    itk::ReaderStreamingWatcher watcher2( reader2 );
+  const double refineDelay =
+    atof( options.GetOptionValue("--refine-delay", "150").c_str() ) / 1000.0;
 
-    //
-    //   Pixel Type = signed short
-    //
-    typedef signed short PixelType3;
-    typedef itk::Image< PixelType3, ImageDimension > ImageType3;
-    typedef itk::ImageFileReader< ImageType3 > ReaderType3;
-    ReaderType3::Pointer reader3  = ReaderType3::New();
-    reader3->SetFileName( inputImageFileName );
+  //------------------------------------------------------------------------
+  // VTK visualization pipeline
+  //------------------------------------------------------------------------
 
-    typedef itk::VTKImageExport< ImageType3 > ExportFilterType3;
-    ExportFilterType3::Pointer exporter3 = ExportFilterType3::New();
+  VTK_CREATE( vtkImageImport, vtkImporter );
+  VTK_CREATE( vtkImageImport, vtkCoarseImporter );
+  VTK_CREATE( vtkImageActor, actor );
+  VTK_CREATE( vtkImageActor, coarseActor );
+  VTK_CREATE( vtkRenderer, renderer );
+  VTK_CREATE( vtkRenderWindow, renWin );
+  VTK_CREATE( vtkRenderWindowInteractor, iren );
+  VTK_CREATE( vtkInteractorStyleImageCursor, interactorStyle );
 
-    exporter3->SetInput( reader3->GetOutput() );
-    itk::ReaderStreamingWatcher watcher3( reader3 );
+  typedef SliceLoader< ImageType > LoaderType;
 
+  vtkSmartPointer< LoaderType > loader = vtkSmartPointer< LoaderType >::New();
+  loader->Initialize( cache, vtkImporter, actor, interactorStyle, renWin, prefetch );
 
-    //
-    //  Setup the rest of the pipeline
-    //
-    VTK_CREATE( vtkImageImport, vtkImporter );
+  //
+  //  The first frame is the coarse middle slice when there is a coarse
+  //  level, and the full resolution one otherwise.
+  //
+  if( coarseCache )
+    {
+    SetupImporter< ImageType >( vtkCoarseImporter, coarseCache, vtkScalarType );
 
+    loader->SetCoarseLevel( coarseCache, vtkCoarseImporter, coarseActor, refineDelay );
+    loader->ShowCoarseSlice( middleSlice );
+
+    coarseActor->SetInput(vtkCoarseImporter->GetOutput());
+    coarseActor->SetInterpolate(0);
+    renderer->AddActor(coarseActor);
+    }
 
+  SetupImporter< ImageType >( vtkImporter, cache, vtkScalarType );
+
+  if( !coarseCache )
+    {
+    loader->ShowSlice( middleSlice );
+    }
+
+  actor->SetInput(vtkImporter->GetOutput());
+  actor->SetInterpolate(0);
+
+  interactorStyle->SetImageActor( actor );
+  interactorStyle->SetRenderWindow( renWin );
+  interactorStyle->SetSliceRange( slice_min, slice_max );
+  interactorStyle->SetSlice( middleSlice );
+  interactorStyle->AddObserver(
+    vtkInteractorStyleImageCursor::SliceChangedEvent, loader );
+
+  renWin->SetSize(500, 500);
+  renWin->AddRenderer(renderer);
+  iren->SetRenderWindow(renWin);
+  iren->SetInteractorStyle( interactorStyle );
+
+  renderer->AddActor(actor);
+  renderer->SetBackground(0.4392, 0.5020, 0.5647);
+
+  //
+  //  The timer refines the coarse slice the view stopped on.
+  //
+  iren->Initialize();
+
+  if( coarseCache )
+    {
+    iren->AddObserver( vtkCommand::TimerEvent, loader );
+    iren->CreateRepeatingTimer( 50 );
+    }
+  else
+    {
+    cache->Prefetch( middleSlice, 1, prefetch );
+    }
+
+  renWin->Render();
+  iren->Start();
+
+  cache->Stop();
+
+  std::cout << "Slice cache hits = " << cache->GetNumberOfHits() << std::endl;
+  std::cout << "Slice cache misses = " << cache->GetNumberOfMisses() << std::endl;
+  std::cout << "Slices prefetched = " << cache->GetNumberOfPrefetchedSlices() << std::endl;
+
+  if( coarseCache )
+    {
+    coarseCache->Stop();
+
+    std::cout << "Coarse slice cache hits = " << coarseCache->GetNumberOfHits() << std::endl;
+    std::cout << "Coarse slice cache misses = " << coarseCache->GetNumberOfMisses() << std::endl;
+    }
+
+  return EXIT_SUCCESS;
+}
+
+
+int main(int argc, char * argv [] )
+{
+
+  // Load a scalar image using ITK and display it with VTK, one slice at a time
+
+  if( argc < 2 )
+    {
+    std::cerr << "Missing parameters" << std::endl;
+    std::cerr << "Usage: " << argv[0] << " inputImageFileName " << std::endl;
+    std::cerr << " [--cache-slices numberOfSlices]" << std::endl;
+    std::cerr << " [--margin numberOfSlices]" << std::endl;
+    std::cerr << " [--prefetch numberOfSlices]" << std::endl;
+    std::cerr << " [--pyramid coarseImageFileName]" << std::endl;
+    std::cerr << " [--shrink shrinkFactor]" << std::endl;
+    std::cerr << " [--refine-delay milliseconds]" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  itk::BrickedImageIOFactory::RegisterOneFactory();
+  itk::BitPackedImageIOFactory::RegisterOneFactory();
+
+  std::string inputImageFileName = argv[1];
+
+  itk::StreamingCommandLineOptions options(argc, argv, 2);
+
+  static const char * const validOptions[] = {
+    "--cache-slices",
+    "--margin",
+    "--prefetch",
+    "--shrink",
+    "--pyramid",
+    "--refine-delay",
+    NULL };
+
+  if( !options.CheckOptions( validOptions, std::cerr ) )
+    {
+    return EXIT_FAILURE;
+    }
+
+  itk::ImageIOBase::Pointer imageIO = itk::ImageIOFactory::CreateImageIO(
+    inputImageFileName.c_str(), itk::ImageIOFactory::ReadMode);
+
+  imageIO->SetFileName( inputImageFileName );
+  imageIO->ReadImageInformation();
+
+  std::cout << "File = " << inputImageFileName << std::endl;
+  std::cout << "File Recognized by " << imageIO->GetNameOfClass() << std::endl;
+
+
+  itk::ImageIOBase::IOComponentType componentType = imageIO->GetComponentType();
+
+  try
+    {
     switch( componentType )
       {
       case itk::ImageIOBase::UCHAR:
         {
-        ConnectPipelines(exporter1, vtkImporter);
-        break;
+        return DisplayImage< unsigned char >( inputImageFileName, VTK_UNSIGNED_CHAR, options );
         }
       case itk::ImageIOBase::FLOAT:
         {
-        ConnectPipelines(exporter2, vtkImporter);
-        break;
+        return DisplayImage< float >( inputImageFileName, VTK_FLOAT, options );
         }
       case itk::ImageIOBase::CHAR:
       case itk::ImageIOBase::USHORT:
       case itk::ImageIOBase::SHORT:
         {
-        ConnectPipelines(exporter3, vtkImporter);
-        break;
+        return DisplayImage< signed short >( inputImageFileName, VTK_SHORT, options );
         }
       case itk::ImageIOBase::ULONG:
       case itk::ImageIOBase::LONG:
@@ -165,46 +521,6 @@ int main(int argc, char * argv [] )
         return EXIT_FAILURE;
         }
       }
-
-    vtkImporter->UpdateInformation();
-
-    int * extent = vtkImporter->GetOutput()->GetWholeExtent();
-
-    int slice_min = extent[2];
-    int slice_max = extent[2 + 1];
-
-    //------------------------------------------------------------------------
-    // VTK visualization pipeline
-    //------------------------------------------------------------------------
-
-    VTK_CREATE( vtkImageActor, actor );
-    VTK_CREATE( vtkRenderer, renderer );
-    VTK_CREATE( vtkRenderWindow, renWin );
-    VTK_CREATE( vtkRenderWindowInteractor, iren );
-    VTK_CREATE( vtkInteractorStyleImageCursor, interactorStyle );
-
-    actor->SetInput(vtkImporter->GetOutput());
-
-    int middleSlice = ( slice_min + slice_max ) / 2.0;
-
-    actor->SetDisplayExtent(
-        extent[0], extent[1], extent[2], extent[3], middleSlice, middleSlice );
-
-    actor->SetInterpolate(0);
-
-    interactorStyle->SetImageActor( actor );
-    interactorStyle->SetRenderWindow( renWin );
-
-    renWin->SetSize(500, 500);
-    renWin->AddRenderer(renderer);
-    iren->SetRenderWindow(renWin);
-    iren->SetInteractorStyle( interactorStyle );
-
-    renderer->AddActor(actor);
-    renderer->SetBackground(0.4392, 0.5020, 0.5647);
-
-    renWin->Render();
-    iren->Start();
     }
   catch( itk::ExceptionObject & e )
     {
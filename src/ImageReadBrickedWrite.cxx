@@ -0,0 +1,232 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include <iostream>
+
+#include "itkImage.h"
+#include "itkImageFileReader.h"
+#include "itkImageFileWriter.h"
+#include "itkBrickedImageIO.h"
+#include "itkBrickedImageIOFactory.h"
+#include "itkBitPackedImageIOFactory.h"
+#include "itkFilterStreamingWatcher.h"
+#include "itkStreamingCommandLineOptions.h"
+#include "itkStreamingCommandLineSupport.h"
+
+#include "itkTimeProbesCollectorBase.h"
+
+//
+// Converts between MetaImage and bricked volumes. The conversion
+// streams in slabs, and the bricked writer keeps in memory only the
+// bricks that straddle the boundary between consecutive slabs.
+// Binary volumes can also be converted to and from bit packed files.
+//
+template< typename TPixel >
+int ConvertImage( const std::string & inputImageFileName,
+                  const std::string & outputImageFileName,
+                  unsigned int numberOfDataBlocks,
+                  unsigned int brickSize,
+                  bool compress,
+                  bool statistics,
+                  const itk::StreamingCommandLineOptions & options )
+{
+  const unsigned int Dimension = 3;
+
+  typedef itk::Image< TPixel, Dimension >     ImageType;
+
+  typedef itk::ImageFileReader< ImageType > ImageReaderType;
+  typedef itk::ImageFileWriter< ImageType > ImageWriterType;
+
+  typename ImageReaderType::Pointer reader = ImageReaderType::New();
+  typename ImageWriterType::Pointer writer = ImageWriterType::New();
+
+  reader->SetFileName( inputImageFileName );
+  writer->SetFileName( outputImageFileName );
+
+  writer->SetNumberOfStreamDivisions( numberOfDataBlocks );
+
+  itk::BrickedImageIO::Pointer brickedIO = itk::BrickedImageIO::New();
+
+  if( brickedIO->CanWriteFile( outputImageFileName.c_str() ) )
+    {
+    brickedIO->SetBrickSize( brickSize );
+    brickedIO->SetWriteStatistics( statistics );
+    writer->SetImageIO( brickedIO );
+    }
+  else if( compress )
+    {
+    std::cerr << "Compression needs a bricked (.bvol) output file" << std::endl;
+    return EXIT_FAILURE;
+    }
+  else if( statistics )
+    {
+    std::cerr << "Brick statistics need a bricked (.bvol) output file" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  writer->SetUseCompression( compress );
+
+  writer->SetInput( reader->GetOutput() );
+
+  //
+  // The reader runs once per stream division; the writer only once.
+  //
+  itk::FilterStreamingWatcher watcher(reader, "converting");
+  watcher.SetRequireProgress( false );
+
+  // Per stream division timings, sizes and memory, for comparing runs.
+  if( options.HasOption("--metrics") )
+    {
+    watcher.SetMetricsFileName( options.GetOptionValue("--metrics") );
+    }
+
+  //
+  // With a declared memory budget, the run fails when its peak memory
+  // grows past it. The trace is the timeline of every stage and stream
+  // division, for a trace viewer.
+  //
+  itk::StreamingCommandLineSupport support( options );
+
+  if( !support.StartMemoryGuard( inputImageFileName, numberOfDataBlocks ) )
+    {
+    return EXIT_FAILURE;
+    }
+
+  support.WatchPipeline( writer );
+
+  itk::TimeProbesCollectorBase chronometer;
+
+  chronometer.Start("Converting");
+
+  try
+    {
+    writer->Update();
+    }
+  catch( itk::ExceptionObject & err )
+    {
+    std::cerr << err << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  chronometer.Stop("Converting");
+  chronometer.Report( std::cout );
+
+  if( !support.FinishRun() )
+    {
+    return EXIT_FAILURE;
+    }
+
+  return EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[])
+{
+  if ( argc < 4 )
+    {
+    std::cerr << "Missing Parameters " << std::endl;
+    std::cerr << "Usage: " << argv[0];
+    std::cerr << " inputImageFile  outputImageFile numberOfDataBlocks [brickSize]" << std::endl;
+    std::cerr << " [--compress]" << std::endl;
+    std::cerr << " [--statistics]" << std::endl;
+    std::cerr << " [--metrics metricsFile.json|metricsFile.csv]" << std::endl;
+    std::cerr << " [--trace traceFile.json]" << std::endl;
+    std::cerr << " [--memory-budget memoryBudget|Nx[+overhead]]" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  itk::BrickedImageIOFactory::RegisterOneFactory();
+  itk::BitPackedImageIOFactory::RegisterOneFactory();
+
+  std::string inputImageFileName  = argv[1];
+  std::string outputImageFileName = argv[2];
+
+  unsigned int numberOfDataBlocks = atoi( argv[3] );
+
+  // The brick size is the only positional argument that may be left out.
+  unsigned int brickSize = 64;
+  int firstOption = 4;
+
+  if( argc > 4 && std::string( argv[4] ).compare( 0, 2, "--" ) != 0 )
+    {
+    brickSize = atoi( argv[4] );
+    firstOption = 5;
+    }
+
+  itk::StreamingCommandLineOptions options( argc, argv, firstOption );
+
+  static const char * const validOptions[] = {
+    "--compress",
+    "--statistics",
+    "--metrics",
+    "--trace",
+    "--memory-budget",
+    NULL };
+
+  if( !options.CheckOptions( validOptions, std::cerr ) )
+    {
+    return EXIT_FAILURE;
+    }
+
+  const bool compress = options.HasOption("--compress");
+  const bool statistics = options.HasOption("--statistics");
+
+  itk::ImageIOBase::Pointer imageIO = itk::ImageIOFactory::CreateImageIO(
+    inputImageFileName.c_str(), itk::ImageIOFactory::ReadMode);
+
+  if( imageIO.IsNull() )
+    {
+    std::cerr << "Could not create IO object for file " << inputImageFileName << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  try
+    {
+    imageIO->SetFileName( inputImageFileName );
+    imageIO->ReadImageInformation();
+    }
+  catch( itk::ExceptionObject & err )
+    {
+    std::cerr << err << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  switch( imageIO->GetComponentType() )
+    {
+    case itk::ImageIOBase::UCHAR:
+      return ConvertImage< unsigned char >( inputImageFileName, outputImageFileName,
+                                            numberOfDataBlocks, brickSize, compress,
+                                            statistics, options );
+    case itk::ImageIOBase::SHORT:
+      return ConvertImage< signed short >( inputImageFileName, outputImageFileName,
+                                           numberOfDataBlocks, brickSize, compress,
+                                           statistics, options );
+    case itk::ImageIOBase::USHORT:
+      return ConvertImage< unsigned short >( inputImageFileName, outputImageFileName,
+                                             numberOfDataBlocks, brickSize, compress,
+                                             statistics, options );
+    case itk::ImageIOBase::FLOAT:
+      return ConvertImage< float >( inputImageFileName, outputImageFileName,
+                                    numberOfDataBlocks, brickSize, compress,
+                                    statistics, options );
+    default:
+      std::cerr << "Unsupported pixel type "
+                << imageIO->GetComponentTypeAsString( imageIO->GetComponentType() )
+                << std::endl;
+      return EXIT_FAILURE;
+    }
+}
@@ -21,6 +21,8 @@
 #include "itkImage.h"
 #include "itkImageIOFactory.h"
 #include "itkImageIOFactoryRegisterManager.h"
+#include "itkBrickedImageIOFactory.h"
+#include "itkBitPackedImageIOFactory.h"
 
 int main(int argc, char *argv[])
 {
@@ -32,6 +34,9 @@ int main(int argc, char *argv[])
     return EXIT_FAILURE;
     }
 
+  itk::BrickedImageIOFactory::RegisterOneFactory();
+  itk::BitPackedImageIOFactory::RegisterOneFactory();
+
   std::string inputImageFileName  = argv[1];
 
   itk::ImageIOBase::Pointer imageIO = itk::ImageIOFactory::CreateImageIO(
@@ -20,6 +20,10 @@
 #include "itkImageFileWriter.h"
 #include "itkRegionOfInterestImageFilter.h"
 #include "itkImage.h"
+#include "itkRegionOfInterestList.h"
+#include "itkStreamingCommandLineOptions.h"
+#include "itkBrickedImageIOFactory.h"
+#include "itkBitPackedImageIOFactory.h"
 
 int main( int argc, char ** argv )
 {
@@ -29,9 +33,13 @@ int main( int argc, char ** argv )
     std::cerr << "Usage: " << std::endl;
     std::cerr << argv[0] << " inputImageFile  outputImageFile " << std::endl;
     std::cerr << " SliceNumberInZ startX startY sizeX sizeY" << std::endl;
+    std::cerr << " [--region outputImageFile SliceNumberInZ startX startY sizeX sizeY]" << std::endl;
+    std::cerr << " [--region-list listFile]" << std::endl;
     return EXIT_FAILURE;
     }
 
+  itk::BrickedImageIOFactory::RegisterOneFactory();
+  itk::BitPackedImageIOFactory::RegisterOneFactory();
 
   typedef unsigned char       InputPixelType;
   typedef unsigned char       OutputPixelType;
@@ -48,38 +56,63 @@ int main( int argc, char ** argv )
 
   FilterType::Pointer filter = FilterType::New();
 
-  OutputImageType::IndexType start;
-  start[0] = atoi( argv[4] );
-  start[1] = atoi( argv[5] );
-  start[2] = atoi( argv[3] );
+  //
+  // All the regions are served by the same reader, in file order, so
+  // that the volume is opened once and swept from front to back.
+  //
+  itk::RegionOfInterestList regions;
 
+  itk::StreamingCommandLineOptions options( argc, argv, 8 );
 
-  OutputImageType::SizeType size;
-  size[0] = atoi( argv[6] );
-  size[1] = atoi( argv[7] );
-  size[2] = 1; // one slice in Z
+  static const char * const validOptions[] = {
+    "--region",
+    "--region-list",
+    NULL };
 
-  OutputImageType::RegionType desiredRegion;
-  desiredRegion.SetSize(  size  );
-  desiredRegion.SetIndex( start );
+  if( !options.CheckOptions( validOptions, std::cerr ) )
+    {
+    return EXIT_FAILURE;
+    }
+
+  regions.AddRegion( itk::RegionOfInterestList::ValuesType( argv + 2, argv + 8 ) );
+
+  for( unsigned int k = 0; k < options.GetNumberOfOccurrences("--region"); k++ )
+    {
+    if( !regions.AddRegion( options.GetOptionValues( "--region", k ) ) )
+      {
+      std::cerr << "--region needs six values" << std::endl;
+      return EXIT_FAILURE;
+      }
+    }
+
+  if( options.HasOption("--region-list") &&
+      !regions.ReadListFile( options.GetOptionValue("--region-list") ) )
+    {
+    std::cerr << "Could not read the region list "
+              << options.GetOptionValue("--region-list") << std::endl;
+    return EXIT_FAILURE;
+    }
 
-  filter->SetRegionOfInterest( desiredRegion );
+  regions.Sort();
 
   ReaderType::Pointer reader = ReaderType::New();
   WriterType::Pointer writer = WriterType::New();
 
   const char * inputFilename  = argv[1];
-  const char * outputFilename = argv[2];
 
   reader->SetFileName( inputFilename  );
-  writer->SetFileName( outputFilename );
 
   filter->SetInput( reader->GetOutput() );
   writer->SetInput( filter->GetOutput() );
 
   try
     {
-    writer->Update();
+    for( unsigned int k = 0; k < regions.GetNumberOfRegions(); k++ )
+      {
+      filter->SetRegionOfInterest( regions.GetRegion( k ) );
+      writer->SetFileName( regions.GetFileName( k ) );
+      writer->Update();
+      }
     }
   catch( itk::ExceptionObject & err )
     {
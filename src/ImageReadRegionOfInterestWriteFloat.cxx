@@ -20,7 +20,13 @@
 #include "itkImageFileWriter.h"
 #include "itkRegionOfInterestImageFilter.h"
 #include "itkRescaleIntensityImageFilter.h"
+#include "itkIntensityWindowingImageFilter.h"
 #include "itkImage.h"
+#include "itkRegionOfInterestList.h"
+#include "itkStreamingCommandLineOptions.h"
+#include "itkBrickStatistics.h"
+#include "itkBrickedImageIOFactory.h"
+#include "itkBitPackedImageIOFactory.h"
 
 int main( int argc, char ** argv )
 {
@@ -30,9 +36,14 @@ int main( int argc, char ** argv )
     std::cerr << "Usage: " << std::endl;
     std::cerr << argv[0] << " inputImageFile  outputImageFile " << std::endl;
     std::cerr << " SliceNumberInZ startX startY sizeX sizeY" << std::endl;
+    std::cerr << " [--region outputImageFile SliceNumberInZ startX startY sizeX sizeY]" << std::endl;
+    std::cerr << " [--region-list listFile]" << std::endl;
+    std::cerr << " [--statistics]" << std::endl;
     return EXIT_FAILURE;
     }
 
+  itk::BrickedImageIOFactory::RegisterOneFactory();
+  itk::BitPackedImageIOFactory::RegisterOneFactory();
 
   typedef float               InputPixelType;
   typedef unsigned char       OutputPixelType;
@@ -50,34 +61,59 @@ int main( int argc, char ** argv )
   typedef itk::RescaleIntensityImageFilter< InputImageType,
                                             OutputImageType > RescaleFilterType;
 
+  typedef itk::IntensityWindowingImageFilter< InputImageType,
+                                              OutputImageType > WindowingFilterType;
+
   ExtractFilterType::Pointer extract = ExtractFilterType::New();
   RescaleFilterType::Pointer rescale = RescaleFilterType::New();
+  WindowingFilterType::Pointer windowing = WindowingFilterType::New();
+
+  //
+  // All the regions are served by the same reader, in file order, so
+  // that the volume is opened once and swept from front to back.
+  //
+  itk::RegionOfInterestList regions;
 
-  OutputImageType::IndexType start;
-  start[0] = atoi( argv[4] );
-  start[1] = atoi( argv[5] );
-  start[2] = atoi( argv[3] );
+  itk::StreamingCommandLineOptions options( argc, argv, 8 );
 
+  static const char * const validOptions[] = {
+    "--region",
+    "--region-list",
+    "--statistics",
+    NULL };
 
-  OutputImageType::SizeType size;
-  size[0] = atoi( argv[6] );
-  size[1] = atoi( argv[7] );
-  size[2] = 1; // one slice in Z
+  if( !options.CheckOptions( validOptions, std::cerr ) )
+    {
+    return EXIT_FAILURE;
+    }
 
-  OutputImageType::RegionType desiredRegion;
-  desiredRegion.SetSize(  size  );
-  desiredRegion.SetIndex( start );
+  regions.AddRegion( itk::RegionOfInterestList::ValuesType( argv + 2, argv + 8 ) );
 
-  extract->SetRegionOfInterest( desiredRegion );
+  for( unsigned int k = 0; k < options.GetNumberOfOccurrences("--region"); k++ )
+    {
+    if( !regions.AddRegion( options.GetOptionValues( "--region", k ) ) )
+      {
+      std::cerr << "--region needs six values" << std::endl;
+      return EXIT_FAILURE;
+      }
+    }
+
+  if( options.HasOption("--region-list") &&
+      !regions.ReadListFile( options.GetOptionValue("--region-list") ) )
+    {
+    std::cerr << "Could not read the region list "
+              << options.GetOptionValue("--region-list") << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  regions.Sort();
 
   ReaderType::Pointer reader = ReaderType::New();
   WriterType::Pointer writer = WriterType::New();
 
   const char * inputFilename  = argv[1];
-  const char * outputFilename = argv[2];
 
   reader->SetFileName( inputFilename  );
-  writer->SetFileName( outputFilename );
 
   rescale->SetOutputMinimum(  0  );
   rescale->SetOutputMaximum( 255 );
@@ -86,9 +122,46 @@ int main( int argc, char ** argv )
   rescale->SetInput( extract->GetOutput() );
   writer->SetInput( rescale->GetOutput() );
 
+  //
+  // The rescale filter scans every region for its range before writing
+  // a pixel. With the statistics sidecar of the volume, all the regions
+  // are instead mapped from the range of the whole volume, which is
+  // known without a pass over the pixels.
+  //
+  if( options.HasOption("--statistics") )
+    {
+    itk::BrickStatistics statistics;
+
+    try
+      {
+      statistics.Read( itk::BrickStatistics::GetSidecarFileName( inputFilename ) );
+      }
+    catch( itk::ExceptionObject & err )
+      {
+      std::cerr << err << std::endl;
+      return EXIT_FAILURE;
+      }
+
+    std::cout << "Window = " << statistics.GetMinimum()
+              << " " << statistics.GetMaximum() << std::endl;
+
+    windowing->SetWindowMinimum( static_cast< InputPixelType >( statistics.GetMinimum() ) );
+    windowing->SetWindowMaximum( static_cast< InputPixelType >( statistics.GetMaximum() ) );
+    windowing->SetOutputMinimum(  0  );
+    windowing->SetOutputMaximum( 255 );
+
+    windowing->SetInput( extract->GetOutput() );
+    writer->SetInput( windowing->GetOutput() );
+    }
+
   try
     {
-    writer->Update();
+    for( unsigned int k = 0; k < regions.GetNumberOfRegions(); k++ )
+      {
+      extract->SetRegionOfInterest( regions.GetRegion( k ) );
+      writer->SetFileName( regions.GetFileName( k ) );
+      writer->Update();
+      }
     }
   catch( itk::ExceptionObject & err )
     {
@@ -0,0 +1,205 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#include <iostream>
+
+#include "itkImage.h"
+#include "itkImageFileReader.h"
+#include "itkImageFileWriter.h"
+#include "itkShrinkImageFilter.h"
+#include "itkBrickedImageIO.h"
+#include "itkBrickedImageIOFactory.h"
+#include "itkBitPackedImageIOFactory.h"
+#include "itkFilterStreamingWatcher.h"
+#include "itkStreamingCommandLineOptions.h"
+#include "itkStreamingCommandLineSupport.h"
+
+#include "itkTimeProbesCollectorBase.h"
+
+//
+// Writes a coarse level of a volume, subsampled along X and Y only, so
+// that it keeps one slice per slice of the original. ImageDisplay shows
+// its slices while the full resolution ones are being read.
+//
+template< typename TPixel >
+int ShrinkImage( const std::string & inputImageFileName,
+                 const std::string & outputImageFileName,
+                 unsigned int shrinkFactor,
+                 unsigned int numberOfDataBlocks,
+                 bool compress,
+                 const itk::StreamingCommandLineOptions & options )
+{
+  const unsigned int Dimension = 3;
+
+  typedef itk::Image< TPixel, Dimension >     ImageType;
+
+  typedef itk::ImageFileReader< ImageType > ImageReaderType;
+  typedef itk::ImageFileWriter< ImageType > ImageWriterType;
+
+  typedef itk::ShrinkImageFilter< ImageType, ImageType > ShrinkFilterType;
+
+  typename ImageReaderType::Pointer reader = ImageReaderType::New();
+  typename ImageWriterType::Pointer writer = ImageWriterType::New();
+  typename ShrinkFilterType::Pointer shrinker = ShrinkFilterType::New();
+
+  reader->SetFileName( inputImageFileName );
+  writer->SetFileName( outputImageFileName );
+
+  shrinker->SetInput( reader->GetOutput() );
+  shrinker->SetShrinkFactor( 0, shrinkFactor );
+  shrinker->SetShrinkFactor( 1, shrinkFactor );
+  shrinker->SetShrinkFactor( 2, 1 );
+
+  writer->SetInput( shrinker->GetOutput() );
+  writer->SetNumberOfStreamDivisions( numberOfDataBlocks );
+
+  if( compress && !itk::BrickedImageIO::New()->CanWriteFile( outputImageFileName.c_str() ) )
+    {
+    std::cerr << "Compression needs a bricked (.bvol) output file" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  writer->SetUseCompression( compress );
+
+  itk::FilterStreamingWatcher watcher(shrinker, "shrinking");
+
+  // Per stream division timings, sizes and memory, for comparing runs.
+  if( options.HasOption("--metrics") )
+    {
+    watcher.SetMetricsFileName( options.GetOptionValue("--metrics") );
+    }
+
+  //
+  // Timeline of every stage and stream division, for a trace viewer.
+  //
+  itk::StreamingCommandLineSupport support( options );
+
+  support.WatchPipeline( writer );
+
+  itk::TimeProbesCollectorBase chronometer;
+
+  chronometer.Start("Shrinking");
+
+  try
+    {
+    writer->Update();
+    }
+  catch( itk::ExceptionObject & err )
+    {
+    std::cerr << err << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  chronometer.Stop("Shrinking");
+  chronometer.Report( std::cout );
+
+  if( !support.FinishRun() )
+    {
+    return EXIT_FAILURE;
+    }
+
+  return EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[])
+{
+  if ( argc < 5 )
+    {
+    std::cerr << "Missing Parameters " << std::endl;
+    std::cerr << "Usage: " << argv[0];
+    std::cerr << " inputImageFile  outputImageFile shrinkFactor numberOfDataBlocks" << std::endl;
+    std::cerr << " [--compress]" << std::endl;
+    std::cerr << " [--metrics metricsFile.json|metricsFile.csv]" << std::endl;
+    std::cerr << " [--trace traceFile.json]" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  itk::BrickedImageIOFactory::RegisterOneFactory();
+  itk::BitPackedImageIOFactory::RegisterOneFactory();
+
+  std::string inputImageFileName  = argv[1];
+  std::string outputImageFileName = argv[2];
+
+  unsigned int shrinkFactor = atoi( argv[3] );
+  unsigned int numberOfDataBlocks = atoi( argv[4] );
+
+  if( shrinkFactor < 1 )
+    {
+    std::cerr << "The shrink factor must be at least 1" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  itk::StreamingCommandLineOptions options( argc, argv, 5 );
+
+  static const char * const validOptions[] = {
+    "--compress",
+    "--metrics",
+    "--trace",
+    NULL };
+
+  if( !options.CheckOptions( validOptions, std::cerr ) )
+    {
+    return EXIT_FAILURE;
+    }
+
+  const bool compress = options.HasOption("--compress");
+
+  itk::ImageIOBase::Pointer imageIO = itk::ImageIOFactory::CreateImageIO(
+    inputImageFileName.c_str(), itk::ImageIOFactory::ReadMode);
+
+  if( imageIO.IsNull() )
+    {
+    std::cerr << "Could not create IO object for file " << inputImageFileName << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  try
+    {
+    imageIO->SetFileName( inputImageFileName );
+    imageIO->ReadImageInformation();
+    }
+  catch( itk::ExceptionObject & err )
+    {
+    std::cerr << err << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  switch( imageIO->GetComponentType() )
+    {
+    case itk::ImageIOBase::UCHAR:
+      return ShrinkImage< unsigned char >( inputImageFileName, outputImageFileName,
+                                           shrinkFactor, numberOfDataBlocks, compress,
+                                           options );
+    case itk::ImageIOBase::SHORT:
+      return ShrinkImage< signed short >( inputImageFileName, outputImageFileName,
+                                          shrinkFactor, numberOfDataBlocks, compress,
+                                          options );
+    case itk::ImageIOBase::USHORT:
+      return ShrinkImage< unsigned short >( inputImageFileName, outputImageFileName,
+                                            shrinkFactor, numberOfDataBlocks, compress,
+                                            options );
+    case itk::ImageIOBase::FLOAT:
+      return ShrinkImage< float >( inputImageFileName, outputImageFileName,
+                                   shrinkFactor, numberOfDataBlocks, compress,
+                                   options );
+    default:
+      std::cerr << "Unsupported pixel type "
+                << imageIO->GetComponentTypeAsString( imageIO->GetComponentType() )
+                << std::endl;
+      return EXIT_FAILURE;
+    }
+}
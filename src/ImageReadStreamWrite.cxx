@@ -22,6 +22,13 @@
 #include "itkImageFileReader.h"
 #include "itkImageFileWriter.h"
 #include "itkFilterStreamingWatcher.h"
+#include "itkReaderStreamingWatcher.h"
+#include "itkMemoryMappedImageFileReader.h"
+#include "itkStreamingCommandLineOptions.h"
+#include "itkStreamingCommandLineSupport.h"
+#include "itkBrickedImageIO.h"
+#include "itkBrickedImageIOFactory.h"
+#include "itkBitPackedImageIOFactory.h"
 
 #include "itkTimeProbesCollectorBase.h"
 
@@ -32,9 +39,20 @@ int main(int argc, char *argv[])
     std::cerr << "Missing Parameters " << std::endl;
     std::cerr << "Usage: " << argv[0];
     std::cerr << " inputImageFile  outputImageFile numberOfDataBlocks" << std::endl;
+    std::cerr << " [--mmap]" << std::endl;
+    std::cerr << " [--max-memory memoryBudget]" << std::endl;
+    std::cerr << " [--autotune [slabsPerCandidate]] [--autotune-cache cacheFile]" << std::endl;
+    std::cerr << " [--compress]" << std::endl;
+    std::cerr << " [--io-accounting]" << std::endl;
+    std::cerr << " [--metrics metricsFile.json|metricsFile.csv]" << std::endl;
+    std::cerr << " [--trace traceFile.json]" << std::endl;
+    std::cerr << " [--memory-budget memoryBudget|Nx[+overhead]]" << std::endl;
     return EXIT_FAILURE;
     }
 
+  itk::BrickedImageIOFactory::RegisterOneFactory();
+  itk::BitPackedImageIOFactory::RegisterOneFactory();
+
   typedef unsigned char                PixelType;
   const unsigned int Dimension = 3;
 
@@ -49,17 +67,130 @@ int main(int argc, char *argv[])
   std::string inputImageFileName  = argv[1];
   std::string outputImageFileName = argv[2];
 
-  const unsigned int numberOfDataBlocks = atoi( argv[3] );
+  itk::StreamingCommandLineOptions options( argc, argv, 4 );
+
+  static const char * const validOptions[] = {
+    "--mmap",
+    "--max-memory",
+    "--autotune",
+    "--autotune-cache",
+    "--compress",
+    "--io-accounting",
+    "--metrics",
+    "--trace",
+    "--memory-budget",
+    NULL };
+
+  if( !options.CheckOptions( validOptions, std::cerr ) )
+    {
+    return EXIT_FAILURE;
+    }
+
+  itk::StreamingCommandLineSupport support( options );
+
+  unsigned int numberOfDataBlocks = atoi( argv[3] );
+
+  //
+  // A memory budget, when given, overrides the number of data blocks.
+  //
+  itk::StreamingMemoryPlanner::Pointer planner = itk::StreamingMemoryPlanner::New();
+
+  planner->AddStage( "reader", sizeof( PixelType ) );
+
+  if( !support.PlanNumberOfStreamDivisions( planner, inputImageFileName,
+      outputImageFileName, sizeof( PixelType ), numberOfDataBlocks ) )
+    {
+    return EXIT_FAILURE;
+    }
 
   reader->SetFileName( inputImageFileName );
   writer->SetFileName( outputImageFileName );
 
+  //
+  // Bricked outputs can be compressed brick by brick while streaming.
+  //
+  const bool compress = options.HasOption("--compress");
+
+  if( compress && !itk::BrickedImageIO::New()->CanWriteFile( outputImageFileName.c_str() ) )
+    {
+    std::cerr << "Compression needs a bricked (.bvol) output file" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  writer->SetUseCompression( compress );
+
+  //
+  // Memory mapping hands out views into the raw data file,
+  // instead of reading every block into a new buffer.
+  //
+  typedef itk::MemoryMappedImageFileReader< ImageType > MappedReaderType;
+
+  MappedReaderType::Pointer mappedReader = MappedReaderType::New();
+
+  if( options.HasOption("--mmap") )
+    {
+    mappedReader->SetFileName( inputImageFileName );
+    writer->SetInput( mappedReader->GetOutput() );
+    }
+  else
+    {
+    writer->SetInput( reader->GetOutput() );
+    }
+
+  //
+  // Autotuning times a few data block counts on a sample of the input,
+  // and keeps the fastest one that fits the memory budget. The choice is
+  // cached for later runs on this machine and dataset.
+  //
+  if( !support.AutotuneNumberOfStreamDivisions(
+        options.HasOption("--mmap") ? mappedReader->GetOutput() : reader->GetOutput(),
+        itk::StreamDivisionAutotuner::GetFileSignature( inputImageFileName ) +
+        ( options.HasOption("--mmap") ? " mmap" : " read" ),
+        numberOfDataBlocks ) )
+    {
+    return EXIT_FAILURE;
+    }
+
   writer->SetNumberOfStreamDivisions( numberOfDataBlocks );
 
-  writer->SetInput( reader->GetOutput() );
+  //
+  // I/O of the process during every block read: rates, bytes from
+  // storage and page cache hits.
+  //
+  itk::ProcessObject * readingProcess = reader;
+
+  if( options.HasOption("--mmap") )
+    {
+    readingProcess = mappedReader;
+    }
+
+  itk::ReaderStreamingWatcher readerWatcher(
+    options.HasOption("--io-accounting") ? readingProcess : NULL );
+
+  //
+  // Per stream division timings, sizes and memory, for comparing runs.
+  // The reader runs once per stream division; the writer only once.
+  //
+  itk::FilterStreamingWatcher watcher(readingProcess, "stream reading");
+  watcher.SetRequireProgress( false );
+
+  if( options.HasOption("--metrics") )
+    {
+    watcher.SetMetricsFileName( options.GetOptionValue("--metrics") );
+    }
 
-  itk::FilterStreamingWatcher watcher(writer, "stream writing");
 
+  //
+  // With a declared memory budget, the run fails when its peak memory
+  // grows past it. The trace is the timeline of every stage and stream
+  // division, for a trace viewer.
+  //
+  if( !support.StartMemoryGuard( argv[1], numberOfDataBlocks ) )
+    {
+    return EXIT_FAILURE;
+    }
+
+  support.WatchPipeline( writer );
 
   itk::TimeProbesCollectorBase chronometer;
 
@@ -78,5 +209,10 @@ int main(int argc, char *argv[])
   chronometer.Stop("Filtering");
   chronometer.Report( std::cout );
 
+  if( !support.FinishRun() )
+    {
+    return EXIT_FAILURE;
+    }
+
   return EXIT_SUCCESS;
 }
@@ -0,0 +1,291 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include <iostream>
+#include <fstream>
+#include <cmath>
+#include <limits>
+
+#include "itkImage.h"
+#include "itkImageIOFactory.h"
+#include "itkStreamingImageStatistics.h"
+#include "itkStreamingCommandLineOptions.h"
+#include "itkStreamingCommandLineSupport.h"
+#include "itkBrickStatistics.h"
+#include "itkBrickedImageIOFactory.h"
+#include "itkBitPackedImageIOFactory.h"
+
+#include "itkTimeProbesCollectorBase.h"
+
+//
+// Streams through a volume and prints its minimum, maximum, mean,
+// variance and histogram. Integer volumes get one bin per gray level.
+// Float volumes get a number of bins over a range that is taken, in
+// this order, from the command line, from the brick statistics
+// sidecar of the volume, or from a first pass over the pixels.
+//
+template< typename TPixel >
+int ComputeStatistics( const std::string & inputImageFileName,
+                       unsigned int numberOfDataBlocks,
+                       const itk::StreamingCommandLineOptions & options,
+                       itk::StreamingCommandLineSupport & support )
+{
+  const unsigned int Dimension = 3;
+
+  typedef itk::Image< TPixel, Dimension >     ImageType;
+
+  typedef itk::StreamingImageStatistics< ImageType > StatisticsType;
+
+  typename StatisticsType::Pointer statistics = StatisticsType::New();
+
+  statistics->SetFileName( inputImageFileName );
+  statistics->SetNumberOfStreamDivisions( numberOfDataBlocks );
+
+  if( options.HasOption("--threads") )
+    {
+    statistics->SetNumberOfThreads( atoi( options.GetOptionValue("--threads").c_str() ) );
+    }
+
+  //
+  // With a declared memory budget, the run fails when its peak memory
+  // grows past it.
+  //
+  if( !support.StartMemoryGuard( inputImageFileName, numberOfDataBlocks ) )
+    {
+    return EXIT_FAILURE;
+    }
+
+  itk::TimeProbesCollectorBase chronometer;
+
+  try
+    {
+    if( std::numeric_limits< TPixel >::is_integer )
+      {
+      const double minimum = itk::NumericTraits< TPixel >::NonpositiveMin();
+      const double maximum = itk::NumericTraits< TPixel >::max();
+
+      statistics->SetHistogram( static_cast< unsigned int >( maximum - minimum + 1 ),
+                                minimum, maximum + 1 );
+      }
+    else
+      {
+      const unsigned int numberOfBins =
+        atoi( options.GetOptionValue( "--bins", "256" ).c_str() );
+
+      double minimum = 0.0;
+      double maximum = 0.0;
+
+      const std::string sidecarFileName =
+        itk::BrickStatistics::GetSidecarFileName( inputImageFileName );
+
+      if( options.HasOption("--histogram-range") )
+        {
+        itk::StreamingCommandLineOptions::ValuesType range = options.GetOptionValues( "--histogram-range" );
+        if( range.size() != 2 )
+          {
+          std::cerr << "--histogram-range needs two values" << std::endl;
+          return EXIT_FAILURE;
+          }
+        minimum = atof( range[0].c_str() );
+        maximum = atof( range[1].c_str() );
+        }
+      else if( std::ifstream( sidecarFileName.c_str() ).good() )
+        {
+        itk::BrickStatistics brickStatistics;
+        brickStatistics.Read( sidecarFileName );
+        minimum = brickStatistics.GetMinimum();
+        maximum = brickStatistics.GetMaximum();
+        }
+      else
+        {
+        chronometer.Start("Range");
+        statistics->Update();
+        chronometer.Stop("Range");
+
+        minimum = statistics->GetMinimum();
+        maximum = statistics->GetMaximum();
+        }
+
+      //
+      // The maximum itself falls in the last bin, which is clamped.
+      //
+      if( !( maximum > minimum ) )
+        {
+        maximum = minimum + 1.0;
+        }
+
+      statistics->SetHistogram( numberOfBins, minimum, maximum );
+      }
+
+    chronometer.Start("Statistics");
+    statistics->Update();
+    chronometer.Stop("Statistics");
+    }
+  catch( itk::ExceptionObject & err )
+    {
+    std::cerr << err << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  std::cout << "Count = " << statistics->GetCount() << std::endl;
+  std::cout << "Minimum = " << statistics->GetMinimum() << std::endl;
+  std::cout << "Maximum = " << statistics->GetMaximum() << std::endl;
+  std::cout << "Mean = " << statistics->GetMean() << std::endl;
+  std::cout << "Variance = " << statistics->GetVariance() << std::endl;
+  std::cout << "StandardDeviation = " << std::sqrt( statistics->GetVariance() ) << std::endl;
+
+  //
+  // The histogram goes to a file with all the bins, or to the
+  // console with only the bins that are not empty.
+  //
+  const typename StatisticsType::HistogramType & histogram = statistics->GetHistogram();
+
+  if( options.HasOption("--histogram-file") )
+    {
+    std::ofstream histogramFile( options.GetOptionValue("--histogram-file").c_str() );
+
+    if( !histogramFile )
+      {
+      std::cerr << "Could not write " << options.GetOptionValue("--histogram-file") << std::endl;
+      return EXIT_FAILURE;
+      }
+
+    histogramFile.precision( 17 );
+    for( unsigned int b = 0; b < histogram.size(); b++ )
+      {
+      histogramFile << statistics->GetBinMinimum( b ) << " " << histogram[b] << std::endl;
+      }
+    }
+  else
+    {
+    std::cout << "Histogram = " << std::endl;
+    for( unsigned int b = 0; b < histogram.size(); b++ )
+      {
+      if( histogram[b] > 0 )
+        {
+        std::cout << "  " << statistics->GetBinMinimum( b ) << " " << histogram[b] << std::endl;
+        }
+      }
+    }
+
+  chronometer.Report( std::cout );
+
+  if( !support.FinishRun() )
+    {
+    return EXIT_FAILURE;
+    }
+
+  return EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[])
+{
+  if ( argc < 3 )
+    {
+    std::cerr << "Missing Parameters " << std::endl;
+    std::cerr << "Usage: " << argv[0];
+    std::cerr << " inputImageFile numberOfDataBlocks" << std::endl;
+    std::cerr << " [--max-memory memoryBudget]" << std::endl;
+    std::cerr << " [--threads numberOfThreads]" << std::endl;
+    std::cerr << " [--bins numberOfBins]" << std::endl;
+    std::cerr << " [--histogram-range minimum maximum]" << std::endl;
+    std::cerr << " [--histogram-file histogramFile]" << std::endl;
+    std::cerr << " [--memory-budget memoryBudget|Nx[+overhead]]" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  itk::BrickedImageIOFactory::RegisterOneFactory();
+  itk::BitPackedImageIOFactory::RegisterOneFactory();
+
+  std::string inputImageFileName  = argv[1];
+
+  unsigned int numberOfDataBlocks = atoi( argv[2] );
+
+  itk::StreamingCommandLineOptions options( argc, argv, 3 );
+
+  static const char * const validOptions[] = {
+    "--threads",
+    "--memory-budget",
+    "--bins",
+    "--histogram-range",
+    "--histogram-file",
+    "--max-memory",
+    NULL };
+
+  if( !options.CheckOptions( validOptions, std::cerr ) )
+    {
+    return EXIT_FAILURE;
+    }
+
+  itk::StreamingCommandLineSupport support( options );
+
+  itk::ImageIOBase::Pointer imageIO = itk::ImageIOFactory::CreateImageIO(
+    inputImageFileName.c_str(), itk::ImageIOFactory::ReadMode);
+
+  if( imageIO.IsNull() )
+    {
+    std::cerr << "Could not create IO object for file " << inputImageFileName << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  try
+    {
+    imageIO->SetFileName( inputImageFileName );
+    imageIO->ReadImageInformation();
+    }
+  catch( itk::ExceptionObject & err )
+    {
+    std::cerr << err << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  //
+  // A memory budget, when given, overrides the number of data blocks.
+  // The next block is read while the current one is reduced.
+  //
+  itk::StreamingMemoryPlanner::Pointer planner = itk::StreamingMemoryPlanner::New();
+
+  planner->AddStage( "reader", imageIO->GetComponentSize() );
+  planner->SetNumberOfConcurrentChunks( 2 );
+
+  if( !support.PlanNumberOfStreamDivisions( planner, inputImageFileName, numberOfDataBlocks ) )
+    {
+    return EXIT_FAILURE;
+    }
+
+  switch( imageIO->GetComponentType() )
+    {
+    case itk::ImageIOBase::UCHAR:
+      return ComputeStatistics< unsigned char >( inputImageFileName,
+                                                 numberOfDataBlocks, options, support );
+    case itk::ImageIOBase::SHORT:
+      return ComputeStatistics< signed short >( inputImageFileName,
+                                                numberOfDataBlocks, options, support );
+    case itk::ImageIOBase::USHORT:
+      return ComputeStatistics< unsigned short >( inputImageFileName,
+                                                  numberOfDataBlocks, options, support );
+    case itk::ImageIOBase::FLOAT:
+      return ComputeStatistics< float >( inputImageFileName,
+                                         numberOfDataBlocks, options, support );
+    default:
+      std::cerr << "Unsupported pixel type "
+                << imageIO->GetComponentTypeAsString( imageIO->GetComponentType() )
+                << std::endl;
+      return EXIT_FAILURE;
+    }
+}
@@ -21,6 +21,8 @@
 #include "itkImageFileReader.h"
 #include "itkShrinkImageFilter.h"
 #include "itkImageRegionExclusionIteratorWithIndex.h"
+#include "itkBrickedImageIOFactory.h"
+#include "itkBitPackedImageIOFactory.h"
 
 #include "vtkSmartPointer.h"
 #include "vtkImageData.h"
@@ -72,6 +74,9 @@ int main(int argc, char * argv [] )
     return EXIT_FAILURE;
     }
 
+  itk::BrickedImageIOFactory::RegisterOneFactory();
+  itk::BitPackedImageIOFactory::RegisterOneFactory();
+
   // Run the interactor event loop if -I is specified.
   bool interactive = false;
   for (int i = 0; i < argc; i++)
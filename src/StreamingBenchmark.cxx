@@ -0,0 +1,759 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <map>
+#include <string>
+#include <vector>
+#include <utility>
+
+#include "itkImage.h"
+#include "itkImageFileReader.h"
+#include "itkImageFileWriter.h"
+#include "itkFastBinaryThresholdImageFilter.h"
+#include "itkVotingBinaryHoleFillingImageFilter.h"
+#include "itkSubtractImageFilter.h"
+#include "itkSyntheticTrabecularImageSource.h"
+#include "itkMultiThreader.h"
+#include "itkRealTimeClock.h"
+#include "itkProcessResourceUsage.h"
+#include "itkStreamingCommandLineOptions.h"
+#include "itkBrickedImageIOFactory.h"
+#include "itkBitPackedImageIOFactory.h"
+
+//
+// Runs the pipelines of the streaming tools over synthetic volumes, for
+// a sweep of volume sizes, pixel types, stream division counts and
+// thread counts, and writes the wall time, throughput, peak memory and
+// time of every stage of each run to a report. A report from another
+// build or machine can be given as a baseline, and the runs that got
+// slower or larger than the tolerance are flagged.
+//
+
+//
+// Accumulates the time between the start and end events of every stage.
+// A filter ends before its consumer starts, so the time of a filter does
+// not include the time of its inputs. The writer is the exception: it
+// starts first and ends last, and its own time is what is left once the
+// time of the other stages is taken out.
+//
+class StageTimer
+{
+public:
+  typedef std::vector< std::pair< std::string, double > > StageTimesType;
+
+  StageTimer()
+  {
+    m_Clock = itk::RealTimeClock::New();
+  }
+
+  void Watch( itk::ProcessObject * process, const std::string & name )
+  {
+    m_Processes.push_back( process );
+    m_Names.push_back( name );
+    m_Starts.push_back( 0.0 );
+    m_Totals.push_back( 0.0 );
+
+    itk::MemberCommand< StageTimer >::Pointer command = itk::MemberCommand< StageTimer >::New();
+    command->SetCallbackFunction( this, &StageTimer::RecordEvent );
+
+    process->AddObserver( itk::StartEvent(), command );
+    process->AddObserver( itk::EndEvent(), command );
+  }
+
+  /** Time of every stage, with the last watched stage being the writer. */
+  StageTimesType GetStageTimes() const
+  {
+    StageTimesType times;
+
+    double upstream = 0.0;
+    for( size_t k = 0; k + 1 < m_Totals.size(); k++ )
+      {
+      times.push_back( std::make_pair( m_Names[k], m_Totals[k] ) );
+      upstream += m_Totals[k];
+      }
+
+    if( !m_Totals.empty() )
+      {
+      const double writer = m_Totals.back() - upstream;
+      times.push_back( std::make_pair( m_Names.back(), writer > 0.0 ? writer : 0.0 ) );
+      }
+
+    return times;
+  }
+
+private:
+  void RecordEvent( itk::Object * caller, const itk::EventObject & event )
+  {
+    for( size_t k = 0; k < m_Processes.size(); k++ )
+      {
+      if( m_Processes[k] == caller )
+        {
+        const double now = m_Clock->GetTimeInSeconds();
+
+        if( itk::StartEvent().CheckEvent( &event ) )
+          {
+          m_Starts[k] = now;
+          }
+        else
+          {
+          m_Totals[k] += now - m_Starts[k];
+          }
+        }
+      }
+    }
+
+  itk::RealTimeClock::Pointer         m_Clock;
+  std::vector< itk::ProcessObject * > m_Processes;
+  std::vector< std::string >          m_Names;
+  std::vector< double >               m_Starts;
+  std::vector< double >               m_Totals;
+};
+
+//
+// One configuration of the sweep and its measurements.
+//
+struct BenchmarkResult
+{
+  std::string               Pipeline;
+  std::string               PixelType;
+  unsigned int              Size;
+  unsigned int              Divisions;
+  unsigned int              Threads;
+  double                    WallTime;
+  double                    Throughput;
+  itk::SizeValueType        PeakResidentSetSize;
+  StageTimer::StageTimesType  Stages;
+
+  std::string GetKey() const
+  {
+    std::ostringstream key;
+    key << Pipeline << " " << PixelType << " " << Size << " "
+        << Divisions << " " << Threads;
+    return key.str();
+  }
+};
+
+typedef std::vector< BenchmarkResult >              ResultListType;
+typedef std::map< std::string, BenchmarkResult >    ResultMapType;
+
+template< typename TImage >
+void WriteImage( TImage * image, const std::string & fileName,
+                 unsigned int numberOfDataBlocks, StageTimer & timer )
+{
+  typedef itk::ImageFileWriter< TImage > WriterType;
+
+  typename WriterType::Pointer writer = WriterType::New();
+  writer->SetInput( image );
+  writer->SetFileName( fileName );
+  writer->SetNumberOfStreamDivisions( numberOfDataBlocks );
+
+  timer.Watch( writer, "writer" );
+
+  writer->Update();
+}
+
+//
+// The pipelines of ImageReadStreamWrite, BinaryThreshold*ImageFilter,
+// VotingBinaryHoleFillingImageFilter (after thresholding the input) and
+// SubtractImageFilter.
+//
+template< typename TPixel >
+void RunPipeline( const std::string & pipeline,
+                  const std::string & inputFileName,
+                  const std::string & outputFileName,
+                  unsigned int numberOfDataBlocks,
+                  unsigned int numberOfThreads,
+                  StageTimer & timer )
+{
+  const unsigned int Dimension = 3;
+
+  typedef itk::Image< TPixel, Dimension >         InputImageType;
+  typedef itk::Image< unsigned char, Dimension >  MaskImageType;
+
+  typedef itk::ImageFileReader< InputImageType >  ReaderType;
+
+  typedef itk::FastBinaryThresholdImageFilter<
+    InputImageType, MaskImageType >               ThresholdFilterType;
+  typedef itk::VotingBinaryHoleFillingImageFilter<
+    MaskImageType, MaskImageType >                VotingFilterType;
+  typedef itk::SubtractImageFilter<
+    InputImageType, InputImageType, InputImageType >  SubtractFilterType;
+
+  typename ReaderType::Pointer reader = ReaderType::New();
+  reader->SetFileName( inputFileName );
+  timer.Watch( reader, "reader" );
+
+  if( pipeline == "read-write" )
+    {
+    WriteImage< InputImageType >( reader->GetOutput(), outputFileName, numberOfDataBlocks, timer );
+    return;
+    }
+
+  if( pipeline == "subtract" )
+    {
+    typename ReaderType::Pointer secondReader = ReaderType::New();
+    secondReader->SetFileName( inputFileName );
+    timer.Watch( secondReader, "second reader" );
+
+    typename SubtractFilterType::Pointer subtract = SubtractFilterType::New();
+    subtract->SetInput1( reader->GetOutput() );
+    subtract->SetInput2( secondReader->GetOutput() );
+    subtract->SetNumberOfThreads( numberOfThreads );
+    timer.Watch( subtract, "subtract" );
+
+    WriteImage< InputImageType >( subtract->GetOutput(), outputFileName, numberOfDataBlocks, timer );
+    return;
+    }
+
+  //
+  // Halfway between the marrow and bone values of the synthetic volumes.
+  //
+  typename ThresholdFilterType::Pointer threshold = ThresholdFilterType::New();
+  threshold->SetInput( reader->GetOutput() );
+  threshold->SetLowerThreshold( static_cast< TPixel >( 120 ) );
+  threshold->SetUpperThreshold( itk::NumericTraits< TPixel >::max() );
+  threshold->SetInsideValue( 255 );
+  threshold->SetOutsideValue( 0 );
+  threshold->SetNumberOfThreads( numberOfThreads );
+  timer.Watch( threshold, "threshold" );
+
+  if( pipeline == "threshold" )
+    {
+    WriteImage< MaskImageType >( threshold->GetOutput(), outputFileName, numberOfDataBlocks, timer );
+    return;
+    }
+
+  if( pipeline == "voting" )
+    {
+    typename MaskImageType::SizeType radius;
+    radius.Fill( 1 );
+
+    typename VotingFilterType::Pointer voting = VotingFilterType::New();
+    voting->SetInput( threshold->GetOutput() );
+    voting->SetRadius( radius );
+    voting->SetBackgroundValue( 0 );
+    voting->SetForegroundValue( 255 );
+    voting->SetMajorityThreshold( 1 );
+    voting->SetNumberOfThreads( numberOfThreads );
+    timer.Watch( voting, "voting" );
+
+    WriteImage< MaskImageType >( voting->GetOutput(), outputFileName, numberOfDataBlocks, timer );
+    return;
+    }
+
+  itkGenericExceptionMacro("Unknown pipeline " << pipeline);
+}
+
+//
+// Synthetic input volumes are generated once, and kept in the working
+// directory for later sweeps. The same seed always gives the same file.
+//
+template< typename TPixel >
+void GenerateInput( const std::string & fileName, unsigned int size )
+{
+  if( std::ifstream( fileName.c_str() ).good() )
+    {
+    return;
+    }
+
+  typedef itk::Image< TPixel, 3 >                           ImageType;
+  typedef itk::SyntheticTrabecularImageSource< ImageType >  SourceType;
+  typedef itk::ImageFileWriter< ImageType >                 WriterType;
+
+  typename SourceType::SizeType volumeSize;
+  volumeSize.Fill( size );
+
+  typename SourceType::Pointer source = SourceType::New();
+  source->SetSize( volumeSize );
+
+  typename WriterType::Pointer writer = WriterType::New();
+  writer->SetInput( source->GetOutput() );
+  writer->SetFileName( fileName );
+  writer->SetNumberOfStreamDivisions( 8 );
+
+  std::cout << "Generating " << fileName << std::endl;
+
+  writer->Update();
+}
+
+template< typename TPixel >
+BenchmarkResult RunBenchmark( const std::string & workingDirectory,
+                              const std::string & pipeline,
+                              const std::string & pixelType,
+                              unsigned int size,
+                              unsigned int numberOfDataBlocks,
+                              unsigned int numberOfThreads,
+                              unsigned int repetitions )
+{
+  std::ostringstream inputFileName;
+  inputFileName << workingDirectory << "/BenchmarkInput_" << pixelType << "_" << size << ".mhd";
+
+  const std::string outputFileName = workingDirectory + "/BenchmarkOutput.mhd";
+
+  GenerateInput< TPixel >( inputFileName.str(), size );
+
+  itk::RealTimeClock::Pointer clock = itk::RealTimeClock::New();
+
+  BenchmarkResult best;
+  best.Pipeline = pipeline;
+  best.PixelType = pixelType;
+  best.Size = size;
+  best.Divisions = numberOfDataBlocks;
+  best.Threads = numberOfThreads;
+  best.WallTime = 0.0;
+  best.Throughput = 0.0;
+  best.PeakResidentSetSize = 0;
+
+  const double megabytes =
+    static_cast< double >( size ) * size * size * sizeof( TPixel ) / ( 1024.0 * 1024.0 );
+
+  //
+  // The fastest repetition is kept, which is the least disturbed by the
+  // rest of the machine.
+  //
+  for( unsigned int r = 0; r < repetitions; r++ )
+    {
+    StageTimer timer;
+
+    itk::ProcessResourceUsage::ResetPeakResidentSetSize();
+
+    const double start = clock->GetTimeInSeconds();
+
+    RunPipeline< TPixel >( pipeline, inputFileName.str(), outputFileName,
+                           numberOfDataBlocks, numberOfThreads, timer );
+
+    const double wallTime = clock->GetTimeInSeconds() - start;
+
+    if( r == 0 || wallTime < best.WallTime )
+      {
+      best.WallTime = wallTime;
+      best.Throughput = wallTime > 0.0 ? megabytes / wallTime : 0.0;
+      best.PeakResidentSetSize = itk::ProcessResourceUsage::GetPeakResidentSetSize();
+      best.Stages = timer.GetStageTimes();
+      }
+    }
+
+  return best;
+}
+
+void WriteReport( const std::string & fileName, const ResultListType & results )
+{
+  std::ofstream file( fileName.c_str() );
+
+  if( !file )
+    {
+    itkGenericExceptionMacro("Could not write report " << fileName);
+    }
+
+  file.precision( 9 );
+
+  const std::string::size_type dot = fileName.rfind('.');
+  const bool json = ( dot != std::string::npos && fileName.substr( dot ) == ".json" );
+
+  if( json )
+    {
+    file << "{\"results\": [" << std::endl;
+    }
+  else
+    {
+    file << "pipeline,pixel_type,size,divisions,threads,"
+         << "wall_seconds,throughput_mb_per_second,peak_rss_bytes,stages" << std::endl;
+    }
+
+  //
+  // One result per line in both formats, which is how they are read back.
+  //
+  for( size_t k = 0; k < results.size(); k++ )
+    {
+    const BenchmarkResult & result = results[k];
+
+    if( json )
+      {
+      file << "{\"pipeline\": \"" << result.Pipeline << "\""
+           << ", \"pixel_type\": \"" << result.PixelType << "\""
+           << ", \"size\": " << result.Size
+           << ", \"divisions\": " << result.Divisions
+           << ", \"threads\": " << result.Threads
+           << ", \"wall_seconds\": " << result.WallTime
+           << ", \"throughput_mb_per_second\": " << result.Throughput
+           << ", \"peak_rss_bytes\": " << result.PeakResidentSetSize
+           << ", \"stages\": {";
+      for( size_t s = 0; s < result.Stages.size(); s++ )
+        {
+        file << ( s > 0 ? ", " : "" ) << "\"" << result.Stages[s].first << "\": "
+             << result.Stages[s].second;
+        }
+      file << "}}" << ( k + 1 < results.size() ? "," : "" ) << std::endl;
+      }
+    else
+      {
+      file << result.Pipeline << "," << result.PixelType << "," << result.Size << ","
+           << result.Divisions << "," << result.Threads << ","
+           << result.WallTime << "," << result.Throughput << ","
+           << result.PeakResidentSetSize << ",";
+      for( size_t s = 0; s < result.Stages.size(); s++ )
+        {
+        file << ( s > 0 ? ";" : "" ) << result.Stages[s].first << ":"
+             << result.Stages[s].second;
+        }
+      file << std::endl;
+      }
+    }
+
+  if( json )
+    {
+    file << "]}" << std::endl;
+    }
+}
+
+//
+// Value of a field of a result written by WriteReport as a JSON line.
+//
+std::string GetJsonField( const std::string & line, const std::string & name )
+{
+  const std::string key = "\"" + name + "\": ";
+
+  std::string::size_type begin = line.find( key );
+
+  if( begin == std::string::npos )
+    {
+    return "";
+    }
+
+  begin += key.size();
+
+  if( line[begin] == '"' )
+    {
+    return line.substr( begin + 1, line.find( '"', begin + 1 ) - begin - 1 );
+    }
+
+  return line.substr( begin, line.find_first_of( ",}", begin ) - begin );
+}
+
+//
+// The fields of the results of a report written by WriteReport, either
+// as JSON or as CSV. The stage times are not read back.
+//
+ResultMapType ReadReport( const std::string & fileName )
+{
+  std::ifstream file( fileName.c_str() );
+
+  if( !file )
+    {
+    itkGenericExceptionMacro("Could not read report " << fileName);
+    }
+
+  const std::string::size_type dot = fileName.rfind('.');
+  const bool json = ( dot != std::string::npos && fileName.substr( dot ) == ".json" );
+
+  ResultMapType results;
+
+  std::string line;
+
+  if( !json )
+    {
+    std::getline( file, line ); // Header
+    }
+
+  while( std::getline( file, line ) )
+    {
+    std::vector< std::string > fields;
+
+    if( json )
+      {
+      if( line.find( "\"pipeline\"" ) == std::string::npos )
+        {
+        continue;
+        }
+
+      const char * names[] = { "pipeline", "pixel_type", "size", "divisions", "threads",
+                               "wall_seconds", "throughput_mb_per_second", "peak_rss_bytes" };
+      for( unsigned int f = 0; f < 8; f++ )
+        {
+        fields.push_back( GetJsonField( line, names[f] ) );
+        }
+      }
+    else
+      {
+      std::istringstream stream( line );
+      std::string field;
+      while( std::getline( stream, field, ',' ) )
+        {
+        fields.push_back( field );
+        }
+      }
+
+    if( fields.size() < 8 )
+      {
+      continue;
+      }
+
+    BenchmarkResult result;
+    result.Pipeline = fields[0];
+    result.PixelType = fields[1];
+    result.Size = atoi( fields[2].c_str() );
+    result.Divisions = atoi( fields[3].c_str() );
+    result.Threads = atoi( fields[4].c_str() );
+    result.WallTime = atof( fields[5].c_str() );
+    result.Throughput = atof( fields[6].c_str() );
+    result.PeakResidentSetSize =
+      static_cast< itk::SizeValueType >( atof( fields[7].c_str() ) );
+
+    results[result.GetKey()] = result;
+    }
+
+  return results;
+}
+
+//
+// Prints every run next to its baseline, and returns the number of runs
+// whose wall time or peak memory grew by more than the tolerance.
+//
+unsigned int CompareWithBaseline( const ResultListType & results,
+                                  const ResultMapType & baseline,
+                                  double tolerance )
+{
+  unsigned int regressions = 0;
+
+  for( size_t k = 0; k < results.size(); k++ )
+    {
+    const BenchmarkResult & result = results[k];
+
+    ResultMapType::const_iterator reference = baseline.find( result.GetKey() );
+
+    std::cout << result.GetKey() << ": ";
+
+    if( reference == baseline.end() )
+      {
+      std::cout << "not in the baseline" << std::endl;
+      continue;
+      }
+
+    const double timeChange = reference->second.WallTime > 0.0 ?
+      result.WallTime / reference->second.WallTime - 1.0 : 0.0;
+    const double memoryChange = reference->second.PeakResidentSetSize > 0 ?
+      static_cast< double >( result.PeakResidentSetSize ) /
+      reference->second.PeakResidentSetSize - 1.0 : 0.0;
+
+    const bool slower = timeChange > tolerance;
+    const bool larger = memoryChange > tolerance;
+
+    std::cout << result.WallTime << " s (" << ( timeChange >= 0.0 ? "+" : "" )
+              << 100.0 * timeChange << "%), "
+              << result.PeakResidentSetSize / ( 1024.0 * 1024.0 ) << " MiB ("
+              << ( memoryChange >= 0.0 ? "+" : "" ) << 100.0 * memoryChange << "%)";
+
+    if( slower || larger )
+      {
+      std::cout << " REGRESSION";
+      regressions++;
+      }
+
+    std::cout << std::endl;
+    }
+
+  return regressions;
+}
+
+std::vector< unsigned int > GetNumbers( const itk::StreamingCommandLineOptions & options,
+                                        const std::string & name,
+                                        const std::vector< unsigned int > & defaults )
+{
+  if( !options.HasOption( name ) )
+    {
+    return defaults;
+    }
+
+  const itk::StreamingCommandLineOptions::ValuesType values = options.GetOptionValues( name );
+
+  std::vector< unsigned int > numbers;
+  for( size_t i = 0; i < values.size(); i++ )
+    {
+    numbers.push_back( atoi( values[i].c_str() ) );
+    }
+
+  return numbers;
+}
+
+int main(int argc, char *argv[])
+{
+  if ( argc < 3 )
+    {
+    std::cerr << "Missing Parameters " << std::endl;
+    std::cerr << "Usage: " << argv[0];
+    std::cerr << " workingDirectory reportFile.csv|reportFile.json" << std::endl;
+    std::cerr << " [--sizes edge ...]" << std::endl;
+    std::cerr << " [--pixel-types uchar float]" << std::endl;
+    std::cerr << " [--pipelines read-write threshold voting subtract]" << std::endl;
+    std::cerr << " [--divisions numberOfDataBlocks ...]" << std::endl;
+    std::cerr << " [--threads numberOfThreads ...]" << std::endl;
+    std::cerr << " [--repetitions numberOfRepetitions]" << std::endl;
+    std::cerr << " [--baseline baselineReport] [--tolerance fraction]" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  itk::BrickedImageIOFactory::RegisterOneFactory();
+  itk::BitPackedImageIOFactory::RegisterOneFactory();
+
+  const std::string workingDirectory = argv[1];
+  const std::string reportFileName = argv[2];
+
+  itk::StreamingCommandLineOptions options( argc, argv, 3 );
+
+  static const char * const validOptions[] = {
+    "--sizes",
+    "--pixel-types",
+    "--pipelines",
+    "--divisions",
+    "--threads",
+    "--repetitions",
+    "--baseline",
+    "--tolerance",
+    NULL };
+
+  if( !options.CheckOptions( validOptions, std::cerr ) )
+    {
+    return EXIT_FAILURE;
+    }
+
+  std::vector< unsigned int > defaultSizes;
+  defaultSizes.push_back( 128 );
+  defaultSizes.push_back( 256 );
+
+  std::vector< unsigned int > defaultDivisions;
+  defaultDivisions.push_back( 1 );
+  defaultDivisions.push_back( 4 );
+  defaultDivisions.push_back( 16 );
+
+  std::vector< unsigned int > defaultThreads;
+  defaultThreads.push_back( 1 );
+  if( itk::MultiThreader::GetGlobalDefaultNumberOfThreads() > 1 )
+    {
+    defaultThreads.push_back( itk::MultiThreader::GetGlobalDefaultNumberOfThreads() );
+    }
+
+  const std::vector< unsigned int > sizes = GetNumbers( options, "--sizes", defaultSizes );
+  const std::vector< unsigned int > divisions = GetNumbers( options, "--divisions", defaultDivisions );
+  const std::vector< unsigned int > threads = GetNumbers( options, "--threads", defaultThreads );
+
+  itk::StreamingCommandLineOptions::ValuesType pixelTypes;
+  pixelTypes.push_back( "uchar" );
+  pixelTypes.push_back( "float" );
+
+  if( options.HasOption("--pixel-types") )
+    {
+    pixelTypes = options.GetOptionValues("--pixel-types");
+    }
+
+  itk::StreamingCommandLineOptions::ValuesType pipelines;
+  pipelines.push_back( "read-write" );
+  pipelines.push_back( "threshold" );
+  pipelines.push_back( "voting" );
+  pipelines.push_back( "subtract" );
+
+  if( options.HasOption("--pipelines") )
+    {
+    pipelines = options.GetOptionValues("--pipelines");
+    }
+
+  const unsigned int repetitions =
+    atoi( options.GetOptionValue( "--repetitions", "3" ).c_str() );
+
+  ResultListType results;
+
+  try
+    {
+    for( size_t p = 0; p < pipelines.size(); p++ )
+      {
+      for( size_t t = 0; t < pixelTypes.size(); t++ )
+        {
+        if( pixelTypes[t] != "uchar" && pixelTypes[t] != "float" )
+          {
+          std::cerr << "Unsupported pixel type " << pixelTypes[t] << std::endl;
+          return EXIT_FAILURE;
+          }
+
+        for( size_t s = 0; s < sizes.size(); s++ )
+          {
+          for( size_t d = 0; d < divisions.size(); d++ )
+            {
+            for( size_t n = 0; n < threads.size(); n++ )
+              {
+              BenchmarkResult result;
+
+              if( pixelTypes[t] == "uchar" )
+                {
+                result = RunBenchmark< unsigned char >( workingDirectory, pipelines[p],
+                  pixelTypes[t], sizes[s], divisions[d], threads[n], repetitions );
+                }
+              else
+                {
+                result = RunBenchmark< float >( workingDirectory, pipelines[p],
+                  pixelTypes[t], sizes[s], divisions[d], threads[n], repetitions );
+                }
+
+              std::cout << result.GetKey() << ": " << result.WallTime << " s, "
+                        << result.Throughput << " MB/s, "
+                        << result.PeakResidentSetSize / ( 1024.0 * 1024.0 ) << " MiB peak"
+                        << std::endl;
+
+              results.push_back( result );
+              }
+            }
+          }
+        }
+      }
+
+    WriteReport( reportFileName, results );
+    }
+  catch( itk::ExceptionObject & err )
+    {
+    std::cerr << err << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  if( options.HasOption("--baseline") )
+    {
+    const double tolerance = atof( options.GetOptionValue( "--tolerance", "0.1" ).c_str() );
+
+    unsigned int regressions = 0;
+
+    try
+      {
+      regressions = CompareWithBaseline( results,
+        ReadReport( options.GetOptionValue("--baseline") ), tolerance );
+      }
+    catch( itk::ExceptionObject & err )
+      {
+      std::cerr << err << std::endl;
+      return EXIT_FAILURE;
+      }
+
+    if( regressions > 0 )
+      {
+      std::cerr << regressions << " runs regressed by more than "
+                << 100.0 * tolerance << "%" << std::endl;
+      return EXIT_FAILURE;
+      }
+    }
+
+  return EXIT_SUCCESS;
+}
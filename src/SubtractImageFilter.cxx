@@ -15,10 +15,19 @@
  *  limitations under the License.
  *
  *=========================================================================*/
+#include <algorithm>
+
 #include "itkImageFileReader.h"
 #include "itkImageFileWriter.h"
 #include "itkFilterStreamingWatcher.h"
+#include "itkOverlappedStreamingDriver.h"
+#include "itkConcurrentChunkStreamingDriver.h"
+#include "itkStreamingCommandLineOptions.h"
+#include "itkStreamingCommandLineSupport.h"
 #include "itkSubtractImageFilter.h"
+#include "itkBrickedImageIO.h"
+#include "itkBrickedImageIOFactory.h"
+#include "itkBitPackedImageIOFactory.h"
 #include "itkTimeProbesCollectorBase.h"
 
 int main(int argc, char * argv[])
@@ -28,9 +37,20 @@ int main(int argc, char * argv[])
     std::cerr << "Missing Parameters " << std::endl;
     std::cerr << "Usage: " << argv[0];
     std::cerr << " InputImage1 InputImage2 OutputImage numberOfDataBlocks" << std::endl;
+    std::cerr << " [--chunks-in-flight maximumNumberOfChunksInFlight]" << std::endl;
+    std::cerr << " [--workers numberOfWorkers]" << std::endl;
+    std::cerr << " [--max-memory memoryBudget]" << std::endl;
+    std::cerr << " [--autotune [slabsPerCandidate]] [--autotune-cache cacheFile]" << std::endl;
+    std::cerr << " [--compress]" << std::endl;
+    std::cerr << " [--metrics metricsFile.json|metricsFile.csv]" << std::endl;
+    std::cerr << " [--trace traceFile.json]" << std::endl;
+    std::cerr << " [--memory-budget memoryBudget|Nx[+overhead]]" << std::endl;
     return EXIT_FAILURE;
     }
 
+  itk::BrickedImageIOFactory::RegisterOneFactory();
+  itk::BitPackedImageIOFactory::RegisterOneFactory();
+
   const unsigned int Dimension = 3;
 
   typedef unsigned char  InputPixelType;
@@ -63,17 +83,195 @@ int main(int argc, char * argv[])
   writer->SetInput( filter->GetOutput() );
   writer->SetFileName( argv[3] );
 
-  const unsigned int numberOfDataBlocks = atoi( argv[4] );
+  itk::StreamingCommandLineOptions options( argc, argv, 5 );
+
+  static const char * const validOptions[] = {
+    "--chunks-in-flight",
+    "--workers",
+    "--max-memory",
+    "--autotune",
+    "--autotune-cache",
+    "--compress",
+    "--metrics",
+    "--trace",
+    "--memory-budget",
+    NULL };
+
+  if( !options.CheckOptions( validOptions, std::cerr ) )
+    {
+    return EXIT_FAILURE;
+    }
+
+  itk::StreamingCommandLineSupport support( options );
+
+  //
+  // Per stream division timings, sizes and memory, for comparing runs.
+  //
+  if( options.HasOption("--metrics") )
+    {
+    watcher.SetMetricsFileName( options.GetOptionValue("--metrics") );
+    }
+
+  unsigned int numberOfDataBlocks = atoi( argv[4] );
+
+  //
+  // A memory budget, when given, overrides the number of data blocks.
+  //
+  itk::StreamingMemoryPlanner::Pointer planner = itk::StreamingMemoryPlanner::New();
+
+  planner->AddStage( "reader1", sizeof( InputPixelType ) );
+  planner->AddStage( "reader2", sizeof( InputPixelType ) );
+  planner->AddStage( "subtract", sizeof( OutputPixelType ) );
+
+  if( !support.PlanNumberOfStreamDivisions( planner, argv[1],
+      argv[3], sizeof( OutputPixelType ), numberOfDataBlocks ) )
+    {
+    return EXIT_FAILURE;
+    }
+
+  //
+  // Autotuning times a few data block counts on a sample of the input,
+  // and keeps the fastest one that fits the memory budget. The choice is
+  // cached for later runs on this machine and dataset.
+  //
+  if( !support.AutotuneNumberOfStreamDivisions( filter->GetOutput(),
+        itk::StreamDivisionAutotuner::GetFileSignature( argv[1] ) + " " +
+        itk::StreamDivisionAutotuner::GetFileSignature( argv[2] ) + " subtract",
+        numberOfDataBlocks ) )
+    {
+    return EXIT_FAILURE;
+    }
+
+  // The probes are not part of the run.
+  watcher.ClearMetrics();
 
   writer->SetNumberOfStreamDivisions( numberOfDataBlocks );
 
+  //
+  // Bricked outputs can be compressed brick by brick while streaming.
+  //
+  const bool compress = options.HasOption("--compress");
+
+  if( compress && !itk::BrickedImageIO::New()->CanWriteFile( argv[3] ) )
+    {
+    std::cerr << "Compression needs a bricked (.bvol) output file" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  writer->SetUseCompression( compress );
+
+  //
+  // Optionally read and filter several data blocks at once, every
+  // worker with its own copy of the filter. The cores are shared
+  // among the workers.
+  //
+  typedef itk::ConcurrentChunkStreamingDriver<
+    InputImageType, OutputImageType > ConcurrentDriverType;
+
+  ConcurrentDriverType::Pointer concurrentDriver = ConcurrentDriverType::New();
+
+  const bool concurrent = options.HasOption("--workers");
+
+  if( concurrent )
+    {
+    const unsigned int numberOfWorkers =
+      std::max( atoi( options.GetOptionValue("--workers").c_str() ), 1 );
+
+    const itk::ThreadIdType threadsPerWorker = std::max(
+      itk::MultiThreader::GetGlobalDefaultNumberOfThreads() / numberOfWorkers, 1u );
+
+    concurrentDriver->AddInputFileName( argv[1] );
+    concurrentDriver->AddInputFileName( argv[2] );
+    concurrentDriver->SetOutputFileName( argv[3] );
+    concurrentDriver->SetNumberOfStreamDivisions( numberOfDataBlocks );
+    concurrentDriver->SetUseCompression( compress );
+
+    // One chunk per worker, and one finished chunk waiting for the writer.
+    unsigned int chunksInFlight = numberOfWorkers + 1;
+
+    if( options.HasOption("--chunks-in-flight") )
+      {
+      chunksInFlight = atoi( options.GetOptionValue("--chunks-in-flight").c_str() );
+      }
+
+    concurrentDriver->SetMaximumNumberOfChunksInFlight( chunksInFlight );
+
+    filter->SetNumberOfThreads( threadsPerWorker );
+    concurrentDriver->AddFilter( filter );
+
+    for( unsigned int w = 1; w < numberOfWorkers; w++ )
+      {
+      SubtractFilterType::Pointer workerFilter = SubtractFilterType::New();
+      workerFilter->SetNumberOfThreads( threadsPerWorker );
+      concurrentDriver->AddFilter( workerFilter );
+      watcher.WatchProcess( workerFilter );
+      }
+    }
+
+  //
+  // Optionally overlap the reading, filtering and writing
+  // of consecutive data blocks.
+  //
+  typedef itk::OverlappedStreamingDriver<
+    InputImageType, OutputImageType > DriverType;
+
+  DriverType::Pointer driver = DriverType::New();
+
+  const bool overlapped = options.HasOption("--chunks-in-flight") && !concurrent;
+
+  if( overlapped )
+    {
+    driver->AddInputFileName( argv[1] );
+    driver->AddInputFileName( argv[2] );
+    driver->SetOutputFileName( argv[3] );
+    driver->SetFilter( filter );
+    driver->SetNumberOfStreamDivisions( numberOfDataBlocks );
+    driver->SetMaximumNumberOfChunksInFlight(
+      atoi( options.GetOptionValue("--chunks-in-flight").c_str() ) );
+    driver->SetUseCompression( compress );
+    }
+
+  //
+  // With a declared memory budget, the run fails when its peak memory
+  // grows past it. The trace is the timeline of every stage and stream
+  // division, for a trace viewer.
+  //
+  if( !support.StartMemoryGuard( argv[1], numberOfDataBlocks ) )
+    {
+    return EXIT_FAILURE;
+    }
+
+  if( concurrent )
+    {
+    support.WatchDriver( concurrentDriver.GetPointer() );
+    }
+  else if( overlapped )
+    {
+    support.WatchDriver( driver.GetPointer() );
+    }
+  else
+    {
+    support.WatchPipeline( writer );
+    }
+
   itk::TimeProbesCollectorBase chronometer;
 
   chronometer.Start("Filtering");
 
   try
     {
-    writer->Update();
+    if( concurrent )
+      {
+      concurrentDriver->Update();
+      }
+    else if( overlapped )
+      {
+      driver->Update();
+      }
+    else
+      {
+      writer->Update();
+      }
     }
   catch ( itk::ExceptionObject & excp )
     {
@@ -84,5 +282,16 @@ int main(int argc, char * argv[])
   chronometer.Stop("Filtering");
   chronometer.Report( std::cout );
 
+  if( !support.FinishRun() )
+    {
+    return EXIT_FAILURE;
+    }
+
+  if( concurrent )
+    {
+    std::cout << "Chunks run by another worker: "
+              << concurrentDriver->GetNumberOfStolenChunks() << std::endl;
+    }
+
   return EXIT_SUCCESS;
 }
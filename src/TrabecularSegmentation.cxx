@@ -0,0 +1,403 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include "itkImage.h"
+#include "itkImageFileReader.h"
+#include "itkImageFileWriter.h"
+#include "itkFastBinaryThresholdImageFilter.h"
+#include "itkVotingBinaryHoleFillingImageFilter.h"
+#include "itkFastVotingBinaryHoleFillingImageFilter.h"
+#include "itkSubtractImageFilter.h"
+#include "itkSlidingWindowCacheImageFilter.h"
+#include "itkFilterStreamingWatcher.h"
+#include "itkStreamingCommandLineOptions.h"
+#include "itkStreamingCommandLineSupport.h"
+#include "itkBrickedImageIO.h"
+#include "itkBrickedImageIOFactory.h"
+#include "itkBitPackedImageIOFactory.h"
+
+#include "itkTimeProbesCollectorBase.h"
+
+#include <sstream>
+#include <vector>
+
+//
+// Runs the whole processing chain of the tests as a single pipeline:
+//
+//   threshold -> voting (N passes) -> subtract( last pass, first pass )
+//
+// The first voting pass fills holes of the background and the following
+// ones fill holes of the foreground, as the individual executables do in
+// the tests. Every stage asks its input for the halo it needs, so each
+// stream division is computed from the input slab plus N times the radius
+// on every side, and nothing but the final result is written to disk.
+//
+
+//
+// Creates one voting pass, with either of the two voting filters.
+//
+template< typename TVotingFilter, typename TImage >
+typename itk::ImageToImageFilter< TImage, TImage >::Pointer
+CreateVotingPass( typename TImage::PixelType backgroundValue,
+                  typename TImage::PixelType foregroundValue,
+                  const typename TImage::SizeType & radius,
+                  unsigned int majority )
+{
+  typename TVotingFilter::Pointer filter = TVotingFilter::New();
+
+  filter->SetBackgroundValue( backgroundValue );
+  filter->SetForegroundValue( foregroundValue );
+  filter->SetRadius( radius );
+  filter->SetMajorityThreshold( majority );
+
+  return filter.GetPointer();
+}
+
+template< typename TInputPixel >
+int Segment( const char * inputFileName,
+             const char * outputFileName,
+             int thresholdValue,
+             unsigned int radius,
+             unsigned int majority,
+             unsigned int numberOfPasses,
+             unsigned int numberOfDataBlocks,
+             const itk::StreamingCommandLineOptions & options )
+{
+  typedef TInputPixel         InputPixelType;
+  typedef unsigned char       OutputPixelType;
+
+  const unsigned int Dimension = 3;
+
+  typedef itk::Image< InputPixelType, Dimension >   InputImageType;
+  typedef itk::Image< OutputPixelType, Dimension >  OutputImageType;
+
+  typedef itk::ImageFileReader< InputImageType >  ReaderType;
+  typedef itk::ImageFileWriter< OutputImageType > WriterType;
+
+  typedef itk::FastBinaryThresholdImageFilter<
+               InputImageType, OutputImageType >  ThresholdFilterType;
+
+  typedef itk::VotingBinaryHoleFillingImageFilter<
+               OutputImageType, OutputImageType > VotingFilterType;
+
+  typedef itk::FastVotingBinaryHoleFillingImageFilter<
+               OutputImageType, OutputImageType > FastVotingFilterType;
+
+  typedef itk::ImageToImageFilter<
+               OutputImageType, OutputImageType > NeighborhoodFilterType;
+
+  typedef itk::SubtractImageFilter<
+               OutputImageType, OutputImageType, OutputImageType > SubtractFilterType;
+
+  typedef itk::SlidingWindowCacheImageFilter< OutputImageType > CacheFilterType;
+
+  typename ReaderType::Pointer reader = ReaderType::New();
+  reader->SetFileName( inputFileName );
+
+  typename ThresholdFilterType::Pointer threshold = ThresholdFilterType::New();
+  threshold->SetInput( reader->GetOutput() );
+  threshold->SetOutsideValue( 0 );
+  threshold->SetInsideValue( 255 );
+  threshold->SetLowerThreshold( static_cast< InputPixelType >( thresholdValue ) );
+  threshold->SetUpperThreshold( itk::NumericTraits< InputPixelType >::max() );
+
+  typename OutputImageType::SizeType neighborhoodRadius;
+  neighborhoodRadius.Fill( radius );
+
+  //
+  // With the halo cache, every voting pass reads its input through a
+  // cache, so that each stage only computes the slices that a data block
+  // adds to the previous one. The cache after the first pass also serves
+  // the subtraction, which lags behind the second pass by the halo of the
+  // remaining passes, so it gets a second branch.
+  //
+  const bool haloCache = options.HasOption("--halo-cache");
+
+  std::vector< typename CacheFilterType::Pointer > cache;
+
+  if( haloCache )
+    {
+    cache.resize( numberOfPasses );
+    for( unsigned int k = 0; k < numberOfPasses; k++ )
+      {
+      cache[k] = CacheFilterType::New();
+      }
+    cache[0]->SetInput( threshold->GetOutput() );
+    cache[1]->SetNumberOfBranches( 2 );
+    }
+
+  //
+  // The running sums filter gives the same passes at a cost per
+  // voxel that does not depend on the radius.
+  //
+  const bool runningSums = options.HasOption("--running-sums");
+
+  std::vector< typename NeighborhoodFilterType::Pointer > voting( numberOfPasses );
+
+  for( unsigned int k = 0; k < numberOfPasses; k++ )
+    {
+    const OutputPixelType backgroundValue = ( k == 0 ? 255 : 0 );
+    const OutputPixelType foregroundValue = ( k == 0 ? 0 : 255 );
+
+    if( runningSums )
+      {
+      voting[k] = CreateVotingPass< FastVotingFilterType, OutputImageType >(
+        backgroundValue, foregroundValue, neighborhoodRadius, majority );
+      }
+    else
+      {
+      voting[k] = CreateVotingPass< VotingFilterType, OutputImageType >(
+        backgroundValue, foregroundValue, neighborhoodRadius, majority );
+      }
+
+    if( haloCache )
+      {
+      voting[k]->SetInput( cache[k]->GetOutput() );
+      if( k + 1 < numberOfPasses )
+        {
+        cache[k+1]->SetInput( voting[k]->GetOutput() );
+        }
+      }
+    else
+      {
+      voting[k]->SetInput( k == 0 ? threshold->GetOutput() : voting[k-1]->GetOutput() );
+      }
+    }
+
+  //
+  // The last pass is the first input, because the subtraction runs in
+  // place and may only reuse the buffer of a stage with a single consumer.
+  //
+  typename SubtractFilterType::Pointer subtract = SubtractFilterType::New();
+  subtract->SetInput1( voting[numberOfPasses-1]->GetOutput() );
+  if( haloCache )
+    {
+    subtract->SetInput2( cache[1]->GetOutput( 1 ) );
+    }
+  else
+    {
+    subtract->SetInput2( voting[0]->GetOutput() );
+    }
+
+  //
+  // Intermediate buffers with a single consumer are released as soon as
+  // they have been used. The first pass feeds both the second pass and
+  // the subtraction, so it is kept. With the halo cache every voting pass
+  // has a single consumer, and the caches keep their own buffers.
+  //
+  reader->ReleaseDataFlagOn();
+  threshold->ReleaseDataFlagOn();
+  for( unsigned int k = haloCache ? 0 : 1; k + 1 < numberOfPasses; k++ )
+    {
+    voting[k]->ReleaseDataFlagOn();
+    }
+
+  itk::FilterStreamingWatcher watcher(subtract, "segmentation");
+
+  //
+  // Per stream division timings, sizes and memory, for comparing runs.
+  //
+  if( options.HasOption("--metrics") )
+    {
+    watcher.SetMetricsFileName( options.GetOptionValue("--metrics") );
+    }
+
+  typename WriterType::Pointer writer = WriterType::New();
+  writer->SetInput( subtract->GetOutput() );
+  writer->SetFileName( outputFileName );
+
+  itk::StreamingCommandLineSupport support( options );
+
+  //
+  // A memory budget, when given, overrides the number of data blocks.
+  //
+  itk::StreamingMemoryPlanner::Pointer planner = itk::StreamingMemoryPlanner::New();
+
+  planner->AddStage( "reader", sizeof( InputPixelType ) );
+  planner->AddStage( "threshold", sizeof( OutputPixelType ) );
+  for( unsigned int k = 0; k < numberOfPasses; k++ )
+    {
+    planner->AddStage( "voting", sizeof( OutputPixelType ), radius );
+    }
+  planner->AddStage( "subtract", sizeof( OutputPixelType ) );
+
+  if( !support.PlanNumberOfStreamDivisions( planner, inputFileName,
+      outputFileName, sizeof( OutputPixelType ), numberOfDataBlocks ) )
+    {
+    return EXIT_FAILURE;
+    }
+
+  //
+  // Autotuning times a few data block counts on a sample of the input,
+  // and keeps the fastest one that fits the memory budget. The choice is
+  // cached for later runs on this machine and dataset.
+  //
+  std::ostringstream key;
+  key << itk::StreamDivisionAutotuner::GetFileSignature( inputFileName )
+      << " segmentation radius " << radius << " passes " << numberOfPasses
+      << ( runningSums ? " running sums" : "" ) << ( haloCache ? " halo cache" : "" );
+
+  if( !support.AutotuneNumberOfStreamDivisions( subtract->GetOutput(), key.str(),
+                                                numberOfDataBlocks ) )
+    {
+    return EXIT_FAILURE;
+    }
+
+  // The probes are not part of the run.
+  watcher.ClearMetrics();
+
+  writer->SetNumberOfStreamDivisions( numberOfDataBlocks );
+
+  //
+  // Bricked outputs can be compressed brick by brick while streaming.
+  //
+  const bool compress = options.HasOption("--compress");
+
+  if( compress && !itk::BrickedImageIO::New()->CanWriteFile( outputFileName ) )
+    {
+    std::cerr << "Compression needs a bricked (.bvol) output file" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  writer->SetUseCompression( compress );
+
+  //
+  // With a declared memory budget, the run fails when its peak memory
+  // grows past it. The trace is the timeline of every stage and stream
+  // division, for a trace viewer.
+  //
+  if( !support.StartMemoryGuard( inputFileName, numberOfDataBlocks ) )
+    {
+    return EXIT_FAILURE;
+    }
+
+  support.WatchPipeline( writer );
+
+  itk::TimeProbesCollectorBase chronometer;
+
+  chronometer.Start("Filtering");
+
+  try
+    {
+    writer->Update();
+    }
+  catch( itk::ExceptionObject & err )
+    {
+    std::cerr << err << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  chronometer.Stop("Filtering");
+  chronometer.Report( std::cout );
+
+  if( !support.FinishRun() )
+    {
+    return EXIT_FAILURE;
+    }
+
+  return EXIT_SUCCESS;
+}
+
+int main( int argc, char * argv[] )
+{
+  if( argc < 8 )
+    {
+    std::cerr << "Missing Parameters " << std::endl;
+    std::cerr << "Usage: " << argv[0];
+    std::cerr << " inputImageFile outputImageFile thresholdValue";
+    std::cerr << " Radius Majority numberOfVotingPasses numberOfDataBlocks" << std::endl;
+    std::cerr << " [--max-memory memoryBudget]" << std::endl;
+    std::cerr << " [--autotune [slabsPerCandidate]] [--autotune-cache cacheFile]" << std::endl;
+    std::cerr << " [--compress]" << std::endl;
+    std::cerr << " [--halo-cache]" << std::endl;
+    std::cerr << " [--running-sums]" << std::endl;
+    std::cerr << " [--metrics metricsFile.json|metricsFile.csv]" << std::endl;
+    std::cerr << " [--trace traceFile.json]" << std::endl;
+    std::cerr << " [--memory-budget memoryBudget|Nx[+overhead]]" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  itk::BrickedImageIOFactory::RegisterOneFactory();
+  itk::BitPackedImageIOFactory::RegisterOneFactory();
+
+  const int          thresholdValue     = atoi( argv[3] );
+  const unsigned int radius             = atoi( argv[4] );
+  const unsigned int majority           = atoi( argv[5] );
+  const unsigned int numberOfPasses     = atoi( argv[6] );
+  const unsigned int numberOfDataBlocks = atoi( argv[7] );
+
+  if( numberOfPasses < 2 )
+    {
+    std::cerr << "At least two voting passes are needed" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  itk::StreamingCommandLineOptions options( argc, argv, 8 );
+
+  static const char * const validOptions[] = {
+    "--halo-cache",
+    "--running-sums",
+    "--metrics",
+    "--max-memory",
+    "--autotune",
+    "--autotune-cache",
+    "--compress",
+    "--memory-budget",
+    "--trace",
+    NULL };
+
+  if( !options.CheckOptions( validOptions, std::cerr ) )
+    {
+    return EXIT_FAILURE;
+    }
+
+  itk::ImageIOBase::Pointer imageIO = itk::ImageIOFactory::CreateImageIO(
+    argv[1], itk::ImageIOFactory::ReadMode);
+
+  if( imageIO.IsNull() )
+    {
+    std::cerr << "Could not create IO object for file " << argv[1] << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  try
+    {
+    imageIO->SetFileName( argv[1] );
+    imageIO->ReadImageInformation();
+    }
+  catch( itk::ExceptionObject & err )
+    {
+    std::cerr << err << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  switch( imageIO->GetComponentType() )
+    {
+    case itk::ImageIOBase::UCHAR:
+      return Segment< unsigned char >( argv[1], argv[2], thresholdValue, radius,
+        majority, numberOfPasses, numberOfDataBlocks, options );
+    case itk::ImageIOBase::FLOAT:
+      return Segment< float >( argv[1], argv[2], thresholdValue, radius,
+        majority, numberOfPasses, numberOfDataBlocks, options );
+    default:
+      std::cerr << "Unsupported pixel type "
+                << imageIO->GetComponentTypeAsString( imageIO->GetComponentType() )
+                << std::endl;
+      return EXIT_FAILURE;
+    }
+}
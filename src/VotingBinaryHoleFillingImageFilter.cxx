@@ -15,11 +15,23 @@
  *  limitations under the License.
  *
  *=========================================================================*/
+#include <algorithm>
+
 #include "itkImageFileReader.h"
 #include "itkImageFileWriter.h"
 #include "itkFilterStreamingWatcher.h"
+#include "itkOverlappedStreamingDriver.h"
+#include "itkConcurrentChunkStreamingDriver.h"
+#include "itkDirtyBrickIterationDriver.h"
+#include "itkStreamingCommandLineOptions.h"
+#include "itkStreamingCommandLineSupport.h"
 
 #include "itkVotingBinaryHoleFillingImageFilter.h"
+#include "itkFastVotingBinaryHoleFillingImageFilter.h"
+#include "itkSlidingWindowCacheImageFilter.h"
+#include "itkBrickedImageIO.h"
+#include "itkBrickedImageIOFactory.h"
+#include "itkBitPackedImageIOFactory.h"
 
 #include "itkTimeProbesCollectorBase.h"
 
@@ -30,9 +42,23 @@ int main(int argc, char * argv[])
     std::cerr << "Missing Parameters " << std::endl;
     std::cerr << "Usage: " << argv[0];
     std::cerr << " InputImage OutputImage Background Foreground Radius Majority numberOfDataBlocks" << std::endl;
+    std::cerr << " [--chunks-in-flight maximumNumberOfChunksInFlight]" << std::endl;
+    std::cerr << " [--workers numberOfWorkers]" << std::endl;
+    std::cerr << " [--max-memory memoryBudget]" << std::endl;
+    std::cerr << " [--autotune [slabsPerCandidate]] [--autotune-cache cacheFile]" << std::endl;
+    std::cerr << " [--compress]" << std::endl;
+    std::cerr << " [--halo-cache]" << std::endl;
+    std::cerr << " [--running-sums]" << std::endl;
+    std::cerr << " [--iterations maximumNumberOfIterations [--brick-size brickSize]]" << std::endl;
+    std::cerr << " [--metrics metricsFile.json|metricsFile.csv]" << std::endl;
+    std::cerr << " [--trace traceFile.json]" << std::endl;
+    std::cerr << " [--memory-budget memoryBudget|Nx[+overhead]]" << std::endl;
     return EXIT_FAILURE;
     }
 
+  itk::BrickedImageIOFactory::RegisterOneFactory();
+  itk::BitPackedImageIOFactory::RegisterOneFactory();
+
   const unsigned int Dimension = 3;
 
   typedef unsigned char       InputPixelType;
@@ -64,22 +90,311 @@ int main(int argc, char * argv[])
   filter->SetRadius( neighborhoodRadius );
   filter->SetMajorityThreshold( atoi( argv[6] ) );
 
+  writer->SetFileName( argv[2] );
+
+  itk::StreamingCommandLineOptions options( argc, argv, 8 );
 
-  itk::FilterStreamingWatcher watcher(filter, "filter");
+  static const char * const validOptions[] = {
+    "--chunks-in-flight",
+    "--workers",
+    "--max-memory",
+    "--autotune",
+    "--autotune-cache",
+    "--compress",
+    "--halo-cache",
+    "--running-sums",
+    "--iterations",
+    "--brick-size",
+    "--metrics",
+    "--trace",
+    "--memory-budget",
+    NULL };
 
-  writer->SetFileName( argv[2] );
+  if( !options.CheckOptions( validOptions, std::cerr ) )
+    {
+    return EXIT_FAILURE;
+    }
+
+  itk::StreamingCommandLineSupport support( options );
+
+  //
+  // The running sums filter produces the same output, at a cost
+  // per voxel that does not depend on the radius.
+  //
+  typedef itk::FastVotingBinaryHoleFillingImageFilter<
+    InputImageType, OutputImageType > FastVotingFilterType;
+
+  typedef itk::ImageToImageFilter< InputImageType, OutputImageType > NeighborhoodFilterType;
+
+  NeighborhoodFilterType::Pointer votingFilter = filter.GetPointer();
+
+  if( options.HasOption("--running-sums") )
+    {
+    FastVotingFilterType::Pointer fastFilter = FastVotingFilterType::New();
+
+    fastFilter->SetInput( reader->GetOutput() );
+    fastFilter->SetBackgroundValue( filter->GetBackgroundValue() );
+    fastFilter->SetForegroundValue( filter->GetForegroundValue() );
+    fastFilter->SetRadius( filter->GetRadius() );
+    fastFilter->SetMajorityThreshold( filter->GetMajorityThreshold() );
+
+    votingFilter = fastFilter;
+    writer->SetInput( votingFilter->GetOutput() );
+    }
+
+  itk::FilterStreamingWatcher watcher(votingFilter, "filter");
+
+  //
+  // Per stream division timings, sizes and memory, for comparing runs.
+  //
+  if( options.HasOption("--metrics") )
+    {
+    watcher.SetMetricsFileName( options.GetOptionValue("--metrics") );
+    }
+
+  unsigned int numberOfDataBlocks = atoi( argv[7] );
+
+  //
+  // A memory budget, when given, overrides the number of data blocks.
+  //
+  itk::StreamingMemoryPlanner::Pointer planner = itk::StreamingMemoryPlanner::New();
+
+  planner->AddStage( "reader", sizeof( InputPixelType ) );
+  planner->AddStage( "voting", sizeof( OutputPixelType ), atoi( argv[5] ) );
 
-  const unsigned int numberOfDataBlocks = atoi( argv[7] );
+  if( !support.PlanNumberOfStreamDivisions( planner, argv[1],
+      argv[2], sizeof( OutputPixelType ), numberOfDataBlocks ) )
+    {
+    return EXIT_FAILURE;
+    }
+
+  //
+  // Autotuning times a few data block counts on a sample of the input,
+  // and keeps the fastest one that fits the memory budget. The choice is
+  // cached for later runs on this machine and dataset.
+  //
+  if( !support.AutotuneNumberOfStreamDivisions( votingFilter->GetOutput(),
+        itk::StreamDivisionAutotuner::GetFileSignature( argv[1] ) +
+        " voting radius " + argv[5] +
+        ( options.HasOption("--running-sums") ? " running sums" : "" ),
+        numberOfDataBlocks ) )
+    {
+    return EXIT_FAILURE;
+    }
+
+  // The probes are not part of the run.
+  watcher.ClearMetrics();
 
   writer->SetNumberOfStreamDivisions( numberOfDataBlocks );
 
+  //
+  // Bricked outputs can be compressed brick by brick while streaming.
+  //
+  const bool compress = options.HasOption("--compress");
+
+  if( compress && !itk::BrickedImageIO::New()->CanWriteFile( argv[2] ) )
+    {
+    std::cerr << "Compression needs a bricked (.bvol) output file" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  writer->SetUseCompression( compress );
+
+  //
+  // Optionally read and filter several data blocks at once, every
+  // worker with its own copy of the filter. The cores are shared
+  // among the workers.
+  //
+  typedef itk::ConcurrentChunkStreamingDriver<
+    InputImageType, OutputImageType > ConcurrentDriverType;
+
+  ConcurrentDriverType::Pointer concurrentDriver = ConcurrentDriverType::New();
+
+  // The iterated passes run their own schedule.
+  const bool concurrent = options.HasOption("--workers") && !options.HasOption("--iterations");
+
+  if( concurrent )
+    {
+    const unsigned int numberOfWorkers =
+      std::max( atoi( options.GetOptionValue("--workers").c_str() ), 1 );
+
+    const itk::ThreadIdType threadsPerWorker = std::max(
+      itk::MultiThreader::GetGlobalDefaultNumberOfThreads() / numberOfWorkers, 1u );
+
+    concurrentDriver->AddInputFileName( argv[1] );
+    concurrentDriver->SetOutputFileName( argv[2] );
+    concurrentDriver->SetNumberOfStreamDivisions( numberOfDataBlocks );
+    concurrentDriver->SetUseCompression( compress );
+
+    // One chunk per worker, and one finished chunk waiting for the writer.
+    unsigned int chunksInFlight = numberOfWorkers + 1;
+
+    if( options.HasOption("--chunks-in-flight") )
+      {
+      chunksInFlight = atoi( options.GetOptionValue("--chunks-in-flight").c_str() );
+      }
+
+    concurrentDriver->SetMaximumNumberOfChunksInFlight( chunksInFlight );
+
+    votingFilter->SetNumberOfThreads( threadsPerWorker );
+    concurrentDriver->AddFilter( votingFilter );
+
+    for( unsigned int w = 1; w < numberOfWorkers; w++ )
+      {
+      NeighborhoodFilterType::Pointer workerFilter;
+
+      if( options.HasOption("--running-sums") )
+        {
+        FastVotingFilterType::Pointer fastWorkerFilter = FastVotingFilterType::New();
+        fastWorkerFilter->SetBackgroundValue( filter->GetBackgroundValue() );
+        fastWorkerFilter->SetForegroundValue( filter->GetForegroundValue() );
+        fastWorkerFilter->SetRadius( filter->GetRadius() );
+        fastWorkerFilter->SetMajorityThreshold( filter->GetMajorityThreshold() );
+        workerFilter = fastWorkerFilter;
+        }
+      else
+        {
+        VotingFilterType::Pointer votingWorkerFilter = VotingFilterType::New();
+        votingWorkerFilter->SetBackgroundValue( filter->GetBackgroundValue() );
+        votingWorkerFilter->SetForegroundValue( filter->GetForegroundValue() );
+        votingWorkerFilter->SetRadius( filter->GetRadius() );
+        votingWorkerFilter->SetMajorityThreshold( filter->GetMajorityThreshold() );
+        workerFilter = votingWorkerFilter;
+        }
+
+      workerFilter->SetNumberOfThreads( threadsPerWorker );
+      concurrentDriver->AddFilter( workerFilter );
+      watcher.WatchProcess( workerFilter );
+      }
+    }
+
+  //
+  // Optionally overlap the reading, filtering and writing
+  // of consecutive data blocks.
+  //
+  typedef itk::OverlappedStreamingDriver<
+    InputImageType, OutputImageType > DriverType;
+
+  DriverType::Pointer driver = DriverType::New();
+
+  bool overlapped = options.HasOption("--chunks-in-flight") && !concurrent;
+
+  if( overlapped )
+    {
+    driver->AddInputFileName( argv[1] );
+    driver->SetOutputFileName( argv[2] );
+    driver->SetFilter( votingFilter );
+    driver->SetNumberOfStreamDivisions( numberOfDataBlocks );
+    driver->SetMaximumNumberOfChunksInFlight(
+      atoi( options.GetOptionValue("--chunks-in-flight").c_str() ) );
+    driver->SetUseCompression( compress );
+    }
+
+  //
+  // Optionally repeat the pass until nothing changes, recomputing after
+  // the first pass only the bricks next to the ones that changed.
+  //
+  typedef itk::DirtyBrickIterationDriver< InputImageType > IterationDriverType;
+
+  IterationDriverType::Pointer iterationDriver = IterationDriverType::New();
+
+  const bool iterated = options.HasOption("--iterations");
+
+  if( iterated )
+    {
+    if( overlapped )
+      {
+      std::cerr << "--chunks-in-flight is ignored with --iterations" << std::endl;
+      overlapped = false;
+      }
+
+    if( options.HasOption("--workers") )
+      {
+      std::cerr << "--workers is ignored with --iterations" << std::endl;
+      }
+
+    iterationDriver->SetInputFileName( argv[1] );
+    iterationDriver->SetOutputFileName( argv[2] );
+    iterationDriver->SetFilter( votingFilter );
+    iterationDriver->SetRadius( neighborhoodRadius );
+    iterationDriver->SetMaximumNumberOfIterations(
+      atoi( options.GetOptionValue("--iterations").c_str() ) );
+    iterationDriver->SetBrickSize( static_cast< itk::SizeValueType >(
+      atoi( options.GetOptionValue("--brick-size", "64").c_str() ) ) );
+    iterationDriver->SetNumberOfStreamDivisions( numberOfDataBlocks );
+    iterationDriver->SetUseCompression( compress );
+    }
+
+  //
+  // Consecutive data blocks share the slices of the neighborhood halo.
+  // The cache keeps them, so that only the new slices are read.
+  //
+  typedef itk::SlidingWindowCacheImageFilter< InputImageType > CacheFilterType;
+
+  CacheFilterType::Pointer cache = CacheFilterType::New();
+
+  if( options.HasOption("--halo-cache") )
+    {
+    if( overlapped || concurrent || iterated )
+      {
+      std::cerr << "--halo-cache is ignored with --chunks-in-flight, --workers and --iterations" << std::endl;
+      }
+    else
+      {
+      cache->SetInput( reader->GetOutput() );
+      votingFilter->SetInput( cache->GetOutput() );
+      }
+    }
+
+  //
+  // With a declared memory budget, the run fails when its peak memory
+  // grows past it. The trace is the timeline of every stage and stream
+  // division, for a trace viewer.
+  //
+  if( !support.StartMemoryGuard( argv[1], numberOfDataBlocks ) )
+    {
+    return EXIT_FAILURE;
+    }
+
+  if( iterated )
+    {
+    support.WatchDriver( iterationDriver.GetPointer() );
+    }
+  else if( concurrent )
+    {
+    support.WatchDriver( concurrentDriver.GetPointer() );
+    }
+  else if( overlapped )
+    {
+    support.WatchDriver( driver.GetPointer() );
+    }
+  else
+    {
+    support.WatchPipeline( writer );
+    }
+
   itk::TimeProbesCollectorBase chronometer;
 
   chronometer.Start("Filtering");
 
   try
     {
-    writer->Update();
+    if( iterated )
+      {
+      iterationDriver->Update();
+      }
+    else if( concurrent )
+      {
+      concurrentDriver->Update();
+      }
+    else if( overlapped )
+      {
+      driver->Update();
+      }
+    else
+      {
+      writer->Update();
+      }
     }
   catch ( itk::ExceptionObject & excp )
     {
@@ -90,5 +405,26 @@ int main(int argc, char * argv[])
   chronometer.Stop("Filtering");
   chronometer.Report( std::cout );
 
+  if( !support.FinishRun() )
+    {
+    return EXIT_FAILURE;
+    }
+
+  if( concurrent )
+    {
+    std::cout << "Chunks run by another worker: "
+              << concurrentDriver->GetNumberOfStolenChunks() << std::endl;
+    }
+
+  if( iterated )
+    {
+    for( unsigned int k = 0; k < iterationDriver->GetNumberOfIterations(); k++ )
+      {
+      std::cout << "Iteration " << k + 1 << ": "
+                << iterationDriver->GetNumberOfRecomputedBricks()[k] << " bricks recomputed, "
+                << iterationDriver->GetNumberOfChangedBricks()[k] << " changed" << std::endl;
+      }
+    }
+
   return EXIT_SUCCESS;
 }
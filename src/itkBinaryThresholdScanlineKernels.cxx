@@ -0,0 +1,313 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include "itkBinaryThresholdScanlineKernels.h"
+
+//
+// The vector kernels are compiled for their instruction set through
+// function attributes (or unconditionally with Visual Studio), so that the
+// rest of the library keeps the baseline architecture flags and the kernel
+// is picked when the program runs.
+//
+#if ( defined(__GNUC__) || defined(__clang__) ) && ( defined(__x86_64__) || defined(__i386__) )
+#define ITK_THRESHOLD_KERNELS_X86
+#define ITK_THRESHOLD_TARGET(name) __attribute__((target(name)))
+#include <immintrin.h>
+#elif defined(_MSC_VER) && ( defined(_M_X64) || defined(_M_IX86) )
+#define ITK_THRESHOLD_KERNELS_X86
+#define ITK_THRESHOLD_TARGET(name)
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+
+namespace itk
+{
+
+namespace
+{
+
+template< typename TInputPixel >
+void ThresholdScalar( const TInputPixel * input, unsigned char * output,
+                      std::size_t length, TInputPixel lower, TInputPixel upper,
+                      unsigned char insideValue, unsigned char outsideValue )
+{
+  for( std::size_t i = 0; i < length; i++ )
+    {
+    const TInputPixel value = input[i];
+    output[i] = ( lower <= value && value <= upper ) ? insideValue : outsideValue;
+    }
+}
+
+#if defined(ITK_THRESHOLD_KERNELS_X86)
+
+ITK_THRESHOLD_TARGET("sse4.1")
+void ThresholdSSE41( const unsigned char * input, unsigned char * output,
+                     std::size_t length, unsigned char lower, unsigned char upper,
+                     unsigned char insideValue, unsigned char outsideValue )
+{
+  const __m128i lowerVector   = _mm_set1_epi8( static_cast< char >( lower ) );
+  const __m128i upperVector   = _mm_set1_epi8( static_cast< char >( upper ) );
+  const __m128i insideVector  = _mm_set1_epi8( static_cast< char >( insideValue ) );
+  const __m128i outsideVector = _mm_set1_epi8( static_cast< char >( outsideValue ) );
+
+  std::size_t i = 0;
+
+  for( ; i + 16 <= length; i += 16 )
+    {
+    const __m128i value = _mm_loadu_si128( reinterpret_cast< const __m128i * >( input + i ) );
+
+    // Unsigned comparisons: value >= lower <=> max(value, lower) == value.
+    const __m128i mask = _mm_and_si128(
+      _mm_cmpeq_epi8( _mm_max_epu8( value, lowerVector ), value ),
+      _mm_cmpeq_epi8( _mm_min_epu8( value, upperVector ), value ) );
+
+    _mm_storeu_si128( reinterpret_cast< __m128i * >( output + i ),
+      _mm_blendv_epi8( outsideVector, insideVector, mask ) );
+    }
+
+  ThresholdScalar( input + i, output + i, length - i, lower, upper, insideValue, outsideValue );
+}
+
+ITK_THRESHOLD_TARGET("sse4.1")
+void ThresholdSSE41( const float * input, unsigned char * output,
+                     std::size_t length, float lower, float upper,
+                     unsigned char insideValue, unsigned char outsideValue )
+{
+  const __m128  lowerVector   = _mm_set1_ps( lower );
+  const __m128  upperVector   = _mm_set1_ps( upper );
+  const __m128i insideVector  = _mm_set1_epi8( static_cast< char >( insideValue ) );
+  const __m128i outsideVector = _mm_set1_epi8( static_cast< char >( outsideValue ) );
+
+  std::size_t i = 0;
+
+  for( ; i + 16 <= length; i += 16 )
+    {
+    __m128i mask[4];
+
+    for( unsigned int k = 0; k < 4; k++ )
+      {
+      const __m128 value = _mm_loadu_ps( input + i + 4 * k );
+      mask[k] = _mm_castps_si128( _mm_and_ps(
+        _mm_cmpge_ps( value, lowerVector ), _mm_cmple_ps( value, upperVector ) ) );
+      }
+
+    // Narrow the 32 bit masks to bytes; saturation keeps 0 and -1.
+    const __m128i bytes = _mm_packs_epi16(
+      _mm_packs_epi32( mask[0], mask[1] ), _mm_packs_epi32( mask[2], mask[3] ) );
+
+    _mm_storeu_si128( reinterpret_cast< __m128i * >( output + i ),
+      _mm_blendv_epi8( outsideVector, insideVector, bytes ) );
+    }
+
+  ThresholdScalar( input + i, output + i, length - i, lower, upper, insideValue, outsideValue );
+}
+
+ITK_THRESHOLD_TARGET("avx2")
+void ThresholdAVX2( const unsigned char * input, unsigned char * output,
+                    std::size_t length, unsigned char lower, unsigned char upper,
+                    unsigned char insideValue, unsigned char outsideValue )
+{
+  const __m256i lowerVector   = _mm256_set1_epi8( static_cast< char >( lower ) );
+  const __m256i upperVector   = _mm256_set1_epi8( static_cast< char >( upper ) );
+  const __m256i insideVector  = _mm256_set1_epi8( static_cast< char >( insideValue ) );
+  const __m256i outsideVector = _mm256_set1_epi8( static_cast< char >( outsideValue ) );
+
+  std::size_t i = 0;
+
+  for( ; i + 32 <= length; i += 32 )
+    {
+    const __m256i value = _mm256_loadu_si256( reinterpret_cast< const __m256i * >( input + i ) );
+
+    const __m256i mask = _mm256_and_si256(
+      _mm256_cmpeq_epi8( _mm256_max_epu8( value, lowerVector ), value ),
+      _mm256_cmpeq_epi8( _mm256_min_epu8( value, upperVector ), value ) );
+
+    _mm256_storeu_si256( reinterpret_cast< __m256i * >( output + i ),
+      _mm256_blendv_epi8( outsideVector, insideVector, mask ) );
+    }
+
+  ThresholdScalar( input + i, output + i, length - i, lower, upper, insideValue, outsideValue );
+}
+
+ITK_THRESHOLD_TARGET("avx2")
+void ThresholdAVX2( const float * input, unsigned char * output,
+                    std::size_t length, float lower, float upper,
+                    unsigned char insideValue, unsigned char outsideValue )
+{
+  const __m256  lowerVector   = _mm256_set1_ps( lower );
+  const __m256  upperVector   = _mm256_set1_ps( upper );
+  const __m256i insideVector  = _mm256_set1_epi8( static_cast< char >( insideValue ) );
+  const __m256i outsideVector = _mm256_set1_epi8( static_cast< char >( outsideValue ) );
+
+  // The packs work within 128 bit lanes; this restores the pixel order.
+  const __m256i laneOrder = _mm256_setr_epi32( 0, 4, 1, 5, 2, 6, 3, 7 );
+
+  std::size_t i = 0;
+
+  for( ; i + 32 <= length; i += 32 )
+    {
+    __m256i mask[4];
+
+    for( unsigned int k = 0; k < 4; k++ )
+      {
+      const __m256 value = _mm256_loadu_ps( input + i + 8 * k );
+      mask[k] = _mm256_castps_si256( _mm256_and_ps(
+        _mm256_cmp_ps( value, lowerVector, _CMP_GE_OQ ),
+        _mm256_cmp_ps( value, upperVector, _CMP_LE_OQ ) ) );
+      }
+
+    const __m256i bytes = _mm256_permutevar8x32_epi32( _mm256_packs_epi16(
+      _mm256_packs_epi32( mask[0], mask[1] ), _mm256_packs_epi32( mask[2], mask[3] ) ),
+      laneOrder );
+
+    _mm256_storeu_si256( reinterpret_cast< __m256i * >( output + i ),
+      _mm256_blendv_epi8( outsideVector, insideVector, bytes ) );
+    }
+
+  ThresholdScalar( input + i, output + i, length - i, lower, upper, insideValue, outsideValue );
+}
+
+#endif
+
+} // end anonymous namespace
+
+
+BinaryThresholdScanlineKernels::InstructionSetType
+BinaryThresholdScanlineKernels::m_MaximumInstructionSet = BinaryThresholdScanlineKernels::AVX2;
+
+
+BinaryThresholdScanlineKernels::InstructionSetType
+BinaryThresholdScanlineKernels::DetectInstructionSet()
+{
+#if defined(ITK_THRESHOLD_KERNELS_X86) && defined(_MSC_VER)
+  int registers[4];
+
+  __cpuid( registers, 0 );
+  const int maximumLeaf = registers[0];
+
+  __cpuid( registers, 1 );
+  const bool sse41   = ( registers[2] & ( 1 << 19 ) ) != 0;
+  const bool osxsave = ( registers[2] & ( 1 << 27 ) ) != 0;
+  const bool avx     = ( registers[2] & ( 1 << 28 ) ) != 0;
+
+  bool avx2 = false;
+  if( maximumLeaf >= 7 && osxsave && avx && ( _xgetbv( 0 ) & 0x6 ) == 0x6 )
+    {
+    __cpuidex( registers, 7, 0 );
+    avx2 = ( registers[1] & ( 1 << 5 ) ) != 0;
+    }
+
+  if( avx2 )
+    {
+    return AVX2;
+    }
+  if( sse41 )
+    {
+    return SSE41;
+    }
+#elif defined(ITK_THRESHOLD_KERNELS_X86)
+  __builtin_cpu_init();
+
+  if( __builtin_cpu_supports( "avx2" ) )
+    {
+    return AVX2;
+    }
+  if( __builtin_cpu_supports( "sse4.1" ) )
+    {
+    return SSE41;
+    }
+#endif
+  return Scalar;
+}
+
+
+BinaryThresholdScanlineKernels::InstructionSetType
+BinaryThresholdScanlineKernels::GetInstructionSet()
+{
+  static const InstructionSetType detected = DetectInstructionSet();
+
+  return detected < m_MaximumInstructionSet ? detected : m_MaximumInstructionSet;
+}
+
+
+const char *
+BinaryThresholdScanlineKernels::GetInstructionSetName()
+{
+  switch( GetInstructionSet() )
+    {
+    case AVX2:
+      return "AVX2";
+    case SSE41:
+      return "SSE4.1";
+    default:
+      return "Scalar";
+    }
+}
+
+
+void
+BinaryThresholdScanlineKernels::SetMaximumInstructionSet( InstructionSetType instructionSet )
+{
+  m_MaximumInstructionSet = instructionSet;
+}
+
+
+void
+BinaryThresholdScanlineKernels::Threshold( const unsigned char * input, unsigned char * output,
+                                           std::size_t length,
+                                           unsigned char lower, unsigned char upper,
+                                           unsigned char insideValue, unsigned char outsideValue )
+{
+  switch( GetInstructionSet() )
+    {
+#if defined(ITK_THRESHOLD_KERNELS_X86)
+    case AVX2:
+      ThresholdAVX2( input, output, length, lower, upper, insideValue, outsideValue );
+      return;
+    case SSE41:
+      ThresholdSSE41( input, output, length, lower, upper, insideValue, outsideValue );
+      return;
+#endif
+    default:
+      ThresholdScalar( input, output, length, lower, upper, insideValue, outsideValue );
+    }
+}
+
+
+void
+BinaryThresholdScanlineKernels::Threshold( const float * input, unsigned char * output,
+                                           std::size_t length,
+                                           float lower, float upper,
+                                           unsigned char insideValue, unsigned char outsideValue )
+{
+  switch( GetInstructionSet() )
+    {
+#if defined(ITK_THRESHOLD_KERNELS_X86)
+    case AVX2:
+      ThresholdAVX2( input, output, length, lower, upper, insideValue, outsideValue );
+      return;
+    case SSE41:
+      ThresholdSSE41( input, output, length, lower, upper, insideValue, outsideValue );
+      return;
+#endif
+    default:
+      ThresholdScalar( input, output, length, lower, upper, insideValue, outsideValue );
+    }
+}
+
+} // end namespace itk
@@ -0,0 +1,660 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include "itkBitPackedImageIO.h"
+#include "itksys/SystemTools.hxx"
+
+#include <iomanip>
+#include <map>
+#include <sstream>
+
+namespace itk
+{
+
+namespace
+{
+
+const char * const BitPackedVolumeSignature = "BitPackedVolume = 1";
+
+const std::streamoff BitPackedHeaderAlignment = 512;
+
+const std::streamoff BitPackedMaximumHeaderLength = 65536;
+
+std::string TrimSpaces( const std::string & text )
+{
+  const std::string::size_type first = text.find_first_not_of( " \t\r" );
+  if( first == std::string::npos )
+    {
+    return "";
+    }
+  const std::string::size_type last = text.find_last_not_of( " \t\r" );
+  return text.substr( first, last - first + 1 );
+}
+
+uint64_t AlignHeaderLength( uint64_t length )
+{
+  return ( ( length + BitPackedHeaderAlignment - 1 ) / BitPackedHeaderAlignment ) * BitPackedHeaderAlignment;
+}
+
+} // end anonymous namespace
+
+
+BitPackedImageIO::BitPackedImageIO()
+{
+  this->SetNumberOfDimensions( 3 );
+
+  m_ForegroundValue = 255;
+  m_ForegroundValueFromData = true;
+  m_ForegroundValueKnown = false;
+  m_HeaderOutdated = false;
+  m_HeaderSize = 0;
+
+  m_Writing = false;
+  m_NumberOfPixelsWritten = 0;
+
+  this->SetPixelType( SCALAR );
+  this->SetComponentType( UCHAR );
+  this->SetNumberOfComponents( 1 );
+}
+
+BitPackedImageIO::~BitPackedImageIO()
+{
+  if( m_Writing )
+    {
+    try
+      {
+      this->EndWriting();
+      }
+    catch( ... )
+      {
+      }
+    }
+}
+
+SizeValueType
+BitPackedImageIO::GetDimension( unsigned int i ) const
+{
+  return i < this->GetNumberOfDimensions() ? this->GetDimensions(i) : 1;
+}
+
+void
+BitPackedImageIO::GetIORegionExtent( IndexValueType index[3], SizeValueType size[3] ) const
+{
+  for( unsigned int i = 0; i < 3; i++ )
+    {
+    if( i < m_IORegion.GetImageDimension() )
+      {
+      index[i] = m_IORegion.GetIndex(i);
+      size[i] = m_IORegion.GetSize(i);
+      }
+    else
+      {
+      index[i] = 0;
+      size[i] = 1;
+      }
+    }
+}
+
+SizeValueType
+BitPackedImageIO::GetRowLength() const
+{
+  return ( this->GetDimension(0) + 7 ) / 8;
+}
+
+uint64_t
+BitPackedImageIO::GetRowOffset( SizeValueType y, SizeValueType z ) const
+{
+  return m_HeaderSize +
+    ( static_cast< uint64_t >( z ) * this->GetDimension(1) + y ) * this->GetRowLength();
+}
+
+void
+BitPackedImageIO::UnpackBits( const unsigned char * packed, SizeValueType begin, SizeValueType end,
+                              unsigned char * pixels ) const
+{
+  const unsigned char foreground = m_ForegroundValue;
+  const SizeValueType firstByte = begin / 8;
+
+  SizeValueType x = begin;
+
+  // Leading bits up to the first whole byte.
+  for( ; x < end && ( x % 8 ) != 0; x++ )
+    {
+    *pixels++ = ( ( packed[ x / 8 - firstByte ] >> ( x % 8 ) ) & 1 ) ? foreground : 0;
+    }
+
+  for( ; x + 8 <= end; x += 8 )
+    {
+    const unsigned char bits = packed[ x / 8 - firstByte ];
+    for( unsigned int b = 0; b < 8; b++ )
+      {
+      *pixels++ = ( ( bits >> b ) & 1 ) ? foreground : 0;
+      }
+    }
+
+  for( ; x < end; x++ )
+    {
+    *pixels++ = ( ( packed[ x / 8 - firstByte ] >> ( x % 8 ) ) & 1 ) ? foreground : 0;
+    }
+}
+
+void
+BitPackedImageIO::PackBits( const unsigned char * pixels, SizeValueType begin, SizeValueType end,
+                            unsigned char * packed )
+{
+  const SizeValueType firstByte = begin / 8;
+
+  SizeValueType x = begin;
+
+  for( ; x < end && ( x % 8 ) != 0; x++ )
+    {
+    const unsigned char mask = static_cast< unsigned char >( 1 << ( x % 8 ) );
+    unsigned char & byte = packed[ x / 8 - firstByte ];
+    byte = *pixels++ ? ( byte | mask ) : ( byte & ~mask );
+    }
+
+  for( ; x + 8 <= end; x += 8 )
+    {
+    unsigned char bits = 0;
+    for( unsigned int b = 0; b < 8; b++ )
+      {
+      bits |= static_cast< unsigned char >( ( *pixels++ != 0 ) << b );
+      }
+    packed[ x / 8 - firstByte ] = bits;
+    }
+
+  for( ; x < end; x++ )
+    {
+    const unsigned char mask = static_cast< unsigned char >( 1 << ( x % 8 ) );
+    unsigned char & byte = packed[ x / 8 - firstByte ];
+    byte = *pixels++ ? ( byte | mask ) : ( byte & ~mask );
+    }
+}
+
+void
+BitPackedImageIO::CheckBinaryPixels( const unsigned char * pixels, SizeValueType numberOfPixels )
+{
+  for( SizeValueType i = 0; i < numberOfPixels; i++ )
+    {
+    const unsigned char value = pixels[i];
+
+    if( value == 0 )
+      {
+      continue;
+      }
+
+    if( !m_ForegroundValueKnown )
+      {
+      m_HeaderOutdated = ( value != m_ForegroundValue );
+      m_ForegroundValue = value;
+      m_ForegroundValueKnown = true;
+      }
+    else if( value != m_ForegroundValue )
+      {
+      itkExceptionMacro("Only binary images can be written to " << m_FileName
+        << ": found value " << static_cast< unsigned int >( value )
+        << " besides 0 and " << static_cast< unsigned int >( m_ForegroundValue ));
+      }
+    }
+}
+
+bool
+BitPackedImageIO::CanReadFile(const char *filename)
+{
+  const std::string fname = filename;
+
+  if( fname == "" )
+    {
+    return false;
+    }
+
+  if( itksys::SystemTools::GetFilenameLastExtension( fname ) != ".bitvol" )
+    {
+    return false;
+    }
+
+  std::ifstream file( filename, std::ios::in | std::ios::binary );
+  if( !file )
+    {
+    return false;
+    }
+
+  std::string line;
+  std::getline( file, line );
+
+  return TrimSpaces( line ) == BitPackedVolumeSignature;
+}
+
+bool
+BitPackedImageIO::CanWriteFile(const char *filename)
+{
+  const std::string fname = filename;
+
+  if( fname == "" )
+    {
+    return false;
+    }
+
+  return itksys::SystemTools::GetFilenameLastExtension( fname ) == ".bitvol";
+}
+
+void
+BitPackedImageIO::ReadImageInformation()
+{
+  std::ifstream file( m_FileName.c_str(), std::ios::in | std::ios::binary );
+
+  if( !file )
+    {
+    itkExceptionMacro("Could not open file " << m_FileName << " for reading");
+    }
+
+  std::map< std::string, std::string > fields;
+
+  std::string line;
+  std::getline( file, line );
+
+  if( TrimSpaces( line ) != BitPackedVolumeSignature )
+    {
+    itkExceptionMacro("File " << m_FileName << " is not a bit packed volume");
+    }
+
+  bool headerEnd = false;
+
+  while( std::getline( file, line ) )
+    {
+    line = TrimSpaces( line );
+    if( line == "HeaderEnd" )
+      {
+      headerEnd = true;
+      break;
+      }
+    if( file.tellg() > BitPackedMaximumHeaderLength )
+      {
+      break;
+      }
+    const std::string::size_type equal = line.find( '=' );
+    if( equal != std::string::npos )
+      {
+      fields[ TrimSpaces( line.substr( 0, equal ) ) ] = TrimSpaces( line.substr( equal + 1 ) );
+      }
+    }
+
+  if( !headerEnd )
+    {
+    itkExceptionMacro("Header of file " << m_FileName << " is truncated");
+    }
+
+  m_HeaderSize = AlignHeaderLength( static_cast< uint64_t >( file.tellg() ) );
+
+  const char * requiredFields[] = { "NDims", "DimSize", "ElementSpacing", "Offset",
+    "Direction", "ForegroundValue" };
+
+  for( unsigned int k = 0; k < sizeof( requiredFields ) / sizeof( requiredFields[0] ); k++ )
+    {
+    if( fields.find( requiredFields[k] ) == fields.end() )
+      {
+      itkExceptionMacro("Field " << requiredFields[k] << " is missing in file " << m_FileName);
+      }
+    }
+
+  unsigned int numberOfDimensions = 0;
+  std::istringstream( fields["NDims"] ) >> numberOfDimensions;
+
+  if( !this->SupportsDimension( numberOfDimensions ) )
+    {
+    itkExceptionMacro("Unsupported number of dimensions " << numberOfDimensions
+      << " in file " << m_FileName);
+    }
+
+  this->SetNumberOfDimensions( numberOfDimensions );
+
+  std::istringstream dimSize( fields["DimSize"] );
+  std::istringstream spacing( fields["ElementSpacing"] );
+  std::istringstream origin( fields["Offset"] );
+  std::istringstream direction( fields["Direction"] );
+
+  for( unsigned int i = 0; i < numberOfDimensions; i++ )
+    {
+    SizeValueType size = 0;
+    double value = 0.0;
+
+    dimSize >> size;
+    this->SetDimensions( i, size );
+
+    spacing >> value;
+    this->SetSpacing( i, value );
+
+    origin >> value;
+    this->SetOrigin( i, value );
+
+    std::vector< double > axis( numberOfDimensions );
+    for( unsigned int j = 0; j < numberOfDimensions; j++ )
+      {
+      direction >> axis[j];
+      }
+    this->SetDirection( i, axis );
+    }
+
+  if( !dimSize || !spacing || !origin || !direction )
+    {
+    itkExceptionMacro("Invalid geometry in file " << m_FileName);
+    }
+
+  unsigned int foregroundValue = 255;
+  std::istringstream( fields["ForegroundValue"] ) >> foregroundValue;
+  m_ForegroundValue = static_cast< unsigned char >( foregroundValue );
+
+  this->SetPixelType( SCALAR );
+  this->SetComponentType( UCHAR );
+  this->SetNumberOfComponents( 1 );
+
+  const uint64_t expectedLength = this->GetRowOffset( 0, this->GetDimension(2) );
+
+  if( static_cast< uint64_t >( itksys::SystemTools::FileLength( m_FileName.c_str() ) ) < expectedLength )
+    {
+    itkExceptionMacro("File " << m_FileName << " is shorter than the "
+      << expectedLength << " bytes of its image");
+    }
+}
+
+void
+BitPackedImageIO::Read(void *buffer)
+{
+  std::ifstream file( m_FileName.c_str(), std::ios::in | std::ios::binary );
+
+  if( !file )
+    {
+    itkExceptionMacro("Could not open file " << m_FileName << " for reading");
+    }
+
+  IndexValueType index[3];
+  SizeValueType size[3];
+  this->GetIORegionExtent( index, size );
+
+  const SizeValueType rowLength = this->GetRowLength();
+  const SizeValueType begin = index[0];
+  const SizeValueType end = index[0] + size[0];
+
+  const SizeValueType firstByte = begin / 8;
+  const SizeValueType packedLength = ( end + 7 ) / 8 - firstByte;
+
+  //
+  // Full rows are consecutive in the file, so each slice of
+  // the region is then fetched with a single read.
+  //
+  const bool fullRows = ( size[0] == this->GetDimension(0) );
+  const SizeValueType rowsPerRead = fullRows ? size[1] : 1;
+
+  RowBufferType packed( rowsPerRead * rowLength );
+
+  unsigned char * pixels = static_cast< unsigned char * >( buffer );
+
+  for( SizeValueType z = index[2]; z < index[2] + size[2]; z++ )
+    {
+    for( SizeValueType y = index[1]; y < index[1] + size[1]; y += rowsPerRead )
+      {
+      const std::streamsize length = fullRows ? rowsPerRead * rowLength : packedLength;
+
+      file.seekg( static_cast< std::streamoff >( this->GetRowOffset( y, z ) + ( fullRows ? 0 : firstByte ) ) );
+      file.read( reinterpret_cast< char * >( &packed[0] ), length );
+
+      if( !file )
+        {
+        itkExceptionMacro("Could not read row " << y << " of slice " << z
+          << " of file " << m_FileName);
+        }
+
+      for( SizeValueType r = 0; r < rowsPerRead; r++ )
+        {
+        this->UnpackBits( &packed[ r * rowLength ], begin, end, pixels );
+        pixels += size[0];
+        }
+      }
+    }
+}
+
+std::string
+BitPackedImageIO::CreateHeader() const
+{
+  const unsigned int numberOfDimensions = this->GetNumberOfDimensions();
+
+  std::ostringstream header;
+  header.precision( 17 );
+
+  header << BitPackedVolumeSignature << "\n";
+  header << "NDims = " << numberOfDimensions << "\n";
+
+  header << "DimSize =";
+  for( unsigned int i = 0; i < numberOfDimensions; i++ )
+    {
+    header << " " << this->GetDimensions(i);
+    }
+  header << "\n";
+
+  header << "ElementSpacing =";
+  for( unsigned int i = 0; i < numberOfDimensions; i++ )
+    {
+    header << " " << this->GetSpacing(i);
+    }
+  header << "\n";
+
+  header << "Offset =";
+  for( unsigned int i = 0; i < numberOfDimensions; i++ )
+    {
+    header << " " << this->GetOrigin(i);
+    }
+  header << "\n";
+
+  header << "Direction =";
+  for( unsigned int i = 0; i < numberOfDimensions; i++ )
+    {
+    const std::vector< double > axis = this->GetDirection(i);
+    for( unsigned int j = 0; j < numberOfDimensions; j++ )
+      {
+      header << " " << axis[j];
+      }
+    }
+  header << "\n";
+
+  // Fixed width, so that the header can be rewritten in place.
+  header << "ForegroundValue = " << std::setw(3)
+         << static_cast< unsigned int >( m_ForegroundValue ) << "\n";
+  header << "HeaderEnd\n";
+
+  return header.str();
+}
+
+void
+BitPackedImageIO::BeginWriting()
+{
+  if( !this->SupportsDimension( this->GetNumberOfDimensions() ) )
+    {
+    itkExceptionMacro("Unsupported number of dimensions " << this->GetNumberOfDimensions());
+    }
+
+  if( this->GetComponentType() != UCHAR || this->GetNumberOfComponents() != 1 )
+    {
+    itkExceptionMacro("Only binary images of unsigned char can be written to "
+      << m_FileName << ", not " << GetComponentTypeAsString( this->GetComponentType() ));
+    }
+
+  m_ForegroundValueKnown = !m_ForegroundValueFromData;
+  m_HeaderOutdated = false;
+
+  const std::string header = this->CreateHeader();
+
+  m_HeaderSize = AlignHeaderLength( header.size() );
+
+  m_OutputFile.close();
+  m_OutputFile.clear();
+  m_OutputFile.open( m_FileName.c_str(),
+    std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc );
+
+  if( !m_OutputFile )
+    {
+    itkExceptionMacro("Could not open file " << m_FileName << " for writing");
+    }
+
+  std::string paddedHeader = header;
+  paddedHeader.resize( m_HeaderSize, '\0' );
+
+  m_OutputFile.write( paddedHeader.c_str(), paddedHeader.size() );
+
+  // Give the file its final length, so that rows can be written in any order.
+  const uint64_t length = this->GetRowOffset( 0, this->GetDimension(2) );
+  if( length > m_HeaderSize )
+    {
+    m_OutputFile.seekp( static_cast< std::streamoff >( length - 1 ) );
+    m_OutputFile.put( '\0' );
+    }
+
+  if( !m_OutputFile )
+    {
+    itkExceptionMacro("Could not write the header of file " << m_FileName);
+    }
+
+  m_NumberOfPixelsWritten = 0;
+
+  m_Writing = true;
+  m_WritingFileName = m_FileName;
+}
+
+void
+BitPackedImageIO::EndWriting()
+{
+  m_Writing = false;
+
+  //
+  // The foreground value was only known once the data came in.
+  //
+  if( m_HeaderOutdated )
+    {
+    m_OutputFile.seekp( 0 );
+    m_OutputFile << this->CreateHeader();
+    m_HeaderOutdated = false;
+    }
+
+  m_OutputFile.flush();
+
+  const bool failed = !m_OutputFile;
+
+  m_OutputFile.close();
+
+  if( failed )
+    {
+    itkExceptionMacro("Could not write file " << m_WritingFileName);
+    }
+}
+
+void
+BitPackedImageIO::Write(const void *buffer)
+{
+  if( m_Writing && m_WritingFileName != m_FileName )
+    {
+    this->EndWriting();
+    }
+
+  if( !m_Writing )
+    {
+    this->BeginWriting();
+    }
+
+  IndexValueType index[3];
+  SizeValueType size[3];
+  this->GetIORegionExtent( index, size );
+
+  const SizeValueType rowLength = this->GetRowLength();
+  const SizeValueType begin = index[0];
+  const SizeValueType end = index[0] + size[0];
+
+  const SizeValueType firstByte = begin / 8;
+  const SizeValueType packedLength = ( end + 7 ) / 8 - firstByte;
+
+  const bool fullRows = ( size[0] == this->GetDimension(0) );
+  const SizeValueType rowsPerWrite = fullRows ? size[1] : 1;
+
+  //
+  // A byte shared with pixels outside of the region
+  // must keep the bits that are already in the file.
+  //
+  const bool merge = ( begin % 8 != 0 ) ||
+    ( end % 8 != 0 && end != this->GetDimension(0) );
+
+  RowBufferType packed( rowsPerWrite * rowLength, 0 );
+
+  const unsigned char * pixels = static_cast< const unsigned char * >( buffer );
+
+  try
+    {
+    this->CheckBinaryPixels( pixels, size[0] * size[1] * size[2] );
+    }
+  catch( ExceptionObject & )
+    {
+    m_Writing = false;
+    m_OutputFile.close();
+    throw;
+    }
+
+  for( SizeValueType z = index[2]; z < index[2] + size[2]; z++ )
+    {
+    for( SizeValueType y = index[1]; y < index[1] + size[1]; y += rowsPerWrite )
+      {
+      const std::streamoff offset = static_cast< std::streamoff >(
+        this->GetRowOffset( y, z ) + ( fullRows ? 0 : firstByte ) );
+      const std::streamsize length = fullRows ? rowsPerWrite * rowLength : packedLength;
+
+      if( merge )
+        {
+        m_OutputFile.seekg( offset );
+        m_OutputFile.read( reinterpret_cast< char * >( &packed[0] ), length );
+        }
+
+      for( SizeValueType r = 0; r < rowsPerWrite; r++ )
+        {
+        PackBits( pixels, begin, end, &packed[ r * rowLength ] );
+        pixels += size[0];
+        }
+
+      m_OutputFile.seekp( offset );
+      m_OutputFile.write( reinterpret_cast< const char * >( &packed[0] ), length );
+
+      if( !m_OutputFile )
+        {
+        itkExceptionMacro("Could not write row " << y << " of slice " << z
+          << " of file " << m_WritingFileName);
+        }
+      }
+    }
+
+  m_NumberOfPixelsWritten += size[0] * size[1] * size[2];
+
+  if( m_NumberOfPixelsWritten >= this->GetDimension(0) * this->GetDimension(1) * this->GetDimension(2) )
+    {
+    this->EndWriting();
+    }
+}
+
+void
+BitPackedImageIO::PrintSelf(std::ostream & os, Indent indent) const
+{
+  Superclass::PrintSelf(os, indent);
+
+  os << indent << "ForegroundValue: " << static_cast< unsigned int >( m_ForegroundValue ) << std::endl;
+}
+
+} // end namespace itk
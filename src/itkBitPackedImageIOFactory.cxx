@@ -0,0 +1,48 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include "itkBitPackedImageIOFactory.h"
+#include "itkBitPackedImageIO.h"
+#include "itkCreateObjectFunction.h"
+#include "itkVersion.h"
+
+namespace itk
+{
+
+BitPackedImageIOFactory::BitPackedImageIOFactory()
+{
+  this->RegisterOverride( "itkImageIOBase",
+                          "itkBitPackedImageIO",
+                          "Bit Packed Image IO",
+                          1,
+                          CreateObjectFunction< BitPackedImageIO >::New() );
+}
+
+const char *
+BitPackedImageIOFactory::GetITKSourceVersion(void) const
+{
+  return ITK_SOURCE_VERSION;
+}
+
+const char *
+BitPackedImageIOFactory::GetDescription(void) const
+{
+  return "Bit Packed ImageIO Factory, allows the loading of one bit per voxel binary volumes into insight";
+}
+
+} // end namespace itk
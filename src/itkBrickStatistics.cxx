@@ -0,0 +1,417 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include "itkBrickStatistics.h"
+#include "itkNumericTraits.h"
+#include "itkMacro.h"
+
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+namespace itk
+{
+
+const unsigned int BrickStatistics::NumberOfBins;
+
+BrickStatistics::BrickStatistics()
+{
+  m_Minimum = NumericTraits< double >::max();
+  m_Maximum = NumericTraits< double >::NonpositiveMin();
+  m_Sum = 0.0;
+  m_Count = 0;
+}
+
+
+void
+BrickStatistics::Initialize( const RegionType & imageRegion, const SizeType & brickSize )
+{
+  m_Grid.SetImageRegion( imageRegion );
+  m_Grid.SetBrickSize( brickSize );
+
+  BrickType empty;
+  empty.Minimum = 0.0;
+  empty.Maximum = 0.0;
+  empty.Mean = 0.0;
+  empty.Count = 0;
+  for( unsigned int b = 0; b < NumberOfBins; b++ )
+    {
+    empty.Histogram[b] = 0;
+    }
+  empty.Valid = false;
+
+  m_Bricks.assign( m_Grid.GetNumberOfBricks(), empty );
+
+  m_Minimum = NumericTraits< double >::max();
+  m_Maximum = NumericTraits< double >::NonpositiveMin();
+  m_Sum = 0.0;
+  m_Count = 0;
+}
+
+
+template< typename TPixel >
+void
+BrickStatistics::ComputeBrickFromPixels( BrickIdType id, const TPixel * pixels )
+{
+  const SizeValueType numberOfPixels = m_Grid.GetBrickRegion( id ).GetNumberOfPixels();
+
+  BrickType & brick = m_Bricks[id];
+
+  double minimum = NumericTraits< double >::max();
+  double maximum = NumericTraits< double >::NonpositiveMin();
+  double sum = 0.0;
+  SizeValueType count = 0;
+
+  for( SizeValueType i = 0; i < numberOfPixels; i++ )
+    {
+    const double value = static_cast< double >( pixels[i] );
+
+    if( value != value )
+      {
+      continue;
+      }
+
+    if( value < minimum )
+      {
+      minimum = value;
+      }
+    if( value > maximum )
+      {
+      maximum = value;
+      }
+    sum += value;
+    count++;
+    }
+
+  for( unsigned int b = 0; b < NumberOfBins; b++ )
+    {
+    brick.Histogram[b] = 0;
+    }
+
+  if( count > 0 )
+    {
+    const double binWidth = ( maximum - minimum ) / NumberOfBins;
+
+    for( SizeValueType i = 0; i < numberOfPixels; i++ )
+      {
+      const double value = static_cast< double >( pixels[i] );
+
+      if( value != value )
+        {
+        continue;
+        }
+
+      unsigned int bin = 0;
+      if( binWidth > 0.0 )
+        {
+        bin = static_cast< unsigned int >( ( value - minimum ) / binWidth );
+        if( bin >= NumberOfBins )
+          {
+          bin = NumberOfBins - 1;
+          }
+        }
+      brick.Histogram[bin]++;
+      }
+    }
+  else
+    {
+    minimum = 0.0;
+    maximum = 0.0;
+    }
+
+  brick.Minimum = minimum;
+  brick.Maximum = maximum;
+  brick.Mean = count > 0 ? sum / count : 0.0;
+  brick.Count = count;
+  brick.Valid = true;
+
+  this->AddToVolume( brick );
+}
+
+
+void
+BrickStatistics::ComputeBrick( BrickIdType id, const void * pixels,
+                               ImageIOBase::IOComponentType componentType )
+{
+  switch( componentType )
+    {
+    case ImageIOBase::UCHAR:
+      this->ComputeBrickFromPixels( id, static_cast< const unsigned char * >( pixels ) );
+      break;
+    case ImageIOBase::CHAR:
+      this->ComputeBrickFromPixels( id, static_cast< const char * >( pixels ) );
+      break;
+    case ImageIOBase::USHORT:
+      this->ComputeBrickFromPixels( id, static_cast< const unsigned short * >( pixels ) );
+      break;
+    case ImageIOBase::SHORT:
+      this->ComputeBrickFromPixels( id, static_cast< const short * >( pixels ) );
+      break;
+    case ImageIOBase::UINT:
+      this->ComputeBrickFromPixels( id, static_cast< const unsigned int * >( pixels ) );
+      break;
+    case ImageIOBase::INT:
+      this->ComputeBrickFromPixels( id, static_cast< const int * >( pixels ) );
+      break;
+    case ImageIOBase::ULONG:
+      this->ComputeBrickFromPixels( id, static_cast< const unsigned long * >( pixels ) );
+      break;
+    case ImageIOBase::LONG:
+      this->ComputeBrickFromPixels( id, static_cast< const long * >( pixels ) );
+      break;
+    case ImageIOBase::FLOAT:
+      this->ComputeBrickFromPixels( id, static_cast< const float * >( pixels ) );
+      break;
+    case ImageIOBase::DOUBLE:
+      this->ComputeBrickFromPixels( id, static_cast< const double * >( pixels ) );
+      break;
+    default:
+      itkGenericExceptionMacro("Unsupported component type for brick statistics");
+    }
+}
+
+
+void
+BrickStatistics::AddToVolume( const BrickType & brick )
+{
+  if( brick.Count == 0 )
+    {
+    return;
+    }
+
+  if( brick.Minimum < m_Minimum )
+    {
+    m_Minimum = brick.Minimum;
+    }
+  if( brick.Maximum > m_Maximum )
+    {
+    m_Maximum = brick.Maximum;
+    }
+  m_Sum += brick.Mean * brick.Count;
+  m_Count += brick.Count;
+}
+
+
+bool
+BrickStatistics::IsComplete() const
+{
+  for( size_t k = 0; k < m_Bricks.size(); k++ )
+    {
+    if( !m_Bricks[k].Valid )
+      {
+      return false;
+      }
+    }
+  return !m_Bricks.empty();
+}
+
+
+double
+BrickStatistics::GetMean() const
+{
+  return m_Count > 0 ? m_Sum / m_Count : 0.0;
+}
+
+
+BrickStatistics::ClassificationType
+BrickStatistics::Classify( BrickIdType id, double lower, double upper ) const
+{
+  const BrickType & brick = m_Bricks[id];
+
+  if( !brick.Valid )
+    {
+    return Mixed;
+    }
+
+  // NaN pixels are outside of any interval.
+  if( brick.Count == 0 || brick.Maximum < lower || brick.Minimum > upper )
+    {
+    return AllOutside;
+    }
+
+  if( brick.Count == m_Grid.GetBrickRegion( id ).GetNumberOfPixels() &&
+      lower <= brick.Minimum && brick.Maximum <= upper )
+    {
+    return AllInside;
+    }
+
+  return Mixed;
+}
+
+
+std::string
+BrickStatistics::GetSidecarFileName( const std::string & imageFileName )
+{
+  return imageFileName + ".stats";
+}
+
+
+void
+BrickStatistics::Write( const std::string & fileName ) const
+{
+  std::ofstream file( fileName.c_str() );
+
+  if( !file )
+    {
+    itkGenericExceptionMacro("Could not open file " << fileName << " for writing");
+    }
+
+  const RegionType & region = m_Grid.GetImageRegion();
+  const SizeType & brickSize = m_Grid.GetBrickSize();
+
+  // Enough digits for every double to be read back exactly.
+  file << std::setprecision( 17 );
+
+  file << "BrickStatistics = 1" << std::endl;
+  file << "Index = " << region.GetIndex(0) << " " << region.GetIndex(1)
+       << " " << region.GetIndex(2) << std::endl;
+  file << "DimSize = " << region.GetSize(0) << " " << region.GetSize(1)
+       << " " << region.GetSize(2) << std::endl;
+  file << "BrickSize = " << brickSize[0] << " " << brickSize[1]
+       << " " << brickSize[2] << std::endl;
+  file << "NumberOfBins = " << NumberOfBins << std::endl;
+  file << "Minimum = " << m_Minimum << std::endl;
+  file << "Maximum = " << m_Maximum << std::endl;
+  file << "Mean = " << this->GetMean() << std::endl;
+  file << "HeaderEnd" << std::endl;
+
+  //
+  // One line per brick: valid, minimum, maximum, mean, count, histogram.
+  //
+  for( size_t k = 0; k < m_Bricks.size(); k++ )
+    {
+    const BrickType & brick = m_Bricks[k];
+
+    if( !brick.Valid )
+      {
+      file << 0 << std::endl;
+      continue;
+      }
+
+    file << 1 << " " << brick.Minimum << " " << brick.Maximum << " "
+         << brick.Mean << " " << brick.Count;
+    for( unsigned int b = 0; b < NumberOfBins; b++ )
+      {
+      file << " " << brick.Histogram[b];
+      }
+    file << std::endl;
+    }
+
+  if( !file )
+    {
+    itkGenericExceptionMacro("Could not write file " << fileName);
+    }
+}
+
+
+void
+BrickStatistics::Read( const std::string & fileName )
+{
+  std::ifstream file( fileName.c_str() );
+
+  if( !file )
+    {
+    itkGenericExceptionMacro("Could not open file " << fileName << " for reading");
+    }
+
+  RegionType region;
+  SizeType brickSize;
+  brickSize.Fill( 0 );
+  unsigned int numberOfBins = 0;
+  bool isStatistics = false;
+
+  std::string line;
+  while( std::getline( file, line ) && line != "HeaderEnd" )
+    {
+    const std::string::size_type equal = line.find( " = " );
+    if( equal == std::string::npos )
+      {
+      continue;
+      }
+
+    const std::string key = line.substr( 0, equal );
+    std::istringstream value( line.substr( equal + 3 ) );
+
+    if( key == "BrickStatistics" )
+      {
+      isStatistics = true;
+      }
+    else if( key == "Index" )
+      {
+      for( unsigned int i = 0; i < 3; i++ )
+        {
+        IndexValueType index = 0;
+        value >> index;
+        region.SetIndex( i, index );
+        }
+      }
+    else if( key == "DimSize" )
+      {
+      for( unsigned int i = 0; i < 3; i++ )
+        {
+        SizeValueType size = 0;
+        value >> size;
+        region.SetSize( i, size );
+        }
+      }
+    else if( key == "BrickSize" )
+      {
+      value >> brickSize[0] >> brickSize[1] >> brickSize[2];
+      }
+    else if( key == "NumberOfBins" )
+      {
+      value >> numberOfBins;
+      }
+    }
+
+  if( !isStatistics || numberOfBins != NumberOfBins ||
+      brickSize[0] == 0 || brickSize[1] == 0 || brickSize[2] == 0 )
+    {
+    itkGenericExceptionMacro("File " << fileName << " is not a brick statistics file");
+    }
+
+  this->Initialize( region, brickSize );
+
+  for( size_t k = 0; k < m_Bricks.size(); k++ )
+    {
+    BrickType & brick = m_Bricks[k];
+
+    int valid = 0;
+    file >> valid;
+
+    if( valid )
+      {
+      file >> brick.Minimum >> brick.Maximum >> brick.Mean >> brick.Count;
+      for( unsigned int b = 0; b < NumberOfBins; b++ )
+        {
+        file >> brick.Histogram[b];
+        }
+      brick.Valid = true;
+
+      this->AddToVolume( brick );
+      }
+
+    if( !file )
+      {
+      itkGenericExceptionMacro("Could not read the statistics of brick " << k
+                               << " from file " << fileName);
+      }
+    }
+}
+
+} // end namespace itk
@@ -0,0 +1,1001 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include "itkBrickedImageIO.h"
+#include "itkByteSwapper.h"
+#include "itksys/SystemTools.hxx"
+#include "itk_zlib.h"
+
+#include <algorithm>
+#include <sstream>
+
+namespace itk
+{
+
+namespace
+{
+
+const char * const BrickedVolumeSignature = "BrickedVolume = 1";
+
+const std::streamoff BrickedHeaderAlignment = 512;
+
+const std::streamoff BrickedMaximumHeaderLength = 65536;
+
+std::string TrimSpaces( const std::string & text )
+{
+  const std::string::size_type first = text.find_first_not_of( " \t\r" );
+  if( first == std::string::npos )
+    {
+    return "";
+    }
+  const std::string::size_type last = text.find_last_not_of( " \t\r" );
+  return text.substr( first, last - first + 1 );
+}
+
+uint64_t AlignHeaderLength( uint64_t length )
+{
+  return ( ( length + BrickedHeaderAlignment - 1 ) / BrickedHeaderAlignment ) * BrickedHeaderAlignment;
+}
+
+} // end anonymous namespace
+
+
+BrickedImageIO::BrickedImageIO()
+{
+  this->SetNumberOfDimensions( GridDimension );
+
+  m_BrickSize.Fill( 64 );
+  m_MaximumNumberOfCachedBricks = 0;
+  m_CompressionLevel = 1;
+  m_NumberOfThreads = MultiThreader::GetGlobalDefaultNumberOfThreads();
+  m_WriteStatistics = false;
+
+  m_Compression = "None";
+  m_IndexOffset = 0;
+
+  m_OpenFileModifiedTime = 0;
+
+  m_Writing = false;
+  m_WriteOffset = 0;
+  m_NumberOfBricksWritten = 0;
+  m_CollectStatistics = false;
+
+  if( ByteSwapper< int >::SystemIsBigEndian() )
+    {
+    this->SetByteOrderToBigEndian();
+    }
+  else
+    {
+    this->SetByteOrderToLittleEndian();
+    }
+}
+
+BrickedImageIO::~BrickedImageIO()
+{
+  if( m_Writing )
+    {
+    // Bricks that were not completely written are stored
+    // as they are, so that the file remains readable.
+    try
+      {
+      this->FlushAllBricks();
+      this->EndWriting();
+      }
+    catch( ... )
+      {
+      }
+    }
+}
+
+void
+BrickedImageIO::SetBrickSize( const BrickSizeType & size )
+{
+  if( m_BrickSize != size )
+    {
+    m_BrickSize = size;
+    this->Modified();
+    }
+}
+
+void
+BrickedImageIO::SetBrickSize( SizeValueType size )
+{
+  BrickSizeType brickSize;
+  brickSize.Fill( size );
+  this->SetBrickSize( brickSize );
+}
+
+SizeValueType
+BrickedImageIO::ComputePendingMemory( const std::vector< SizeValueType > & imageSize,
+                                      SizeValueType bytesPerPixel ) const
+{
+  if( imageSize.empty() )
+    {
+    return 0;
+    }
+
+  const unsigned int slowest = static_cast< unsigned int >( imageSize.size() ) - 1;
+
+  // Pending bricks are clipped to the image like the others.
+  SizeValueType numberOfPixels =
+    std::min( imageSize[slowest], static_cast< SizeValueType >(
+      slowest < GridDimension ? m_BrickSize[slowest] : 1 ) );
+
+  for( unsigned int i = 0; i < slowest; i++ )
+    {
+    numberOfPixels *= imageSize[i];
+    }
+
+  return numberOfPixels * bytesPerPixel;
+}
+
+SizeValueType
+BrickedImageIO::GetPixelSize() const
+{
+  return static_cast< SizeValueType >( this->GetComponentSize() ) * this->GetNumberOfComponents();
+}
+
+BrickedImageIO::GridRegionType
+BrickedImageIO::GetImageGridRegion() const
+{
+  GridRegionType region;
+  for( unsigned int i = 0; i < GridDimension; i++ )
+    {
+    region.SetIndex( i, 0 );
+    region.SetSize( i, i < this->GetNumberOfDimensions() ? this->GetDimensions(i) : 1 );
+    }
+  return region;
+}
+
+BrickedImageIO::GridRegionType
+BrickedImageIO::GetIORegionAsGridRegion() const
+{
+  GridRegionType region;
+  for( unsigned int i = 0; i < GridDimension; i++ )
+    {
+    if( i < m_IORegion.GetImageDimension() )
+      {
+      region.SetIndex( i, m_IORegion.GetIndex(i) );
+      region.SetSize( i, m_IORegion.GetSize(i) );
+      }
+    else
+      {
+      region.SetIndex( i, 0 );
+      region.SetSize( i, 1 );
+      }
+    }
+  return region;
+}
+
+bool
+BrickedImageIO::CanReadFile(const char *filename)
+{
+  const std::string fname = filename;
+
+  if( fname == "" )
+    {
+    return false;
+    }
+
+  if( itksys::SystemTools::GetFilenameLastExtension( fname ) != ".bvol" )
+    {
+    return false;
+    }
+
+  std::ifstream file( filename, std::ios::in | std::ios::binary );
+  if( !file )
+    {
+    return false;
+    }
+
+  std::string line;
+  std::getline( file, line );
+
+  return TrimSpaces( line ) == BrickedVolumeSignature;
+}
+
+bool
+BrickedImageIO::CanWriteFile(const char *filename)
+{
+  const std::string fname = filename;
+
+  if( fname == "" )
+    {
+    return false;
+    }
+
+  return itksys::SystemTools::GetFilenameLastExtension( fname ) == ".bvol";
+}
+
+void
+BrickedImageIO::ReadImageInformation()
+{
+  std::ifstream file( m_FileName.c_str(), std::ios::in | std::ios::binary );
+
+  if( !file )
+    {
+    itkExceptionMacro("Could not open file " << m_FileName << " for reading");
+    }
+
+  std::map< std::string, std::string > fields;
+
+  std::string line;
+  std::getline( file, line );
+
+  if( TrimSpaces( line ) != BrickedVolumeSignature )
+    {
+    itkExceptionMacro("File " << m_FileName << " is not a bricked volume");
+    }
+
+  bool headerEnd = false;
+
+  while( std::getline( file, line ) )
+    {
+    line = TrimSpaces( line );
+    if( line == "HeaderEnd" )
+      {
+      headerEnd = true;
+      break;
+      }
+    if( file.tellg() > BrickedMaximumHeaderLength )
+      {
+      break;
+      }
+    const std::string::size_type equal = line.find( '=' );
+    if( equal != std::string::npos )
+      {
+      fields[ TrimSpaces( line.substr( 0, equal ) ) ] = TrimSpaces( line.substr( equal + 1 ) );
+      }
+    }
+
+  if( !headerEnd )
+    {
+    itkExceptionMacro("Header of file " << m_FileName << " is truncated");
+    }
+
+  m_IndexOffset = AlignHeaderLength( static_cast< uint64_t >( file.tellg() ) );
+
+  const char * requiredFields[] = { "NDims", "DimSize", "ElementSpacing", "Offset",
+    "Direction", "PixelType", "ElementType", "ElementNumberOfChannels",
+    "ByteOrderMSB", "BrickSize", "NumberOfBricks", "Compression" };
+
+  for( unsigned int k = 0; k < sizeof( requiredFields ) / sizeof( requiredFields[0] ); k++ )
+    {
+    if( fields.find( requiredFields[k] ) == fields.end() )
+      {
+      itkExceptionMacro("Field " << requiredFields[k] << " is missing in file " << m_FileName);
+      }
+    }
+
+  unsigned int numberOfDimensions = 0;
+  std::istringstream( fields["NDims"] ) >> numberOfDimensions;
+
+  if( !this->SupportsDimension( numberOfDimensions ) )
+    {
+    itkExceptionMacro("Unsupported number of dimensions " << numberOfDimensions
+      << " in file " << m_FileName);
+    }
+
+  this->SetNumberOfDimensions( numberOfDimensions );
+
+  std::istringstream dimSize( fields["DimSize"] );
+  std::istringstream spacing( fields["ElementSpacing"] );
+  std::istringstream origin( fields["Offset"] );
+  std::istringstream direction( fields["Direction"] );
+
+  for( unsigned int i = 0; i < numberOfDimensions; i++ )
+    {
+    SizeValueType size = 0;
+    double value = 0.0;
+
+    dimSize >> size;
+    this->SetDimensions( i, size );
+
+    spacing >> value;
+    this->SetSpacing( i, value );
+
+    origin >> value;
+    this->SetOrigin( i, value );
+
+    std::vector< double > axis( numberOfDimensions );
+    for( unsigned int j = 0; j < numberOfDimensions; j++ )
+      {
+      direction >> axis[j];
+      }
+    this->SetDirection( i, axis );
+    }
+
+  if( !dimSize || !spacing || !origin || !direction )
+    {
+    itkExceptionMacro("Invalid geometry in file " << m_FileName);
+    }
+
+  bool knownPixelType = false;
+  for( int type = SCALAR; type <= MATRIX; type++ )
+    {
+    if( fields["PixelType"] == GetPixelTypeAsString( static_cast< IOPixelType >( type ) ) )
+      {
+      this->SetPixelType( static_cast< IOPixelType >( type ) );
+      knownPixelType = true;
+      break;
+      }
+    }
+
+  const IOComponentType componentTypes[] = { UCHAR, CHAR, USHORT, SHORT,
+    UINT, INT, ULONG, LONG, FLOAT, DOUBLE };
+
+  bool knownComponentType = false;
+  for( unsigned int k = 0; k < sizeof( componentTypes ) / sizeof( componentTypes[0] ); k++ )
+    {
+    if( fields["ElementType"] == GetComponentTypeAsString( componentTypes[k] ) )
+      {
+      this->SetComponentType( componentTypes[k] );
+      knownComponentType = true;
+      break;
+      }
+    }
+
+  if( !knownPixelType || !knownComponentType )
+    {
+    itkExceptionMacro("Unknown pixel type " << fields["PixelType"] << " of "
+      << fields["ElementType"] << " in file " << m_FileName);
+    }
+
+  unsigned int numberOfComponents = 1;
+  std::istringstream( fields["ElementNumberOfChannels"] ) >> numberOfComponents;
+  this->SetNumberOfComponents( numberOfComponents );
+
+  const bool fileIsBigEndian = ( fields["ByteOrderMSB"] == "True" );
+  if( fileIsBigEndian != ByteSwapper< int >::SystemIsBigEndian() )
+    {
+    itkExceptionMacro("File " << m_FileName
+      << " was written on a platform of different byte order");
+    }
+
+  std::istringstream brickSizeStream( fields["BrickSize"] );
+  BrickSizeType brickSize;
+  brickSize.Fill( 1 );
+  for( unsigned int i = 0; i < numberOfDimensions; i++ )
+    {
+    brickSizeStream >> brickSize[i];
+    }
+
+  m_Compression = fields["Compression"];
+
+  if( m_Compression != "None" && m_Compression != "Zlib" )
+    {
+    itkExceptionMacro("Unsupported compression " << m_Compression
+      << " in file " << m_FileName);
+    }
+
+  m_Grid.SetImageRegion( this->GetImageGridRegion() );
+  m_Grid.SetBrickSize( brickSize );
+
+  BrickIdType numberOfBricks = 0;
+  std::istringstream( fields["NumberOfBricks"] ) >> numberOfBricks;
+
+  if( numberOfBricks != m_Grid.GetNumberOfBricks() )
+    {
+    itkExceptionMacro("File " << m_FileName << " has " << numberOfBricks
+      << " bricks, " << m_Grid.GetNumberOfBricks() << " were expected");
+    }
+
+  m_BrickIndex.resize( numberOfBricks );
+
+  file.clear();
+  file.seekg( static_cast< std::streamoff >( m_IndexOffset ) );
+  file.read( reinterpret_cast< char * >( &m_BrickIndex[0] ),
+             numberOfBricks * sizeof( IndexEntryType ) );
+
+  if( !file )
+    {
+    itkExceptionMacro("Could not read the brick index of file " << m_FileName);
+    }
+
+  // The decoded bricks of a previous read can only be
+  // reused if the file has not changed since.
+  const long int modifiedTime = itksys::SystemTools::ModifiedTime( m_FileName.c_str() );
+
+  if( m_OpenFileName != m_FileName || m_OpenFileModifiedTime != modifiedTime )
+    {
+    this->ClearCache();
+    m_InputFile.close();
+    m_InputFile.clear();
+    m_OpenFileName = "";
+    }
+}
+
+void
+BrickedImageIO::OpenForReading()
+{
+  if( m_InputFile.is_open() && m_OpenFileName == m_FileName )
+    {
+    return;
+    }
+
+  m_InputFile.close();
+  m_InputFile.clear();
+  this->ClearCache();
+
+  m_InputFile.open( m_FileName.c_str(), std::ios::in | std::ios::binary );
+
+  if( !m_InputFile )
+    {
+    itkExceptionMacro("Could not open file " << m_FileName << " for reading");
+    }
+
+  m_OpenFileName = m_FileName;
+  m_OpenFileModifiedTime = itksys::SystemTools::ModifiedTime( m_FileName.c_str() );
+}
+
+void
+BrickedImageIO::ClearCache()
+{
+  m_Cache.clear();
+  m_CacheOrder.clear();
+}
+
+SizeValueType
+BrickedImageIO::GetBrickLength( BrickIdType id ) const
+{
+  return m_Grid.GetBrickRegion( id ).GetNumberOfPixels() * this->GetPixelSize();
+}
+
+void
+BrickedImageIO::CacheBrick( BrickIdType id, BufferType & data )
+{
+  SizeValueType capacity = m_MaximumNumberOfCachedBricks;
+  if( capacity == 0 )
+    {
+    capacity = m_Grid.GetGridSize()[0] * m_Grid.GetGridSize()[1];
+    }
+
+  while( !m_CacheOrder.empty() && m_CacheOrder.size() >= capacity )
+    {
+    m_Cache.erase( m_CacheOrder.front() );
+    m_CacheOrder.pop_front();
+    }
+
+  CachedBrickType & brick = m_Cache[id];
+  brick.Data.swap( data );
+  brick.Position = m_CacheOrder.insert( m_CacheOrder.end(), id );
+}
+
+void
+BrickedImageIO::ReadBricks( std::vector< CodecJobType > & jobs )
+{
+  const bool compressed = ( m_Compression != "None" );
+
+  for( size_t k = 0; k < jobs.size(); k++ )
+    {
+    CodecJobType & job = jobs[k];
+
+    const IndexEntryType & entry = m_BrickIndex[job.Id];
+
+    job.OutputLength = this->GetBrickLength( job.Id );
+    job.Failed = false;
+
+    if( !compressed && entry.Length != job.OutputLength )
+      {
+      itkExceptionMacro("Brick " << job.Id << " of file " << m_FileName << " has "
+        << entry.Length << " bytes, " << job.OutputLength << " were expected");
+      }
+
+    if( entry.Length == 0 )
+      {
+      itkExceptionMacro("Brick " << job.Id << " of file " << m_FileName << " was never written");
+      }
+
+    job.Input.resize( entry.Length );
+
+    m_InputFile.seekg( static_cast< std::streamoff >( entry.Offset ) );
+    m_InputFile.read( &job.Input[0], entry.Length );
+
+    if( !m_InputFile )
+      {
+      m_InputFile.clear();
+      itkExceptionMacro("Could not read brick " << job.Id << " of file " << m_FileName);
+      }
+    }
+
+  this->RunCodec( jobs, false );
+
+  for( size_t k = 0; k < jobs.size(); k++ )
+    {
+    if( jobs[k].Failed )
+      {
+      itkExceptionMacro("Could not decompress brick " << jobs[k].Id << " of file " << m_FileName);
+      }
+    }
+}
+
+void
+BrickedImageIO::Read(void *buffer)
+{
+  this->OpenForReading();
+
+  const GridRegionType region = this->GetIORegionAsGridRegion();
+  const SizeValueType pixelSize = this->GetPixelSize();
+
+  const GridType::BrickIdListType bricks = m_Grid.GetBricksIntersecting( region );
+
+  //
+  // Bricks missing from the cache are read in batches, a few per
+  // thread, which bounds the memory of the compressed copies.
+  //
+  const size_t batchSize = 4 * m_NumberOfThreads;
+
+  std::vector< CodecJobType > jobs;
+
+  for( size_t k = 0; k < bricks.size(); k++ )
+    {
+    const BrickIdType id = bricks[k];
+    const GridRegionType brickRegion = m_Grid.GetBrickRegion( id );
+
+    GridRegionType overlap = brickRegion;
+    overlap.Crop( region );
+
+    std::map< BrickIdType, CachedBrickType >::iterator found = m_Cache.find( id );
+
+    if( found != m_Cache.end() )
+      {
+      m_CacheOrder.splice( m_CacheOrder.end(), m_CacheOrder, found->second.Position );
+
+      GridType::CopyRegion( &found->second.Data[0], brickRegion,
+                            static_cast< char * >( buffer ), region,
+                            overlap, pixelSize );
+      }
+    else
+      {
+      jobs.push_back( CodecJobType() );
+      jobs.back().Id = id;
+      }
+
+    if( jobs.size() == batchSize || ( k + 1 == bricks.size() && !jobs.empty() ) )
+      {
+      this->ReadBricks( jobs );
+
+      for( size_t j = 0; j < jobs.size(); j++ )
+        {
+        const GridRegionType jobRegion = m_Grid.GetBrickRegion( jobs[j].Id );
+
+        GridRegionType jobOverlap = jobRegion;
+        jobOverlap.Crop( region );
+
+        GridType::CopyRegion( &jobs[j].Output[0], jobRegion,
+                              static_cast< char * >( buffer ), region,
+                              jobOverlap, pixelSize );
+
+        this->CacheBrick( jobs[j].Id, jobs[j].Output );
+        }
+
+      jobs.clear();
+      }
+    }
+}
+
+void
+BrickedImageIO::RunCodec( std::vector< CodecJobType > & jobs, bool encode ) const
+{
+  if( jobs.empty() )
+    {
+    return;
+    }
+
+  CodecBatchType batch;
+  batch.IO = this;
+  batch.Jobs = &jobs;
+  batch.Encode = encode;
+
+  // Uncompressed bricks are only moved, which is not worth a thread.
+  ThreadIdType numberOfThreads = 1;
+  if( m_Compression != "None" )
+    {
+    numberOfThreads = m_NumberOfThreads;
+    if( jobs.size() < numberOfThreads )
+      {
+      numberOfThreads = static_cast< ThreadIdType >( jobs.size() );
+      }
+    }
+
+  if( numberOfThreads <= 1 )
+    {
+    for( size_t k = 0; k < jobs.size(); k++ )
+      {
+      if( encode )
+        {
+        this->EncodeBrick( jobs[k] );
+        }
+      else
+        {
+        this->DecodeBrick( jobs[k] );
+        }
+      }
+    return;
+    }
+
+  MultiThreader::Pointer threader = MultiThreader::New();
+  threader->SetNumberOfThreads( numberOfThreads );
+  threader->SetSingleMethod( Self::CodecThreadCallback, &batch );
+  threader->SingleMethodExecute();
+}
+
+ITK_THREAD_RETURN_TYPE
+BrickedImageIO::CodecThreadCallback( void * arg )
+{
+  MultiThreader::ThreadInfoStruct * info =
+    static_cast< MultiThreader::ThreadInfoStruct * >( arg );
+
+  CodecBatchType * batch = static_cast< CodecBatchType * >( info->UserData );
+
+  std::vector< CodecJobType > & jobs = *batch->Jobs;
+
+  for( size_t k = info->ThreadID; k < jobs.size(); k += info->NumberOfThreads )
+    {
+    if( batch->Encode )
+      {
+      batch->IO->EncodeBrick( jobs[k] );
+      }
+    else
+      {
+      batch->IO->DecodeBrick( jobs[k] );
+      }
+    }
+
+  return ITK_THREAD_RETURN_VALUE;
+}
+
+void
+BrickedImageIO::EncodeBrick( CodecJobType & job ) const
+{
+  job.Failed = false;
+
+  if( m_Compression == "None" )
+    {
+    job.Output.swap( job.Input );
+    return;
+    }
+
+  uLongf length = compressBound( static_cast< uLong >( job.Input.size() ) );
+  job.Output.resize( length );
+
+  const int status = compress2( reinterpret_cast< Bytef * >( &job.Output[0] ), &length,
+                                reinterpret_cast< const Bytef * >( &job.Input[0] ),
+                                static_cast< uLong >( job.Input.size() ),
+                                m_CompressionLevel );
+
+  job.Failed = ( status != Z_OK );
+  job.Output.resize( length );
+
+  BufferType().swap( job.Input );
+}
+
+void
+BrickedImageIO::DecodeBrick( CodecJobType & job ) const
+{
+  job.Failed = false;
+
+  if( m_Compression == "None" )
+    {
+    job.Output.swap( job.Input );
+    return;
+    }
+
+  uLongf length = static_cast< uLongf >( job.OutputLength );
+  job.Output.resize( job.OutputLength );
+
+  const int status = uncompress( reinterpret_cast< Bytef * >( &job.Output[0] ), &length,
+                                 reinterpret_cast< const Bytef * >( &job.Input[0] ),
+                                 static_cast< uLong >( job.Input.size() ) );
+
+  job.Failed = ( status != Z_OK || length != job.OutputLength );
+
+  BufferType().swap( job.Input );
+}
+
+std::string
+BrickedImageIO::CreateHeader() const
+{
+  const unsigned int numberOfDimensions = this->GetNumberOfDimensions();
+
+  std::ostringstream header;
+  header.precision( 17 );
+
+  header << BrickedVolumeSignature << "\n";
+  header << "NDims = " << numberOfDimensions << "\n";
+
+  header << "DimSize =";
+  for( unsigned int i = 0; i < numberOfDimensions; i++ )
+    {
+    header << " " << this->GetDimensions(i);
+    }
+  header << "\n";
+
+  header << "ElementSpacing =";
+  for( unsigned int i = 0; i < numberOfDimensions; i++ )
+    {
+    header << " " << this->GetSpacing(i);
+    }
+  header << "\n";
+
+  header << "Offset =";
+  for( unsigned int i = 0; i < numberOfDimensions; i++ )
+    {
+    header << " " << this->GetOrigin(i);
+    }
+  header << "\n";
+
+  header << "Direction =";
+  for( unsigned int i = 0; i < numberOfDimensions; i++ )
+    {
+    const std::vector< double > axis = this->GetDirection(i);
+    for( unsigned int j = 0; j < numberOfDimensions; j++ )
+      {
+      header << " " << axis[j];
+      }
+    }
+  header << "\n";
+
+  header << "PixelType = " << GetPixelTypeAsString( this->GetPixelType() ) << "\n";
+  header << "ElementType = " << GetComponentTypeAsString( this->GetComponentType() ) << "\n";
+  header << "ElementNumberOfChannels = " << this->GetNumberOfComponents() << "\n";
+  header << "ByteOrderMSB = "
+         << ( ByteSwapper< int >::SystemIsBigEndian() ? "True" : "False" ) << "\n";
+
+  header << "BrickSize =";
+  for( unsigned int i = 0; i < numberOfDimensions; i++ )
+    {
+    header << " " << m_Grid.GetBrickSize()[i];
+    }
+  header << "\n";
+
+  header << "NumberOfBricks = " << m_Grid.GetNumberOfBricks() << "\n";
+  header << "Compression = " << m_Compression << "\n";
+  header << "HeaderEnd\n";
+
+  return header.str();
+}
+
+void
+BrickedImageIO::BeginWriting()
+{
+  if( !this->SupportsDimension( this->GetNumberOfDimensions() ) )
+    {
+    itkExceptionMacro("Unsupported number of dimensions " << this->GetNumberOfDimensions());
+    }
+
+  m_Compression = this->GetUseCompression() ? "Zlib" : "None";
+
+  m_Grid.SetImageRegion( this->GetImageGridRegion() );
+  m_Grid.SetBrickSize( m_BrickSize );
+
+  const std::string header = this->CreateHeader();
+
+  m_IndexOffset = AlignHeaderLength( header.size() );
+
+  m_BrickIndex.assign( m_Grid.GetNumberOfBricks(), IndexEntryType() );
+  for( size_t k = 0; k < m_BrickIndex.size(); k++ )
+    {
+    m_BrickIndex[k].Offset = 0;
+    m_BrickIndex[k].Length = 0;
+    }
+
+  m_PendingBricks.clear();
+  m_NumberOfBricksWritten = 0;
+
+  //
+  // Statistics are only kept for scalar pixels. A sidecar left by an
+  // earlier version of the file would no longer describe it.
+  //
+  m_CollectStatistics = m_WriteStatistics && this->GetNumberOfComponents() == 1;
+
+  const std::string statisticsFileName = BrickStatistics::GetSidecarFileName( m_FileName );
+
+  if( m_CollectStatistics )
+    {
+    m_Statistics.Initialize( m_Grid.GetImageRegion(), m_BrickSize );
+    }
+  else if( itksys::SystemTools::FileExists( statisticsFileName.c_str() ) )
+    {
+    itksys::SystemTools::RemoveFile( statisticsFileName.c_str() );
+    }
+
+  m_OutputFile.close();
+  m_OutputFile.clear();
+  m_OutputFile.open( m_FileName.c_str(), std::ios::out | std::ios::binary | std::ios::trunc );
+
+  if( !m_OutputFile )
+    {
+    itkExceptionMacro("Could not open file " << m_FileName << " for writing");
+    }
+
+  std::string paddedHeader = header;
+  paddedHeader.resize( m_IndexOffset, '\0' );
+
+  m_OutputFile.write( paddedHeader.c_str(), paddedHeader.size() );
+  m_OutputFile.write( reinterpret_cast< const char * >( &m_BrickIndex[0] ),
+                      m_BrickIndex.size() * sizeof( IndexEntryType ) );
+
+  if( !m_OutputFile )
+    {
+    itkExceptionMacro("Could not write the header of file " << m_FileName);
+    }
+
+  m_WriteOffset = m_IndexOffset + m_BrickIndex.size() * sizeof( IndexEntryType );
+
+  m_Writing = true;
+  m_WritingFileName = m_FileName;
+}
+
+void
+BrickedImageIO::FlushBricks( const std::vector< BrickIdType > & ids )
+{
+  std::vector< CodecJobType > jobs( ids.size() );
+
+  for( size_t k = 0; k < ids.size(); k++ )
+    {
+    std::map< BrickIdType, PendingBrickType >::iterator pending = m_PendingBricks.find( ids[k] );
+
+    if( m_CollectStatistics )
+      {
+      m_Statistics.ComputeBrick( ids[k], &pending->second.Data[0], this->GetComponentType() );
+      }
+
+    jobs[k].Id = ids[k];
+    jobs[k].Input.swap( pending->second.Data );
+
+    m_PendingBricks.erase( pending );
+    }
+
+  this->RunCodec( jobs, true );
+
+  for( size_t k = 0; k < jobs.size(); k++ )
+    {
+    const CodecJobType & job = jobs[k];
+
+    if( job.Failed )
+      {
+      itkExceptionMacro("Could not compress brick " << job.Id << " of file " << m_WritingFileName);
+      }
+
+    m_OutputFile.write( &job.Output[0], job.Output.size() );
+
+    if( !m_OutputFile )
+      {
+      itkExceptionMacro("Could not write brick " << job.Id << " of file " << m_WritingFileName);
+      }
+
+    m_BrickIndex[job.Id].Offset = m_WriteOffset;
+    m_BrickIndex[job.Id].Length = job.Output.size();
+
+    m_WriteOffset += job.Output.size();
+    m_NumberOfBricksWritten++;
+    }
+}
+
+void
+BrickedImageIO::FlushAllBricks()
+{
+  std::vector< BrickIdType > ids;
+
+  std::map< BrickIdType, PendingBrickType >::const_iterator it = m_PendingBricks.begin();
+  while( it != m_PendingBricks.end() )
+    {
+    ids.push_back( it->first );
+    ++it;
+    }
+
+  this->FlushBricks( ids );
+}
+
+void
+BrickedImageIO::EndWriting()
+{
+  m_Writing = false;
+
+  m_OutputFile.seekp( static_cast< std::streamoff >( m_IndexOffset ) );
+  m_OutputFile.write( reinterpret_cast< const char * >( &m_BrickIndex[0] ),
+                      m_BrickIndex.size() * sizeof( IndexEntryType ) );
+
+  const bool failed = !m_OutputFile;
+
+  m_OutputFile.close();
+
+  if( failed )
+    {
+    itkExceptionMacro("Could not write the brick index of file " << m_WritingFileName);
+    }
+
+  if( m_CollectStatistics )
+    {
+    m_Statistics.Write( BrickStatistics::GetSidecarFileName( m_WritingFileName ) );
+    }
+}
+
+void
+BrickedImageIO::Write(const void *buffer)
+{
+  if( m_Writing && m_WritingFileName != m_FileName )
+    {
+    this->FlushAllBricks();
+    this->EndWriting();
+    }
+
+  if( !m_Writing )
+    {
+    this->BeginWriting();
+    }
+
+  const GridRegionType region = this->GetIORegionAsGridRegion();
+  const SizeValueType pixelSize = this->GetPixelSize();
+
+  const GridType::BrickIdListType bricks = m_Grid.GetBricksIntersecting( region );
+
+  std::vector< BrickIdType > completed;
+
+  for( size_t k = 0; k < bricks.size(); k++ )
+    {
+    const BrickIdType id = bricks[k];
+    const GridRegionType brickRegion = m_Grid.GetBrickRegion( id );
+
+    PendingBrickType & pending = m_PendingBricks[id];
+    if( pending.Data.empty() )
+      {
+      pending.Data.assign( brickRegion.GetNumberOfPixels() * pixelSize, 0 );
+      pending.NumberOfPixelsWritten = 0;
+      }
+
+    GridRegionType overlap = brickRegion;
+    overlap.Crop( region );
+
+    GridType::CopyRegion( static_cast< const char * >( buffer ), region,
+                          &pending.Data[0], brickRegion,
+                          overlap, pixelSize );
+
+    pending.NumberOfPixelsWritten += overlap.GetNumberOfPixels();
+
+    if( pending.NumberOfPixelsWritten >= brickRegion.GetNumberOfPixels() )
+      {
+      completed.push_back( id );
+      }
+    }
+
+  // The bricks completed by this piece are encoded together.
+  this->FlushBricks( completed );
+
+  if( m_NumberOfBricksWritten == m_Grid.GetNumberOfBricks() )
+    {
+    this->EndWriting();
+    }
+}
+
+void
+BrickedImageIO::PrintSelf(std::ostream & os, Indent indent) const
+{
+  Superclass::PrintSelf(os, indent);
+
+  os << indent << "BrickSize: " << m_BrickSize << std::endl;
+  os << indent << "MaximumNumberOfCachedBricks: " << m_MaximumNumberOfCachedBricks << std::endl;
+  os << indent << "CompressionLevel: " << m_CompressionLevel << std::endl;
+  os << indent << "NumberOfThreads: " << m_NumberOfThreads << std::endl;
+  os << indent << "WriteStatistics: " << m_WriteStatistics << std::endl;
+  os << indent << "Compression: " << m_Compression << std::endl;
+  os << indent << "NumberOfCachedBricks: " << m_Cache.size() << std::endl;
+}
+
+} // end namespace itk
@@ -29,6 +29,9 @@ vtkInteractorStyleImageCursor::vtkInteractorStyleImageCursor()
 {
   this->ImageActor = NULL;
   this->RenderWindow = NULL;
+  this->SliceMin = 0;
+  this->SliceMax = -1;
+  this->Slice = 0;
 }
 
 //----------------------------------------------------------------------------
@@ -48,6 +51,13 @@ void vtkInteractorStyleImageCursor::SetRenderWindow( vtkRenderWindow * renderWin
   this->RenderWindow = renderWindow;
 }
 
+//----------------------------------------------------------------------------
+void vtkInteractorStyleImageCursor::SetSliceRange( int minimum, int maximum )
+{
+  this->SliceMin = minimum;
+  this->SliceMax = maximum;
+}
+
 //----------------------------------------------------------------------------
 void vtkInteractorStyleImageCursor::RefreshRender()
 {
@@ -60,7 +70,17 @@ void vtkInteractorStyleImageCursor::RefreshRender()
 //----------------------------------------------------------------------------
 void vtkInteractorStyleImageCursor::GoToNextSlice()
 {
-  if( this->ImageActor )
+  if( this->SliceMax >= this->SliceMin )
+    {
+    if( this->Slice < this->SliceMax )
+      {
+      this->Slice++;
+      int direction = 1;
+      this->InvokeEvent( SliceChangedEvent, &direction );
+      }
+    std::cout << "Slice : " << this->Slice << std::endl;
+    }
+  else if( this->ImageActor )
     {
     int currentSlice = this->ImageActor->GetSliceNumber();
     int nextSlice = currentSlice + 1;
@@ -76,7 +96,17 @@ void vtkInteractorStyleImageCursor::GoToNextSlice()
 //----------------------------------------------------------------------------
 void vtkInteractorStyleImageCursor::GoToPreviousSlice()
 {
-  if( this->ImageActor )
+  if( this->SliceMax >= this->SliceMin )
+    {
+    if( this->Slice > this->SliceMin )
+      {
+      this->Slice--;
+      int direction = -1;
+      this->InvokeEvent( SliceChangedEvent, &direction );
+      }
+    std::cout << "Slice : " << this->Slice << std::endl;
+    }
+  else if( this->ImageActor )
     {
     int currentSlice = this->ImageActor->GetSliceNumber();
     int previousSlice = currentSlice - 1;
@@ -118,4 +148,7 @@ void vtkInteractorStyleImageCursor::OnChar()
 void vtkInteractorStyleImageCursor::PrintSelf(ostream& os, vtkIndent indent)
 {
   this->Superclass::PrintSelf(os, indent);
+  os << indent << "SliceMin: " << this->SliceMin << endl;
+  os << indent << "SliceMax: " << this->SliceMax << endl;
+  os << indent << "Slice: " << this->Slice << endl;
 }
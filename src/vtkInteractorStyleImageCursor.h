@@ -21,6 +21,12 @@
 //
 // Extends the vtkInteractorStyleImage to use cursor arrows to change image slices.
 //
+// When a slice range is given with SetSliceRange(), the style keeps the
+// current slice itself and, instead of moving the image actor, invokes
+// SliceChangedEvent with a pointer to the direction of travel (+1 or -1)
+// as call data. The observer is then in charge of loading and showing
+// the slice given by GetSlice().
+//
 // Note that the renderer's actors are not moved; instead the camera is moved.
 
 // .SECTION See Also
@@ -32,6 +38,7 @@
 #include "vtkInteractorStyleImage.h"
 #include "vtkImageActor.h"
 #include "vtkRenderWindow.h"
+#include "vtkCommand.h"
 
 
 class VTK_RENDERING_EXPORT vtkInteractorStyleImageCursor : public vtkInteractorStyleImage
@@ -44,6 +51,16 @@ public:
   void SetImageActor( vtkImageActor * );
   void SetRenderWindow( vtkRenderWindow * );
 
+  // Description:
+  // Invoked after the current slice changed, when a slice range is set.
+  enum { SliceChangedEvent = vtkCommand::UserEvent + 1 };
+
+  // Description:
+  // Range of slices to travel through, and current slice.
+  void SetSliceRange( int minimum, int maximum );
+  vtkSetMacro(Slice, int);
+  vtkGetMacro(Slice, int);
+
   // Description:
   // Override the key presses
   virtual void OnChar();
@@ -62,6 +79,10 @@ private:
 
   vtkImageActor   * ImageActor;
   vtkRenderWindow * RenderWindow;
+
+  int SliceMin;
+  int SliceMax;
+  int Slice;
 };
 
 #endif
@@ -0,0 +1,25 @@
+#
+# Checks that a metrics file written by the streaming tools has one
+# record per stream division.
+#
+#   cmake -DMETRICS_FILE=metrics.json -DNUMBER_OF_RECORDS=4 -P CheckMetrics.cmake
+#
+# Files ending in .json are read as JSON, any other as CSV.
+#
+if(NOT EXISTS "${METRICS_FILE}")
+  message(FATAL_ERROR "Missing metrics file ${METRICS_FILE}")
+endif()
+
+if("${METRICS_FILE}" MATCHES "\\.json$")
+  file(READ ${METRICS_FILE} METRICS)
+  string(REGEX MATCHALL "\"chunk\": [0-9]+" RECORDS "${METRICS}")
+else()
+  file(STRINGS ${METRICS_FILE} RECORDS REGEX "^[0-9]+,")
+endif()
+
+list(LENGTH RECORDS COUNT)
+
+if(NOT COUNT EQUAL NUMBER_OF_RECORDS)
+  message(FATAL_ERROR
+    "${METRICS_FILE} has ${COUNT} records instead of ${NUMBER_OF_RECORDS}")
+endif()
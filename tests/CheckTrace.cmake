@@ -0,0 +1,66 @@
+#
+# Checks a trace written by the streaming tools with --trace: the file
+# must be valid JSON (checked with CMake 3.19 or later), and on every
+# thread each begin event must be closed by an end event of the same
+# name, in nested order.
+#
+#   cmake -DTRACE_FILE=trace.json -P CheckTrace.cmake
+#
+if(NOT EXISTS "${TRACE_FILE}")
+  message(FATAL_ERROR "Missing trace file ${TRACE_FILE}")
+endif()
+
+if(NOT CMAKE_VERSION VERSION_LESS 3.19)
+  file(READ ${TRACE_FILE} TRACE)
+  string(JSON NUMBER_OF_EVENTS ERROR_VARIABLE JSON_ERROR LENGTH "${TRACE}" traceEvents)
+  if(JSON_ERROR)
+    message(FATAL_ERROR "${TRACE_FILE} is not a trace: ${JSON_ERROR}")
+  endif()
+endif()
+
+# The tracer writes one event per line.
+file(STRINGS ${TRACE_FILE} EVENTS REGEX "\"ph\": \"[BE]\"")
+
+if(NOT EVENTS)
+  message(FATAL_ERROR "${TRACE_FILE} has no duration events")
+endif()
+
+set(THREADS)
+
+foreach(EVENT ${EVENTS})
+  string(REGEX MATCH "\"name\": \"([^\"]*)\"" MATCHED "${EVENT}")
+  set(NAME "${CMAKE_MATCH_1}")
+  string(REGEX MATCH "\"ph\": \"([BE])\"" MATCHED "${EVENT}")
+  set(PHASE "${CMAKE_MATCH_1}")
+  string(REGEX MATCH "\"tid\": ([0-9]+)" MATCHED "${EVENT}")
+  set(THREAD "${CMAKE_MATCH_1}")
+
+  if(NAME STREQUAL "" OR THREAD STREQUAL "")
+    message(FATAL_ERROR "Malformed event in ${TRACE_FILE}: ${EVENT}")
+  endif()
+
+  list(APPEND THREADS ${THREAD})
+
+  if(PHASE STREQUAL "B")
+    list(APPEND OPEN_${THREAD} "${NAME}")
+  else()
+    list(LENGTH OPEN_${THREAD} DEPTH)
+    if(DEPTH EQUAL 0)
+      message(FATAL_ERROR "End of \"${NAME}\" without a begin on thread ${THREAD}")
+    endif()
+    math(EXPR LAST "${DEPTH} - 1")
+    list(GET OPEN_${THREAD} ${LAST} OPENED)
+    if(NOT OPENED STREQUAL NAME)
+      message(FATAL_ERROR "End of \"${NAME}\" while \"${OPENED}\" is open on thread ${THREAD}")
+    endif()
+    list(REMOVE_AT OPEN_${THREAD} ${LAST})
+  endif()
+endforeach()
+
+list(REMOVE_DUPLICATES THREADS)
+
+foreach(THREAD ${THREADS})
+  if(OPEN_${THREAD})
+    message(FATAL_ERROR "Unfinished events on thread ${THREAD}: ${OPEN_${THREAD}}")
+  endif()
+endforeach()
@@ -0,0 +1,48 @@
+#
+# Checks the window that ImageReadRegionOfInterestWriteFloat takes from
+# the statistics sidecar with --statistics: it must be the range that
+# ImageStatistics finds in the pixels of the reference volume.
+#
+#   cmake -DREGION_TOOL=ImageReadRegionOfInterestWriteFloat
+#         -DSTATISTICS_TOOL=ImageStatistics
+#         -DINPUT_FILE=volume.bvol -DREFERENCE_FILE=volume.mhd
+#         -DREGION="output.png 800 900 900 200 200" -DNUMBER_OF_PIECES=6
+#         -P CheckWindow.cmake
+#
+separate_arguments(REGION)
+
+execute_process(
+  COMMAND ${REGION_TOOL} ${INPUT_FILE} ${REGION} --statistics
+  OUTPUT_VARIABLE REGION_OUTPUT
+  RESULT_VARIABLE REGION_RESULT
+  )
+
+if(NOT REGION_RESULT EQUAL 0)
+  message(FATAL_ERROR "${REGION_TOOL} failed: ${REGION_OUTPUT}")
+endif()
+
+execute_process(
+  COMMAND ${STATISTICS_TOOL} ${REFERENCE_FILE} ${NUMBER_OF_PIECES}
+  OUTPUT_VARIABLE STATISTICS_OUTPUT
+  RESULT_VARIABLE STATISTICS_RESULT
+  )
+
+if(NOT STATISTICS_RESULT EQUAL 0)
+  message(FATAL_ERROR "${STATISTICS_TOOL} failed: ${STATISTICS_OUTPUT}")
+endif()
+
+if(NOT REGION_OUTPUT MATCHES "Window = ([^ \n]+) ([^ \n]+)")
+  message(FATAL_ERROR "${REGION_TOOL} printed no window: ${REGION_OUTPUT}")
+endif()
+set(WINDOW_MINIMUM "${CMAKE_MATCH_1}")
+set(WINDOW_MAXIMUM "${CMAKE_MATCH_2}")
+
+string(REGEX MATCH "Minimum = ([^ \n]+)" MATCHED "${STATISTICS_OUTPUT}")
+set(MINIMUM "${CMAKE_MATCH_1}")
+string(REGEX MATCH "Maximum = ([^ \n]+)" MATCHED "${STATISTICS_OUTPUT}")
+set(MAXIMUM "${CMAKE_MATCH_1}")
+
+if(NOT WINDOW_MINIMUM STREQUAL MINIMUM OR NOT WINDOW_MAXIMUM STREQUAL MAXIMUM)
+  message(FATAL_ERROR "The window is [${WINDOW_MINIMUM}, ${WINDOW_MAXIMUM}]"
+    " instead of the range [${MINIMUM}, ${MAXIMUM}] of ${REFERENCE_FILE}")
+endif()
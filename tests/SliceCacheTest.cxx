@@ -0,0 +1,324 @@
+/*=========================================================================
+ *
+ *  Copyright Insight Software Consortium
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#include <iostream>
+
+#include "itkImage.h"
+#include "itkImageFileReader.h"
+#include "itkImageRegionConstIteratorWithIndex.h"
+#include "itkSliceCache.h"
+
+#include "itksys/SystemTools.hxx"
+
+//
+// Checks the slice cache of ImageDisplay without a display: hits and
+// misses, the slices read around a miss, the eviction of the least
+// recently used slices, and the slices read in the background. Every
+// slice is compared with the same slice of the volume read as a whole.
+// With shrink factors, checks instead that every coarse slice holds
+// every f-th pixel of the full slice along X and Y.
+//
+typedef itk::Image< unsigned char, 3 >    ImageType;
+typedef itk::SliceCache< ImageType >      CacheType;
+
+static int Check( bool condition, const char * description )
+{
+  if( !condition )
+    {
+    std::cerr << "Failed: " << description << std::endl;
+    return 1;
+    }
+  return 0;
+}
+
+//
+// Whether the slice holds slice z of the volume, and nothing else.
+//
+static bool IsSliceOf( const ImageType * slice, const ImageType * volume,
+                       itk::IndexValueType z )
+{
+  if( slice == NULL )
+    {
+    return false;
+    }
+
+  ImageType::RegionType expected = volume->GetLargestPossibleRegion();
+  expected.SetIndex( 2, z );
+  expected.SetSize( 2, 1 );
+
+  if( slice->GetBufferedRegion() != expected )
+    {
+    return false;
+    }
+
+  itk::ImageRegionConstIteratorWithIndex< ImageType > it( slice, expected );
+
+  for( it.GoToBegin(); !it.IsAtEnd(); ++it )
+    {
+    if( it.Get() != volume->GetPixel( it.GetIndex() ) )
+      {
+      return false;
+      }
+    }
+
+  return true;
+}
+
+//
+// Wait for the prefetch thread to have read the given number of slices.
+//
+static bool WaitForPrefetch( const CacheType * cache, itk::SizeValueType numberOfSlices )
+{
+  for( unsigned int i = 0; i < 1000; i++ )
+    {
+    if( cache->GetNumberOfPrefetchedSlices() >= numberOfSlices )
+      {
+      return true;
+      }
+    itksys::SystemTools::Delay( 10 );
+    }
+  return false;
+}
+
+//
+// Hits, misses, margin, eviction and prefetch of full slices.
+//
+static int CheckCache( const char * fileName, const ImageType * volume )
+{
+  int failures = 0;
+
+  const itk::IndexValueType lastSlice =
+    static_cast< itk::IndexValueType >( volume->GetLargestPossibleRegion().GetSize( 2 ) ) - 1;
+
+  //
+  // A miss reads the slice with Margin slices on each side.
+  //
+  CacheType::Pointer cache = CacheType::New();
+  cache->SetFileName( fileName );
+  cache->SetCapacity( 4 );
+  cache->SetMargin( 1 );
+  cache->Initialize();
+
+  failures += Check( cache->GetLargestPossibleRegion() == volume->GetLargestPossibleRegion(),
+                     "region of the cache is the region of the file" );
+
+  ImageType::Pointer slice10 = cache->GetSlice( 10 );
+
+  failures += Check( IsSliceOf( slice10, volume, 10 ), "slice 10 matches the file" );
+  failures += Check( cache->GetNumberOfMisses() == 1, "first slice is a miss" );
+  failures += Check( cache->GetNumberOfHits() == 0, "no hit before the first slice" );
+  failures += Check( cache->GetNumberOfCachedSlices() == 3, "margin slices are cached" );
+  failures += Check( cache->IsCached( 9 ) && cache->IsCached( 11 ), "slices 9 and 11 are cached" );
+
+  //
+  // The margin slices are hits, and the same as in the file.
+  //
+  failures += Check( IsSliceOf( cache->GetSlice( 11 ), volume, 11 ), "slice 11 matches the file" );
+  failures += Check( IsSliceOf( cache->GetSlice( 9 ), volume, 9 ), "slice 9 matches the file" );
+  failures += Check( cache->GetNumberOfHits() == 2, "margin slices are hits" );
+  failures += Check( cache->GetNumberOfMisses() == 1, "margin slices are not misses" );
+
+  //
+  // Slices 19 to 21 push the total past the capacity, and slices 10
+  // and 11, the least recently used, are dropped in that order.
+  //
+  failures += Check( IsSliceOf( cache->GetSlice( 20 ), volume, 20 ), "slice 20 matches the file" );
+  failures += Check( cache->GetNumberOfMisses() == 2, "slice 20 is a miss" );
+  failures += Check( cache->GetNumberOfCachedSlices() == 4, "cache holds its capacity" );
+  failures += Check( !cache->IsCached( 10 ) && !cache->IsCached( 11 ),
+                     "least recently used slices are dropped" );
+  failures += Check( cache->IsCached( 9 ) && cache->IsCached( 19 ) &&
+                     cache->IsCached( 20 ) && cache->IsCached( 21 ),
+                     "most recently used slices are kept" );
+
+  failures += Check( IsSliceOf( slice10, volume, 10 ), "dropped slice is still valid" );
+
+  //
+  // Dropped slices are read again.
+  //
+  failures += Check( IsSliceOf( cache->GetSlice( 10 ), volume, 10 ), "slice 10 is read again" );
+  failures += Check( cache->GetNumberOfMisses() == 3, "dropped slice is a miss" );
+
+  //
+  // The margin stops at the first and last slices.
+  //
+  failures += Check( IsSliceOf( cache->GetSlice( 0 ), volume, 0 ), "first slice matches the file" );
+  failures += Check( cache->IsCached( 1 ), "margin after the first slice is cached" );
+  failures += Check( IsSliceOf( cache->GetSlice( lastSlice ), volume, lastSlice ),
+                     "last slice matches the file" );
+  failures += Check( cache->IsCached( lastSlice - 1 ), "margin before the last slice is cached" );
+
+  bool outside = false;
+  try
+    {
+    cache->GetSlice( lastSlice + 1 );
+    }
+  catch( itk::ExceptionObject & )
+    {
+    outside = true;
+    }
+  failures += Check( outside, "slice past the end is an error" );
+
+  cache->Stop();
+
+  //
+  // Prefetched slices are read in the background, in the direction of
+  // travel, and are hits once they are asked for.
+  //
+  CacheType::Pointer prefetchCache = CacheType::New();
+  prefetchCache->SetFileName( fileName );
+  prefetchCache->SetCapacity( 16 );
+  prefetchCache->SetMargin( 0 );
+  prefetchCache->Initialize();
+
+  prefetchCache->Prefetch( 50, 1, 5 );
+
+  failures += Check( WaitForPrefetch( prefetchCache, 5 ), "slices after 50 are prefetched" );
+
+  prefetchCache->Prefetch( 50, -1, 3 );
+
+  failures += Check( WaitForPrefetch( prefetchCache, 8 ), "slices before 50 are prefetched" );
+
+  for( itk::IndexValueType z = 47; z <= 55; z++ )
+    {
+    if( z != 50 )
+      {
+      failures += Check( IsSliceOf( prefetchCache->GetSlice( z ), volume, z ),
+                         "prefetched slice matches the file" );
+      }
+    }
+
+  failures += Check( prefetchCache->GetNumberOfHits() == 8, "prefetched slices are hits" );
+  failures += Check( prefetchCache->GetNumberOfMisses() == 0, "prefetched slices are not misses" );
+  failures += Check( !prefetchCache->IsCached( 50 ), "slice 50 is not prefetched" );
+
+  prefetchCache->Stop();
+
+  return failures;
+}
+
+//
+// Coarse pixel (i,j) of slice z is the file pixel (i f, j f, z). When the
+// size is not a multiple of f, the last coarse column and row come from
+// the last multiple of f in the file.
+//
+static int CheckShrinkFactor( const char * fileName, const ImageType * volume,
+                              unsigned int factor )
+{
+  int failures = 0;
+
+  CacheType::Pointer cache = CacheType::New();
+  cache->SetFileName( fileName );
+  cache->SetShrinkFactor( factor );
+  cache->SetMargin( 1 );
+  cache->Initialize();
+
+  const ImageType::RegionType fileRegion = volume->GetLargestPossibleRegion();
+  const ImageType::RegionType coarseRegion = cache->GetLargestPossibleRegion();
+
+  for( unsigned int i = 0; i < 2; i++ )
+    {
+    failures += Check( coarseRegion.GetIndex( i ) == 0, "coarse region starts at zero" );
+    failures += Check( coarseRegion.GetSize( i ) ==
+                       ( fileRegion.GetSize( i ) + factor - 1 ) / factor,
+                       "coarse size covers the last pixel of the file" );
+    failures += Check( cache->GetSpacing()[i] == volume->GetSpacing()[i] * factor,
+                       "coarse spacing is the file spacing times the factor" );
+    }
+
+  failures += Check( coarseRegion.GetIndex( 2 ) == fileRegion.GetIndex( 2 ) &&
+                     coarseRegion.GetSize( 2 ) == fileRegion.GetSize( 2 ),
+                     "coarse volume keeps every slice" );
+  failures += Check( cache->GetOrigin() == volume->GetOrigin(), "coarse origin is the file origin" );
+
+  const itk::IndexValueType lastSlice =
+    fileRegion.GetIndex( 2 ) + static_cast< itk::IndexValueType >( fileRegion.GetSize( 2 ) ) - 1;
+
+  const itk::IndexValueType slices[] = { fileRegion.GetIndex( 2 ), lastSlice / 2, lastSlice };
+
+  for( unsigned int k = 0; k < 3; k++ )
+    {
+    ImageType::Pointer slice = cache->GetSlice( slices[k] );
+
+    ImageType::RegionType expected = coarseRegion;
+    expected.SetIndex( 2, slices[k] );
+    expected.SetSize( 2, 1 );
+
+    failures += Check( slice->GetBufferedRegion() == expected, "coarse slice holds one slice" );
+
+    bool same = true;
+
+    itk::ImageRegionConstIteratorWithIndex< ImageType > it( slice, expected );
+
+    for( it.GoToBegin(); !it.IsAtEnd() && same; ++it )
+      {
+      ImageType::IndexType index = it.GetIndex();
+      index[0] = fileRegion.GetIndex( 0 ) + index[0] * static_cast< itk::IndexValueType >( factor );
+      index[1] = fileRegion.GetIndex( 1 ) + index[1] * static_cast< itk::IndexValueType >( factor );
+
+      same = fileRegion.IsInside( index ) && it.Get() == volume->GetPixel( index );
+      }
+
+    failures += Check( same, "coarse slice holds every f-th pixel of the full slice" );
+    }
+
+  cache->Stop();
+
+  return failures;
+}
+
+int main(int argc, char * argv[])
+{
+  if( argc < 2 )
+    {
+    std::cerr << "Missing Parameters " << std::endl;
+    std::cerr << "Usage: " << argv[0];
+    std::cerr << " inputImageFile [shrinkFactor ...]" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  typedef itk::ImageFileReader< ImageType > ReaderType;
+
+  ReaderType::Pointer reader = ReaderType::New();
+  reader->SetFileName( argv[1] );
+
+  int failures = 0;
+
+  try
+    {
+    reader->Update();
+
+    if( argc == 2 )
+      {
+      failures += CheckCache( argv[1], reader->GetOutput() );
+      }
+
+    for( int i = 2; i < argc; i++ )
+      {
+      failures += CheckShrinkFactor( argv[1], reader->GetOutput(), atoi( argv[i] ) );
+      }
+    }
+  catch( itk::ExceptionObject & err )
+    {
+    std::cerr << err << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  std::cout << failures << " failed checks" << std::endl;
+
+  return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}